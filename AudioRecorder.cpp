@@ -0,0 +1,124 @@
+#include "AudioRecorder.h"
+#include <algorithm>
+#include <chrono>
+
+// How often the writer drains the ring when not woken
+static const std::chrono::milliseconds DRAIN_INTERVAL(20);
+
+AudioRecorder::AudioRecorder()
+    : m_recording(false)
+    , m_channels(0)
+    , m_readIndex(0)
+    , m_writeIndex(0)
+    , m_framesWritten(0)
+    , m_framesDropped(0)
+{
+}
+
+AudioRecorder::~AudioRecorder()
+{
+    Stop();
+}
+
+bool AudioRecorder::Start(const std::string& path, int channels, uint32_t sampleRate, WaveSampleFormat format)
+{
+    Stop();
+
+    if (channels <= 0 || !m_writer.Open(path, channels, sampleRate, format))
+    {
+        return false;
+    }
+
+    m_ring.assign(RING_SAMPLES, 0.0f);
+    m_channels = channels;
+    m_readIndex = 0;
+    m_writeIndex = 0;
+    m_framesWritten = 0;
+    m_framesDropped = 0;
+    m_recording = true;
+    m_thread = std::thread(&AudioRecorder::WriterThread, this);
+    return true;
+}
+
+void AudioRecorder::Stop()
+{
+    if (!m_recording)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_recording = false;
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    m_writer.Close();
+}
+
+void AudioRecorder::Write(const float* interleaved, size_t frames)
+{
+    if (!m_recording)
+    {
+        return;
+    }
+
+    size_t samples = frames * m_channels;
+    size_t write = m_writeIndex.load(std::memory_order_relaxed);
+    size_t used = write - m_readIndex.load(std::memory_order_acquire);
+    if (samples > RING_SAMPLES - used)
+    {
+        m_framesDropped.fetch_add(frames, std::memory_order_relaxed);
+        return;
+    }
+
+    for (size_t i = 0; i < samples; i++)
+    {
+        m_ring[(write + i) & (RING_SAMPLES - 1)] = interleaved[i];
+    }
+    m_writeIndex.store(write + samples, std::memory_order_release);
+}
+
+size_t AudioRecorder::Drain(std::vector<float>& chunk)
+{
+    size_t read = m_readIndex.load(std::memory_order_relaxed);
+    size_t available = m_writeIndex.load(std::memory_order_acquire) - read;
+    available -= available % m_channels;
+
+    chunk.resize(available);
+    for (size_t i = 0; i < available; i++)
+    {
+        chunk[i] = m_ring[(read + i) & (RING_SAMPLES - 1)];
+    }
+    m_readIndex.store(read + available, std::memory_order_release);
+    return available / m_channels;
+}
+
+void AudioRecorder::WriterThread()
+{
+    std::vector<float> chunk;
+    for (;;)
+    {
+        bool recording;
+        {
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_wake.wait_for(lock, DRAIN_INTERVAL, [this] { return !m_recording; });
+            recording = m_recording;
+        }
+
+        // Drain whatever the callback has written, including the tail after Stop
+        size_t frames = Drain(chunk);
+        if (frames > 0 && m_writer.Write(chunk.data(), frames))
+        {
+            m_framesWritten.fetch_add(frames, std::memory_order_relaxed);
+        }
+
+        if (!recording)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "WaveFileWriter.h"
+
+// Records audio from the callback to a WAV file without doing I/O on the
+// callback thread. Write copies samples into a lock-free ring; a writer
+// thread drains it to disk. If the disk falls behind, the samples that do
+// not fit are dropped and counted instead of stalling the callback.
+class AudioRecorder {
+public:
+    AudioRecorder();
+    ~AudioRecorder();
+
+    bool Start(const std::string& path, int channels, uint32_t sampleRate, WaveSampleFormat format);
+    void Stop();
+    bool IsRecording() const { return m_recording; }
+
+    // Audio thread: append interleaved frames
+    void Write(const float* interleaved, size_t frames);
+
+    uint64_t GetFramesWritten() const { return m_framesWritten; }
+    uint64_t GetFramesDropped() const { return m_framesDropped; }
+
+private:
+    // About six seconds of stereo audio at 44.1 kHz
+    static const size_t RING_SAMPLES = 1 << 19;
+
+    void WriterThread();
+    size_t Drain(std::vector<float>& chunk);
+
+    WaveFileWriter m_writer;
+    std::thread m_thread;
+    std::atomic<bool> m_recording;
+    int m_channels;
+
+    std::vector<float> m_ring;
+    std::atomic<size_t> m_readIndex;
+    std::atomic<size_t> m_writeIndex;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+
+    std::atomic<uint64_t> m_framesWritten;
+    std::atomic<uint64_t> m_framesDropped;
+};
@@ -0,0 +1,130 @@
+#include "AudioTap.h"
+#include <cstring>
+
+// Slot headers and data start on cache-line boundaries
+static uint32_t AlignTo64(uint32_t bytes)
+{
+    return (bytes + 63) & ~63u;
+}
+
+AudioTap::AudioTap()
+    : m_header(nullptr)
+    , m_next(0)
+{
+}
+
+AudioTap::~AudioTap()
+{
+    Stop();
+}
+
+bool AudioTap::Start(const std::wstring& name, uint32_t slotCount, uint32_t slotBytes)
+{
+    Stop();
+
+    if (slotCount < 2 || slotBytes == 0)
+    {
+        return false;
+    }
+    uint32_t slotStride = AlignTo64(sizeof(AudioTapSlot) + slotBytes);
+    size_t size = AlignTo64(sizeof(AudioTapHeader)) + static_cast<size_t>(slotCount) * slotStride;
+
+    bool existed = false;
+    if (!m_memory.Create(name, size, existed))
+    {
+        return false;
+    }
+    AudioTapHeader* header = reinterpret_cast<AudioTapHeader*>(m_memory.GetData());
+
+    if (existed && header->magic == AUDIO_TAP_MAGIC)
+    {
+        // Readers may still be attached to a region an earlier engine left;
+        // reuse it only if they would read it the same way
+        if (header->version != AUDIO_TAP_VERSION || header->slotCount != slotCount ||
+            header->slotBytes != slotBytes || header->slotStride != slotStride)
+        {
+            m_memory.Close();
+            return false;
+        }
+        m_header = header;
+        m_next = header->published.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        // Touch every page now so the audio thread never takes a page fault
+        memset(m_memory.GetData(), 0, size);
+        header->version = AUDIO_TAP_VERSION;
+        header->slotCount = slotCount;
+        header->slotBytes = slotBytes;
+        header->slotStride = slotStride;
+        header->published.store(0, std::memory_order_relaxed);
+        m_header = header;
+        m_next = 0;
+        for (uint32_t i = 0; i < slotCount; i++)
+        {
+            SlotFor(i)->sequence.store(AUDIO_TAP_WRITING, std::memory_order_relaxed);
+        }
+
+        // Readers check the magic first, so it goes in last
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = AUDIO_TAP_MAGIC;
+    }
+
+    header->writerSession.fetch_add(1, std::memory_order_relaxed);
+    header->writerOpen.store(1, std::memory_order_release);
+    return true;
+}
+
+void AudioTap::Stop()
+{
+    if (!m_header)
+    {
+        return;
+    }
+    m_header->writerOpen.store(0, std::memory_order_release);
+    m_header = nullptr;
+    m_memory.Close();
+}
+
+AudioTapSlot* AudioTap::SlotFor(uint64_t sequence) const
+{
+    uint8_t* slots = m_memory.GetData() + AlignTo64(sizeof(AudioTapHeader));
+    return reinterpret_cast<AudioTapSlot*>(slots + (sequence % m_header->slotCount) * m_header->slotStride);
+}
+
+void AudioTap::Write(const float* interleaved, uint32_t frames, uint32_t channels, uint32_t sampleRate,
+                     uint64_t streamFrame, double hostTimeMs)
+{
+    if (!m_header || channels == 0)
+    {
+        return;
+    }
+
+    uint32_t slotFrames = m_header->slotBytes / (channels * sizeof(float));
+    while (frames > 0 && slotFrames > 0)
+    {
+        uint32_t count = frames < slotFrames ? frames : slotFrames;
+        AudioTapSlot* slot = SlotFor(m_next);
+
+        // Mark the slot as changing before touching its contents, so a
+        // reader still holding the previous block sees it go stale
+        slot->sequence.store(AUDIO_TAP_WRITING, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->streamFrame = streamFrame;
+        slot->hostTimeMs = hostTimeMs;
+        slot->frames = count;
+        slot->channels = channels;
+        slot->sampleRate = sampleRate;
+        slot->format = AudioTapSampleFormat::Float32;
+        memcpy(reinterpret_cast<uint8_t*>(slot) + sizeof(AudioTapSlot), interleaved, count * channels * sizeof(float));
+
+        slot->sequence.store(m_next, std::memory_order_release);
+        m_next++;
+        m_header->published.store(m_next, std::memory_order_release);
+
+        interleaved += count * channels;
+        streamFrame += count;
+        frames -= count;
+    }
+}
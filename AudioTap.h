@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "AudioTapLayout.h"
+#include "SharedMemory.h"
+
+// Publishes the engine's output into a named shared-memory ring for local
+// consumers such as visualizers, loggers and recorders (see
+// AudioTapReader). Write is a copy into the ring and a few atomic stores:
+// it never waits for a reader, and a reader that falls behind loses the
+// oldest blocks rather than holding the engine up.
+class AudioTap {
+public:
+    // 4096 stereo float frames per slot; 128 slots hold about 12 seconds
+    // of 44.1 kHz stereo, so a reader has plenty of time to keep up
+    static const uint32_t DEFAULT_SLOT_COUNT = 128;
+    static const uint32_t DEFAULT_SLOT_BYTES = 32768;
+
+    AudioTap();
+    ~AudioTap();
+
+    AudioTap(const AudioTap&) = delete;
+    AudioTap& operator=(const AudioTap&) = delete;
+
+    // Creates the region, or takes over one left by an earlier engine and
+    // continues its block numbering so attached readers carry on. Not
+    // thread-safe with Write; start and stop while no audio is flowing.
+    bool Start(const std::wstring& name, uint32_t slotCount = DEFAULT_SLOT_COUNT, uint32_t slotBytes = DEFAULT_SLOT_BYTES);
+    void Stop();
+    bool IsOpen() const { return m_header != nullptr; }
+
+    // Audio thread: publishes interleaved frames. A block larger than a
+    // slot is split across consecutive slots.
+    void Write(const float* interleaved, uint32_t frames, uint32_t channels, uint32_t sampleRate,
+               uint64_t streamFrame, double hostTimeMs);
+
+    uint64_t GetBlocksPublished() const { return m_next; }
+
+private:
+    AudioTapSlot* SlotFor(uint64_t sequence) const;
+
+    SharedMemory m_memory;
+    AudioTapHeader* m_header;
+    uint64_t m_next;                // Sequence of the next block
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Shared-memory layout of the audio tap (see AudioTap and AudioTapReader).
+//
+// The region is an AudioTapHeader followed by slotCount slots, each an
+// AudioTapSlot header followed by slotBytes of sample data. Blocks of audio
+// are numbered from 0 and block n lives in slot n % slotCount. The writer
+// never waits for readers: it overwrites the oldest slot, so a reader
+// checks a slot's sequence before and after reading it, seqlock style.
+//
+// Only fixed-width fields and lock-free atomics appear here, so 32-bit and
+// 64-bit readers agree on the layout.
+
+static const uint32_t AUDIO_TAP_MAGIC = 0x5054414D;    // "MATP"
+static const uint32_t AUDIO_TAP_VERSION = 1;
+static const wchar_t* const AUDIO_TAP_DEFAULT_NAME = L"MusicAppTap";
+
+// Slot sequence while its data is being replaced or before first use
+static const uint64_t AUDIO_TAP_WRITING = ~0ull;
+
+enum class AudioTapSampleFormat : uint32_t {
+    Float32 = 0     // Interleaved, nominal range -1..1
+};
+
+struct AudioTapHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotBytes;             // Sample data capacity of each slot
+    uint32_t slotStride;            // Distance between slot headers
+    uint32_t reserved;
+    std::atomic<uint32_t> writerOpen;   // 0 once the engine has stopped the tap
+    std::atomic<uint32_t> writerSession;// Changes each time an engine takes over the region
+    alignas(64) std::atomic<uint64_t> published;    // Blocks completed so far
+};
+
+struct alignas(64) AudioTapSlot {
+    std::atomic<uint64_t> sequence; // Block held, or AUDIO_TAP_WRITING
+    uint64_t streamFrame;           // Position of the first frame in the engine's capture stream
+    double hostTimeMs;              // SampleTimeline::HostTimeMs() when the buffer arrived
+    uint32_t frames;
+    uint32_t channels;
+    uint32_t sampleRate;
+    AudioTapSampleFormat format;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The tap needs lock-free 64-bit atomics in shared memory");
+static_assert(sizeof(AudioTapSlot) == 64, "AudioTapSlot is one cache line");
@@ -0,0 +1,150 @@
+#include "AudioTapReader.h"
+
+static size_t AlignTo64(size_t bytes)
+{
+    return (bytes + 63) & ~static_cast<size_t>(63);
+}
+
+AudioTapReader::AudioTapReader()
+    : m_header(nullptr)
+    , m_session(0)
+    , m_next(0)
+    , m_blocksRead(0)
+    , m_blocksSkipped(0)
+    , m_blocksTorn(0)
+{
+}
+
+AudioTapReader::~AudioTapReader()
+{
+    Close();
+}
+
+bool AudioTapReader::Open(const std::wstring& name)
+{
+    Close();
+
+    if (!m_memory.Open(name) || m_memory.GetSize() < sizeof(AudioTapHeader))
+    {
+        m_memory.Close();
+        return false;
+    }
+
+    const AudioTapHeader* header = reinterpret_cast<const AudioTapHeader*>(m_memory.GetData());
+    bool valid = header->magic == AUDIO_TAP_MAGIC && header->version == AUDIO_TAP_VERSION && header->slotCount >= 2 &&
+                 header->slotStride >= sizeof(AudioTapSlot) + header->slotBytes &&
+                 AlignTo64(sizeof(AudioTapHeader)) + static_cast<size_t>(header->slotCount) * header->slotStride <= m_memory.GetSize();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid)
+    {
+        m_memory.Close();
+        return false;
+    }
+
+    m_header = header;
+    m_session = header->writerSession.load(std::memory_order_relaxed);
+    m_next = header->published.load(std::memory_order_acquire);
+    m_blocksRead = 0;
+    m_blocksSkipped = 0;
+    m_blocksTorn = 0;
+    return true;
+}
+
+void AudioTapReader::Close()
+{
+    m_header = nullptr;
+    m_memory.Close();
+}
+
+bool AudioTapReader::IsWriterOpen() const
+{
+    return m_header && m_header->writerOpen.load(std::memory_order_acquire) != 0;
+}
+
+const AudioTapSlot* AudioTapReader::SlotFor(uint64_t sequence) const
+{
+    const uint8_t* slots = m_memory.GetData() + AlignTo64(sizeof(AudioTapHeader));
+    return reinterpret_cast<const AudioTapSlot*>(slots + (sequence % m_header->slotCount) * m_header->slotStride);
+}
+
+bool AudioTapReader::Acquire(AudioTapBlock& block)
+{
+    if (!m_header)
+    {
+        return false;
+    }
+
+    // A new engine continues the numbering, but follow its latest block
+    // rather than trust the gap
+    uint32_t session = m_header->writerSession.load(std::memory_order_relaxed);
+    if (session != m_session)
+    {
+        m_session = session;
+        m_next = m_header->published.load(std::memory_order_acquire);
+    }
+
+    for (;;)
+    {
+        uint64_t published = m_header->published.load(std::memory_order_acquire);
+        if (m_next >= published)
+        {
+            return false;
+        }
+
+        // The writer reuses a slot slotCount blocks later; once it gets that
+        // far, jump to the newest block, which has the most time left
+        if (published - m_next >= m_header->slotCount)
+        {
+            m_blocksSkipped += published - 1 - m_next;
+            m_next = published - 1;
+        }
+
+        const AudioTapSlot* slot = SlotFor(m_next);
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence != m_next)
+        {
+            // Overwritten since published was read; move on
+            m_blocksSkipped++;
+            m_next++;
+            continue;
+        }
+
+        block.sequence = sequence;
+        block.streamFrame = slot->streamFrame;
+        block.hostTimeMs = slot->hostTimeMs;
+        block.frames = slot->frames;
+        block.channels = slot->channels;
+        block.sampleRate = slot->sampleRate;
+        block.format = slot->format;
+        block.samples = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(slot) + sizeof(AudioTapSlot));
+
+        // Fields read mid-overwrite could be anything; keep the sample count
+        // inside the slot so a torn block can only give wrong values
+        if (block.channels == 0 || static_cast<uint64_t>(block.frames) * block.channels * sizeof(float) > m_header->slotBytes)
+        {
+            block.frames = 0;
+        }
+
+        m_next++;
+        m_blocksRead++;
+        return true;
+    }
+}
+
+bool AudioTapReader::Release(const AudioTapBlock& block)
+{
+    if (!m_header)
+    {
+        return false;
+    }
+
+    // Pairs with the writer's fence after marking the slot as changing: if
+    // any read saw new data, this load sees the mark or a later sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (SlotFor(block.sequence)->sequence.load(std::memory_order_relaxed) != block.sequence)
+    {
+        m_blocksTorn++;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "AudioTapLayout.h"
+#include "SharedMemory.h"
+
+// One block of tapped audio. samples points straight into the shared ring;
+// nothing is copied.
+struct AudioTapBlock {
+    uint64_t sequence;
+    uint64_t streamFrame;       // Position in the engine's capture stream
+    double hostTimeMs;          // Engine's SampleTimeline::HostTimeMs() at capture
+    uint32_t frames;
+    uint32_t channels;
+    uint32_t sampleRate;
+    AudioTapSampleFormat format;
+    const float* samples;       // frames * channels interleaved values
+};
+
+// Reader side of the audio tap, for use in other processes. It only needs
+// this class, SharedMemory and AudioTapLayout.h. Any number of readers can
+// attach; none of them can slow the engine down.
+//
+//     AudioTapReader reader;
+//     reader.Open(AUDIO_TAP_DEFAULT_NAME);
+//     AudioTapBlock block;
+//     while (reader.Acquire(block))
+//     {
+//         Analyse(block.samples, block.frames);
+//         if (!reader.Release(block))
+//         {
+//             // Overwritten while in use: discard the results
+//         }
+//     }
+//
+// The engine never waits, so a block can be overwritten while it is being
+// read if the reader falls a whole ring behind. Release reports that; a
+// reader that needs the data afterwards copies it out before calling
+// Release. Acquire does not block: poll, for example once per display
+// frame or every few milliseconds.
+class AudioTapReader {
+public:
+    AudioTapReader();
+    ~AudioTapReader();
+
+    AudioTapReader(const AudioTapReader&) = delete;
+    AudioTapReader& operator=(const AudioTapReader&) = delete;
+
+    // Attaches to the tap; reading starts with the next block published
+    bool Open(const std::wstring& name);
+    void Close();
+    bool IsOpen() const { return m_header != nullptr; }
+
+    // The next block in order, or false if none has been published since
+    // the last one. A reader more than a ring behind skips ahead to the
+    // newest block, and the gap is counted.
+    bool Acquire(AudioTapBlock& block);
+
+    // True if block was intact for the whole time it was held
+    bool Release(const AudioTapBlock& block);
+
+    // False once the engine has stopped the tap; reopen to follow a new one
+    bool IsWriterOpen() const;
+
+    uint64_t GetBlocksRead() const { return m_blocksRead; }
+    uint64_t GetBlocksSkipped() const { return m_blocksSkipped; }
+    uint64_t GetBlocksTorn() const { return m_blocksTorn; }
+
+private:
+    const AudioTapSlot* SlotFor(uint64_t sequence) const;
+
+    SharedMemory m_memory;
+    const AudioTapHeader* m_header;
+    uint32_t m_session;
+    uint64_t m_next;
+    uint64_t m_blocksRead;
+    uint64_t m_blocksSkipped;   // Lost by falling behind
+    uint64_t m_blocksTorn;      // Overwritten while held
+};
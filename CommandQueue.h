@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "MpscQueue.h"
+
+// MpscQueue whose consumer thread can sleep until something is posted.
+//
+// Push stays lock-free apart from taking the wake mutex for an instant
+// before notifying. That orders the notify after any consumer that already
+// checked the queue under the mutex has gone to sleep, so a wake-up is
+// never lost and the consumer needs no polling timeout to recover one.
+template <typename T, size_t Capacity>
+class CommandQueue {
+public:
+    CommandQueue()
+        : m_closed(false)
+    {
+    }
+
+    // Any thread; returns false when full
+    bool Push(const T& item)
+    {
+        if (!m_queue.Push(item))
+        {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_wake.notify_one();
+        return true;
+    }
+
+    // Consumer side
+    bool Pop(T& item) { return m_queue.Pop(item); }
+
+    // Consumer side: returns once an item is queued, the queue is closed or
+    // the deadline passes
+    void WaitUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait_until(lock, deadline, [this] { return m_queue.Size() > 0 || m_closed; });
+    }
+
+    // Wakes the consumer and keeps WaitUntil from sleeping until reopened
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_wake.notify_one();
+    }
+
+    void Reopen()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = false;
+    }
+
+private:
+    MpscQueue<T, Capacity> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_closed;
+};
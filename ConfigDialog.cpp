@@ -2,8 +2,12 @@
 #include <commctrl.h>
 #include <windowsx.h>
 
-ConfigDialog::ConfigDialog(HWND hParent)
+ConfigDialog::ConfigDialog(HWND hParent, DeviceManager& deviceManager, EngineController& engine)
     : m_hParent(hParent)
+    , m_deviceManager(deviceManager)
+    , m_engine(engine)
+    , m_pendingAudioConnect(0)
+    , m_pendingMidiConnect(0)
 {
 }
 
@@ -48,8 +52,17 @@ INT_PTR ConfigDialog::HandleMessage(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM
         case WM_INITDIALOG:
             InitializeControls(hwnd);
             UpdateDeviceLists(hwnd);
+            SetTimer(hwnd, ID_ENGINE_STATE_TIMER, ENGINE_STATE_POLL_MS, nullptr);
             return TRUE;
 
+        case WM_TIMER:
+            if (wParam == ID_ENGINE_STATE_TIMER)
+            {
+                OnEngineState(hwnd);
+                return TRUE;
+            }
+            break;
+
         case WM_CLOSE:
             OnCancel(hwnd);
             return TRUE;
@@ -153,9 +166,11 @@ void ConfigDialog::OnTestAudioChanged(HWND hwnd, bool checked)
             const auto& input = m_audioInputDevices[inputIndex];
             const auto& output = m_audioOutputDevices[outputIndex];
 
-            if (!m_deviceManager.ConnectAudioInputToOutput(input, output))
+            // The outcome arrives with a later engine state
+            m_pendingAudioConnect = m_engine.Post(EngineCommand::ConnectAudio, input.deviceId, output.deviceId);
+            if (m_pendingAudioConnect == 0)
             {
-                MessageBoxW(hwnd, L"Failed to connect audio devices", L"Error", MB_ICONERROR);
+                MessageBoxW(hwnd, L"Audio engine is busy, try again", L"Error", MB_ICONERROR);
                 CheckDlgButton(hwnd, IDC_TEST_AUDIO_CHECK, BST_UNCHECKED);
                 return;
             }
@@ -163,7 +178,8 @@ void ConfigDialog::OnTestAudioChanged(HWND hwnd, bool checked)
     }
     else
     {
-        m_deviceManager.DisconnectAudioDevices();
+        m_pendingAudioConnect = 0;
+        m_engine.Post(EngineCommand::DisconnectAudio);
     }
 }
 
@@ -181,9 +197,10 @@ void ConfigDialog::OnTestMidiChanged(HWND hwnd, bool checked)
             const auto& input = m_midiInputDevices[inputIndex];
             const auto& output = m_midiOutputDevices[outputIndex];
 
-            if (!m_deviceManager.ConnectMidiInputToOutput(input, output))
+            m_pendingMidiConnect = m_engine.Post(EngineCommand::ConnectMidi, input.deviceId, output.deviceId);
+            if (m_pendingMidiConnect == 0)
             {
-                MessageBoxW(hwnd, L"Failed to connect MIDI devices", L"Error", MB_ICONERROR);
+                MessageBoxW(hwnd, L"MIDI engine is busy, try again", L"Error", MB_ICONERROR);
                 CheckDlgButton(hwnd, IDC_TEST_MIDI_CHECK, BST_UNCHECKED);
                 return;
             }
@@ -191,15 +208,43 @@ void ConfigDialog::OnTestMidiChanged(HWND hwnd, bool checked)
     }
     else
     {
-        m_deviceManager.DisconnectMidiDevices();
+        m_pendingMidiConnect = 0;
+        m_engine.Post(EngineCommand::DisconnectMidi);
+    }
+}
+
+void ConfigDialog::OnEngineState(HWND hwnd)
+{
+    std::shared_ptr<const EngineState> state = m_engine.GetState();
+
+    // A connect that has been applied but left nothing connected failed
+    if (m_pendingAudioConnect != 0 && state->appliedSequence >= m_pendingAudioConnect)
+    {
+        m_pendingAudioConnect = 0;
+        if (!state->audioConnected)
+        {
+            CheckDlgButton(hwnd, IDC_TEST_AUDIO_CHECK, BST_UNCHECKED);
+            MessageBoxW(hwnd, L"Failed to connect audio devices", L"Error", MB_ICONERROR);
+        }
+    }
+
+    if (m_pendingMidiConnect != 0 && state->appliedSequence >= m_pendingMidiConnect)
+    {
+        m_pendingMidiConnect = 0;
+        if (!state->midiConnected)
+        {
+            CheckDlgButton(hwnd, IDC_TEST_MIDI_CHECK, BST_UNCHECKED);
+            MessageBoxW(hwnd, L"Failed to connect MIDI devices", L"Error", MB_ICONERROR);
+        }
     }
 }
 
 void ConfigDialog::OnOK(HWND hwnd)
 {
     // Disconnect any test connections
-    m_deviceManager.DisconnectAudioDevices();
-    m_deviceManager.DisconnectMidiDevices();
+    KillTimer(hwnd, ID_ENGINE_STATE_TIMER);
+    m_engine.Post(EngineCommand::DisconnectAudio);
+    m_engine.Post(EngineCommand::DisconnectMidi);
 
     EndDialog(hwnd, IDOK);
 }
@@ -207,8 +252,9 @@ void ConfigDialog::OnOK(HWND hwnd)
 void ConfigDialog::OnCancel(HWND hwnd)
 {
     // Disconnect any test connections
-    m_deviceManager.DisconnectAudioDevices();
-    m_deviceManager.DisconnectMidiDevices();
+    KillTimer(hwnd, ID_ENGINE_STATE_TIMER);
+    m_engine.Post(EngineCommand::DisconnectAudio);
+    m_engine.Post(EngineCommand::DisconnectMidi);
 
     EndDialog(hwnd, IDCANCEL);
 } 
\ No newline at end of file
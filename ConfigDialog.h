@@ -2,6 +2,7 @@
 
 #include <windows.h>
 #include "DeviceManager.h"
+#include "EngineController.h"
 
 // Dialog control IDs
 #define IDD_CONFIG_DIALOG 101
@@ -14,9 +15,15 @@
 #define IDC_OK_BUTTON 1007
 #define IDC_CANCEL_BUTTON 1008
 
+// Polls the engine state for the outcome of queued test connections
+#define ID_ENGINE_STATE_TIMER 3001
+#define ENGINE_STATE_POLL_MS 30
+
 class ConfigDialog {
 public:
-    ConfigDialog(HWND hParent);
+    // Devices are enumerated through the DeviceManager; every change to
+    // them goes through the EngineController so the UI never blocks on it
+    ConfigDialog(HWND hParent, DeviceManager& deviceManager, EngineController& engine);
     ~ConfigDialog();
 
     bool Show();
@@ -28,11 +35,15 @@ private:
     void UpdateDeviceLists(HWND hwnd);
     void OnTestAudioChanged(HWND hwnd, bool checked);
     void OnTestMidiChanged(HWND hwnd, bool checked);
+    void OnEngineState(HWND hwnd);
     void OnOK(HWND hwnd);
     void OnCancel(HWND hwnd);
 
     HWND m_hParent;
-    DeviceManager m_deviceManager;
+    DeviceManager& m_deviceManager;
+    EngineController& m_engine;
+    uint64_t m_pendingAudioConnect;     // Sequence of the queued connect, 0 if none
+    uint64_t m_pendingMidiConnect;
     std::vector<AudioDeviceInfo> m_audioInputDevices;
     std::vector<AudioDeviceInfo> m_audioOutputDevices;
     std::vector<MidiDeviceInfo> m_midiInputDevices;
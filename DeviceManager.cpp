@@ -1,4 +1,7 @@
 #include "DeviceManager.h"
+#include "RealtimeGuard.h"
+#include <algorithm>
+#include <mmreg.h>
 #include <mmdeviceapi.h>
 #include <functiondiscoverykeys_devpkey.h>
 #include <endpointvolume.h>
@@ -14,14 +17,44 @@ DeviceManager::DeviceManager()
     , m_hWaveOut(nullptr)
     , m_audioConnected(false)
     , m_isShuttingDown(false)
+    , m_numBuffers(DEFAULT_NUM_BUFFERS)
+    , m_bufferSize(DEFAULT_BUFFER_SIZE)
+    , m_currentBuffer(0)
+    , m_waveFormat()
+    , m_audioFormat{ DEFAULT_SAMPLE_RATE, 2, DeviceSampleFormat::Pcm16 }
+    , m_pipeline(nullptr)
+    , m_pendingGapFrames(0)
+    , m_pendingCaptureFrames(0)
+    , m_pendingGapCause(DropoutCause::CaptureGap)
+    , m_buffersProcessed(0)
+    , m_framesProcessed(0)
+    , m_emptyBuffers(0)
+    , m_requeueFailures(0)
+    , m_dropouts(0)
+    , m_concealedFrames(0)
+    , m_silencedFrames(0)
+    , m_outputWriteFailures(0)
+    , m_midiMessagesIn(0)
+    , m_midiMessagesOut(0)
+    , m_connectHostMs(0.0)
+    , m_firstAudioHostMs(0.0)
+    , m_blockMidiEventCount(0)
     , m_hMidiIn(nullptr)
     , m_hMidiOut(nullptr)
     , m_midiConnected(false)
+    , m_nextMidiOutBuffer(0)
+    , m_midiBatchOptions()
+    , m_clockMode(MidiClockMode::Thru)
+    , m_tempoBpm(120.0)
+    , m_clockResetPending(false)
+    , m_midiStartHostMs(0.0)
+    , m_wave(GetSystemWaveDeviceApi())
 {
 }
 
 DeviceManager::~DeviceManager()
 {
+    StopRecording();
     DisconnectAudioDevices();
     DisconnectMidiDevices();
 }
@@ -84,11 +117,60 @@ std::vector<AudioDeviceInfo> DeviceManager::EnumerateAudioOutputDevices() const
     return devices;
 }
 
+// Sub-format for WAVE_FORMAT_EXTENSIBLE: the plain format tag followed by
+// the fixed audio suffix, so ksmedia.h and its GUID library are not needed
+static GUID WaveSubFormat(WORD tag)
+{
+    GUID guid = { tag, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+    return guid;
+}
+
+// Speaker positions for each channel count, in the usual layouts up to 7.1
+static const DWORD CHANNEL_MASKS[PIPELINE_MAX_CHANNELS] = {
+    SPEAKER_FRONT_CENTER,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_BACK_LEFT | SPEAKER_BACK_RIGHT,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT |
+        SPEAKER_BACK_RIGHT,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT |
+        SPEAKER_BACK_RIGHT | SPEAKER_BACK_CENTER,
+    SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT | SPEAKER_FRONT_CENTER | SPEAKER_LOW_FREQUENCY | SPEAKER_BACK_LEFT |
+        SPEAKER_BACK_RIGHT | SPEAKER_SIDE_LEFT | SPEAKER_SIDE_RIGHT
+};
+
+// 16-bit mono and stereo keep the plain format every driver takes; anything
+// else needs the extensible form, which also says where the channels go
+static void BuildWaveFormat(const AudioFormat& format, WAVEFORMATEXTENSIBLE& wfx)
+{
+    ZeroMemory(&wfx, sizeof(wfx));
+    WORD bytesPerSample = static_cast<WORD>(GetDeviceBytesPerSample(format.sampleFormat));
+    wfx.Format.nChannels = static_cast<WORD>(format.channels);
+    wfx.Format.nSamplesPerSec = format.sampleRate;
+    wfx.Format.wBitsPerSample = bytesPerSample * 8;
+    wfx.Format.nBlockAlign = static_cast<WORD>(format.channels * bytesPerSample);
+    wfx.Format.nAvgBytesPerSec = wfx.Format.nSamplesPerSec * wfx.Format.nBlockAlign;
+
+    if (format.sampleFormat == DeviceSampleFormat::Pcm16 && format.channels <= 2)
+    {
+        wfx.Format.wFormatTag = WAVE_FORMAT_PCM;
+        return;
+    }
+    wfx.Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+    wfx.Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+    wfx.Samples.wValidBitsPerSample = wfx.Format.wBitsPerSample;
+    wfx.dwChannelMask = CHANNEL_MASKS[format.channels - 1];
+    wfx.SubFormat = WaveSubFormat(format.sampleFormat == DeviceSampleFormat::Float32 ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+}
+
 bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, const AudioDeviceInfo& output)
 {
     LogMessage(L"\nConnecting audio devices...");
-    LogMessage((L"\nInput: " + input.name).c_str());
-    LogMessage((L"\nOutput: " + output.name).c_str());
+    LogMessage(L"\nInput: ");
+    LogMessage(input.name.c_str());
+    LogMessage(L"\nOutput: ");
+    LogMessage(output.name.c_str());
 
     m_isShuttingDown = false;
 
@@ -104,18 +186,15 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
         return false;
     }
 
-    // Configure wave format
-    WAVEFORMATEX wfx = {};
-    wfx.wFormatTag = WAVE_FORMAT_PCM;
-    wfx.nChannels = 2;
-    wfx.nSamplesPerSec = 44100;
-    wfx.wBitsPerSample = 16;
-    wfx.nBlockAlign = (wfx.nChannels * wfx.wBitsPerSample) / 8;
-    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
+    // Configure wave format and the per-sample steps that go with it
+    WAVEFORMATEXTENSIBLE wfx;
+    BuildWaveFormat(m_audioFormat, wfx);
+    m_waveFormat = wfx.Format;
+    m_pipeline = GetFramePipeline(m_audioFormat.sampleFormat, m_audioFormat.channels);
 
     LogMessage(L"\nOpening input device...");
     // Open wave input device with callback
-    MMRESULT result = waveInOpen(&m_hWaveIn, input.deviceId, &wfx, (DWORD_PTR)WaveInProc, (DWORD_PTR)this, CALLBACK_FUNCTION);
+    MMRESULT result = m_wave.waveInOpen(&m_hWaveIn, input.deviceId, &wfx.Format, (DWORD_PTR)WaveInProc, (DWORD_PTR)this, CALLBACK_FUNCTION);
     if (result != MMSYSERR_NOERROR)
     {
         LogMessage(L"\nFailed to open input device");
@@ -124,19 +203,30 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
 
     LogMessage(L"\nOpening output device...");
     // Open wave output device
-    result = waveOutOpen(&m_hWaveOut, output.deviceId, &wfx, 0, 0, CALLBACK_NULL);
+    result = m_wave.waveOutOpen(&m_hWaveOut, output.deviceId, &wfx.Format, 0, 0, CALLBACK_NULL);
     if (result != MMSYSERR_NOERROR)
     {
         LogMessage(L"\nFailed to open output device");
-        waveInClose(m_hWaveIn);
+        m_wave.waveInClose(m_hWaveIn);
         m_hWaveIn = nullptr;
         return false;
     }
 
+    // Buffers hold whole frames; output buffers leave room for dropout
+    // concealment in front of a block
+    uint32_t blockFrames = m_bufferSize / wfx.Format.nBlockAlign;
+    DWORD inputBytes = blockFrames * wfx.Format.nBlockAlign;
+    m_gapDetector.Reset(blockFrames);
+    m_concealer.Reset(wfx.Format.nChannels, wfx.Format.nSamplesPerSec, blockFrames);
+    m_concealBuffer.assign(m_concealer.GetMaxFillFrames() * wfx.Format.nChannels, 0.0f);
+    m_pendingGapFrames = 0;
+    m_pendingCaptureFrames = 0;
+    size_t outputBytes = inputBytes + m_concealer.GetMaxFillFrames() * wfx.Format.nBlockAlign;
+
     LogMessage(L"\nInitializing audio buffers...");
     // Initialize audio buffers
-    m_audioBuffers.resize(NUM_BUFFERS);
-    for (int i = 0; i < NUM_BUFFERS; i++)
+    m_audioBuffers.resize(m_numBuffers);
+    for (int i = 0; i < m_numBuffers; i++)
     {
         wchar_t debugMsg[256];
         swprintf_s(debugMsg, L"\nInitializing buffer %d", i);
@@ -145,26 +235,27 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
         // Initialize the buffer structures
         ZeroMemory(&m_audioBuffers[i].inHeader, sizeof(WAVEHDR));
         ZeroMemory(&m_audioBuffers[i].outHeader, sizeof(WAVEHDR));
-        ZeroMemory(m_audioBuffers[i].inData, BUFFER_SIZE);
-        ZeroMemory(m_audioBuffers[i].outData, BUFFER_SIZE);
+        m_audioBuffers[i].inData.assign(inputBytes, 0);
+        m_audioBuffers[i].outData.assign(outputBytes, 0);
         m_audioBuffers[i].inUse = false;
+        m_audioBuffers[i].requeuePending = false;
         
         // Set up the input header
-        m_audioBuffers[i].inHeader.lpData = (LPSTR)m_audioBuffers[i].inData;
-        m_audioBuffers[i].inHeader.dwBufferLength = BUFFER_SIZE;
+        m_audioBuffers[i].inHeader.lpData = (LPSTR)m_audioBuffers[i].inData.data();
+        m_audioBuffers[i].inHeader.dwBufferLength = inputBytes;
         m_audioBuffers[i].inHeader.dwUser = i;  // Store buffer index for tracking
         m_audioBuffers[i].inHeader.dwFlags = 0;
         m_audioBuffers[i].inHeader.dwLoops = 0;
 
         // Set up the output header
-        m_audioBuffers[i].outHeader.lpData = (LPSTR)m_audioBuffers[i].outData;
-        m_audioBuffers[i].outHeader.dwBufferLength = BUFFER_SIZE;
+        m_audioBuffers[i].outHeader.lpData = (LPSTR)m_audioBuffers[i].outData.data();
+        m_audioBuffers[i].outHeader.dwBufferLength = static_cast<DWORD>(outputBytes);
         m_audioBuffers[i].outHeader.dwUser = i;  // Store buffer index for tracking
         m_audioBuffers[i].outHeader.dwFlags = 0;
         m_audioBuffers[i].outHeader.dwLoops = 0;
 
         // Prepare headers
-        result = waveInPrepareHeader(m_hWaveIn, &m_audioBuffers[i].inHeader, sizeof(WAVEHDR));
+        result = m_wave.waveInPrepareHeader(m_hWaveIn, &m_audioBuffers[i].inHeader, sizeof(WAVEHDR));
         if (result != MMSYSERR_NOERROR)
         {
             LogMessage(L"\nFailed to prepare input header");
@@ -172,7 +263,7 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
             return false;
         }
 
-        result = waveOutPrepareHeader(m_hWaveOut, &m_audioBuffers[i].outHeader, sizeof(WAVEHDR));
+        result = m_wave.waveOutPrepareHeader(m_hWaveOut, &m_audioBuffers[i].outHeader, sizeof(WAVEHDR));
         if (result != MMSYSERR_NOERROR)
         {
             LogMessage(L"\nFailed to prepare output header");
@@ -181,7 +272,7 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
         }
 
         // Add buffer to input queue
-        result = waveInAddBuffer(m_hWaveIn, &m_audioBuffers[i].inHeader, sizeof(WAVEHDR));
+        result = m_wave.waveInAddBuffer(m_hWaveIn, &m_audioBuffers[i].inHeader, sizeof(WAVEHDR));
         if (result != MMSYSERR_NOERROR)
         {
             swprintf_s(debugMsg, L"\nFailed to add buffer to input queue, error: %d", result);
@@ -192,8 +283,21 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
     }
 
     LogMessage(L"\nStarting recording...");
-    // Start recording
-    result = waveInStart(m_hWaveIn);
+    // Start recording; the timeline counts from the first captured sample
+    m_floatBuffer.assign(blockFrames * wfx.Format.nChannels, 0.0f);
+    m_samplerMix.assign(blockFrames * 2, 0.0f);
+    m_sampler.SetSampleRate(wfx.Format.nSamplesPerSec);
+    m_inputMeter.Reset(wfx.Format.nChannels, wfx.Format.nSamplesPerSec);
+    m_timeline.Reset(wfx.Format.nSamplesPerSec);
+    m_firstAudioHostMs = 0.0;
+    m_connectHostMs = SampleTimeline::HostTimeMs();
+
+    // The audio callback consumes the MIDI events, so drop those left from
+    // the last connection before capture starts calling it. Nothing new is
+    // queued until m_audioConnected is set.
+    m_midiEvents.Clear();
+    m_currentBuffer = 0;
+    result = m_wave.waveInStart(m_hWaveIn);
     if (result != MMSYSERR_NOERROR)
     {
         LogMessage(L"\nFailed to start recording");
@@ -201,7 +305,6 @@ bool DeviceManager::ConnectAudioInputToOutput(const AudioDeviceInfo& input, cons
         return false;
     }
 
-    m_currentBuffer = 0;
     m_audioConnected = true;
     LogMessage(L"\nAudio devices connected successfully");
     return true;
@@ -214,6 +317,7 @@ void CALLBACK DeviceManager::WaveInProc(HWAVEIN hWaveIn, UINT uMsg, DWORD_PTR dw
         DeviceManager* manager = reinterpret_cast<DeviceManager*>(dwInstance);
         if (manager)
         {
+            RealtimeScope realtime;
             manager->HandleAudioData((LPWAVEHDR)dwParam1);
         }
     }
@@ -228,48 +332,129 @@ void DeviceManager::HandleAudioData(LPWAVEHDR lpWaveHdr)
         return;
     }
 
+    double hostTimeMs = SampleTimeline::HostTimeMs();
+
     int bufferIndex = static_cast<int>(lpWaveHdr->dwUser);
     if (bufferIndex >= 0 && bufferIndex < m_audioBuffers.size())
     {
         m_audioBuffers[bufferIndex].inUse = true;
     }
+    RetryRequeues();
 
     if (m_hWaveOut && lpWaveHdr->dwBytesRecorded > 0)
     {
-        wchar_t debugMsg[256];
-        swprintf_s(debugMsg, L"\nReceived audio data: %d bytes, buffer %d", 
-                  lpWaveHdr->dwBytesRecorded, static_cast<DWORD>(lpWaveHdr->dwUser));
-        LogMessage(debugMsg);
+        // Messages here are fixed strings: nothing is formatted per buffer,
+        // and failures are counted in the engine stats
+        LogMessage(L"\nReceived audio data");
+
+        uint32_t frames = lpWaveHdr->dwBytesRecorded / m_waveFormat.nBlockAlign;
+        int channels = m_waveFormat.nChannels;
+
+        // Frames the capture clock says should have arrived by now but have not
+        uint64_t captureEnd = m_timeline.GetSamplePosition(SampleTimeline::CAPTURE_STREAM) + frames;
+        double deficit = m_timeline.HostTimeToSample(hostTimeMs) - static_cast<double>(captureEnd);
+        uint32_t lostFrames = m_gapDetector.Update(deficit, m_timeline.GetEstimatedErrorSamples());
+        if (lostFrames > 0)
+        {
+            m_timeline.Skip(SampleTimeline::CAPTURE_STREAM, lostFrames);
+            AddGap(lostFrames, DropoutCause::CaptureGap);
+        }
+
+        // Place this buffer on the timeline and pick up the MIDI events that fall inside it
+        uint64_t blockStart = m_timeline.Advance(SampleTimeline::CAPTURE_STREAM, frames, hostTimeMs);
+        CollectBlockMidiEvents(blockStart, frames);
+
+        // Meter the input
+        m_pipeline->decode(lpWaveHdr->lpData, m_floatBuffer.data(), frames);
+        m_inputMeter.Process(m_floatBuffer.data(), frames);
+
+        // Mix in the sampler, playing each MIDI event at its frame. It also
+        // runs while an unload is pending so the old library gets released.
+        bool samplerActive = m_sampler.IsActive();
+        if (samplerActive)
+        {
+            RenderSampler(frames);
+        }
+
+        // Fill any gap since the last block, then blend this block in after it
+        uint32_t fillFrames = 0;
+        uint32_t captureFillFrames = 0;
+        if (m_pendingGapFrames > 0)
+        {
+            DropoutAction action;
+            fillFrames = m_concealer.Conceal(m_pendingGapFrames, m_concealBuffer.data(), action);
+            captureFillFrames = m_pendingCaptureFrames < fillFrames ? m_pendingCaptureFrames : fillFrames;
+            ReportDropout(blockStart, m_pendingGapFrames, m_pendingGapCause, action, hostTimeMs);
+            m_pendingGapFrames = 0;
+            m_pendingCaptureFrames = 0;
+        }
+        bool blended = m_concealer.Process(m_floatBuffer.data(), frames);
+
+        // The recorder and tap already have the frames of a block that only
+        // failed to play, so they get just the end of the fill that stands
+        // in for frames capture lost
+        if (captureFillFrames > 0)
+        {
+            const float* captureFill = m_concealBuffer.data() + static_cast<size_t>(fillFrames - captureFillFrames) * channels;
+            uint64_t fillStart = blockStart > captureFillFrames ? blockStart - captureFillFrames : 0;
+            m_recorder.Write(captureFill, captureFillFrames);
+            m_tap.Write(captureFill, captureFillFrames, channels, m_waveFormat.nSamplesPerSec, fillStart, hostTimeMs);
+        }
+        m_recorder.Write(m_floatBuffer.data(), frames);
+        m_tap.Write(m_floatBuffer.data(), frames, channels, m_waveFormat.nSamplesPerSec, blockStart, hostTimeMs);
+
+        m_buffersProcessed.fetch_add(1, std::memory_order_relaxed);
+        if (m_firstAudioHostMs == 0.0)
+        {
+            m_firstAudioHostMs = hostTimeMs;
+        }
+        m_framesProcessed.fetch_add(frames, std::memory_order_relaxed);
 
         // Get the corresponding output buffer
         LPWAVEHDR outHdr = &m_audioBuffers[lpWaveHdr->dwUser].outHeader;
         
-        // Copy the data to the output buffer
-        memcpy(outHdr->lpData, lpWaveHdr->lpData, lpWaveHdr->dwBytesRecorded);
-        outHdr->dwBufferLength = lpWaveHdr->dwBytesRecorded;
+        // Copy the data to the output buffer, after any concealment
+        if (samplerActive || fillFrames > 0 || blended)
+        {
+            BYTE* out = reinterpret_cast<BYTE*>(outHdr->lpData);
+            m_pipeline->encode(m_concealBuffer.data(), out, fillFrames);
+            m_pipeline->encode(m_floatBuffer.data(), out + fillFrames * m_waveFormat.nBlockAlign, frames);
+        }
+        else
+        {
+            memcpy(outHdr->lpData, lpWaveHdr->lpData, lpWaveHdr->dwBytesRecorded);
+        }
+        outHdr->dwBufferLength = (fillFrames + frames) * m_waveFormat.nBlockAlign;
         
         // Write the audio data to the output device
-        MMRESULT result = waveOutWrite(m_hWaveOut, outHdr, sizeof(WAVEHDR));
+        MMRESULT result = m_wave.waveOutWrite(m_hWaveOut, outHdr, sizeof(WAVEHDR));
         
         if (result == MMSYSERR_NOERROR)
         {
+            m_timeline.Advance(SampleTimeline::PLAYBACK_STREAM, fillFrames + frames, hostTimeMs);
             LogMessage(L"\nWrote data to output device");
         }
         else
         {
-            swprintf_s(debugMsg, L"\nFailed to write to output device, error: %d", result);
-            LogMessage(debugMsg);
+            // The next block makes up for this one
+            m_outputWriteFailures.fetch_add(1, std::memory_order_relaxed);
+            AddGap(fillFrames + frames, DropoutCause::OutputWriteFailed);
+            LogMessage(L"\nFailed to write to output device");
         }
 
         // Only requeue if we're not shutting down
         if (!m_isShuttingDown)
         {
             // Requeue the input buffer
-            result = waveInAddBuffer(m_hWaveIn, lpWaveHdr, sizeof(WAVEHDR));
+            result = m_wave.waveInAddBuffer(m_hWaveIn, lpWaveHdr, sizeof(WAVEHDR));
             if (result != MMSYSERR_NOERROR)
             {
-                swprintf_s(debugMsg, L"\nFailed to requeue input buffer, error: %d", result);
-                LogMessage(debugMsg);
+                // One buffer fewer in the capture queue until the retry on the
+                // next callback; a gap it causes shows up in the capture position
+                m_requeueFailures.fetch_add(1, std::memory_order_relaxed);
+                MarkRequeuePending(bufferIndex);
+                ReportDropout(blockStart, 0, DropoutCause::RequeueFailed, DropoutAction::None, hostTimeMs);
+                LogMessage(L"\nFailed to requeue input buffer");
             }
             else
             {
@@ -278,7 +463,7 @@ void DeviceManager::HandleAudioData(LPWAVEHDR lpWaveHdr)
         }
         
         // Rotate to next buffer
-        m_currentBuffer = (m_currentBuffer + 1) % NUM_BUFFERS;
+        m_currentBuffer = (m_currentBuffer + 1) % m_numBuffers;
     }
     else
     {
@@ -289,13 +474,24 @@ void DeviceManager::HandleAudioData(LPWAVEHDR lpWaveHdr)
         if (lpWaveHdr->dwBytesRecorded == 0)
         {
             LogMessage(L"\nNo bytes recorded in buffer");
-            
+            m_emptyBuffers.fetch_add(1, std::memory_order_relaxed);
+
+            // The period passed without audio; keep the capture position in
+            // step with the clock and fill the gap in the output
+            uint32_t missing = lpWaveHdr->dwBufferLength / m_waveFormat.nBlockAlign;
+            m_timeline.Skip(SampleTimeline::CAPTURE_STREAM, missing);
+            AddGap(missing, DropoutCause::EmptyBuffer);
+
             // Only requeue if we're not shutting down
             if (!m_isShuttingDown)
             {
-                MMRESULT result = waveInAddBuffer(m_hWaveIn, lpWaveHdr, sizeof(WAVEHDR));
+                MMRESULT result = m_wave.waveInAddBuffer(m_hWaveIn, lpWaveHdr, sizeof(WAVEHDR));
                 if (result != MMSYSERR_NOERROR)
                 {
+                    m_requeueFailures.fetch_add(1, std::memory_order_relaxed);
+                    MarkRequeuePending(bufferIndex);
+                    ReportDropout(m_timeline.GetSamplePosition(SampleTimeline::CAPTURE_STREAM), 0, DropoutCause::RequeueFailed,
+                                  DropoutAction::None, hostTimeMs);
                     LogMessage(L"\nFailed to requeue empty buffer");
                 }
             }
@@ -308,6 +504,47 @@ void DeviceManager::HandleAudioData(LPWAVEHDR lpWaveHdr)
     }
 }
 
+void DeviceManager::CollectBlockMidiEvents(uint64_t blockStart, uint32_t frames)
+{
+    m_blockMidiEventCount = 0;
+    uint64_t blockEnd = blockStart + frames;
+
+    // Events stamped before this block (late arrivals) land at its first frame
+    const TimedMidiEvent* event;
+    while ((event = m_midiEvents.Front()) != nullptr && event->samplePosition < blockEnd &&
+           m_blockMidiEventCount < MAX_BLOCK_MIDI_EVENTS)
+    {
+        BlockMidiEvent& blockEvent = m_blockMidiEvents[m_blockMidiEventCount++];
+        blockEvent.offset = event->samplePosition > blockStart ? static_cast<uint32_t>(event->samplePosition - blockStart) : 0;
+        blockEvent.message = event->message;
+        m_midiEvents.PopFront();
+    }
+}
+
+void DeviceManager::RenderSampler(uint32_t frames)
+{
+    float* mix = m_samplerMix.data();
+    std::fill(mix, mix + frames * 2, 0.0f);
+
+    // Render up to each event, then apply it
+    m_sampler.BeginBlock();
+    uint32_t rendered = 0;
+    for (int i = 0; i < m_blockMidiEventCount; i++)
+    {
+        uint32_t offset = m_blockMidiEvents[i].offset;
+        if (offset > rendered)
+        {
+            m_sampler.Render(mix + rendered * 2, offset - rendered);
+            rendered = offset;
+        }
+        m_sampler.HandleMidiMessage(m_blockMidiEvents[i].message);
+    }
+    m_sampler.Render(mix + rendered * 2, frames - rendered);
+
+    // Add to the audio passing through, folded down for mono devices
+    m_pipeline->addStereo(mix, m_floatBuffer.data(), frames);
+}
+
 void DeviceManager::DisconnectAudioDevices()
 {
     LogMessage(L"\nDisconnecting audio devices...");
@@ -318,7 +555,7 @@ void DeviceManager::DisconnectAudioDevices()
     if (m_hWaveIn)
     {
         LogMessage(L"\nStopping input device...");
-        waveInStop(m_hWaveIn);
+        m_wave.waveInStop(m_hWaveIn);
         
         // Wait for any in-flight buffers to complete
         LogMessage(L"\nWaiting for buffers to complete...");
@@ -337,10 +574,10 @@ void DeviceManager::DisconnectAudioDevices()
         } while (buffersInUse);
         
         LogMessage(L"\nResetting devices...");
-        waveInReset(m_hWaveIn);
+        m_wave.waveInReset(m_hWaveIn);
         if (m_hWaveOut)
         {
-            waveOutReset(m_hWaveOut);
+            m_wave.waveOutReset(m_hWaveOut);
         }
         
         LogMessage(L"\nUnpreparing buffers...");
@@ -348,28 +585,28 @@ void DeviceManager::DisconnectAudioDevices()
         {
             if (m_hWaveIn)
             {
-                waveInUnprepareHeader(m_hWaveIn, &buffer.inHeader, sizeof(WAVEHDR));
+                m_wave.waveInUnprepareHeader(m_hWaveIn, &buffer.inHeader, sizeof(WAVEHDR));
             }
             if (m_hWaveOut)
             {
-                waveOutUnprepareHeader(m_hWaveOut, &buffer.outHeader, sizeof(WAVEHDR));
+                m_wave.waveOutUnprepareHeader(m_hWaveOut, &buffer.outHeader, sizeof(WAVEHDR));
             }
         }
         
         LogMessage(L"\nClosing devices...");
-        waveInClose(m_hWaveIn);
+        m_wave.waveInClose(m_hWaveIn);
         m_hWaveIn = nullptr;
         
         if (m_hWaveOut)
         {
-            waveOutClose(m_hWaveOut);
+            m_wave.waveOutClose(m_hWaveOut);
             m_hWaveOut = nullptr;
         }
     }
     else if (m_hWaveOut)
     {
-        waveOutReset(m_hWaveOut);
-        waveOutClose(m_hWaveOut);
+        m_wave.waveOutReset(m_hWaveOut);
+        m_wave.waveOutClose(m_hWaveOut);
         m_hWaveOut = nullptr;
     }
     
@@ -378,6 +615,166 @@ void DeviceManager::DisconnectAudioDevices()
     LogMessage(L"\nAudio devices disconnected");
 }
 
+void DeviceManager::SetWaveDeviceApi(const WaveDeviceApi& api)
+{
+    // Never swapped under an open device
+    if (!m_hWaveIn && !m_hWaveOut)
+    {
+        m_wave = api;
+    }
+}
+
+void DeviceManager::SetBufferGeometry(int numBuffers, int bufferSize)
+{
+    // At least double buffering; connect rounds sizes down to whole frames
+    // (the windows.h min/max macros rule out std::min/std::max here)
+    m_numBuffers = numBuffers < 2 ? 2 : (numBuffers > 64 ? 64 : numBuffers);
+    m_bufferSize = (bufferSize < 256 ? 256 : (bufferSize > (1 << 20) ? (1 << 20) : bufferSize)) & ~3;
+}
+
+bool DeviceManager::SetAudioFormat(const AudioFormat& format)
+{
+    if (format.sampleRate < 8000 || format.sampleRate > 192000 || !GetFramePipeline(format.sampleFormat, format.channels))
+    {
+        return false;
+    }
+    m_audioFormat = format;
+    return true;
+}
+
+bool DeviceManager::StartRecording(const std::string& path)
+{
+    if (!m_audioConnected)
+    {
+        LogMessage(L"\nCannot record without an audio connection");
+        return false;
+    }
+    // Deeper device formats are recorded as float so no resolution is lost
+    WaveSampleFormat format = m_waveFormat.wBitsPerSample == 16 ? WaveSampleFormat::Pcm16 : WaveSampleFormat::Float32;
+    return m_recorder.Start(path, m_waveFormat.nChannels, m_waveFormat.nSamplesPerSec, format);
+}
+
+void DeviceManager::StopRecording()
+{
+    m_recorder.Stop();
+}
+
+void DeviceManager::MarkRequeuePending(int bufferIndex)
+{
+    if (bufferIndex >= 0 && bufferIndex < m_audioBuffers.size())
+    {
+        m_audioBuffers[bufferIndex].requeuePending = true;
+    }
+}
+
+// A capture buffer that could not be requeued is lost to the driver for good,
+// and once all of them are the input stops; give each another try
+void DeviceManager::RetryRequeues()
+{
+    for (AudioBuffer& buffer : m_audioBuffers)
+    {
+        if (buffer.requeuePending &&
+            m_wave.waveInAddBuffer(m_hWaveIn, &buffer.inHeader, sizeof(WAVEHDR)) == MMSYSERR_NOERROR)
+        {
+            buffer.requeuePending = false;
+        }
+    }
+}
+
+void DeviceManager::AddGap(uint32_t frames, DropoutCause cause)
+{
+    if (m_pendingGapFrames == 0)
+    {
+        m_pendingGapCause = cause;
+    }
+    m_pendingGapFrames += frames;
+    if (cause != DropoutCause::OutputWriteFailed)
+    {
+        m_pendingCaptureFrames += frames;
+    }
+}
+
+void DeviceManager::ReportDropout(uint64_t streamFrame, uint32_t gapFrames, DropoutCause cause, DropoutAction action, double hostTimeMs)
+{
+    if (gapFrames > 0)
+    {
+        m_dropouts.fetch_add(1, std::memory_order_relaxed);
+        if (action == DropoutAction::Repeated)
+        {
+            m_concealedFrames.fetch_add(gapFrames, std::memory_order_relaxed);
+        }
+        else
+        {
+            m_silencedFrames.fetch_add(gapFrames, std::memory_order_relaxed);
+        }
+    }
+    DropoutEvent event = { hostTimeMs, streamFrame, gapFrames, cause, action };
+    m_dropoutEvents.Push(event);
+}
+
+bool DeviceManager::ReadDropoutEvent(DropoutEvent& event)
+{
+    return m_dropoutEvents.Pop(event);
+}
+
+bool DeviceManager::StartTap(const std::wstring& name)
+{
+    if (m_hWaveIn || m_hWaveOut)
+    {
+        LogMessage(L"\nCannot start the tap while audio is connected");
+        return false;
+    }
+    return m_tap.Start(name);
+}
+
+void DeviceManager::StopTap()
+{
+    if (m_hWaveIn || m_hWaveOut)
+    {
+        LogMessage(L"\nCannot stop the tap while audio is connected");
+        return;
+    }
+    m_tap.Stop();
+}
+
+bool DeviceManager::LoadSampler(const std::wstring& mapPath, std::wstring& error)
+{
+    // Loading maps the files and decodes every attack, so it happens here
+    // rather than on the audio thread
+    std::shared_ptr<SampleLibrary> library = std::make_shared<SampleLibrary>();
+    if (!library->LoadMap(mapPath, error))
+    {
+        return false;
+    }
+    m_sampler.SetLibrary(library);
+    return true;
+}
+
+void DeviceManager::UnloadSampler()
+{
+    m_sampler.SetLibrary(nullptr);
+}
+
+EngineStats DeviceManager::GetStats() const
+{
+    EngineStats stats;
+    stats.buffersProcessed = m_buffersProcessed;
+    stats.framesProcessed = m_framesProcessed;
+    stats.emptyBuffers = m_emptyBuffers;
+    stats.requeueFailures = m_requeueFailures;
+    stats.outputWriteFailures = m_outputWriteFailures;
+    stats.midiMessagesIn = m_midiMessagesIn;
+    stats.midiMessagesOut = m_midiMessagesOut;
+    stats.recordedFrames = m_recorder.GetFramesWritten();
+    stats.recordDroppedFrames = m_recorder.GetFramesDropped();
+    stats.dropouts = m_dropouts;
+    stats.concealedFrames = m_concealedFrames;
+    stats.silencedFrames = m_silencedFrames;
+    stats.connectHostMs = m_connectHostMs;
+    stats.firstAudioHostMs = m_firstAudioHostMs;
+    return stats;
+}
+
 std::vector<MidiDeviceInfo> DeviceManager::EnumerateMidiInputDevices() const
 {
     std::vector<MidiDeviceInfo> devices;
@@ -437,13 +834,23 @@ std::vector<MidiDeviceInfo> DeviceManager::EnumerateMidiOutputDevices() const
 }
 
 bool DeviceManager::ConnectMidiInputToOutput(const MidiDeviceInfo& input, const MidiDeviceInfo& output)
+{
+    return ConnectMidi(input, &output);
+}
+
+bool DeviceManager::ConnectMidiInput(const MidiDeviceInfo& input)
+{
+    return ConnectMidi(input, nullptr);
+}
+
+bool DeviceManager::ConnectMidi(const MidiDeviceInfo& input, const MidiDeviceInfo* output)
 {
     if (m_midiConnected)
     {
         DisconnectMidiDevices();
     }
 
-    if (input.deviceId == MIDI_MAPPER || output.deviceId == MIDI_MAPPER)
+    if (input.deviceId == MIDI_MAPPER || (output && output->deviceId == MIDI_MAPPER))
     {
         return false;
     }
@@ -455,27 +862,47 @@ bool DeviceManager::ConnectMidiInputToOutput(const MidiDeviceInfo& input, const
         return false;
     }
 
-    // Open MIDI output device
-    result = midiOutOpen(&m_hMidiOut, output.deviceId, 0, 0, CALLBACK_NULL);
-    if (result != MMSYSERR_NOERROR)
+    // Open MIDI output device, if messages are to be forwarded
+    if (output)
     {
-        midiInClose(m_hMidiIn);
-        m_hMidiIn = nullptr;
-        return false;
+        result = midiOutOpen(&m_hMidiOut, output->deviceId, 0, 0, CALLBACK_NULL);
+        if (result != MMSYSERR_NOERROR)
+        {
+            midiInClose(m_hMidiIn);
+            m_hMidiIn = nullptr;
+            return false;
+        }
     }
 
-    // Start recording MIDI input
+    // No callbacks run before midiInStart, so the PLL can be reset here
+    m_clockPll.Reset(m_tempoBpm);
+    m_clockState.Publish(m_clockPll);
+    m_clockResetPending = false;
+
+    // Start recording MIDI input; input timestamps are relative to this point
+    m_midiStartHostMs = SampleTimeline::HostTimeMs();
     result = midiInStart(m_hMidiIn);
     if (result != MMSYSERR_NOERROR)
     {
         midiInClose(m_hMidiIn);
-        midiOutClose(m_hMidiOut);
         m_hMidiIn = nullptr;
-        m_hMidiOut = nullptr;
+        if (m_hMidiOut)
+        {
+            midiOutClose(m_hMidiOut);
+            m_hMidiOut = nullptr;
+        }
         return false;
     }
 
     m_midiConnected = true;
+    if (m_hMidiOut)
+    {
+        StartMidiBatching();
+        if (m_clockMode == MidiClockMode::Master)
+        {
+            StartClockMaster();
+        }
+    }
     return true;
 }
 
@@ -486,6 +913,7 @@ void CALLBACK DeviceManager::MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dw
         DeviceManager* manager = reinterpret_cast<DeviceManager*>(dwInstance);
         if (manager)
         {
+            RealtimeScope realtime;
             manager->HandleMidiMessage(dwParam1, dwParam2);
         }
     }
@@ -493,21 +921,244 @@ void CALLBACK DeviceManager::MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dw
 
 void DeviceManager::HandleMidiMessage(DWORD_PTR dwParam1, DWORD_PTR dwParam2)
 {
-    if (m_hMidiOut)
+    // Extract MIDI message components
+    BYTE status = (BYTE)(dwParam1 & 0xFF);
+    BYTE data1 = (BYTE)((dwParam1 >> 8) & 0xFF);
+    BYTE data2 = (BYTE)((dwParam1 >> 16) & 0xFF);
+    DWORD timestamp = (DWORD)dwParam2;
+    m_midiMessagesIn.fetch_add(1, std::memory_order_relaxed);
+
+    // Sync messages may be consumed by the clock instead of forwarded
+    if ((status >= MIDI_CLOCK || status == MIDI_SONG_POSITION) &&
+        HandleClockMessage(status, data1, data2, timestamp))
     {
-        // Extract MIDI message components
-        BYTE status = (BYTE)(dwParam1 & 0xFF);
-        BYTE data1 = (BYTE)((dwParam1 >> 8) & 0xFF);
-        BYTE data2 = (BYTE)((dwParam1 >> 16) & 0xFF);
-        DWORD timestamp = (DWORD)dwParam2;
+        return;
+    }
 
-        // Forward the message to the output device
-        midiOutShortMsg(m_hMidiOut, static_cast<DWORD>(dwParam1));
+    // Stamp channel and common messages with their position on the audio
+    // timeline, for the sampler, whether or not there is an output
+    if (m_audioConnected && status < MIDI_CLOCK)
+    {
+        double samplePosition = m_timeline.HostTimeToSample(m_midiStartHostMs + timestamp);
+        TimedMidiEvent event;
+        event.samplePosition = samplePosition > 0.0 ? static_cast<uint64_t>(samplePosition + 0.5) : 0;
+        event.message = static_cast<DWORD>(dwParam1);
+        m_midiEvents.Push(event);
+    }
+
+    // Forward the message to the output device, batched when enabled and
+    // directly if batching is off or the batcher cannot hold any more
+    if (m_hMidiOut &&
+        ((m_midiBatcher.IsRunning() && m_midiBatcher.Send(static_cast<uint32_t>(dwParam1))) ||
+         midiOutShortMsg(m_hMidiOut, static_cast<DWORD>(dwParam1)) == MMSYSERR_NOERROR))
+    {
+        m_midiMessagesOut.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
+bool DeviceManager::HandleClockMessage(BYTE status, BYTE data1, BYTE data2, DWORD timestamp)
+{
+    MidiClockMode mode = m_clockMode;
+    if (mode == MidiClockMode::Master)
+    {
+        // Only one clock master per chain; drop incoming sync
+        return status == MIDI_CLOCK || status == MIDI_START || status == MIDI_CONTINUE ||
+               status == MIDI_STOP || status == MIDI_SONG_POSITION;
+    }
+
+    if (mode == MidiClockMode::Slave)
+    {
+        // The PLL belongs to this callback; other threads read the copy
+        // published below and ask for resets through the flag
+        if (m_clockResetPending.exchange(false, std::memory_order_acquire))
+        {
+            m_clockPll.Reset(m_tempoBpm);
+        }
+
+        switch (status)
+        {
+            case MIDI_CLOCK:
+                m_clockPll.OnTick(static_cast<double>(timestamp));
+                break;
+            case MIDI_START:
+                m_clockPll.OnStart();
+                break;
+            case MIDI_CONTINUE:
+                m_clockPll.OnContinue();
+                break;
+            case MIDI_STOP:
+                m_clockPll.OnStop();
+                break;
+            case MIDI_SONG_POSITION:
+                m_clockPll.OnSongPosition(data1 | (data2 << 7));
+                break;
+        }
+        m_clockState.Publish(m_clockPll);
+    }
+
+    // Slave and thru modes pass sync on to the output
+    return false;
+}
+
+void DeviceManager::StartClockMaster()
+{
+    HMIDIOUT hMidiOut = m_hMidiOut;
+    m_clockMaster.Start([hMidiOut](uint8_t status) {
+        midiOutShortMsg(hMidiOut, status);
+    }, m_tempoBpm);
+}
+
+void DeviceManager::StartMidiBatching()
+{
+    if (m_midiBatchOptions.tickMicros == 0)
+    {
+        return;
+    }
+
+    m_midiOutBuffers.resize(NUM_MIDI_OUT_BUFFERS);
+    for (MidiOutBuffer& buffer : m_midiOutBuffers)
+    {
+        buffer.data.assign(MidiOutBatcher::MAX_BATCH_BYTES, 0);
+        ZeroMemory(&buffer.header, sizeof(MIDIHDR));
+        buffer.header.lpData = buffer.data.data();
+        buffer.header.dwBufferLength = static_cast<DWORD>(buffer.data.size());
+        if (midiOutPrepareHeader(m_hMidiOut, &buffer.header, sizeof(MIDIHDR)) != MMSYSERR_NOERROR)
+        {
+            LogMessage(L"\nFailed to prepare MIDI output buffer; sending messages directly");
+            StopMidiBatching();
+            return;
+        }
+    }
+    m_nextMidiOutBuffer = 0;
+
+    m_midiBatcher.Start([this](const uint8_t* bytes, size_t size) {
+        return SubmitMidiBatch(bytes, size);
+    }, m_midiBatchOptions);
+}
+
+void DeviceManager::StopMidiBatching()
+{
+    // Sends what is still queued, then takes back any buffers the driver holds
+    m_midiBatcher.Stop();
+    if (m_midiOutBuffers.empty())
+    {
+        return;
+    }
+
+    midiOutReset(m_hMidiOut);
+    for (MidiOutBuffer& buffer : m_midiOutBuffers)
+    {
+        if (buffer.header.dwFlags & MHDR_PREPARED)
+        {
+            midiOutUnprepareHeader(m_hMidiOut, &buffer.header, sizeof(MIDIHDR));
+        }
+    }
+    m_midiOutBuffers.clear();
+}
+
+bool DeviceManager::SubmitMidiBatch(const uint8_t* bytes, size_t size)
+{
+    // Buffers are used in rotation; if the next one is still queued the
+    // driver is behind and the batch waits for the next tick
+    MidiOutBuffer& buffer = m_midiOutBuffers[m_nextMidiOutBuffer];
+    if (buffer.header.dwFlags & MHDR_INQUEUE)
+    {
+        return false;
+    }
+
+    memcpy(buffer.data.data(), bytes, size);
+    buffer.header.dwBufferLength = static_cast<DWORD>(size);
+    if (midiOutLongMsg(m_hMidiOut, &buffer.header, sizeof(MIDIHDR)) != MMSYSERR_NOERROR)
+    {
+        return false;
+    }
+    m_nextMidiOutBuffer = (m_nextMidiOutBuffer + 1) % NUM_MIDI_OUT_BUFFERS;
+    return true;
+}
+
+void DeviceManager::SetMidiClockMode(MidiClockMode mode)
+{
+    if (mode == m_clockMode)
+    {
+        return;
+    }
+
+    m_clockMaster.Stop();
+    if (m_midiConnected)
+    {
+        // The MIDI callback may be using the PLL; it resets it on its next message
+        m_clockResetPending = true;
+    }
+    else
+    {
+        m_clockPll.Reset(m_tempoBpm);
+        m_clockState.Publish(m_clockPll);
+    }
+    m_clockMode = mode;
+
+    if (m_clockMode == MidiClockMode::Master && m_midiConnected && m_hMidiOut)
+    {
+        StartClockMaster();
+    }
+}
+
+void DeviceManager::SetTempo(double tempoBpm)
+{
+    if (tempoBpm <= 0.0)
+    {
+        return;
+    }
+
+    // In slave mode the tempo comes from the incoming clock
+    m_tempoBpm = tempoBpm;
+    m_clockMaster.SetTempo(tempoBpm);
+}
+
+// Until the callback has taken a pending reset, the slave reads as a clock
+// that has not received anything yet
+double DeviceManager::GetTempoBpm() const
+{
+    if (m_clockMode == MidiClockMode::Slave && !m_clockResetPending)
+    {
+        return m_clockState.GetStats().tempoBpm;
+    }
+    return m_tempoBpm;
+}
+
+double DeviceManager::GetBeatPosition() const
+{
+    if (m_clockMode == MidiClockMode::Slave)
+    {
+        if (m_clockResetPending)
+        {
+            return 0.0;
+        }
+        double nowMs = SampleTimeline::HostTimeMs() - m_midiStartHostMs;
+        return m_clockState.GetPhase().GetPositionTicks(nowMs) / MIDI_CLOCK_PPQN;
+    }
+    return m_clockMaster.GetPositionTicks() / MIDI_CLOCK_PPQN;
+}
+
+MidiClockStats DeviceManager::GetMidiClockStats() const
+{
+    if (m_clockMode == MidiClockMode::Slave)
+    {
+        if (m_clockResetPending)
+        {
+            MidiClockStats stats = {};
+            stats.tempoBpm = m_tempoBpm;
+            return stats;
+        }
+        return m_clockState.GetStats();
+    }
+    return m_clockMaster.GetStats();
+}
+
 void DeviceManager::DisconnectMidiDevices()
 {
+    // Stop the clock before its output handle goes away
+    m_clockMaster.Stop();
+
     if (m_hMidiIn)
     {
         midiInStop(m_hMidiIn);
@@ -516,6 +1167,8 @@ void DeviceManager::DisconnectMidiDevices()
     }
     if (m_hMidiOut)
     {
+        // After the input stops so nothing new is queued
+        StopMidiBatching();
         midiOutClose(m_hMidiOut);
         m_hMidiOut = nullptr;
     }
@@ -4,11 +4,55 @@
 #include <mmsystem.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include "MidiClock.h"
+#include "SampleTimeline.h"
+#include "SpscQueue.h"
+#include "LevelMeter.h"
+#include "AudioRecorder.h"
+#include "AudioTap.h"
+#include "DropoutConcealer.h"
+#include "FramePipeline.h"
+#include "MidiOutBatcher.h"
+#include "Sampler.h"
+#include "WaveDeviceApi.h"
 
 // Forward declarations
 struct AudioDeviceInfo;
 struct MidiDeviceInfo;
 
+// How MIDI clock is handled on the MIDI connection
+enum class MidiClockMode {
+    Thru,       // Forward incoming clock unchanged
+    Master,     // Generate clock; incoming sync messages are dropped
+    Slave       // Follow incoming clock through the PLL and forward it
+};
+
+// Sample format the audio devices are opened with
+struct AudioFormat {
+    uint32_t sampleRate;
+    int channels;                       // 1 to PIPELINE_MAX_CHANNELS
+    DeviceSampleFormat sampleFormat;
+};
+
+// Running engine counters, readable from any thread
+struct EngineStats {
+    uint64_t buffersProcessed;
+    uint64_t framesProcessed;
+    uint64_t emptyBuffers;
+    uint64_t requeueFailures;
+    uint64_t outputWriteFailures;
+    uint64_t midiMessagesIn;
+    uint64_t midiMessagesOut;
+    uint64_t recordedFrames;
+    uint64_t recordDroppedFrames;
+    uint64_t dropouts;          // Gaps in the audio, whatever the cause
+    uint64_t concealedFrames;   // Gap frames filled by repetition
+    uint64_t silencedFrames;    // Gap frames too long to fill, faded around instead
+    double connectHostMs;       // Host time of the last successful audio connect
+    double firstAudioHostMs;    // Host time the first buffer flowed after it, 0 until then
+};
+
 class DeviceManager {
 public:
     DeviceManager();
@@ -19,32 +63,157 @@ public:
     std::vector<AudioDeviceInfo> EnumerateAudioOutputDevices() const;
     bool ConnectAudioInputToOutput(const AudioDeviceInfo& input, const AudioDeviceInfo& output);
     void DisconnectAudioDevices();
+    bool IsAudioConnected() const { return m_audioConnected; }
+
+    // Device calls used for audio; the system's by default. Only takes
+    // effect while no audio device is open.
+    void SetWaveDeviceApi(const WaveDeviceApi& api);
+
+    // Buffer geometry used by the next audio connection
+    void SetBufferGeometry(int numBuffers, int bufferSize);
+    int GetNumBuffers() const { return m_numBuffers; }
+    int GetBufferSize() const { return m_bufferSize; }
+
+    // Sample format used by the next audio connection; false if unsupported
+    bool SetAudioFormat(const AudioFormat& format);
+    AudioFormat GetAudioFormat() const { return m_audioFormat; }
+
+    // Record the audio passing through to a WAV file
+    bool StartRecording(const std::string& path);
+    void StopRecording();
+
+    // Publish the output to a shared-memory ring for other local processes
+    // (see AudioTapReader). Only while no audio device is open.
+    bool StartTap(const std::wstring& name);
+    void StopTap();
+
+    EngineStats GetStats() const;
+
+    // Dropouts in the order they were handled; call from one thread only.
+    // Events that arrive while the queue is full are only counted in the stats.
+    bool ReadDropoutEvent(DropoutEvent& event);
+
+    // Sampler played from the MIDI input and mixed into the audio output.
+    // The map file format is described in SampleLibrary.h.
+    bool LoadSampler(const std::wstring& mapPath, std::wstring& error);
+    void UnloadSampler();
+    int GetSamplerVoiceCount() const { return m_sampler.GetActiveVoiceCount(); }
 
     // MIDI device management
     std::vector<MidiDeviceInfo> EnumerateMidiInputDevices() const;
     std::vector<MidiDeviceInfo> EnumerateMidiOutputDevices() const;
     bool ConnectMidiInputToOutput(const MidiDeviceInfo& input, const MidiDeviceInfo& output);
+    // Input only, to play the sampler: nothing is forwarded and the clock
+    // master has no output to drive
+    bool ConnectMidiInput(const MidiDeviceInfo& input);
     void DisconnectMidiDevices();
+    bool IsMidiConnected() const { return m_midiConnected; }
+
+    // MIDI clock sync
+    void SetMidiClockMode(MidiClockMode mode);
+    MidiClockMode GetMidiClockMode() const { return m_clockMode.load(); }
+    void SetTempo(double tempoBpm);
+    double GetTempoBpm() const;
+    double GetBeatPosition() const;  // Quarter notes since the last start
+    MidiClockStats GetMidiClockStats() const;
+
+    // Batched MIDI output: forwarded messages are collected per tick and sent
+    // as one long buffer. A tick of 0 sends each message directly. Applies
+    // from the next MIDI connection.
+    void SetMidiBatching(const MidiBatchOptions& options) { m_midiBatchOptions = options; }
+    MidiBatchStats GetMidiBatchStats() const { return m_midiBatcher.GetStats(); }
+
+    // Shared audio/MIDI timeline
+    const SampleTimeline& GetTimeline() const { return m_timeline; }
+
+    // Input level meters; call from a single (UI) thread
+    bool ReadInputLevels(LevelReading& reading) { return m_inputMeter.Read(reading); }
 
 private:
     // Audio device connection state
     HWAVEIN m_hWaveIn;
     HWAVEOUT m_hWaveOut;
-    bool m_audioConnected;
-    volatile bool m_isShuttingDown;  // Flag to indicate shutdown in progress
+    // Connection flags are read by the device callbacks and by other threads
+    std::atomic<bool> m_audioConnected;
+    std::atomic<bool> m_isShuttingDown;  // Flag to indicate shutdown in progress
 
     // Audio buffer management
-    static const int NUM_BUFFERS = 4;
-    static const int BUFFER_SIZE = 4096; // 2KB per buffer
+    static const int DEFAULT_NUM_BUFFERS = 4;
+    static const int DEFAULT_BUFFER_SIZE = 4096; // 4KB per buffer
+    static const uint32_t DEFAULT_SAMPLE_RATE = 44100;
+    int m_numBuffers;
+    int m_bufferSize;
     struct AudioBuffer {
         WAVEHDR inHeader;
         WAVEHDR outHeader;
-        BYTE inData[BUFFER_SIZE];
-        BYTE outData[BUFFER_SIZE];
+        std::vector<BYTE> inData;
+        std::vector<BYTE> outData;
         volatile bool inUse;  // Track if buffer is currently being processed
+        bool requeuePending;  // Capture requeue failed; retried on the next callback
     };
     std::vector<AudioBuffer> m_audioBuffers;
-    int m_currentBuffer;
+    std::atomic<int> m_currentBuffer;
+    WAVEFORMATEX m_waveFormat;
+    AudioFormat m_audioFormat;
+    const FramePipeline* m_pipeline;    // Chosen for m_waveFormat at connect
+
+    // Float copy of the current block for metering and processing
+    std::vector<float> m_floatBuffer;
+    LevelMeter m_inputMeter;
+    AudioRecorder m_recorder;
+    AudioTap m_tap;
+    Sampler m_sampler;
+    std::vector<float> m_samplerMix;    // Stereo sampler output for one buffer
+    void RenderSampler(uint32_t frames);
+
+    // Dropout handling: gaps found in one callback are filled in front of
+    // the next block written to the output
+    CaptureGapDetector m_gapDetector;
+    DropoutConcealer m_concealer;
+    std::vector<float> m_concealBuffer;
+    uint32_t m_pendingGapFrames;
+    uint32_t m_pendingCaptureFrames;    // Of those, the ones capture lost; they come last
+    DropoutCause m_pendingGapCause;
+    SpscQueue<DropoutEvent, 256> m_dropoutEvents;
+    void MarkRequeuePending(int bufferIndex);
+    void RetryRequeues();
+    void AddGap(uint32_t frames, DropoutCause cause);
+    void ReportDropout(uint64_t streamFrame, uint32_t gapFrames, DropoutCause cause, DropoutAction action, double hostTimeMs);
+
+    // Engine counters, updated from the device callbacks
+    std::atomic<uint64_t> m_buffersProcessed;
+    std::atomic<uint64_t> m_framesProcessed;
+    std::atomic<uint64_t> m_emptyBuffers;
+    std::atomic<uint64_t> m_requeueFailures;
+    std::atomic<uint64_t> m_dropouts;
+    std::atomic<uint64_t> m_concealedFrames;
+    std::atomic<uint64_t> m_silencedFrames;
+    std::atomic<uint64_t> m_outputWriteFailures;
+    std::atomic<uint64_t> m_midiMessagesIn;
+    std::atomic<uint64_t> m_midiMessagesOut;
+    std::atomic<double> m_connectHostMs;
+    std::atomic<double> m_firstAudioHostMs;
+
+    // Running sample positions and the host-time to sample mapping
+    SampleTimeline m_timeline;
+
+    // MIDI events stamped with their capture sample position, passed from
+    // the MIDI callback to the audio callback
+    struct TimedMidiEvent {
+        uint64_t samplePosition;
+        DWORD message;
+    };
+    SpscQueue<TimedMidiEvent, 1024> m_midiEvents;
+
+    // MIDI events due in the block being processed, with their frame offset
+    static const int MAX_BLOCK_MIDI_EVENTS = 256;
+    struct BlockMidiEvent {
+        uint32_t offset;
+        DWORD message;
+    };
+    BlockMidiEvent m_blockMidiEvents[MAX_BLOCK_MIDI_EVENTS];
+    int m_blockMidiEventCount;
+    void CollectBlockMidiEvents(uint64_t blockStart, uint32_t frames);
 
     // Audio callback handling
     static void CALLBACK WaveInProc(HWAVEIN hWaveIn, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2);
@@ -52,12 +221,40 @@ private:
 
     // MIDI device connection state
     HMIDIIN m_hMidiIn;
-    HMIDIOUT m_hMidiOut;
-    bool m_midiConnected;
+    HMIDIOUT m_hMidiOut;                // Null when only the input is connected
+    std::atomic<bool> m_midiConnected;
+    bool ConnectMidi(const MidiDeviceInfo& input, const MidiDeviceInfo* output);
 
     // MIDI callback handling
     static void CALLBACK MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2);
     void HandleMidiMessage(DWORD_PTR dwParam1, DWORD_PTR dwParam2);
+    bool HandleClockMessage(BYTE status, BYTE data1, BYTE data2, DWORD timestamp);
+    void StartClockMaster();
+
+    // Batched MIDI output through a small pool of long-message buffers
+    static const int NUM_MIDI_OUT_BUFFERS = 8;
+    struct MidiOutBuffer {
+        MIDIHDR header;
+        std::vector<char> data;
+    };
+    std::vector<MidiOutBuffer> m_midiOutBuffers;
+    int m_nextMidiOutBuffer;
+    MidiBatchOptions m_midiBatchOptions;
+    MidiOutBatcher m_midiBatcher;
+    void StartMidiBatching();
+    void StopMidiBatching();
+    bool SubmitMidiBatch(const uint8_t* bytes, size_t size);
+
+    // MIDI clock state
+    std::atomic<MidiClockMode> m_clockMode;
+    std::atomic<double> m_tempoBpm;
+    MidiClockMaster m_clockMaster;
+    MidiClockPll m_clockPll;            // MIDI callback only once midiInStart is called
+    PublishedMidiClock m_clockState;    // m_clockPll as last seen by the callback
+    std::atomic<bool> m_clockResetPending;
+    double m_midiStartHostMs;           // Host time when midiInStart was called
+
+    WaveDeviceApi m_wave;
 
     // Helper functions
     static std::wstring GetDeviceName(UINT deviceId, bool isInput);
@@ -0,0 +1,288 @@
+#include "DropoutConcealer.h"
+#include "Simd.h"
+#include <cmath>
+#include <cstring>
+
+CaptureGapDetector::CaptureGapDetector()
+    : m_blockFrames(0)
+    , m_blocks(0)
+    , m_previousDeficit(0.0)
+{
+}
+
+void CaptureGapDetector::Reset(uint32_t blockFrames)
+{
+    m_blockFrames = blockFrames;
+    m_blocks = 0;
+    m_previousDeficit = 0.0;
+}
+
+uint32_t CaptureGapDetector::Update(double deficitFrames, double errorFrames)
+{
+    if (++m_blocks <= WARMUP_BLOCKS)
+    {
+        return 0;
+    }
+
+    // Callbacks wander by less than half a buffer plus the fit's own noise
+    double threshold = m_blockFrames * 0.5 + 3.0 * errorFrames;
+    double change = deficitFrames - m_previousDeficit;
+    bool steady = change < m_blockFrames * 0.5 && change > -(m_blockFrames * 0.5);
+    if (deficitFrames >= threshold && m_previousDeficit >= threshold && steady)
+    {
+        double gap = deficitFrames < m_previousDeficit ? deficitFrames : m_previousDeficit;
+        m_previousDeficit = 0.0;
+        return static_cast<uint32_t>(gap + 0.5);
+    }
+    m_previousDeficit = deficitFrames;
+    return 0;
+}
+
+DropoutConcealer::DropoutConcealer()
+    : m_channels(0)
+    , m_maxRepeatFrames(0)
+    , m_crossfadeFrames(0)
+    , m_fadeFrames(0)
+    , m_minPeriod(0)
+    , m_maxPeriod(0)
+    , m_matchFrames(0)
+    , m_historyFrames(0)
+    , m_historyWrite(0)
+    , m_historyFilled(0)
+    , m_period(0)
+    , m_loopOffset(0)
+    , m_crossfadePending(false)
+    , m_fadeInPending(false)
+{
+}
+
+void DropoutConcealer::Reset(int channels, uint32_t sampleRate, uint32_t maxRepeatFrames)
+{
+    m_channels = channels;
+    m_maxRepeatFrames = maxRepeatFrames;
+
+    // Periods from 2.5 ms to 20 ms cover voices and most instruments; the
+    // match window is one shortest period
+    m_crossfadeFrames = sampleRate / 400;
+    m_fadeFrames = sampleRate / 200;
+    m_minPeriod = sampleRate / 400;
+    m_maxPeriod = sampleRate / 50;
+    m_matchFrames = m_minPeriod;
+
+    m_historyFrames = m_maxPeriod + m_matchFrames;
+    m_history.assign(static_cast<size_t>(m_historyFrames) * channels, 0.0f);
+    m_mono.assign(m_historyFrames, 0.0f);
+    m_historyWrite = 0;
+    m_historyFilled = 0;
+    m_period = m_minPeriod;
+    m_loopOffset = 0;
+    m_crossfadePending = false;
+    m_fadeInPending = false;
+}
+
+uint32_t DropoutConcealer::GetMaxFillFrames() const
+{
+    return m_maxRepeatFrames > m_fadeFrames ? m_maxRepeatFrames : m_fadeFrames;
+}
+
+float DropoutConcealer::HistorySample(uint32_t framesBack, int channel) const
+{
+    uint32_t frame = (m_historyWrite + m_historyFrames - framesBack) % m_historyFrames;
+    return m_history[static_cast<size_t>(frame) * m_channels + channel];
+}
+
+// The period is played from its start; offset 0 is the sample one period
+// before the end of the history
+float DropoutConcealer::LoopSample(uint32_t offset, int channel) const
+{
+    return HistorySample(m_period - offset % m_period, channel);
+}
+
+void DropoutConcealer::AddHistory(const float* interleaved, uint32_t frames)
+{
+    if (frames > m_historyFrames)
+    {
+        interleaved += static_cast<size_t>(frames - m_historyFrames) * m_channels;
+        frames = m_historyFrames;
+    }
+
+    uint32_t first = m_historyFrames - m_historyWrite;
+    if (first > frames)
+    {
+        first = frames;
+    }
+    memcpy(&m_history[static_cast<size_t>(m_historyWrite) * m_channels], interleaved, sizeof(float) * first * m_channels);
+    memcpy(&m_history[0], interleaved + static_cast<size_t>(first) * m_channels, sizeof(float) * (frames - first) * m_channels);
+
+    m_historyWrite = (m_historyWrite + frames) % m_historyFrames;
+    m_historyFilled = m_historyFilled + frames > m_historyFrames ? m_historyFrames : m_historyFilled + frames;
+}
+
+// Picks the lag at which the audio before it best matches the end of the
+// history, so repeating from there continues the waveform without a step
+void DropoutConcealer::FindPeriod()
+{
+    uint32_t available = m_historyFilled;
+    uint32_t frame = m_historyWrite;
+    for (uint32_t back = 1; back <= available; back++)
+    {
+        frame = frame == 0 ? m_historyFrames - 1 : frame - 1;
+        const float* samples = &m_history[static_cast<size_t>(frame) * m_channels];
+        float sum = 0.0f;
+        for (int channel = 0; channel < m_channels; channel++)
+        {
+            sum += samples[channel];
+        }
+        m_mono[m_historyFrames - back] = sum;
+    }
+
+    const float* target = &m_mono[m_historyFrames - m_matchFrames];
+    uint32_t maxPeriod = available - m_matchFrames < m_maxPeriod ? available - m_matchFrames : m_maxPeriod;
+    double bestScore = -1.0;
+    m_period = m_minPeriod;
+    for (uint32_t lag = m_minPeriod; lag <= maxPeriod; lag++)
+    {
+        const float* candidate = target - lag;
+        float correlation = 0.0f;
+        float energy = 0.0f;
+        uint32_t i = 0;
+#ifdef MUSICAPP_SSE2
+        __m128 correlationSum = _mm_setzero_ps();
+        __m128 energySum = _mm_setzero_ps();
+        for (; i + 4 <= m_matchFrames; i += 4)
+        {
+            __m128 t = _mm_loadu_ps(target + i);
+            __m128 c = _mm_loadu_ps(candidate + i);
+            correlationSum = _mm_add_ps(correlationSum, _mm_mul_ps(t, c));
+            energySum = _mm_add_ps(energySum, _mm_mul_ps(c, c));
+        }
+        alignas(16) float lanes[8];
+        _mm_store_ps(lanes, correlationSum);
+        _mm_store_ps(lanes + 4, energySum);
+        correlation = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+        energy = (lanes[4] + lanes[5]) + (lanes[6] + lanes[7]);
+#endif
+        for (; i < m_matchFrames; i++)
+        {
+            correlation += target[i] * candidate[i];
+            energy += candidate[i] * candidate[i];
+        }
+        if (energy > 0.0f)
+        {
+            double score = correlation / std::sqrt(energy);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                m_period = lag;
+            }
+        }
+    }
+}
+
+uint32_t DropoutConcealer::Conceal(uint32_t gapFrames, float* fill, DropoutAction& action)
+{
+    // Without enough history there is nothing to repeat
+    if (m_historyFilled < m_minPeriod + m_matchFrames)
+    {
+        m_crossfadePending = false;
+        m_fadeInPending = true;
+        action = DropoutAction::FadedOut;
+        return 0;
+    }
+
+    FindPeriod();
+
+    uint32_t frames;
+    if (gapFrames <= m_maxRepeatFrames)
+    {
+        frames = gapFrames;
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            for (int channel = 0; channel < m_channels; channel++)
+            {
+                fill[static_cast<size_t>(i) * m_channels + channel] = LoopSample(i, channel);
+            }
+        }
+        m_loopOffset = gapFrames % m_period;
+        m_crossfadePending = true;
+        m_fadeInPending = false;
+        action = DropoutAction::Repeated;
+    }
+    else
+    {
+        frames = m_fadeFrames;
+        for (uint32_t i = 0; i < frames; i++)
+        {
+            float gain = 1.0f - static_cast<float>(i + 1) / frames;
+            for (int channel = 0; channel < m_channels; channel++)
+            {
+                fill[static_cast<size_t>(i) * m_channels + channel] = LoopSample(i, channel) * gain;
+            }
+        }
+        m_crossfadePending = false;
+        m_fadeInPending = true;
+        action = DropoutAction::FadedOut;
+    }
+
+    // The best period rarely matches exactly, so the repetition starts a
+    // little off the waveform; spread that step over the first few frames.
+    // Extrapolating noise can land far outside the waveform, so the
+    // corrected frames stay within the peak of the repeated period
+    uint32_t length = m_crossfadeFrames < frames ? m_crossfadeFrames : frames;
+    for (int channel = 0; channel < m_channels; channel++)
+    {
+        float peak = 0.0f;
+        for (uint32_t back = 1; back <= m_period; back++)
+        {
+            float sample = std::fabs(HistorySample(back, channel));
+            peak = sample > peak ? sample : peak;
+        }
+        float predicted = 2.0f * HistorySample(1, channel) - HistorySample(2, channel);
+        float step = predicted - fill[channel];
+        for (uint32_t i = 0; i < length; i++)
+        {
+            float& sample = fill[static_cast<size_t>(i) * m_channels + channel];
+            sample += step * (1.0f - static_cast<float>(i) / length);
+            sample = sample > peak ? peak : (sample < -peak ? -peak : sample);
+        }
+    }
+    return frames;
+}
+
+bool DropoutConcealer::Process(float* interleaved, uint32_t frames)
+{
+    bool changed = false;
+    if (m_crossfadePending)
+    {
+        uint32_t length = m_crossfadeFrames < frames ? m_crossfadeFrames : frames;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            float weight = static_cast<float>(i + 1) / (length + 1);
+            float* frame = interleaved + static_cast<size_t>(i) * m_channels;
+            for (int channel = 0; channel < m_channels; channel++)
+            {
+                frame[channel] = frame[channel] * weight + LoopSample(m_loopOffset + i, channel) * (1.0f - weight);
+            }
+        }
+        changed = true;
+    }
+    else if (m_fadeInPending)
+    {
+        uint32_t length = m_fadeFrames < frames ? m_fadeFrames : frames;
+        for (uint32_t i = 0; i < length; i++)
+        {
+            float gain = static_cast<float>(i) / length;
+            float* frame = interleaved + static_cast<size_t>(i) * m_channels;
+            for (int channel = 0; channel < m_channels; channel++)
+            {
+                frame[channel] *= gain;
+            }
+        }
+        changed = true;
+    }
+    m_crossfadePending = false;
+    m_fadeInPending = false;
+
+    AddHistory(interleaved, frames);
+    return changed;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class DropoutCause : uint8_t {
+    CaptureGap,         // The capture clock ran ahead of the frames delivered
+    EmptyBuffer,        // A capture buffer came back with no data
+    OutputWriteFailed,  // A block never reached the output device
+    RequeueFailed       // A capture buffer could not be queued again
+};
+
+enum class DropoutAction : uint8_t {
+    None,               // Nothing was missing from the output yet
+    Repeated,           // The gap was filled from recent audio
+    FadedOut            // Too long to fill: faded to silence, then back in
+};
+
+// One dropout, as reported by DeviceManager::ReadDropoutEvent
+struct DropoutEvent {
+    double hostTimeMs;          // SampleTimeline::HostTimeMs() when it was handled
+    uint64_t streamFrame;       // Capture position of the block that followed the gap
+    uint32_t gapFrames;
+    DropoutCause cause;
+    DropoutAction action;
+};
+
+// Finds capture frames the driver lost without telling us, by comparing
+// where the capture clock says the stream should be with where it is. A
+// late callback looks the same at first, but the buffers queued behind it
+// arrive at once and the deficit shrinks by a buffer each; frames that are
+// really gone leave the same deficit on the next callback too.
+class CaptureGapDetector {
+public:
+    CaptureGapDetector();
+
+    void Reset(uint32_t blockFrames);
+
+    // deficitFrames is the expected minus the actual capture position and
+    // errorFrames the clock fit's uncertainty. Returns the frames lost, or
+    // 0; the caller moves the capture position on by that much.
+    uint32_t Update(double deficitFrames, double errorFrames);
+
+private:
+    // Callbacks before the clock fit is trusted
+    static const int WARMUP_BLOCKS = 16;
+
+    uint32_t m_blockFrames;
+    int m_blocks;
+    double m_previousDeficit;
+};
+
+// Hides gaps in the output stream. Short gaps are filled by repeating the
+// most recent pitch period of the output, found by waveform similarity,
+// and the next block crossfades in from that repetition. Gaps longer than
+// maxRepeatFrames get a short fade to silence instead, and the next block
+// fades in, so the gap is silent rather than a click.
+//
+// Process must see every block sent to the output, so the history is the
+// audio that was actually heard. Everything runs on the audio thread;
+// Reset allocates.
+class DropoutConcealer {
+public:
+    DropoutConcealer();
+
+    void Reset(int channels, uint32_t sampleRate, uint32_t maxRepeatFrames);
+
+    // Largest number of frames Conceal writes
+    uint32_t GetMaxFillFrames() const;
+
+    // Writes the frames that stand in for a gap of gapFrames into fill and
+    // returns how many were written
+    uint32_t Conceal(uint32_t gapFrames, float* fill, DropoutAction& action);
+
+    // Blends the start of the block after a concealment into it, then adds
+    // the block to the history. Returns true if the block was changed.
+    bool Process(float* interleaved, uint32_t frames);
+
+private:
+    void FindPeriod();
+    float LoopSample(uint32_t offset, int channel) const;
+    void AddHistory(const float* interleaved, uint32_t frames);
+    float HistorySample(uint32_t framesBack, int channel) const;
+
+    int m_channels;
+    uint32_t m_maxRepeatFrames;
+    uint32_t m_crossfadeFrames;
+    uint32_t m_fadeFrames;
+    uint32_t m_minPeriod;
+    uint32_t m_maxPeriod;
+    uint32_t m_matchFrames;
+
+    // Output history, interleaved, as a ring
+    std::vector<float> m_history;
+    std::vector<float> m_mono;      // Mix of the recent history for the period search
+    uint32_t m_historyFrames;
+    uint32_t m_historyWrite;
+    uint32_t m_historyFilled;
+
+    // Repetition state between Conceal and the next Process
+    uint32_t m_period;
+    uint32_t m_loopOffset;          // Position in the period where the fill stopped
+    bool m_crossfadePending;
+    bool m_fadeInPending;
+};
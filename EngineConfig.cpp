@@ -0,0 +1,343 @@
+#include "EngineConfig.h"
+#include <cwchar>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+
+EngineConfig::EngineConfig()
+    : headless(false)
+    , numBuffers(0)
+    , bufferSize(0)
+    , audioFormat{ 44100, 2, DeviceSampleFormat::Pcm16 }
+    , midiBatch()
+    , clockMode(MidiClockMode::Thru)
+    , tempoBpm(120.0)
+    , statusIntervalMs(5000)
+    , startupBudgetMs(2000)
+    , soakSeconds(0.0)
+    , soakSeed(1)
+{
+}
+
+static std::wstring Trim(const std::wstring& text)
+{
+    size_t first = 0;
+    size_t last = text.size();
+    while (first < last && iswspace(text[first]))
+    {
+        first++;
+    }
+    while (last > first && iswspace(text[last - 1]))
+    {
+        last--;
+    }
+    return text.substr(first, last - first);
+}
+
+static bool ParseInt(const std::wstring& value, int minValue, int maxValue, int& result)
+{
+    wchar_t* end = nullptr;
+    long parsed = wcstol(value.c_str(), &end, 10);
+    if (value.empty() || *end != L'\0' || parsed < minValue || parsed > maxValue)
+    {
+        return false;
+    }
+    result = static_cast<int>(parsed);
+    return true;
+}
+
+static bool ParseDouble(const std::wstring& value, double minValue, double maxValue, double& result)
+{
+    wchar_t* end = nullptr;
+    double parsed = wcstod(value.c_str(), &end);
+    if (value.empty() || *end != L'\0' || parsed < minValue || parsed > maxValue)
+    {
+        return false;
+    }
+    result = parsed;
+    return true;
+}
+
+// A bare flag ("--headless") counts as set
+static bool ParseFlag(const std::wstring& value)
+{
+    return value.empty() || value == L"1" || value == L"true" || value == L"yes";
+}
+
+static bool ApplySetting(const std::wstring& key, const std::wstring& value, EngineConfig& config, std::wstring& error)
+{
+    bool ok = true;
+    if (key == L"headless")
+    {
+        config.headless = ParseFlag(value);
+    }
+    else if (key == L"audio-in")
+    {
+        config.audioIn = value;
+    }
+    else if (key == L"audio-out")
+    {
+        config.audioOut = value;
+    }
+    else if (key == L"midi-in")
+    {
+        config.midiIn = value;
+    }
+    else if (key == L"midi-out")
+    {
+        config.midiOut = value;
+    }
+    else if (key == L"buffers")
+    {
+        ok = ParseInt(value, 2, 64, config.numBuffers);
+    }
+    else if (key == L"buffer-size")
+    {
+        ok = ParseInt(value, 256, 1 << 20, config.bufferSize);
+    }
+    else if (key == L"sample-rate")
+    {
+        int sampleRate = 0;
+        ok = ParseInt(value, 8000, 192000, sampleRate);
+        config.audioFormat.sampleRate = static_cast<uint32_t>(sampleRate);
+    }
+    else if (key == L"channels")
+    {
+        ok = ParseInt(value, 1, PIPELINE_MAX_CHANNELS, config.audioFormat.channels);
+    }
+    else if (key == L"sample-format")
+    {
+        if (value == L"pcm16")
+        {
+            config.audioFormat.sampleFormat = DeviceSampleFormat::Pcm16;
+        }
+        else if (value == L"pcm24")
+        {
+            config.audioFormat.sampleFormat = DeviceSampleFormat::Pcm24;
+        }
+        else if (value == L"pcm32")
+        {
+            config.audioFormat.sampleFormat = DeviceSampleFormat::Pcm32;
+        }
+        else if (value == L"float")
+        {
+            config.audioFormat.sampleFormat = DeviceSampleFormat::Float32;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    else if (key == L"midi-batch")
+    {
+        int tickMicros = 0;
+        ok = ParseInt(value, 0, 100000, tickMicros);
+        config.midiBatch.tickMicros = static_cast<unsigned>(tickMicros);
+    }
+    else if (key == L"midi-running-status")
+    {
+        config.midiBatch.runningStatus = ParseFlag(value);
+    }
+    else if (key == L"midi-thin")
+    {
+        config.midiBatch.thinControllers = ParseFlag(value);
+    }
+    else if (key == L"sampler")
+    {
+        config.samplerMap = value;
+    }
+    else if (key == L"record")
+    {
+        config.recordPath = value;
+    }
+    else if (key == L"tap")
+    {
+        config.tapName = value.empty() ? AUDIO_TAP_DEFAULT_NAME : value;
+    }
+    else if (key == L"clock")
+    {
+        if (value == L"thru")
+        {
+            config.clockMode = MidiClockMode::Thru;
+        }
+        else if (value == L"master")
+        {
+            config.clockMode = MidiClockMode::Master;
+        }
+        else if (value == L"slave")
+        {
+            config.clockMode = MidiClockMode::Slave;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    else if (key == L"tempo")
+    {
+        ok = ParseDouble(value, 20.0, 300.0, config.tempoBpm);
+    }
+    else if (key == L"status-interval")
+    {
+        ok = ParseInt(value, 0, 3600000, config.statusIntervalMs);
+    }
+    else if (key == L"startup-budget")
+    {
+        ok = ParseInt(value, 0, 600000, config.startupBudgetMs);
+    }
+    else if (key == L"soak")
+    {
+        ok = ParseDouble(value, 0.0, 7.0 * 24 * 3600, config.soakSeconds);
+    }
+    else if (key == L"soak-seed")
+    {
+        ok = ParseInt(value, 0, 0x7FFFFFFF, config.soakSeed);
+    }
+    else
+    {
+        error = L"Unknown option: " + key;
+        return false;
+    }
+
+    if (!ok)
+    {
+        error = L"Invalid value for " + key + L": " + value;
+    }
+    return ok;
+}
+
+// Splits "--key=value" (or a config line "key=value") into its parts
+static void SplitSetting(const std::wstring& text, std::wstring& key, std::wstring& value)
+{
+    size_t start = text.compare(0, 2, L"--") == 0 ? 2 : 0;
+    size_t equals = text.find(L'=', start);
+    if (equals == std::wstring::npos)
+    {
+        key = Trim(text.substr(start));
+        value.clear();
+    }
+    else
+    {
+        key = Trim(text.substr(start, equals - start));
+        value = Trim(text.substr(equals + 1));
+    }
+}
+
+static bool LoadConfigFile(const std::wstring& path, EngineConfig& config, std::wstring& error)
+{
+    std::ifstream file{std::filesystem::path(path)};
+    if (!file)
+    {
+        error = L"Cannot open config file: " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        // Config files are UTF-8 so device names can be matched exactly
+        std::wstring wide;
+        if (!line.empty())
+        {
+            int length = MultiByteToWideChar(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), nullptr, 0);
+            wide.resize(length);
+            MultiByteToWideChar(CP_UTF8, 0, line.c_str(), static_cast<int>(line.size()), &wide[0], length);
+        }
+
+        size_t comment = wide.find(L'#');
+        if (comment != std::wstring::npos)
+        {
+            wide.erase(comment);
+        }
+        wide = Trim(wide);
+        if (wide.empty())
+        {
+            continue;
+        }
+
+        std::wstring key, value;
+        SplitSetting(wide, key, value);
+        if (!ApplySetting(key, value, config, error))
+        {
+            error = path + L":" + std::to_wstring(lineNumber) + L": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParseEngineConfig(const std::vector<std::wstring>& args, EngineConfig& config, std::wstring& error)
+{
+    // The config file is applied first so the command line can override it
+    for (const std::wstring& arg : args)
+    {
+        std::wstring key, value;
+        SplitSetting(arg, key, value);
+        if (key == L"config" && !LoadConfigFile(value, config, error))
+        {
+            return false;
+        }
+    }
+
+    for (const std::wstring& arg : args)
+    {
+        if (arg.compare(0, 2, L"--") != 0)
+        {
+            error = L"Unexpected argument: " + arg;
+            return false;
+        }
+
+        std::wstring key, value;
+        SplitSetting(arg, key, value);
+        if (key != L"config" && !ApplySetting(key, value, config, error))
+        {
+            return false;
+        }
+    }
+
+    // A connection needs both ends, except that a MIDI input may run alone
+    // to play the sampler
+    if (config.audioIn.empty() != config.audioOut.empty())
+    {
+        error = L"Both --audio-in and --audio-out are required to connect audio";
+        return false;
+    }
+    if (config.midiIn.empty() && !config.midiOut.empty())
+    {
+        error = L"--midi-out requires --midi-in";
+        return false;
+    }
+    return true;
+}
+
+const wchar_t* GetEngineConfigUsage()
+{
+    return
+        L"Usage: MusicApp --headless [options]\n"
+        L"  --config=<file>          Read key=value options from a file\n"
+        L"  --audio-in=<device>      Audio input, by list index from 1 or name substring\n"
+        L"  --audio-out=<device>     Audio output\n"
+        L"  --midi-in=<device>       MIDI input\n"
+        L"  --midi-out=<device>      MIDI output; without one, MIDI input only plays the sampler\n"
+        L"  --midi-batch=<us>        Batch MIDI output per tick of this length, 0 for off\n"
+        L"  --midi-running-status    Use running status in MIDI batches\n"
+        L"  --midi-thin              Drop redundant controller values in MIDI batches\n"
+        L"  --buffers=<n>            Number of audio buffers (2-64)\n"
+        L"  --buffer-size=<bytes>    Bytes per audio buffer (256-1048576)\n"
+        L"  --sample-rate=<hz>       Audio sample rate (8000-192000, default 44100)\n"
+        L"  --channels=<n>           Audio channels (1-8, default 2)\n"
+        L"  --sample-format=pcm16|pcm24|pcm32|float  Audio sample format\n"
+        L"  --sampler=<map file>     Play a sample map from the MIDI input\n"
+        L"  --record=<file.wav>      Record the audio passing through\n"
+        L"  --tap[=<name>]           Publish the output to shared memory for local readers\n"
+        L"  --clock=thru|master|slave  MIDI clock mode\n"
+        L"  --tempo=<bpm>            Tempo when clock master\n"
+        L"  --status-interval=<ms>   Status dump period, 0 to disable\n"
+        L"  --startup-budget=<ms>    Time allowed from launch to first audio\n"
+        L"  --soak=<seconds>         Soak the engine against a simulated device for this\n"
+        L"                           much audio time instead of running the real devices\n"
+        L"  --soak-seed=<n>          Seed for the simulated device's timing and faults\n";
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "DeviceManager.h"
+
+// Engine settings for unattended startup, read from the command line and an
+// optional config file. Device selectors are either an index into the
+// device list as enumerated (the same order the settings dialog shows, so
+// real devices start at 1 after "No Device") or a case-insensitive
+// substring of the device name; empty leaves the device unconnected. Audio
+// needs both selectors; MIDI needs an input, and the output is optional.
+struct EngineConfig {
+    bool headless;
+    std::wstring audioIn;
+    std::wstring audioOut;
+    std::wstring midiIn;
+    std::wstring midiOut;
+    int numBuffers;             // 0 keeps the engine default
+    int bufferSize;             // Bytes per buffer, 0 keeps the engine default
+    AudioFormat audioFormat;    // Sample format the audio devices are opened with
+    std::wstring recordPath;
+    std::wstring tapName;       // Shared-memory output tap, empty for none
+    std::wstring samplerMap;    // Sample map played from the MIDI input
+    MidiBatchOptions midiBatch; // tickMicros 0 sends each MIDI message directly
+    MidiClockMode clockMode;
+    double tempoBpm;
+    int statusIntervalMs;       // 0 disables the periodic status dump
+    int startupBudgetMs;        // Time allowed from process start to first audio
+    double soakSeconds;         // Simulated audio for a soak run, 0 runs the real devices
+    int soakSeed;               // Seed for the simulated device's timing and faults
+
+    EngineConfig();
+};
+
+// Parses "--key=value" arguments and "--headless". "--config=<file>" loads
+// key=value lines (with '#' comments) from a file first; anything given on
+// the command line overrides the file. Returns false and fills error on an
+// unknown key or bad value.
+bool ParseEngineConfig(const std::vector<std::wstring>& args, EngineConfig& config, std::wstring& error);
+
+// Usage text listing the options
+const wchar_t* GetEngineConfigUsage();
@@ -0,0 +1,227 @@
+#include "EngineController.h"
+#include <chrono>
+#include <string>
+
+static void LogMessage(LPCWSTR message)
+{
+    // You can put a breakpoint/watch here or uncomment the following line to see the messages
+    // OutputDebugStringW(message);
+}
+
+EngineController::EngineController(DeviceManager& deviceManager)
+    : m_deviceManager(deviceManager)
+    , m_nextSequence(1)
+    , m_commandsDropped(0)
+    , m_running(false)
+    , m_sessionFirstSequence(1)
+    , m_version(0)
+    , m_appliedSequence(0)
+    , m_failedSequence(0)
+    , m_audioInputId(0)
+    , m_audioOutputId(0)
+    , m_midiInputId(0)
+    , m_midiOutputId(0)
+{
+    Publish();
+}
+
+EngineController::~EngineController()
+{
+    Stop();
+}
+
+void EngineController::Start()
+{
+    if (m_running)
+    {
+        return;
+    }
+
+    // A Post racing the last Stop can leave its command queued after the
+    // final drain; it was numbered before this point and is dropped
+    m_sessionFirstSequence = m_nextSequence.load();
+    m_commands.Reopen();
+    m_running = true;
+    m_thread = std::thread(&EngineController::ControlThread, this);
+}
+
+void EngineController::Stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+    m_running = false;
+    m_commands.Close();
+    m_thread.join();
+
+    // The control thread is gone, so this thread now owns the devices. Done
+    // here rather than queued so a full queue cannot leave them open.
+    m_deviceManager.StopRecording();
+    m_deviceManager.DisconnectAudioDevices();
+    m_deviceManager.DisconnectMidiDevices();
+    Publish();
+}
+
+uint64_t EngineController::Post(EngineCommand::Type type, UINT inputId, UINT outputId, double value)
+{
+    // Numbered before the running check, so a command posted while a
+    // restart is under way is either numbered into the new session or
+    // dropped by it, never applied from the old one
+    EngineCommand command;
+    command.sequence = m_nextSequence.fetch_add(1);
+    if (!m_running)
+    {
+        return 0;
+    }
+    command.type = type;
+    command.inputId = inputId;
+    command.outputId = outputId;
+    command.value = value;
+
+    // Sequence numbers are unique but may reach the queue out of order when
+    // several threads post at once; each caller only waits for its own
+    if (!m_commands.Push(command))
+    {
+        m_commandsDropped.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return command.sequence;
+}
+
+std::shared_ptr<const EngineState> EngineController::GetState() const
+{
+    return std::atomic_load(&m_state);
+}
+
+void EngineController::ControlThread()
+{
+    auto nextRefresh = std::chrono::steady_clock::now() + std::chrono::milliseconds(REFRESH_MS);
+    for (;;)
+    {
+        bool running = m_running;
+
+        // Drain everything posted so far, including what arrived just
+        // before a stop
+        EngineCommand command;
+        bool applied = false;
+        while (m_commands.Pop(command))
+        {
+            if (command.sequence < m_sessionFirstSequence)
+            {
+                m_commandsDropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (!Apply(command))
+            {
+                m_failedSequence = command.sequence;
+            }
+            m_appliedSequence = command.sequence;
+            applied = true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (applied || now >= nextRefresh)
+        {
+            Publish();
+            nextRefresh = now + std::chrono::milliseconds(REFRESH_MS);
+        }
+
+        if (!running)
+        {
+            break;
+        }
+
+        // Commands wake the thread themselves; the deadline is only for the
+        // counter refresh
+        m_commands.WaitUntil(nextRefresh);
+    }
+}
+
+bool EngineController::Apply(const EngineCommand& command)
+{
+    switch (command.type)
+    {
+        case EngineCommand::ConnectAudio:
+        {
+            // Names are only used for logging by the connect path
+            AudioDeviceInfo input = { command.inputId, L"#" + std::to_wstring(command.inputId), true };
+            AudioDeviceInfo output = { command.outputId, L"#" + std::to_wstring(command.outputId), false };
+            if (!m_deviceManager.ConnectAudioInputToOutput(input, output))
+            {
+                LogMessage(L"\nQueued audio connect failed");
+                return false;
+            }
+            m_audioInputId = command.inputId;
+            m_audioOutputId = command.outputId;
+            return true;
+        }
+
+        case EngineCommand::DisconnectAudio:
+            m_deviceManager.DisconnectAudioDevices();
+            return true;
+
+        case EngineCommand::ConnectMidi:
+        {
+            MidiDeviceInfo input = { command.inputId, L"#" + std::to_wstring(command.inputId), true };
+            MidiDeviceInfo output = { command.outputId, L"#" + std::to_wstring(command.outputId), false };
+            bool connected = command.outputId == MIDI_MAPPER ? m_deviceManager.ConnectMidiInput(input)
+                                                             : m_deviceManager.ConnectMidiInputToOutput(input, output);
+            if (!connected)
+            {
+                LogMessage(L"\nQueued MIDI connect failed");
+                return false;
+            }
+            m_midiInputId = command.inputId;
+            m_midiOutputId = command.outputId;
+            return true;
+        }
+
+        case EngineCommand::DisconnectMidi:
+            m_deviceManager.DisconnectMidiDevices();
+            return true;
+
+        case EngineCommand::DisconnectAll:
+            m_deviceManager.StopRecording();
+            m_deviceManager.DisconnectAudioDevices();
+            m_deviceManager.DisconnectMidiDevices();
+            return true;
+
+        case EngineCommand::SetClockMode:
+            m_deviceManager.SetMidiClockMode(static_cast<MidiClockMode>(static_cast<int>(command.value)));
+            return true;
+
+        case EngineCommand::SetTempo:
+            m_deviceManager.SetTempo(command.value);
+            return true;
+
+        case EngineCommand::SetBufferGeometry:
+            m_deviceManager.SetBufferGeometry(static_cast<int>(command.inputId), static_cast<int>(command.outputId));
+            return true;
+    }
+    return false;
+}
+
+void EngineController::Publish()
+{
+    std::shared_ptr<EngineState> state = std::make_shared<EngineState>();
+    state->version = ++m_version;
+    state->appliedSequence = m_appliedSequence;
+    state->failedSequence = m_failedSequence;
+    state->audioConnected = m_deviceManager.IsAudioConnected();
+    state->midiConnected = m_deviceManager.IsMidiConnected();
+    state->audioInputId = m_audioInputId;
+    state->audioOutputId = m_audioOutputId;
+    state->midiInputId = m_midiInputId;
+    state->midiOutputId = m_midiOutputId;
+    state->clockMode = m_deviceManager.GetMidiClockMode();
+    state->tempoBpm = m_deviceManager.GetTempoBpm();
+    state->numBuffers = m_deviceManager.GetNumBuffers();
+    state->bufferSize = m_deviceManager.GetBufferSize();
+    state->samplerVoices = m_deviceManager.GetSamplerVoiceCount();
+    state->stats = m_deviceManager.GetStats();
+    state->commandsDropped = m_commandsDropped.load(std::memory_order_relaxed);
+
+    // Readers holding the previous snapshot keep it alive until they let go
+    std::atomic_store(&m_state, std::shared_ptr<const EngineState>(std::move(state)));
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "CommandQueue.h"
+#include "DeviceManager.h"
+
+// Request from the UI to the engine. Devices are named by id so a command
+// is plain data and can be queued without allocating.
+struct EngineCommand {
+    enum Type : uint8_t {
+        ConnectAudio,       // inputId -> outputId
+        DisconnectAudio,
+        ConnectMidi,        // inputId -> outputId, or input only if outputId is MIDI_MAPPER
+        DisconnectMidi,
+        DisconnectAll,
+        SetClockMode,       // value = MidiClockMode
+        SetTempo,           // value = BPM
+        SetBufferGeometry   // inputId = buffer count, outputId = buffer bytes
+    };
+
+    Type type;
+    UINT inputId;
+    UINT outputId;
+    double value;
+    uint64_t sequence;      // Assigned by Post
+};
+
+// Engine state as of the last command or refresh. Published as a whole;
+// readers never see a half-updated state.
+struct EngineState {
+    uint64_t version;
+    uint64_t appliedSequence;   // Last command applied
+    uint64_t failedSequence;    // Last command that failed, 0 if none
+    bool audioConnected;
+    bool midiConnected;
+    UINT audioInputId;
+    UINT audioOutputId;
+    UINT midiInputId;
+    UINT midiOutputId;
+    MidiClockMode clockMode;
+    double tempoBpm;
+    int numBuffers;
+    int bufferSize;
+    int samplerVoices;
+    EngineStats stats;
+    uint64_t commandsDropped;   // Rejected because the queue was full, or left from before a restart
+};
+
+// Owns all calls that change the DeviceManager's connections.
+//
+// The UI posts commands into a bounded lock-free queue and returns at once;
+// a control thread sleeps until one arrives, applies them in order and
+// publishes an immutable EngineState snapshot after each one, plus a
+// refresh every REFRESH_MS for the counters. The snapshot pointer is
+// swapped with std::atomic_store, so reading it never waits for a command
+// to finish and a slow device open never stalls the UI.
+class EngineController {
+public:
+    static constexpr size_t QUEUE_CAPACITY = 256;
+    static constexpr int REFRESH_MS = 50;
+
+    explicit EngineController(DeviceManager& deviceManager);
+    ~EngineController();
+
+    void Start();
+    void Stop();    // Disconnects everything, then joins the control thread
+
+    // Any thread. Returns the command's sequence number, or 0 if the queue
+    // is full or the controller is not running.
+    uint64_t Post(EngineCommand::Type type, UINT inputId = 0, UINT outputId = 0, double value = 0.0);
+
+    // Any thread; never null once constructed
+    std::shared_ptr<const EngineState> GetState() const;
+
+private:
+    void ControlThread();
+    bool Apply(const EngineCommand& command);
+    void Publish();
+
+    DeviceManager& m_deviceManager;
+    CommandQueue<EngineCommand, QUEUE_CAPACITY> m_commands;
+    std::atomic<uint64_t> m_nextSequence;
+    std::atomic<uint64_t> m_commandsDropped;
+    std::atomic<bool> m_running;
+    uint64_t m_sessionFirstSequence;    // Set by Start before the control thread runs
+
+    // Control thread only
+    uint64_t m_version;
+    uint64_t m_appliedSequence;
+    uint64_t m_failedSequence;
+    UINT m_audioInputId;
+    UINT m_audioOutputId;
+    UINT m_midiInputId;
+    UINT m_midiOutputId;
+
+    std::shared_ptr<const EngineState> m_state;
+
+    std::thread m_thread;
+};
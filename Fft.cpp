@@ -0,0 +1,188 @@
+#include "Fft.h"
+#include "Simd.h"
+#include <cmath>
+#include <utility>
+
+RadixFft::RadixFft(size_t size)
+    : m_size(size)
+    , m_log2Size(0)
+{
+    while ((static_cast<size_t>(1) << m_log2Size) < m_size)
+    {
+        m_log2Size++;
+    }
+
+    m_bitReverse.resize(m_size);
+    for (size_t i = 0; i < m_size; i++)
+    {
+        size_t reversed = 0;
+        for (int bit = 0; bit < m_log2Size; bit++)
+        {
+            reversed |= ((i >> bit) & 1) << (m_log2Size - 1 - bit);
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    const double pi = 3.14159265358979323846;
+    m_twiddleRe.resize(m_size > 1 ? m_size - 1 : 1);
+    m_twiddleIm.resize(m_size > 1 ? m_size - 1 : 1);
+    for (size_t half = 1; half < m_size; half *= 2)
+    {
+        for (size_t k = 0; k < half; k++)
+        {
+            double angle = -pi * static_cast<double>(k) / static_cast<double>(half);
+            m_twiddleRe[half - 1 + k] = static_cast<float>(std::cos(angle));
+            m_twiddleIm[half - 1 + k] = static_cast<float>(std::sin(angle));
+        }
+    }
+}
+
+void RadixFft::BitReverse(float* re, float* im) const
+{
+    for (size_t i = 0; i < m_size; i++)
+    {
+        size_t j = m_bitReverse[i];
+        if (j > i)
+        {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+}
+
+void RadixFft::Radix2Pass(float* re, float* im, size_t half, const float* wr, const float* wi) const
+{
+    for (size_t j = 0; j < m_size; j += 2 * half)
+    {
+        for (size_t k = 0; k < half; k++)
+        {
+            size_t a = j + k;
+            size_t b = a + half;
+            float tr = wr[k] * re[b] - wi[k] * im[b];
+            float ti = wr[k] * im[b] + wi[k] * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+
+// Two radix-2 DIT passes (half and 2 * half) fused into one radix-4 butterfly:
+//   stage 1: a' = a + w1 b, b' = a - w1 b, c' = c + w1 d, d' = c - w1 d
+//   stage 2: a'' = a' +- w2 c', b'' = b' +- (-i) w2 d'
+void RadixFft::Radix4Pass(float* re, float* im, size_t half, const float* w1r, const float* w1i,
+                          const float* w2r, const float* w2i) const
+{
+    for (size_t j = 0; j < m_size; j += 4 * half)
+    {
+        float* ar = re + j;
+        float* ai = im + j;
+        float* br = ar + half;
+        float* bi = ai + half;
+        float* cr = br + half;
+        float* ci = bi + half;
+        float* dr = cr + half;
+        float* di = ci + half;
+
+        size_t k = 0;
+#ifdef MUSICAPP_SSE2
+        for (; k + 4 <= half; k += 4)
+        {
+            __m128 v1r = _mm_loadu_ps(w1r + k), v1i = _mm_loadu_ps(w1i + k);
+            __m128 v2r = _mm_loadu_ps(w2r + k), v2i = _mm_loadu_ps(w2i + k);
+            __m128 xar = _mm_loadu_ps(ar + k), xai = _mm_loadu_ps(ai + k);
+            __m128 xbr = _mm_loadu_ps(br + k), xbi = _mm_loadu_ps(bi + k);
+            __m128 xcr = _mm_loadu_ps(cr + k), xci = _mm_loadu_ps(ci + k);
+            __m128 xdr = _mm_loadu_ps(dr + k), xdi = _mm_loadu_ps(di + k);
+
+            __m128 tbr = _mm_sub_ps(_mm_mul_ps(v1r, xbr), _mm_mul_ps(v1i, xbi));
+            __m128 tbi = _mm_add_ps(_mm_mul_ps(v1r, xbi), _mm_mul_ps(v1i, xbr));
+            __m128 tdr = _mm_sub_ps(_mm_mul_ps(v1r, xdr), _mm_mul_ps(v1i, xdi));
+            __m128 tdi = _mm_add_ps(_mm_mul_ps(v1r, xdi), _mm_mul_ps(v1i, xdr));
+
+            __m128 a1r = _mm_add_ps(xar, tbr), a1i = _mm_add_ps(xai, tbi);
+            __m128 b1r = _mm_sub_ps(xar, tbr), b1i = _mm_sub_ps(xai, tbi);
+            __m128 c1r = _mm_add_ps(xcr, tdr), c1i = _mm_add_ps(xci, tdi);
+            __m128 d1r = _mm_sub_ps(xcr, tdr), d1i = _mm_sub_ps(xci, tdi);
+
+            __m128 tcr = _mm_sub_ps(_mm_mul_ps(v2r, c1r), _mm_mul_ps(v2i, c1i));
+            __m128 tci = _mm_add_ps(_mm_mul_ps(v2r, c1i), _mm_mul_ps(v2i, c1r));
+
+            // (-i) * (w2 * d') = (im, -re)
+            __m128 pr = _mm_sub_ps(_mm_mul_ps(v2r, d1r), _mm_mul_ps(v2i, d1i));
+            __m128 pi = _mm_add_ps(_mm_mul_ps(v2r, d1i), _mm_mul_ps(v2i, d1r));
+
+            _mm_storeu_ps(ar + k, _mm_add_ps(a1r, tcr));
+            _mm_storeu_ps(ai + k, _mm_add_ps(a1i, tci));
+            _mm_storeu_ps(cr + k, _mm_sub_ps(a1r, tcr));
+            _mm_storeu_ps(ci + k, _mm_sub_ps(a1i, tci));
+            _mm_storeu_ps(br + k, _mm_add_ps(b1r, pi));
+            _mm_storeu_ps(bi + k, _mm_sub_ps(b1i, pr));
+            _mm_storeu_ps(dr + k, _mm_sub_ps(b1r, pi));
+            _mm_storeu_ps(di + k, _mm_add_ps(b1i, pr));
+        }
+#endif
+        for (; k < half; k++)
+        {
+            float tbr = w1r[k] * br[k] - w1i[k] * bi[k];
+            float tbi = w1r[k] * bi[k] + w1i[k] * br[k];
+            float tdr = w1r[k] * dr[k] - w1i[k] * di[k];
+            float tdi = w1r[k] * di[k] + w1i[k] * dr[k];
+
+            float a1r = ar[k] + tbr, a1i = ai[k] + tbi;
+            float b1r = ar[k] - tbr, b1i = ai[k] - tbi;
+            float c1r = cr[k] + tdr, c1i = ci[k] + tdi;
+            float d1r = cr[k] - tdr, d1i = ci[k] - tdi;
+
+            float tcr = w2r[k] * c1r - w2i[k] * c1i;
+            float tci = w2r[k] * c1i + w2i[k] * c1r;
+            float pr = w2r[k] * d1r - w2i[k] * d1i;
+            float pi = w2r[k] * d1i + w2i[k] * d1r;
+
+            ar[k] = a1r + tcr;
+            ai[k] = a1i + tci;
+            cr[k] = a1r - tcr;
+            ci[k] = a1i - tci;
+            br[k] = b1r + pi;
+            bi[k] = b1i - pr;
+            dr[k] = b1r - pi;
+            di[k] = b1i + pr;
+        }
+    }
+}
+
+void RadixFft::Forward(float* re, float* im)
+{
+    BitReverse(re, im);
+
+    size_t half = 1;
+    for (; half * 4 <= m_size; half *= 4)
+    {
+        Radix4Pass(re, im, half,
+                   &m_twiddleRe[half - 1], &m_twiddleIm[half - 1],
+                   &m_twiddleRe[2 * half - 1], &m_twiddleIm[2 * half - 1]);
+    }
+    if (half < m_size)
+    {
+        Radix2Pass(re, im, half, &m_twiddleRe[half - 1], &m_twiddleIm[half - 1]);
+    }
+}
+
+void RadixFft::Inverse(float* re, float* im)
+{
+    // Swapping real and imaginary parts turns the forward transform into the inverse
+    Forward(im, re);
+
+    float scale = 1.0f / static_cast<float>(m_size);
+    for (size_t i = 0; i < m_size; i++)
+    {
+        re[i] *= scale;
+        im[i] *= scale;
+    }
+}
+
+std::unique_ptr<FftEngine> CreateFft(size_t size)
+{
+    return std::unique_ptr<FftEngine>(new RadixFft(size));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Complex FFT on split (separate real and imaginary) arrays. Implementations
+// are interchangeable so a platform library can replace the built-in one.
+class FftEngine {
+public:
+    virtual ~FftEngine() {}
+
+    virtual size_t GetSize() const = 0;
+
+    // In-place transforms. Forward uses e^(-2*pi*i*k*n/N); Inverse includes
+    // the 1/N scale so Inverse(Forward(x)) == x.
+    virtual void Forward(float* re, float* im) = 0;
+    virtual void Inverse(float* re, float* im) = 0;
+};
+
+// Built-in power-of-two FFT. Pairs of radix-2 passes are fused into radix-4
+// (radix-2^2) butterflies with SSE2 across four butterflies at a time; a
+// single radix-2 pass finishes odd sizes.
+class RadixFft : public FftEngine {
+public:
+    explicit RadixFft(size_t size);
+
+    size_t GetSize() const override { return m_size; }
+    void Forward(float* re, float* im) override;
+    void Inverse(float* re, float* im) override;
+
+private:
+    void BitReverse(float* re, float* im) const;
+    void Radix4Pass(float* re, float* im, size_t half, const float* w1r, const float* w1i,
+                    const float* w2r, const float* w2i) const;
+    void Radix2Pass(float* re, float* im, size_t half, const float* wr, const float* wi) const;
+
+    size_t m_size;
+    int m_log2Size;
+    std::vector<size_t> m_bitReverse;
+
+    // Twiddles for a pass of half-size h start at offset h - 1: W_{2h}^k for k < h
+    std::vector<float> m_twiddleRe;
+    std::vector<float> m_twiddleIm;
+};
+
+// Creates the default engine for the given power-of-two size
+std::unique_ptr<FftEngine> CreateFft(size_t size);
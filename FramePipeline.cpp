@@ -0,0 +1,285 @@
+#include "FramePipeline.h"
+#include "SampleConvert.h"
+#include "Simd.h"
+#include <cstring>
+
+static const float PCM24_TO_FLOAT = 1.0f / 8388608.0f;
+static const float FLOAT_TO_PCM24 = 8388608.0f;
+
+// Each codec converts whole runs where it has a vector kernel and reports
+// how many samples it did; the frame loop does the rest one sample at a time
+struct Pcm16Codec {
+    static const size_t BYTES = 2;
+
+    static size_t DecodeRun(const uint8_t* in, float* out, size_t count)
+    {
+        ConvertPcm16ToFloat(reinterpret_cast<const int16_t*>(in), out, count);
+        return count;
+    }
+
+    static size_t EncodeRun(const float* in, uint8_t* out, size_t count)
+    {
+        ConvertFloatToPcm16(in, reinterpret_cast<int16_t*>(out), count);
+        return count;
+    }
+
+    // Never reached: the runs cover every sample
+    static float Decode(const uint8_t*) { return 0.0f; }
+    static void Encode(float, uint8_t*) {}
+};
+
+// Three-byte samples have no vector load or store, but four of them fill
+// three 32-bit words exactly: they move twelve bytes at a time and are
+// rearranged in registers
+struct Pcm24Codec {
+    static const size_t BYTES = 3;
+
+    static size_t DecodeRun(const uint8_t* in, float* out, size_t count)
+    {
+        size_t i = 0;
+#ifdef MUSICAPP_SSE2
+        const __m128 scale = _mm_set1_ps(PCM24_TO_FLOAT);
+        const __m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0);
+        const __m128i lane1 = _mm_setr_epi32(0, -1, 0, 0);
+        const __m128i lane2 = _mm_setr_epi32(0, 0, -1, 0);
+        const __m128i lane3 = _mm_setr_epi32(0, 0, 0, -1);
+        for (; i + 4 <= count; i += 4)
+        {
+            // Twelve bytes, without reading past them
+            const uint8_t* source = in + i * BYTES;
+            uint32_t last;
+            memcpy(&last, source + 8, sizeof(last));
+            __m128i bytes = _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)),
+                                               _mm_cvtsi32_si128(static_cast<int>(last)));
+
+            // Sample n starts 3n bytes in; moving the register up by n bytes
+            // puts it at the bottom of lane n
+            __m128i low = _mm_or_si128(_mm_and_si128(bytes, lane0), _mm_and_si128(_mm_slli_si128(bytes, 1), lane1));
+            __m128i high = _mm_or_si128(_mm_and_si128(_mm_slli_si128(bytes, 2), lane2), _mm_and_si128(_mm_slli_si128(bytes, 3), lane3));
+            __m128i lanes = _mm_or_si128(low, high);
+
+            // Then to the top three bytes, and an arithmetic shift back sign-extends
+            __m128i samples = _mm_srai_epi32(_mm_slli_epi32(lanes, 8), 8);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+        }
+#endif
+        return i;
+    }
+
+    static size_t EncodeRun(const float* in, uint8_t* out, size_t count)
+    {
+        size_t i = 0;
+#ifdef MUSICAPP_SSE2
+        const __m128 scale = _mm_set1_ps(FLOAT_TO_PCM24);
+        const __m128 maximum = _mm_set1_ps(8388607.0f);
+        const __m128 minimum = _mm_set1_ps(-8388608.0f);
+        alignas(16) uint32_t values[4];
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 scaled = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), maximum), minimum);
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), _mm_cvtps_epi32(scaled));
+
+            // Word by word: one wider copy would stall on the separate stores
+            uint8_t* target = out + i * BYTES;
+            uint32_t word = (values[0] & 0xFFFFFF) | values[1] << 24;
+            memcpy(target, &word, sizeof(word));
+            word = (values[1] >> 8 & 0xFFFF) | values[2] << 16;
+            memcpy(target + 4, &word, sizeof(word));
+            word = (values[2] >> 16 & 0xFF) | values[3] << 8;
+            memcpy(target + 8, &word, sizeof(word));
+        }
+#endif
+        return i;
+    }
+
+    static float Decode(const uint8_t* in)
+    {
+        // Assemble in the top three bytes, then shift back to sign-extend
+        int32_t value = static_cast<int32_t>(static_cast<uint32_t>(in[0]) << 8 | static_cast<uint32_t>(in[1]) << 16 |
+                                             static_cast<uint32_t>(in[2]) << 24) >> 8;
+        return value * PCM24_TO_FLOAT;
+    }
+
+    static void Encode(float sample, uint8_t* out)
+    {
+        float scaled = sample * FLOAT_TO_PCM24;
+        if (scaled > 8388607.0f)
+        {
+            scaled = 8388607.0f;
+        }
+        else if (scaled < -8388608.0f)
+        {
+            scaled = -8388608.0f;
+        }
+        int32_t value = static_cast<int32_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+        out[2] = static_cast<uint8_t>(value >> 16);
+    }
+};
+
+struct Pcm32Codec {
+    static const size_t BYTES = 4;
+
+    static size_t DecodeRun(const uint8_t* in, float* out, size_t count)
+    {
+        ConvertPcm32ToFloat(reinterpret_cast<const int32_t*>(in), out, count);
+        return count;
+    }
+
+    static size_t EncodeRun(const float* in, uint8_t* out, size_t count)
+    {
+        ConvertFloatToPcm32(in, reinterpret_cast<int32_t*>(out), count);
+        return count;
+    }
+
+    // Never reached
+    static float Decode(const uint8_t*) { return 0.0f; }
+    static void Encode(float, uint8_t*) {}
+};
+
+// Float devices take the engine's samples as they are, overs included
+struct Float32Codec {
+    static const size_t BYTES = 4;
+
+    static size_t DecodeRun(const uint8_t* in, float* out, size_t count)
+    {
+        memcpy(out, in, count * sizeof(float));
+        return count;
+    }
+
+    static size_t EncodeRun(const float* in, uint8_t* out, size_t count)
+    {
+        memcpy(out, in, count * sizeof(float));
+        return count;
+    }
+
+    // Never reached
+    static float Decode(const uint8_t*) { return 0.0f; }
+    static void Encode(float, uint8_t*) {}
+};
+
+template <typename Codec, int Channels>
+static void DecodeFrames(const void* in, float* out, uint32_t frames)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(in);
+    uint32_t frame = static_cast<uint32_t>(Codec::DecodeRun(bytes, out, static_cast<size_t>(frames) * Channels) / Channels);
+    for (; frame < frames; frame++)
+    {
+        const uint8_t* source = bytes + frame * (Codec::BYTES * Channels);
+        float* target = out + frame * Channels;
+        for (int channel = 0; channel < Channels; channel++)
+        {
+            target[channel] = Codec::Decode(source + channel * Codec::BYTES);
+        }
+    }
+}
+
+template <typename Codec, int Channels>
+static void EncodeFrames(const float* in, void* out, uint32_t frames)
+{
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    uint32_t frame = static_cast<uint32_t>(Codec::EncodeRun(in, bytes, static_cast<size_t>(frames) * Channels) / Channels);
+    for (; frame < frames; frame++)
+    {
+        const float* source = in + frame * Channels;
+        uint8_t* target = bytes + frame * (Codec::BYTES * Channels);
+        for (int channel = 0; channel < Channels; channel++)
+        {
+            Codec::Encode(source[channel], target + channel * Codec::BYTES);
+        }
+    }
+}
+
+template <int Channels>
+static void AddStereo(const float* stereo, float* interleaved, uint32_t frames)
+{
+    uint32_t i = 0;
+#ifdef MUSICAPP_SSE2
+    if (Channels == 1)
+    {
+        const __m128 half = _mm_set1_ps(0.5f);
+        for (; i + 4 <= frames; i += 4)
+        {
+            __m128 first = _mm_loadu_ps(stereo + i * 2);
+            __m128 second = _mm_loadu_ps(stereo + i * 2 + 4);
+            __m128 left = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+            __m128 mono = _mm_mul_ps(_mm_add_ps(left, right), half);
+            _mm_storeu_ps(interleaved + i, _mm_add_ps(_mm_loadu_ps(interleaved + i), mono));
+        }
+    }
+    else if (Channels == 2)
+    {
+        for (; i + 2 <= frames; i += 2)
+        {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(interleaved + i * 2), _mm_loadu_ps(stereo + i * 2));
+            _mm_storeu_ps(interleaved + i * 2, sum);
+        }
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        float* frame = interleaved + i * Channels;
+        if (Channels == 1)
+        {
+            frame[0] += 0.5f * (stereo[i * 2] + stereo[i * 2 + 1]);
+        }
+        else
+        {
+            frame[0] += stereo[i * 2];
+            frame[1] += stereo[i * 2 + 1];
+        }
+    }
+}
+
+template <typename Codec, int Channels>
+static constexpr FramePipeline MakePipeline()
+{
+    return { &DecodeFrames<Codec, Channels>, &EncodeFrames<Codec, Channels>, &AddStereo<Channels> };
+}
+
+struct PipelineRow {
+    FramePipeline byChannels[PIPELINE_MAX_CHANNELS];
+};
+
+template <typename Codec>
+static constexpr PipelineRow MakeRow()
+{
+    return { { MakePipeline<Codec, 1>(), MakePipeline<Codec, 2>(), MakePipeline<Codec, 3>(), MakePipeline<Codec, 4>(),
+               MakePipeline<Codec, 5>(), MakePipeline<Codec, 6>(), MakePipeline<Codec, 7>(), MakePipeline<Codec, 8>() } };
+}
+
+// Indexed by DeviceSampleFormat
+static const PipelineRow s_pipelines[] = {
+    MakeRow<Pcm16Codec>(),
+    MakeRow<Pcm24Codec>(),
+    MakeRow<Pcm32Codec>(),
+    MakeRow<Float32Codec>()
+};
+
+size_t GetDeviceBytesPerSample(DeviceSampleFormat format)
+{
+    switch (format)
+    {
+        case DeviceSampleFormat::Pcm16:
+            return Pcm16Codec::BYTES;
+        case DeviceSampleFormat::Pcm24:
+            return Pcm24Codec::BYTES;
+        case DeviceSampleFormat::Pcm32:
+            return Pcm32Codec::BYTES;
+        case DeviceSampleFormat::Float32:
+            return Float32Codec::BYTES;
+    }
+    return 0;
+}
+
+const FramePipeline* GetFramePipeline(DeviceSampleFormat format, int channels)
+{
+    size_t row = static_cast<size_t>(format);
+    if (row >= sizeof(s_pipelines) / sizeof(s_pipelines[0]) || channels < 1 || channels > PIPELINE_MAX_CHANNELS)
+    {
+        return nullptr;
+    }
+    return &s_pipelines[row].byChannels[channels - 1];
+}
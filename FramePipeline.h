@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Sample encodings an audio device can be opened with, all little-endian
+enum class DeviceSampleFormat : uint8_t {
+    Pcm16,
+    Pcm24,      // Packed, three bytes per sample
+    Pcm32,
+    Float32
+};
+
+const int PIPELINE_MAX_CHANNELS = 8;
+
+size_t GetDeviceBytesPerSample(DeviceSampleFormat format);
+
+// The per-sample steps of the audio callback that depend on the device
+// format. Each entry is instantiated for one sample format and channel
+// count, so its loops have a fixed stride and no format checks inside;
+// the engine picks one per connection with GetFramePipeline.
+struct FramePipeline {
+    // Device samples to interleaved float in [-1, 1)
+    void (*decode)(const void* in, float* out, uint32_t frames);
+
+    // Interleaved float to device samples, saturating for PCM
+    void (*encode)(const float* in, void* out, uint32_t frames);
+
+    // Adds interleaved stereo to the frames: folded down for mono devices,
+    // into the front pair for more channels
+    void (*addStereo)(const float* stereo, float* interleaved, uint32_t frames);
+};
+
+// nullptr if the channel count is outside 1 to PIPELINE_MAX_CHANNELS
+const FramePipeline* GetFramePipeline(DeviceSampleFormat format, int channels);
@@ -0,0 +1,404 @@
+#include "HeadlessEngine.h"
+#include "RealtimeGuard.h"
+#include "SoakTest.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cwctype>
+#include <mutex>
+
+// Exit codes for unattended monitoring (1, a bad command line, comes from
+// WinMain). A missed startup budget is reported at exit even if audio
+// started later. Real-time violations only exist in builds with
+// MUSICAPP_REALTIME_CHECKS. A failed soak run (RunSoakTest) exits with 5.
+static const int EXIT_OK = 0;
+static const int EXIT_DEVICE_ERROR = 2;
+static const int EXIT_STARTUP_BUDGET_MISSED = 3;
+static const int EXIT_REALTIME_VIOLATIONS = 4;
+
+// How long the console handler holds off process termination on close,
+// logoff and shutdown while the engine stops; Windows allows about five seconds
+static const DWORD SHUTDOWN_WAIT_MS = 4000;
+
+static std::mutex s_stopMutex;
+static std::condition_variable s_stopSignal;
+static bool s_stopRequested = false;
+static bool s_stopped = false;
+
+static BOOL WINAPI ConsoleCtrlHandler(DWORD ctrlType)
+{
+    std::unique_lock<std::mutex> lock(s_stopMutex);
+    s_stopRequested = true;
+    s_stopSignal.notify_all();
+
+    // The process is killed as soon as these handlers return, so wait for
+    // the engine to close its devices and finish any recording
+    if (ctrlType == CTRL_CLOSE_EVENT || ctrlType == CTRL_LOGOFF_EVENT || ctrlType == CTRL_SHUTDOWN_EVENT)
+    {
+        s_stopSignal.wait_for(lock, std::chrono::milliseconds(SHUTDOWN_WAIT_MS), [] { return s_stopped; });
+    }
+    return TRUE;
+}
+
+static void AttachOutputConsole()
+{
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+    {
+        AllocConsole();
+    }
+    freopen("CONOUT$", "w", stdout);
+    freopen("CONOUT$", "w", stderr);
+}
+
+static std::wstring ToLower(std::wstring text)
+{
+    for (wchar_t& c : text)
+    {
+        c = static_cast<wchar_t>(towlower(c));
+    }
+    return text;
+}
+
+// Finds a device by list index or by case-insensitive name substring. Entry
+// 0 of an enumerated list is the "No Device" placeholder for the mapper, so
+// neither form ever selects it. An empty selector matches nothing.
+template <typename DeviceInfo>
+static bool ResolveDevice(const std::vector<DeviceInfo>& devices, const std::wstring& selector, DeviceInfo& result)
+{
+    if (selector.empty())
+    {
+        return false;
+    }
+    bool numeric = true;
+    for (wchar_t c : selector)
+    {
+        numeric = numeric && iswdigit(c);
+    }
+    if (numeric)
+    {
+        size_t index = wcstoul(selector.c_str(), nullptr, 10);
+        if (index == 0 || index >= devices.size())
+        {
+            return false;
+        }
+        result = devices[index];
+        return true;
+    }
+
+    std::wstring wanted = ToLower(selector);
+    for (size_t i = 1; i < devices.size(); i++)
+    {
+        if (ToLower(devices[i].name).find(wanted) != std::wstring::npos)
+        {
+            result = devices[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename DeviceInfo>
+static void PrintDevices(const wchar_t* title, const std::vector<DeviceInfo>& devices)
+{
+    fwprintf(stderr, L"%ls:\n", title);
+    for (size_t i = 1; i < devices.size(); i++)
+    {
+        fwprintf(stderr, L"  %zu: %ls\n", i, devices[i].name.c_str());
+    }
+}
+
+static std::string ToNarrowPath(const std::wstring& path)
+{
+    if (path.empty())
+    {
+        return std::string();
+    }
+    int length = WideCharToMultiByte(CP_ACP, 0, path.c_str(), static_cast<int>(path.size()), nullptr, 0, nullptr, nullptr);
+    std::string narrow(length, '\0');
+    WideCharToMultiByte(CP_ACP, 0, path.c_str(), static_cast<int>(path.size()), &narrow[0], length, nullptr, nullptr);
+    return narrow;
+}
+
+static const wchar_t* SampleFormatName(DeviceSampleFormat format)
+{
+    switch (format)
+    {
+        case DeviceSampleFormat::Pcm16:
+            return L"16-bit";
+        case DeviceSampleFormat::Pcm24:
+            return L"24-bit";
+        case DeviceSampleFormat::Pcm32:
+            return L"32-bit";
+        case DeviceSampleFormat::Float32:
+            return L"float";
+    }
+    return L"unknown";
+}
+
+static const wchar_t* DropoutCauseName(DropoutCause cause)
+{
+    switch (cause)
+    {
+        case DropoutCause::CaptureGap:
+            return L"capture gap";
+        case DropoutCause::EmptyBuffer:
+            return L"empty buffer";
+        case DropoutCause::OutputWriteFailed:
+            return L"output write failed";
+        case DropoutCause::RequeueFailed:
+            return L"requeue failed";
+    }
+    return L"unknown";
+}
+
+static const wchar_t* DropoutActionName(DropoutAction action)
+{
+    switch (action)
+    {
+        case DropoutAction::None:
+            return L"nothing missing yet";
+        case DropoutAction::Repeated:
+            return L"repeated";
+        case DropoutAction::FadedOut:
+            return L"faded out";
+    }
+    return L"unknown";
+}
+
+static void PrintStatus(DeviceManager& engine, const EngineConfig& config, double launchHostMs)
+{
+    EngineStats stats = engine.GetStats();
+    double uptime = (SampleTimeline::HostTimeMs() - launchHostMs) / 1000.0;
+
+    wprintf(L"[%9.1f s] buffers %llu, frames %llu, empty %llu, requeue failures %llu, write failures %llu, "
+            L"dropouts %llu (%llu frames repeated, %llu faded), midi in %llu, midi out %llu",
+            uptime,
+            static_cast<unsigned long long>(stats.buffersProcessed),
+            static_cast<unsigned long long>(stats.framesProcessed),
+            static_cast<unsigned long long>(stats.emptyBuffers),
+            static_cast<unsigned long long>(stats.requeueFailures),
+            static_cast<unsigned long long>(stats.outputWriteFailures),
+            static_cast<unsigned long long>(stats.dropouts),
+            static_cast<unsigned long long>(stats.concealedFrames),
+            static_cast<unsigned long long>(stats.silencedFrames),
+            static_cast<unsigned long long>(stats.midiMessagesIn),
+            static_cast<unsigned long long>(stats.midiMessagesOut));
+
+    if (!config.recordPath.empty())
+    {
+        wprintf(L", recorded %llu, dropped %llu",
+                static_cast<unsigned long long>(stats.recordedFrames),
+                static_cast<unsigned long long>(stats.recordDroppedFrames));
+    }
+
+    if (config.clockMode != MidiClockMode::Thru)
+    {
+        MidiClockStats clock = engine.GetMidiClockStats();
+        wprintf(L", clock %.2f bpm%ls, jitter %.2f ms", clock.tempoBpm,
+                config.clockMode == MidiClockMode::Slave && !clock.locked ? L" (unlocked)" : L"", clock.jitterMs);
+    }
+
+    if (!config.samplerMap.empty())
+    {
+        wprintf(L", voices %d", engine.GetSamplerVoiceCount());
+    }
+
+    if (config.midiBatch.tickMicros > 0)
+    {
+        MidiBatchStats batch = engine.GetMidiBatchStats();
+        wprintf(L", midi batches %llu, thinned %llu, latency %.2f/%.2f ms",
+                static_cast<unsigned long long>(batch.batches),
+                static_cast<unsigned long long>(batch.messagesThinned),
+                batch.averageLatencyMs, batch.maxLatencyMs);
+    }
+
+    wprintf(L"\n");
+
+    DropoutEvent event;
+    while (engine.ReadDropoutEvent(event))
+    {
+        wprintf(L"[%9.1f s] dropout at frame %llu: %u frames, %ls, %ls\n",
+                (event.hostTimeMs - launchHostMs) / 1000.0,
+                static_cast<unsigned long long>(event.streamFrame),
+                event.gapFrames,
+                DropoutCauseName(event.cause),
+                DropoutActionName(event.action));
+    }
+    fflush(stdout);
+}
+
+int RunHeadless(const EngineConfig& config, double launchHostMs)
+{
+    AttachOutputConsole();
+
+    if (config.soakSeconds > 0.0)
+    {
+        SoakOptions soak;
+        soak.simulatedSeconds = config.soakSeconds;
+        soak.numBuffers = config.numBuffers;
+        soak.bufferSize = config.bufferSize;
+        soak.device.seed = static_cast<uint64_t>(config.soakSeed);
+        return RunSoakTest(soak);
+    }
+
+    SetConsoleCtrlHandler(ConsoleCtrlHandler, TRUE);
+
+    DeviceManager engine;
+    if (config.numBuffers > 0 || config.bufferSize > 0)
+    {
+        engine.SetBufferGeometry(config.numBuffers > 0 ? config.numBuffers : engine.GetNumBuffers(),
+                                 config.bufferSize > 0 ? config.bufferSize : engine.GetBufferSize());
+    }
+    engine.SetAudioFormat(config.audioFormat);
+    engine.SetMidiBatching(config.midiBatch);
+    engine.SetTempo(config.tempoBpm);
+    engine.SetMidiClockMode(config.clockMode);
+
+    if (!config.samplerMap.empty())
+    {
+        std::wstring error;
+        if (!engine.LoadSampler(config.samplerMap, error))
+        {
+            fwprintf(stderr, L"%ls\n", error.c_str());
+            return EXIT_DEVICE_ERROR;
+        }
+        wprintf(L"Sampler: %ls\n", config.samplerMap.c_str());
+    }
+
+    // Readers can attach before the audio starts
+    if (!config.tapName.empty())
+    {
+        if (!engine.StartTap(config.tapName))
+        {
+            fwprintf(stderr, L"Cannot create the output tap %ls\n", config.tapName.c_str());
+            return EXIT_DEVICE_ERROR;
+        }
+        wprintf(L"Tap: %ls\n", config.tapName.c_str());
+    }
+
+    bool wantAudio = !config.audioIn.empty() || !config.audioOut.empty();
+    if (wantAudio)
+    {
+        std::vector<AudioDeviceInfo> inputs = engine.EnumerateAudioInputDevices();
+        std::vector<AudioDeviceInfo> outputs = engine.EnumerateAudioOutputDevices();
+        AudioDeviceInfo input, output;
+        if (!ResolveDevice(inputs, config.audioIn, input) || !ResolveDevice(outputs, config.audioOut, output))
+        {
+            fwprintf(stderr, L"Audio device not found (in: \"%ls\", out: \"%ls\")\n", config.audioIn.c_str(), config.audioOut.c_str());
+            PrintDevices(L"Audio inputs", inputs);
+            PrintDevices(L"Audio outputs", outputs);
+            return EXIT_DEVICE_ERROR;
+        }
+        if (!engine.ConnectAudioInputToOutput(input, output))
+        {
+            fwprintf(stderr, L"Failed to connect audio %ls -> %ls\n", input.name.c_str(), output.name.c_str());
+            return EXIT_DEVICE_ERROR;
+        }
+        AudioFormat format = engine.GetAudioFormat();
+        wprintf(L"Audio: %ls -> %ls, %d x %d bytes, %u Hz, %d channels, %ls\n", input.name.c_str(), output.name.c_str(),
+                engine.GetNumBuffers(), engine.GetBufferSize(), format.sampleRate, format.channels,
+                SampleFormatName(format.sampleFormat));
+    }
+
+    // An input alone plays the sampler without forwarding anything
+    if (!config.midiIn.empty() || !config.midiOut.empty())
+    {
+        std::vector<MidiDeviceInfo> inputs = engine.EnumerateMidiInputDevices();
+        std::vector<MidiDeviceInfo> outputs = engine.EnumerateMidiOutputDevices();
+        MidiDeviceInfo input, output;
+        bool forward = !config.midiOut.empty();
+        if (!ResolveDevice(inputs, config.midiIn, input) || (forward && !ResolveDevice(outputs, config.midiOut, output)))
+        {
+            fwprintf(stderr, L"MIDI device not found (in: \"%ls\", out: \"%ls\")\n", config.midiIn.c_str(), config.midiOut.c_str());
+            PrintDevices(L"MIDI inputs", inputs);
+            PrintDevices(L"MIDI outputs", outputs);
+            engine.DisconnectAudioDevices();
+            return EXIT_DEVICE_ERROR;
+        }
+        const wchar_t* outputName = forward ? output.name.c_str() : L"(none)";
+        if (forward ? !engine.ConnectMidiInputToOutput(input, output) : !engine.ConnectMidiInput(input))
+        {
+            fwprintf(stderr, L"Failed to connect MIDI %ls -> %ls\n", input.name.c_str(), outputName);
+            engine.DisconnectAudioDevices();
+            return EXIT_DEVICE_ERROR;
+        }
+        wprintf(L"MIDI: %ls -> %ls\n", input.name.c_str(), outputName);
+    }
+
+    if (!config.recordPath.empty())
+    {
+        if (!engine.StartRecording(ToNarrowPath(config.recordPath)))
+        {
+            fwprintf(stderr, L"Cannot record to %ls\n", config.recordPath.c_str());
+            engine.DisconnectMidiDevices();
+            engine.DisconnectAudioDevices();
+            return EXIT_DEVICE_ERROR;
+        }
+        wprintf(L"Recording to %ls\n", config.recordPath.c_str());
+    }
+
+    int exitCode = EXIT_OK;
+    std::unique_lock<std::mutex> lock(s_stopMutex);
+
+    // Startup is measured from process entry to the first buffer passing through
+    if (wantAudio)
+    {
+        double deadline = launchHostMs + config.startupBudgetMs;
+        while (!s_stopRequested && engine.GetStats().firstAudioHostMs == 0.0 && SampleTimeline::HostTimeMs() < deadline)
+        {
+            s_stopSignal.wait_for(lock, std::chrono::milliseconds(1));
+        }
+
+        double firstAudioMs = engine.GetStats().firstAudioHostMs;
+        if (firstAudioMs != 0.0 && firstAudioMs <= deadline)
+        {
+            wprintf(L"Audio flowing %.1f ms after launch (budget %d ms)\n", firstAudioMs - launchHostMs, config.startupBudgetMs);
+        }
+        else if (!s_stopRequested)
+        {
+            wprintf(L"Startup budget of %d ms missed: no audio yet\n", config.startupBudgetMs);
+            exitCode = EXIT_STARTUP_BUDGET_MISSED;
+        }
+    }
+    wprintf(L"Running; press Ctrl+C to stop\n");
+    fflush(stdout);
+
+    while (!s_stopRequested)
+    {
+        if (config.statusIntervalMs > 0)
+        {
+            if (!s_stopSignal.wait_for(lock, std::chrono::milliseconds(config.statusIntervalMs), [] { return s_stopRequested; }))
+            {
+                PrintStatus(engine, config, launchHostMs);
+            }
+        }
+        else
+        {
+            s_stopSignal.wait(lock, [] { return s_stopRequested; });
+        }
+    }
+    lock.unlock();
+
+    wprintf(L"Stopping\n");
+    engine.StopRecording();
+    engine.DisconnectMidiDevices();
+    engine.DisconnectAudioDevices();
+    PrintStatus(engine, config, launchHostMs);
+
+    if (RealtimeGuard::GetViolationCount() > 0)
+    {
+        fflush(stdout);
+        RealtimeGuard::PrintReport(stdout);
+        wprintf(L"%llu real-time violations in the device callbacks\n",
+                static_cast<unsigned long long>(RealtimeGuard::GetViolationCount()));
+        if (exitCode == EXIT_OK)
+        {
+            exitCode = EXIT_REALTIME_VIOLATIONS;
+        }
+    }
+
+    lock.lock();
+    s_stopped = true;
+    s_stopSignal.notify_all();
+    return exitCode;
+}
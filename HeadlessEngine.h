@@ -0,0 +1,12 @@
+#pragma once
+
+#include "EngineConfig.h"
+
+// Runs the engine with the configured routing and no UI until Ctrl+C,
+// Ctrl+Break, console close, logoff or shutdown. Output goes to the parent
+// console, or a new one if there is none. launchHostMs is the
+// SampleTimeline::HostTimeMs() taken at process entry; startup time is
+// measured from it to the first audio buffer. With soakSeconds set it runs
+// the soak harness against a simulated device instead. Returns the process
+// exit code.
+int RunHeadless(const EngineConfig& config, double launchHostMs);
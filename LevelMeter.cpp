@@ -0,0 +1,199 @@
+#include "LevelMeter.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+// Peak meters fall 20 dB in 1.5 s; RMS integrates over 300 ms
+static const double PEAK_RELEASE_SECONDS = 1.5 / std::log(10.0);
+static const double RMS_WINDOW_SECONDS = 0.3;
+
+// Anything this close to full scale counts as a clip for 16-bit sources
+static const float CLIP_LEVEL = 0.9999f;
+
+static void PeakAndSumSquares(const float* x, size_t frames, int channels, float* peak, float* sumSquares)
+{
+    for (int ch = 0; ch < channels; ch++)
+    {
+        peak[ch] = 0.0f;
+        sumSquares[ch] = 0.0f;
+    }
+
+    size_t count = frames * channels;
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    // Interleaved channels map onto fixed vector lanes when they divide four
+    if (4 % channels == 0)
+    {
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 maxAbs = _mm_setzero_ps();
+        __m128 sum = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 v = _mm_loadu_ps(x + i);
+            maxAbs = _mm_max_ps(maxAbs, _mm_and_ps(v, absMask));
+            sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+        }
+
+        alignas(16) float lanePeak[4];
+        alignas(16) float laneSum[4];
+        _mm_store_ps(lanePeak, maxAbs);
+        _mm_store_ps(laneSum, sum);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            int ch = lane % channels;
+            peak[ch] = std::max(peak[ch], lanePeak[lane]);
+            sumSquares[ch] += laneSum[lane];
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        int ch = static_cast<int>(i % channels);
+        float v = x[i];
+        peak[ch] = std::max(peak[ch], std::fabs(v));
+        sumSquares[ch] += v * v;
+    }
+}
+
+LevelMeter::LevelMeter()
+{
+    // Windowed-sinc lowpass at 90% of the original Nyquist, split into four phases
+    const int length = TAPS_PER_PHASE * OVERSAMPLE;
+    const double cutoff = 0.45 / OVERSAMPLE;
+    const double pi = 3.14159265358979323846;
+    double sum = 0.0;
+    double taps[TAPS_PER_PHASE * OVERSAMPLE];
+    for (int n = 0; n < length; n++)
+    {
+        double t = n - (length - 1) / 2.0;
+        double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * pi * cutoff * t) / (pi * t);
+        double window = 0.42 - 0.5 * std::cos(2.0 * pi * n / (length - 1)) + 0.08 * std::cos(4.0 * pi * n / (length - 1));
+        taps[n] = sinc * window;
+        sum += taps[n];
+    }
+    for (int n = 0; n < length; n++)
+    {
+        // Zero stuffing divides the level by the oversampling factor; restore it
+        m_coefficients[n / OVERSAMPLE][n % OVERSAMPLE] = static_cast<float>(taps[n] * OVERSAMPLE / sum);
+    }
+
+    Reset(2, 44100.0);
+}
+
+void LevelMeter::Reset(int channels, double sampleRate)
+{
+    m_channels = std::max(1, std::min(channels, METER_MAX_CHANNELS));
+    m_sampleRate = sampleRate > 0.0 ? sampleRate : 44100.0;
+    m_blocks = 0;
+    for (int ch = 0; ch < METER_MAX_CHANNELS; ch++)
+    {
+        m_peak[ch] = 0.0f;
+        m_meanSquare[ch] = 0.0f;
+        m_truePeak[ch] = 0.0f;
+        m_clipCount[ch] = 0;
+        std::fill(m_history[ch], m_history[ch] + TAPS_PER_PHASE - 1, 0.0f);
+    }
+}
+
+void LevelMeter::Process(const float* interleaved, size_t frames)
+{
+    while (frames > 0)
+    {
+        size_t count = std::min(frames, MAX_BLOCK_FRAMES);
+        ProcessBlock(interleaved, count);
+        interleaved += count * m_channels;
+        frames -= count;
+    }
+}
+
+void LevelMeter::ProcessBlock(const float* interleaved, size_t frames)
+{
+    float blockPeak[METER_MAX_CHANNELS];
+    float sumSquares[METER_MAX_CHANNELS];
+    PeakAndSumSquares(interleaved, frames, m_channels, blockPeak, sumSquares);
+
+    // Ballistics are applied once per block
+    float peakDecay = static_cast<float>(std::exp(-(frames / m_sampleRate) / PEAK_RELEASE_SECONDS));
+    float rmsWeight = static_cast<float>(1.0 - std::exp(-(frames / m_sampleRate) / RMS_WINDOW_SECONDS));
+
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        float truePeak = MeasureTruePeak(ch, interleaved, frames);
+
+        m_peak[ch] = std::max(blockPeak[ch], m_peak[ch] * peakDecay);
+        m_truePeak[ch] = std::max(std::max(truePeak, blockPeak[ch]), m_truePeak[ch] * peakDecay);
+        m_meanSquare[ch] += rmsWeight * (sumSquares[ch] / frames - m_meanSquare[ch]);
+        if (blockPeak[ch] >= CLIP_LEVEL)
+        {
+            m_clipCount[ch]++;
+        }
+    }
+    m_blocks++;
+
+    LevelReading& reading = m_published.WriteBuffer();
+    reading.channels = m_channels;
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        reading.peak[ch] = m_peak[ch];
+        reading.rms[ch] = std::sqrt(m_meanSquare[ch]);
+        reading.truePeak[ch] = m_truePeak[ch];
+        reading.clipCount[ch] = m_clipCount[ch];
+    }
+    reading.blocks = m_blocks;
+    m_published.Publish();
+}
+
+float LevelMeter::MeasureTruePeak(int channel, const float* interleaved, size_t frames)
+{
+    const int historyLength = TAPS_PER_PHASE - 1;
+
+    // Deinterleave behind the saved history so the filter reads one contiguous run
+    std::copy(m_history[channel], m_history[channel] + historyLength, m_scratch);
+    for (size_t n = 0; n < frames; n++)
+    {
+        m_scratch[historyLength + n] = interleaved[n * m_channels + channel];
+    }
+
+    float peak = 0.0f;
+#ifdef MUSICAPP_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 maxAbs = _mm_setzero_ps();
+    for (size_t n = 0; n < frames; n++)
+    {
+        const float* x = m_scratch + historyLength + n;
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < TAPS_PER_PHASE; k++)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(m_coefficients[k]), _mm_set1_ps(x[-k])));
+        }
+        maxAbs = _mm_max_ps(maxAbs, _mm_and_ps(acc, absMask));
+    }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, maxAbs);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#else
+    for (size_t n = 0; n < frames; n++)
+    {
+        const float* x = m_scratch + historyLength + n;
+        for (int phase = 0; phase < OVERSAMPLE; phase++)
+        {
+            float acc = 0.0f;
+            for (int k = 0; k < TAPS_PER_PHASE; k++)
+            {
+                acc += m_coefficients[k][phase] * x[-k];
+            }
+            peak = std::max(peak, std::fabs(acc));
+        }
+    }
+#endif
+
+    std::copy(m_scratch + frames, m_scratch + frames + historyLength, m_history[channel]);
+    return peak;
+}
+
+bool LevelMeter::Read(LevelReading& reading)
+{
+    bool updated = m_published.Update();
+    reading = m_published.ReadBuffer();
+    return updated;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "TripleBuffer.h"
+
+const int METER_MAX_CHANNELS = 8;
+
+// Meter values for display, linear full scale (1.0 = 0 dBFS)
+struct LevelReading {
+    int channels;
+    float peak[METER_MAX_CHANNELS];         // Sample peak with release ballistics
+    float rms[METER_MAX_CHANNELS];          // RMS over the integration window
+    float truePeak[METER_MAX_CHANNELS];     // Inter-sample peak from 4x oversampling
+    uint32_t clipCount[METER_MAX_CHANNELS]; // Blocks with a sample at or above full scale
+    uint64_t blocks;                        // Blocks metered since Reset
+};
+
+// Per-channel peak, RMS and true-peak metering for the audio callback.
+//
+// Process runs in the audio path with vectorized kernels and no allocation;
+// every block's result is published through a triple buffer that the UI
+// reads at display rate without locks (Read may only be called from one
+// thread).
+class LevelMeter {
+public:
+    // Largest block Process accepts in one call; longer blocks are split
+    static constexpr size_t MAX_BLOCK_FRAMES = 4096;
+
+    LevelMeter();
+
+    void Reset(int channels, double sampleRate);
+
+    // Audio thread: meter one block of interleaved float samples
+    void Process(const float* interleaved, size_t frames);
+
+    // UI thread: returns true when a newer reading than the last one was picked up
+    bool Read(LevelReading& reading);
+
+private:
+    static const int TAPS_PER_PHASE = 12;
+    static const int OVERSAMPLE = 4;
+
+    void ProcessBlock(const float* interleaved, size_t frames);
+    float MeasureTruePeak(int channel, const float* interleaved, size_t frames);
+
+    int m_channels;
+    double m_sampleRate;
+
+    // Ballistic state carried between blocks
+    float m_peak[METER_MAX_CHANNELS];
+    float m_meanSquare[METER_MAX_CHANNELS];
+    float m_truePeak[METER_MAX_CHANNELS];
+    uint32_t m_clipCount[METER_MAX_CHANNELS];
+    uint64_t m_blocks;
+
+    // Polyphase interpolation filter laid out [tap][phase] so one vector
+    // multiply-add per tap yields all four oversampled outputs
+    alignas(16) float m_coefficients[TAPS_PER_PHASE][OVERSAMPLE];
+
+    // Per-channel scratch: the last TAPS_PER_PHASE - 1 samples followed by the block
+    alignas(16) float m_history[METER_MAX_CHANNELS][TAPS_PER_PHASE - 1];
+    alignas(16) float m_scratch[TAPS_PER_PHASE - 1 + MAX_BLOCK_FRAMES];
+
+    TripleBuffer<LevelReading> m_published;
+};
@@ -0,0 +1,236 @@
+#include "LoopStore.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_set>
+
+LoopStore::LoopStore(int channels, size_t blockFrames)
+    : m_channels(channels > 0 ? channels : 1)
+    , m_blockFrames(blockFrames > 0 ? blockFrames : DEFAULT_BLOCK_FRAMES)
+    , m_maxHistory(256)
+    , m_position(0)
+{
+    auto silent = std::make_shared<SampleBlock>();
+    silent->samples.assign(m_blockFrames * m_channels, 0.0f);
+    m_silentBlock = silent;
+
+    Clear(0);
+}
+
+LoopStore::~LoopStore()
+{
+}
+
+void LoopStore::Clear(size_t lengthFrames)
+{
+    CancelOverdub();
+
+    auto table = std::make_shared<BlockTable>();
+    table->lengthFrames = lengthFrames;
+    table->blocks.assign((lengthFrames + m_blockFrames - 1) / m_blockFrames, m_silentBlock);
+
+    m_history.clear();
+    m_history.push_back(table);
+    m_position = 0;
+    std::atomic_store(&m_current, std::shared_ptr<const BlockTable>(table));
+}
+
+void LoopStore::BeginOverdub()
+{
+    std::shared_ptr<const BlockTable> current = m_history[m_position];
+
+    // Copy only the table; blocks stay shared until written
+    m_pending.reset(new BlockTable(*current));
+    m_pendingOwned.assign(m_pending->blocks.size(), nullptr);
+}
+
+SampleBlock* LoopStore::MakeWritable(size_t blockIndex)
+{
+    if (!m_pendingOwned[blockIndex])
+    {
+        auto copy = std::make_shared<SampleBlock>(*m_pending->blocks[blockIndex]);
+        m_pendingOwned[blockIndex] = copy;
+        m_pending->blocks[blockIndex] = copy;
+    }
+    return m_pendingOwned[blockIndex].get();
+}
+
+void LoopStore::WriteOverdub(size_t startFrame, const float* samples, size_t frames, float gain)
+{
+    if (!m_pending || m_pending->lengthFrames == 0)
+    {
+        return;
+    }
+
+    size_t length = m_pending->lengthFrames;
+    size_t frame = startFrame % length;
+    while (frames > 0)
+    {
+        size_t blockIndex = frame / m_blockFrames;
+        size_t offset = frame % m_blockFrames;
+
+        // Stop at the end of the block or the end of the loop, whichever is first
+        size_t count = std::min(frames, m_blockFrames - offset);
+        count = std::min(count, length - frame);
+
+        float* dest = MakeWritable(blockIndex)->samples.data() + offset * m_channels;
+        size_t sampleCount = count * m_channels;
+        for (size_t i = 0; i < sampleCount; i++)
+        {
+            dest[i] += samples[i] * gain;
+        }
+
+        samples += sampleCount;
+        frames -= count;
+        frame = (frame + count) % length;
+    }
+}
+
+void LoopStore::CommitOverdub()
+{
+    if (!m_pending)
+    {
+        return;
+    }
+
+    std::shared_ptr<const BlockTable> table(m_pending.release());
+    m_pendingOwned.clear();
+
+    // A new edit discards anything that could have been redone
+    m_history.resize(m_position + 1);
+    m_history.push_back(table);
+    m_position++;
+    TrimHistory();
+
+    Publish(table);
+}
+
+void LoopStore::CancelOverdub()
+{
+    m_pending.reset();
+    m_pendingOwned.clear();
+}
+
+bool LoopStore::Undo()
+{
+    if (m_pending || m_position == 0)
+    {
+        return false;
+    }
+
+    m_position--;
+    Publish(m_history[m_position]);
+    return true;
+}
+
+bool LoopStore::Redo()
+{
+    if (m_pending || m_position + 1 >= m_history.size())
+    {
+        return false;
+    }
+
+    m_position++;
+    Publish(m_history[m_position]);
+    return true;
+}
+
+void LoopStore::SetMaxHistory(size_t maxHistory)
+{
+    m_maxHistory = maxHistory > 0 ? maxHistory : 1;
+    TrimHistory();
+}
+
+void LoopStore::TrimHistory()
+{
+    // m_maxHistory counts undo steps, so keep one extra entry for the current version
+    if (m_history.size() > m_maxHistory + 1)
+    {
+        size_t excess = m_history.size() - (m_maxHistory + 1);
+        excess = std::min(excess, m_position);
+        m_history.erase(m_history.begin(), m_history.begin() + excess);
+        m_position -= excess;
+    }
+}
+
+void LoopStore::Publish(std::shared_ptr<const BlockTable> table)
+{
+    std::atomic_store(&m_current, std::move(table));
+}
+
+std::shared_ptr<const BlockTable> LoopStore::Snapshot() const
+{
+    return std::atomic_load(&m_current);
+}
+
+size_t LoopStore::Read(size_t startFrame, float* out, size_t frames) const
+{
+    std::shared_ptr<const BlockTable> table = Snapshot();
+    return Read(*table, m_channels, m_blockFrames, startFrame, out, frames);
+}
+
+size_t LoopStore::Read(const BlockTable& table, int channels, size_t blockFrames,
+                       size_t startFrame, float* out, size_t frames)
+{
+    size_t length = table.lengthFrames;
+    if (length == 0)
+    {
+        std::fill(out, out + frames * channels, 0.0f);
+        return 0;
+    }
+
+    // Reads wrap around the loop end so playback can run continuously
+    size_t frame = startFrame % length;
+    size_t remaining = frames;
+    while (remaining > 0)
+    {
+        size_t blockIndex = frame / blockFrames;
+        size_t offset = frame % blockFrames;
+        size_t count = std::min(remaining, blockFrames - offset);
+        count = std::min(count, length - frame);
+
+        const float* src = table.blocks[blockIndex]->samples.data() + offset * channels;
+        std::copy(src, src + count * channels, out);
+
+        out += count * channels;
+        remaining -= count;
+        frame = (frame + count) % length;
+    }
+
+    return frame;
+}
+
+size_t LoopStore::GetUniqueBlockCount() const
+{
+    std::unordered_set<const SampleBlock*> unique;
+    for (const auto& table : m_history)
+    {
+        for (const auto& block : table->blocks)
+        {
+            unique.insert(block.get());
+        }
+    }
+    if (m_pending)
+    {
+        for (const auto& block : m_pending->blocks)
+        {
+            unique.insert(block.get());
+        }
+    }
+    return unique.size();
+}
+
+size_t LoopStore::GetMemoryUsage() const
+{
+    size_t blockBytes = m_blockFrames * m_channels * sizeof(float);
+    size_t tableBytes = 0;
+    for (const auto& table : m_history)
+    {
+        tableBytes += sizeof(BlockTable) + table->blocks.size() * sizeof(std::shared_ptr<const SampleBlock>);
+    }
+    return GetUniqueBlockCount() * blockBytes + tableBytes;
+}
+
+size_t LoopStore::GetLengthFrames() const
+{
+    return Snapshot()->lengthFrames;
+}
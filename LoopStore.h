@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Fixed-size block of interleaved float samples. Blocks are immutable once
+// published in a table and are shared between every loop version that has
+// not written to them.
+struct SampleBlock {
+    std::vector<float> samples;
+};
+
+// One version of the loop: an ordered table of refcounted blocks
+struct BlockTable {
+    std::vector<std::shared_ptr<const SampleBlock>> blocks;
+    size_t lengthFrames;
+};
+
+// Block-based loop storage with copy-on-write overdubs and undo/redo.
+//
+// An overdub copies only the blocks it touches, so memory grows with the
+// audio actually changed rather than with loop length times history depth.
+// Editing (Clear/BeginOverdub/WriteOverdub/CommitOverdub/Undo/Redo) is meant
+// for a single control thread; Read and Snapshot may be called from any
+// thread and always see a complete version of the loop.
+class LoopStore {
+public:
+    static const size_t DEFAULT_BLOCK_FRAMES = 4096;
+
+    LoopStore(int channels, size_t blockFrames = DEFAULT_BLOCK_FRAMES);
+    ~LoopStore();
+
+    // Replace the loop with silence of the given length and drop all history
+    void Clear(size_t lengthFrames);
+
+    // Overdub editing. Writes between Begin and Commit form one undo step.
+    void BeginOverdub();
+    void WriteOverdub(size_t startFrame, const float* samples, size_t frames, float gain = 1.0f);
+    void CommitOverdub();
+    void CancelOverdub();
+
+    // History navigation; both are O(1) table swaps
+    bool Undo();
+    bool Redo();
+    size_t GetUndoDepth() const { return m_position; }
+    size_t GetRedoDepth() const { return m_history.size() - 1 - m_position; }
+    void SetMaxHistory(size_t maxHistory);
+
+    // Playback access. Read wraps at the loop end and returns the frame
+    // position following the last frame read.
+    std::shared_ptr<const BlockTable> Snapshot() const;
+    size_t Read(size_t startFrame, float* out, size_t frames) const;
+    static size_t Read(const BlockTable& table, int channels, size_t blockFrames,
+                       size_t startFrame, float* out, size_t frames);
+
+    // Memory accounting across the whole history
+    size_t GetUniqueBlockCount() const;
+    size_t GetMemoryUsage() const;
+
+    int GetChannels() const { return m_channels; }
+    size_t GetBlockFrames() const { return m_blockFrames; }
+    size_t GetLengthFrames() const;
+
+private:
+    void Publish(std::shared_ptr<const BlockTable> table);
+    void TrimHistory();
+    SampleBlock* MakeWritable(size_t blockIndex);
+
+    int m_channels;
+    size_t m_blockFrames;
+    size_t m_maxHistory;
+
+    // Current version visible to readers, swapped with std::atomic_store
+    std::shared_ptr<const BlockTable> m_current;
+
+    // Undo history; m_history[m_position] is the current version
+    std::vector<std::shared_ptr<const BlockTable>> m_history;
+    size_t m_position;
+
+    // Shared all-zero block used for untouched regions
+    std::shared_ptr<const SampleBlock> m_silentBlock;
+
+    // Pending overdub table and which of its blocks were already copied
+    std::unique_ptr<BlockTable> m_pending;
+    std::vector<std::shared_ptr<SampleBlock>> m_pendingOwned;
+};
@@ -0,0 +1,406 @@
+#include "MidiClock.h"
+#include <chrono>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+static const double TWO_PI = 6.283185307179586;
+
+// Weight of each new observation in the exponentially weighted statistics
+static const double STATS_WEIGHT = 0.02;
+
+static double PeriodToBpm(double periodMs)
+{
+    return periodMs > 0.0 ? 60000.0 / (periodMs * MIDI_CLOCK_PPQN) : 0.0;
+}
+
+static double BpmToPeriod(double bpm)
+{
+    return bpm > 0.0 ? 60000.0 / (bpm * MIDI_CLOCK_PPQN) : 0.0;
+}
+
+MidiClockPll::MidiClockPll()
+    : m_alpha(0.0)
+    , m_beta(0.0)
+{
+    SetBandwidth(0.01);
+    Reset();
+}
+
+void MidiClockPll::SetBandwidth(double bandwidth)
+{
+    // Second-order loop with zeta = 0.707: slightly underdamped, the
+    // Butterworth response, which settles faster than critical damping
+    // with about 4% overshoot
+    double wn = TWO_PI * bandwidth;
+    m_alpha = 2.0 * 0.707 * wn;
+    m_beta = wn * wn;
+}
+
+void MidiClockPll::Reset(double initialBpm)
+{
+    m_periodMs = BpmToPeriod(initialBpm);
+    m_phaseMs = 0.0;
+    m_lastRawMs = 0.0;
+    m_positionTicks = 0;
+    m_phasePosition = 0;
+    m_ticksSinceSync = 0;
+    m_running = false;
+    m_jitterVar = 0.0;
+    m_tempoMean = initialBpm;
+    m_tempoVar = 0.0;
+}
+
+void MidiClockPll::Acquire(double timeMs)
+{
+    // Snap the phase to the raw tick; the period is re-estimated from the next interval
+    m_phaseMs = timeMs;
+    m_lastRawMs = timeMs;
+    m_ticksSinceSync = 1;
+}
+
+void MidiClockPll::OnTick(double timeMs)
+{
+    m_phasePosition = m_positionTicks;
+    if (m_running)
+    {
+        m_positionTicks++;
+    }
+
+    if (m_ticksSinceSync == 0)
+    {
+        Acquire(timeMs);
+        return;
+    }
+
+    if (m_ticksSinceSync == 1)
+    {
+        // Coarse acquisition from the first raw interval
+        double interval = timeMs - m_lastRawMs;
+        if (interval > 0.0)
+        {
+            m_periodMs = interval;
+        }
+        m_phaseMs = timeMs;
+        m_lastRawMs = timeMs;
+        m_ticksSinceSync = 2;
+        return;
+    }
+
+    double predictedMs = m_phaseMs + m_periodMs;
+    double errorMs = timeMs - predictedMs;
+
+    // A gap or tempo jump larger than half a tick cannot be tracked smoothly
+    if (std::fabs(errorMs) > 0.5 * m_periodMs)
+    {
+        double interval = timeMs - m_lastRawMs;
+        Acquire(timeMs);
+        if (interval > 0.0 && interval < 4.0 * m_periodMs)
+        {
+            m_periodMs = interval;
+            m_ticksSinceSync = 2;
+        }
+        return;
+    }
+
+    m_phaseMs = predictedMs + m_alpha * errorMs;
+    m_periodMs += m_beta * errorMs;
+    m_lastRawMs = timeMs;
+    m_ticksSinceSync++;
+
+    UpdateStats(errorMs);
+}
+
+void MidiClockPll::UpdateStats(double errorMs)
+{
+    m_jitterVar += STATS_WEIGHT * (errorMs * errorMs - m_jitterVar);
+
+    double bpm = PeriodToBpm(m_periodMs);
+    double deviation = bpm - m_tempoMean;
+    m_tempoMean += STATS_WEIGHT * deviation;
+    m_tempoVar += STATS_WEIGHT * (deviation * deviation - m_tempoVar);
+}
+
+void MidiClockPll::OnStart()
+{
+    // The first clock after Start is the downbeat at position 0
+    m_running = true;
+    m_positionTicks = 0;
+    m_phasePosition = 0;
+}
+
+void MidiClockPll::OnContinue()
+{
+    m_running = true;
+}
+
+void MidiClockPll::OnStop()
+{
+    m_running = false;
+}
+
+void MidiClockPll::OnSongPosition(int sixteenths)
+{
+    // One sixteenth note is six clocks at 24 PPQN
+    m_positionTicks = static_cast<int64_t>(sixteenths) * (MIDI_CLOCK_PPQN / 4);
+    m_phasePosition = m_positionTicks;
+}
+
+double MidiClockPll::GetTempoBpm() const
+{
+    return PeriodToBpm(m_periodMs);
+}
+
+double MidiClockPhase::GetPositionTicks(double timeMs) const
+{
+    if (!running || periodMs <= 0.0)
+    {
+        return static_cast<double>(positionTicks);
+    }
+
+    double fraction = (timeMs - phaseMs) / periodMs;
+    return static_cast<double>(phasePosition) + fraction;
+}
+
+double MidiClockPll::GetPositionTicks(double timeMs) const
+{
+    return GetPhase().GetPositionTicks(timeMs);
+}
+
+MidiClockPhase MidiClockPll::GetPhase() const
+{
+    MidiClockPhase phase;
+    phase.periodMs = m_periodMs;
+    phase.phaseMs = m_phaseMs;
+    phase.phasePosition = m_phasePosition;
+    phase.positionTicks = m_positionTicks;
+    phase.running = m_running;
+    return phase;
+}
+
+MidiClockStats MidiClockPll::GetStats() const
+{
+    MidiClockStats stats = {};
+    stats.tempoBpm = GetTempoBpm();
+    stats.tempoStabilityBpm = std::sqrt(m_tempoVar);
+    stats.jitterMs = std::sqrt(m_jitterVar);
+    stats.ticks = static_cast<uint64_t>(m_positionTicks);
+    stats.running = m_running;
+    stats.locked = m_ticksSinceSync > MIDI_CLOCK_PPQN && stats.jitterMs < 0.25 * m_periodMs;
+    return stats;
+}
+
+PublishedMidiClock::PublishedMidiClock()
+    : m_sequence(0)
+    , m_periodMs(BpmToPeriod(120.0))
+    , m_phaseMs(0.0)
+    , m_phasePosition(0)
+    , m_positionTicks(0)
+    , m_running(false)
+    , m_tempoStabilityBpm(0.0)
+    , m_jitterMs(0.0)
+    , m_locked(false)
+{
+}
+
+void PublishedMidiClock::Publish(const MidiClockPll& pll)
+{
+    MidiClockPhase phase = pll.GetPhase();
+    MidiClockStats stats = pll.GetStats();
+
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_periodMs.store(phase.periodMs, std::memory_order_relaxed);
+    m_phaseMs.store(phase.phaseMs, std::memory_order_relaxed);
+    m_phasePosition.store(phase.phasePosition, std::memory_order_relaxed);
+    m_positionTicks.store(phase.positionTicks, std::memory_order_relaxed);
+    m_running.store(phase.running, std::memory_order_relaxed);
+    m_tempoStabilityBpm.store(stats.tempoStabilityBpm, std::memory_order_relaxed);
+    m_jitterMs.store(stats.jitterMs, std::memory_order_relaxed);
+    m_locked.store(stats.locked, std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void PublishedMidiClock::Load(MidiClockPhase& phase, MidiClockStats& stats) const
+{
+    uint32_t before;
+    uint32_t after;
+    do
+    {
+        before = m_sequence.load(std::memory_order_acquire);
+        phase.periodMs = m_periodMs.load(std::memory_order_relaxed);
+        phase.phaseMs = m_phaseMs.load(std::memory_order_relaxed);
+        phase.phasePosition = m_phasePosition.load(std::memory_order_relaxed);
+        phase.positionTicks = m_positionTicks.load(std::memory_order_relaxed);
+        phase.running = m_running.load(std::memory_order_relaxed);
+        stats.tempoStabilityBpm = m_tempoStabilityBpm.load(std::memory_order_relaxed);
+        stats.jitterMs = m_jitterMs.load(std::memory_order_relaxed);
+        stats.locked = m_locked.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = m_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+
+    stats.tempoBpm = PeriodToBpm(phase.periodMs);
+    stats.ticks = static_cast<uint64_t>(phase.positionTicks);
+    stats.running = phase.running;
+}
+
+MidiClockPhase PublishedMidiClock::GetPhase() const
+{
+    MidiClockPhase phase;
+    MidiClockStats stats;
+    Load(phase, stats);
+    return phase;
+}
+
+MidiClockStats PublishedMidiClock::GetStats() const
+{
+    MidiClockPhase phase;
+    MidiClockStats stats;
+    Load(phase, stats);
+    return stats;
+}
+
+MidiClockMaster::MidiClockMaster()
+    : m_running(false)
+    , m_tempoBpm(120.0)
+    , m_ticks(0)
+    , m_jitterMs(0.0)
+    , m_lastTickNs(0)
+{
+}
+
+MidiClockMaster::~MidiClockMaster()
+{
+    Stop();
+}
+
+bool MidiClockMaster::Start(const Sender& sender, double tempoBpm)
+{
+    if (m_running || !sender || tempoBpm <= 0.0)
+    {
+        return false;
+    }
+
+    m_sender = sender;
+    m_tempoBpm = tempoBpm;
+    m_ticks = 0;
+    m_jitterMs = 0.0;
+    m_running = true;
+    m_thread = std::thread(&MidiClockMaster::SchedulerThread, this);
+    return true;
+}
+
+void MidiClockMaster::Stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    m_running = false;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+    m_sender(MIDI_STOP);
+}
+
+void MidiClockMaster::SetTempo(double tempoBpm)
+{
+    if (tempoBpm > 0.0)
+    {
+        m_tempoBpm = tempoBpm;
+    }
+}
+
+void MidiClockMaster::SchedulerThread()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    // Sleep until this close to a deadline, then spin for the remainder
+    const std::chrono::microseconds spinWindow(1500);
+
+#ifdef _WIN32
+    // Default scheduler granularity is ~15ms; sleeps must land inside the spin window
+    timeBeginPeriod(1);
+#endif
+
+    Clock::time_point deadline = Clock::now();
+    m_lastTickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    m_sender(MIDI_START);
+
+    double jitterVar = 0.0;
+    while (m_running)
+    {
+        Clock::time_point wake = deadline - spinWindow;
+        if (Clock::now() < wake)
+        {
+            std::this_thread::sleep_until(wake);
+        }
+        while (Clock::now() < deadline)
+        {
+            std::this_thread::yield();
+        }
+
+        if (!m_running)
+        {
+            break;
+        }
+
+        m_sender(MIDI_CLOCK);
+        Clock::time_point sent = Clock::now();
+
+        double errorMs = std::chrono::duration<double, std::milli>(sent - deadline).count();
+        jitterVar += STATS_WEIGHT * (errorMs * errorMs - jitterVar);
+        m_jitterMs = std::sqrt(jitterVar);
+        m_lastTickNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        m_ticks++;
+
+        // Schedule from the ideal deadline, not the send time, so errors never accumulate
+        double periodMs = BpmToPeriod(m_tempoBpm);
+        deadline += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(periodMs));
+    }
+
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+double MidiClockMaster::GetPositionTicks() const
+{
+    if (!m_running)
+    {
+        return static_cast<double>(m_ticks);
+    }
+
+    int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    double periodNs = BpmToPeriod(m_tempoBpm) * 1e6;
+    double fraction = (nowNs - m_lastTickNs) / periodNs;
+    if (fraction > 1.0)
+    {
+        fraction = 1.0;
+    }
+
+    // m_ticks counts sent clocks; the last one sent marks position m_ticks - 1
+    return m_ticks > 0 ? static_cast<double>(m_ticks - 1) + fraction : 0.0;
+}
+
+MidiClockStats MidiClockMaster::GetStats() const
+{
+    MidiClockStats stats = {};
+    stats.tempoBpm = m_tempoBpm;
+    stats.tempoStabilityBpm = 0.0;
+    stats.jitterMs = m_jitterMs;
+    stats.ticks = m_ticks;
+    stats.running = m_running;
+    stats.locked = true;
+    return stats;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// MIDI system real-time and common messages used for clock sync
+const uint8_t MIDI_CLOCK = 0xF8;
+const uint8_t MIDI_START = 0xFA;
+const uint8_t MIDI_CONTINUE = 0xFB;
+const uint8_t MIDI_STOP = 0xFC;
+const uint8_t MIDI_SONG_POSITION = 0xF2;
+
+const int MIDI_CLOCK_PPQN = 24;
+
+struct MidiClockStats {
+    double tempoBpm;            // Current (filtered) tempo
+    double tempoStabilityBpm;   // Standard deviation of the instantaneous tempo around the filtered tempo
+    double jitterMs;            // RMS deviation of clock ticks from their ideal time
+    uint64_t ticks;             // Clock ticks sent or received since the last start
+    bool running;               // Transport is running
+    bool locked;                // Slave PLL has converged (always true for the master)
+};
+
+// Clock phase at the last tick, enough to extrapolate the position
+struct MidiClockPhase {
+    double periodMs;
+    double phaseMs;             // Filtered time of the last tick
+    int64_t phasePosition;      // Position of the tick at phaseMs
+    int64_t positionTicks;      // Ticks counted since start/song position
+    bool running;
+
+    // Clock position in ticks at the given time; stopped clocks stay put
+    double GetPositionTicks(double timeMs) const;
+};
+
+// Second-order PLL that locks onto an incoming 24 PPQN clock.
+//
+// Tick timestamps are in milliseconds on any monotonic time base. The loop
+// filter corrects phase and period from each tick's arrival error, so jitter
+// in the incoming stream is averaged out while slow tempo changes are
+// tracked. Independent of any device so it can be driven offline.
+class MidiClockPll {
+public:
+    MidiClockPll();
+
+    // Loop bandwidth as a fraction of the tick rate; lower rejects more jitter
+    void SetBandwidth(double bandwidth);
+    void Reset(double initialBpm = 120.0);
+
+    // Transport and clock events
+    void OnTick(double timeMs);
+    void OnStart();
+    void OnContinue();
+    void OnStop();
+    void OnSongPosition(int sixteenths);
+
+    double GetTempoBpm() const;
+    double GetTickPeriodMs() const { return m_periodMs; }
+
+    // Clock position in ticks at the given time, extrapolated from the PLL
+    // phase so that followers do not accumulate drift between ticks
+    double GetPositionTicks(double timeMs) const;
+
+    MidiClockPhase GetPhase() const;
+    MidiClockStats GetStats() const;
+
+private:
+    void Acquire(double timeMs);
+    void UpdateStats(double errorMs);
+
+    double m_alpha;             // Phase correction gain
+    double m_beta;              // Period correction gain
+    double m_periodMs;
+    double m_phaseMs;           // Filtered time of the last tick
+    double m_lastRawMs;         // Unfiltered arrival time of the last tick
+    int64_t m_positionTicks;    // Ticks counted since start/song position
+    int64_t m_phasePosition;    // Position of the tick at m_phaseMs
+    int m_ticksSinceSync;
+    bool m_running;
+
+    // Exponentially weighted statistics
+    double m_jitterVar;
+    double m_tempoMean;
+    double m_tempoVar;
+};
+
+// Copy of a PLL's phase and statistics for other threads. The thread that
+// drives the PLL publishes after each event and never waits; readers retry
+// if they overlap an update instead of taking a lock.
+class PublishedMidiClock {
+public:
+    PublishedMidiClock();
+
+    // Single writer thread
+    void Publish(const MidiClockPll& pll);
+
+    // Any thread
+    MidiClockPhase GetPhase() const;
+    MidiClockStats GetStats() const;
+
+private:
+    void Load(MidiClockPhase& phase, MidiClockStats& stats) const;
+
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<double> m_periodMs;
+    std::atomic<double> m_phaseMs;
+    std::atomic<int64_t> m_phasePosition;
+    std::atomic<int64_t> m_positionTicks;
+    std::atomic<bool> m_running;
+    std::atomic<double> m_tempoStabilityBpm;
+    std::atomic<double> m_jitterMs;
+    std::atomic<bool> m_locked;
+};
+
+// Clock master that emits jitter-free 24 PPQN clock from a dedicated
+// high-resolution scheduler thread. The sender is called from that thread.
+class MidiClockMaster {
+public:
+    typedef std::function<void(uint8_t)> Sender;
+
+    MidiClockMaster();
+    ~MidiClockMaster();
+
+    bool Start(const Sender& sender, double tempoBpm);
+    void Stop();
+    bool IsRunning() const { return m_running; }
+
+    // Takes effect from the next tick without a phase jump
+    void SetTempo(double tempoBpm);
+    double GetTempoBpm() const { return m_tempoBpm; }
+
+    double GetPositionTicks() const;
+    MidiClockStats GetStats() const;
+
+private:
+    void SchedulerThread();
+
+    Sender m_sender;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<double> m_tempoBpm;
+
+    // Published by the scheduler thread
+    std::atomic<uint64_t> m_ticks;
+    std::atomic<double> m_jitterMs;
+    std::atomic<int64_t> m_lastTickNs;
+};
@@ -0,0 +1,418 @@
+#include "MidiOutBatcher.h"
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#endif
+
+static const uint16_t NO_VALUE = 0xFFFF;
+
+static int64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Length in bytes of a short message, 0 for bytes that cannot start one
+static size_t MessageLength(uint8_t status)
+{
+    if (status < 0x80)
+    {
+        return 0;
+    }
+    if (status < 0xF0)
+    {
+        uint8_t type = status & 0xF0;
+        return (type == 0xC0 || type == 0xD0) ? 2 : 3;
+    }
+    switch (status)
+    {
+        case 0xF1:
+        case 0xF3:
+            return 2;
+        case 0xF2:
+            return 3;
+        case 0xF0:
+        case 0xF7:
+            return 0;       // SysEx never arrives as a short message
+        default:
+            return 1;
+    }
+}
+
+// Thinning slot for continuous controllers, or -1 for messages that must
+// always be sent
+static int ThinSlot(uint32_t message)
+{
+    switch (message & 0xF0)
+    {
+        case 0xB0:
+        {
+            // Bank select, data entry, parameter numbers, switches and channel
+            // mode messages mean something on every occurrence
+            uint8_t cc = (message >> 8) & 0x7F;
+            if (cc == 0 || cc == 32 || cc == 6 || cc == 38 || (cc >= 64 && cc <= 69) ||
+                (cc >= 96 && cc <= 101) || cc >= 120)
+            {
+                return -1;
+            }
+            return cc;
+        }
+        case 0xE0:
+            return 128;     // Pitch bend
+        case 0xD0:
+            return 129;     // Channel pressure
+    }
+    return -1;
+}
+
+MidiOutBatcher::MidiOutBatcher()
+    : m_running(false)
+    , m_spilling(false)
+    , m_staleChannels(0)
+    , m_messagesIn(0)
+    , m_messagesSent(0)
+    , m_messagesThinned(0)
+    , m_messagesSpilled(0)
+    , m_queueOverflows(0)
+    , m_batches(0)
+    , m_bytesSent(0)
+    , m_statusBytesSaved(0)
+    , m_submitStalls(0)
+    , m_totalLatencyMs(0.0)
+    , m_maxLatencyMs(0.0)
+{
+    m_options.tickMicros = 1000;
+    m_options.runningStatus = false;
+    m_options.thinControllers = false;
+
+    m_pending.reserve(MAX_PENDING);
+    m_encodeMessages.reserve(MAX_PENDING);
+    m_bytes.resize(MAX_BATCH_BYTES);
+}
+
+MidiOutBatcher::~MidiOutBatcher()
+{
+    Stop();
+}
+
+bool MidiOutBatcher::Start(const Submitter& submitter, const MidiBatchOptions& options)
+{
+    if (m_running || !submitter)
+    {
+        return false;
+    }
+
+    m_submitter = submitter;
+    m_options = options;
+    m_options.tickMicros = std::max(100u, options.tickMicros);
+
+    m_queue.Clear();
+    m_spill.Clear();
+    m_spilling = false;
+    m_staleChannels = 0;
+    m_pending.clear();
+    ResetThinning();
+    std::fill(&m_lastSent[0][0], &m_lastSent[0][0] + 16 * THIN_SLOTS, NO_VALUE);
+
+    m_messagesIn = 0;
+    m_messagesSent = 0;
+    m_messagesThinned = 0;
+    m_messagesSpilled = 0;
+    m_queueOverflows = 0;
+    m_batches = 0;
+    m_bytesSent = 0;
+    m_statusBytesSaved = 0;
+    m_submitStalls = 0;
+    m_totalLatencyMs = 0.0;
+    m_maxLatencyMs = 0.0;
+
+    m_running = true;
+    m_thread = std::thread(&MidiOutBatcher::SenderThread, this);
+    return true;
+}
+
+void MidiOutBatcher::Stop()
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    m_running = false;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    // One last attempt at whatever is still queued
+    Collect();
+    Flush();
+}
+
+bool MidiOutBatcher::Send(uint32_t message)
+{
+    QueuedMessage queued;
+    queued.message = message;
+    queued.queuedNs = NowNs();
+
+    // Back to the main queue only once the sender has taken every spilled
+    // message, which it does only after emptying the main queue
+    if (m_spilling && m_spill.Size() == 0)
+    {
+        m_spilling = false;
+    }
+    if (!m_spilling && m_queue.Push(queued))
+    {
+        m_messagesIn.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    m_spilling = true;
+    if (m_spill.Push(queued))
+    {
+        m_messagesIn.fetch_add(1, std::memory_order_relaxed);
+        m_messagesSpilled.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // The caller sends this one ahead of the queues, so the receiver's
+    // controller values on its channel are no longer the ones last sent
+    uint8_t status = static_cast<uint8_t>(message & 0xFF);
+    uint32_t channels = status < 0xF0 ? 1u << (status & 0x0F) : (status == 0xFF ? 0xFFFFu : 0u);
+    m_staleChannels.fetch_or(channels, std::memory_order_release);
+    m_queueOverflows.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+MidiBatchStats MidiOutBatcher::GetStats() const
+{
+    MidiBatchStats stats;
+    stats.messagesIn = m_messagesIn;
+    stats.messagesSent = m_messagesSent;
+    stats.messagesThinned = m_messagesThinned;
+    stats.messagesSpilled = m_messagesSpilled;
+    stats.queueOverflows = m_queueOverflows;
+    stats.batches = m_batches;
+    stats.bytesSent = m_bytesSent;
+    stats.statusBytesSaved = m_statusBytesSaved;
+    stats.submitStalls = m_submitStalls;
+    stats.averageLatencyMs = stats.messagesSent > 0 ? m_totalLatencyMs / stats.messagesSent : 0.0;
+    stats.maxLatencyMs = m_maxLatencyMs;
+    return stats;
+}
+
+size_t MidiOutBatcher::Encode(const uint32_t* messages, size_t count, bool runningStatus,
+                              uint8_t* out, size_t capacity, size_t& messagesUsed)
+{
+    size_t size = 0;
+    uint8_t running = 0;
+    messagesUsed = 0;
+
+    for (; messagesUsed < count; messagesUsed++)
+    {
+        uint32_t message = messages[messagesUsed];
+        uint8_t status = static_cast<uint8_t>(message & 0xFF);
+        size_t length = MessageLength(status);
+        if (length == 0)
+        {
+            continue;
+        }
+
+        // Channel messages with the previous status send only their data bytes
+        bool omitStatus = runningStatus && status == running;
+        size_t bytes = omitStatus ? length - 1 : length;
+        if (size + bytes > capacity)
+        {
+            break;
+        }
+
+        for (size_t i = omitStatus ? 1 : 0; i < length; i++)
+        {
+            out[size++] = static_cast<uint8_t>(message >> (8 * i));
+        }
+
+        // Real-time bytes may interleave without affecting running status;
+        // system common messages cancel it
+        if (status < 0xF0)
+        {
+            running = status;
+        }
+        else if (status < 0xF8)
+        {
+            running = 0;
+        }
+    }
+    return size;
+}
+
+void MidiOutBatcher::SenderThread()
+{
+    typedef std::chrono::steady_clock Clock;
+
+#ifdef _WIN32
+    // Default scheduler granularity is ~15ms, far longer than a tick
+    timeBeginPeriod(1);
+#endif
+
+    const std::chrono::microseconds tick(m_options.tickMicros);
+    Clock::time_point deadline = Clock::now() + tick;
+    while (m_running)
+    {
+        std::this_thread::sleep_until(deadline);
+        deadline += tick;
+
+        // After a long stall, resume from now instead of bursting to catch up
+        Clock::time_point now = Clock::now();
+        if (deadline < now)
+        {
+            deadline = now + tick;
+        }
+
+        Collect();
+        Flush();
+    }
+
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void MidiOutBatcher::Collect()
+{
+    // Values sent directly have replaced the ones thinning remembers, and
+    // no queued value may be merged across them
+    uint32_t stale = m_staleChannels.exchange(0, std::memory_order_acquire);
+    for (int channel = 0; channel < 16; channel++)
+    {
+        if (stale & (1u << channel))
+        {
+            std::fill(m_lastSent[channel], m_lastSent[channel] + THIN_SLOTS, NO_VALUE);
+            m_channelBarrier[channel] = m_pending.size();
+        }
+    }
+
+    // Spilled messages come after everything in the main queue
+    while (m_pending.size() < MAX_PENDING)
+    {
+        SpscQueue<QueuedMessage, MAX_PENDING>& queue = m_queue.Front() ? m_queue : m_spill;
+        const QueuedMessage* queued = queue.Front();
+        if (!queued)
+        {
+            break;
+        }
+        Append(*queued);
+        queue.PopFront();
+    }
+}
+
+void MidiOutBatcher::Append(const QueuedMessage& queued)
+{
+    uint8_t status = static_cast<uint8_t>(queued.message & 0xFF);
+    if (!m_options.thinControllers || status >= 0xF0)
+    {
+        m_pending.push_back(queued);
+
+        // A system reset returns every controller on the receiver to its
+        // default, so no value sent before it may be assumed or replaced
+        if (m_options.thinControllers && status == 0xFF)
+        {
+            std::fill(&m_lastSent[0][0], &m_lastSent[0][0] + 16 * THIN_SLOTS, NO_VALUE);
+            std::fill(m_channelBarrier, m_channelBarrier + 16, m_pending.size());
+        }
+        return;
+    }
+
+    int channel = status & 0x0F;
+    int slot = ThinSlot(queued.message);
+    if (slot < 0)
+    {
+        // Channel mode messages and program changes may reset the channel's
+        // controllers
+        uint8_t type = status & 0xF0;
+        if (type == 0xC0 || (type == 0xB0 && ((queued.message >> 8) & 0x7F) >= 120))
+        {
+            std::fill(m_lastSent[channel], m_lastSent[channel] + THIN_SLOTS, NO_VALUE);
+        }
+
+        // Later controller values may not move across this message
+        m_pending.push_back(queued);
+        m_channelBarrier[channel] = m_pending.size();
+        return;
+    }
+
+    uint16_t value = static_cast<uint16_t>((queued.message >> 8) & 0x7F7F);
+    if (value == m_lastSent[channel][slot])
+    {
+        m_messagesThinned.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_lastSent[channel][slot] = value;
+
+    // Replace the earlier value when nothing else was sent on the channel
+    // since; it keeps its place and queue time
+    int index = m_pendingSlot[channel][slot];
+    if (index >= 0 && static_cast<size_t>(index) >= m_channelBarrier[channel])
+    {
+        m_pending[index].message = queued.message;
+        m_messagesThinned.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    m_pendingSlot[channel][slot] = static_cast<int>(m_pending.size());
+    m_pending.push_back(queued);
+}
+
+void MidiOutBatcher::Flush()
+{
+    if (m_pending.empty())
+    {
+        return;
+    }
+
+    m_encodeMessages.clear();
+    for (const QueuedMessage& queued : m_pending)
+    {
+        m_encodeMessages.push_back(queued.message);
+    }
+
+    size_t used = 0;
+    size_t size = Encode(m_encodeMessages.data(), m_encodeMessages.size(), m_options.runningStatus,
+                         m_bytes.data(), m_bytes.size(), used);
+    if (size > 0 && !m_submitter(m_bytes.data(), size))
+    {
+        // The device still holds every buffer; retry on the next tick
+        m_submitStalls.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    int64_t nowNs = NowNs();
+    double totalLatencyMs = 0.0;
+    double maxLatencyMs = m_maxLatencyMs;
+    size_t fullSize = 0;
+    for (size_t i = 0; i < used; i++)
+    {
+        double latencyMs = (nowNs - m_pending[i].queuedNs) * 1e-6;
+        totalLatencyMs += latencyMs;
+        maxLatencyMs = std::max(maxLatencyMs, latencyMs);
+        fullSize += MessageLength(static_cast<uint8_t>(m_pending[i].message & 0xFF));
+    }
+
+    m_messagesSent.fetch_add(used, std::memory_order_relaxed);
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_bytesSent.fetch_add(size, std::memory_order_relaxed);
+    m_statusBytesSaved.fetch_add(fullSize - size, std::memory_order_relaxed);
+    m_totalLatencyMs = m_totalLatencyMs + totalLatencyMs;
+    m_maxLatencyMs = maxLatencyMs;
+
+    // Pending indices shift, so nothing left over can be replaced in place
+    m_pending.erase(m_pending.begin(), m_pending.begin() + used);
+    ResetThinning();
+}
+
+void MidiOutBatcher::ResetThinning()
+{
+    std::fill(&m_pendingSlot[0][0], &m_pendingSlot[0][0] + 16 * THIN_SLOTS, -1);
+    std::fill(m_channelBarrier, m_channelBarrier + 16, 0);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include "SpscQueue.h"
+
+struct MidiBatchOptions {
+    unsigned tickMicros;        // How long messages are collected before one submit
+    bool runningStatus;         // Omit repeated channel status bytes
+    bool thinControllers;       // Collapse and drop redundant continuous controller values
+};
+
+struct MidiBatchStats {
+    uint64_t messagesIn;        // Messages handed to Send
+    uint64_t messagesSent;
+    uint64_t messagesThinned;   // Superseded within a tick or equal to the value last sent
+    uint64_t messagesSpilled;   // Held back in order while the queue was full
+    uint64_t queueOverflows;    // Messages the caller had to send directly
+    uint64_t batches;
+    uint64_t bytesSent;
+    uint64_t statusBytesSaved;  // Saved by running status
+    uint64_t submitStalls;      // Ticks where the submitter had no free buffer
+    double averageLatencyMs;    // Time from Send to submit
+    double maxLatencyMs;
+};
+
+// Coalesces outgoing short MIDI messages into one byte buffer per scheduling
+// tick so a dense controller stream costs one driver call per tick instead
+// of one per message.
+//
+// Send is called from the MIDI input callback and never blocks: messages go
+// through a lock-free queue to a sender thread. Each tick the sender thread
+// encodes the queued messages and hands the bytes to the submitter, which
+// returns false if it cannot take them yet; they are then retried on the
+// next tick. While the sender is stalled and the queue is full, messages
+// wait in a second queue behind it. Messages keep their order, except that
+// with thinning a controller value replaces an earlier value of the same
+// controller when nothing else was sent on that channel between them, and
+// that a message the caller sends itself overtakes those still queued.
+// Independent of any device so it can be driven offline.
+class MidiOutBatcher {
+public:
+    typedef std::function<bool(const uint8_t* bytes, size_t size)> Submitter;
+
+    // Largest buffer handed to the submitter
+    static const size_t MAX_BATCH_BYTES = 4096;
+
+    MidiOutBatcher();
+    ~MidiOutBatcher();
+
+    bool Start(const Submitter& submitter, const MidiBatchOptions& options);
+    void Stop();
+    bool IsRunning() const { return m_running; }
+
+    // Input callback: queue a packed short message (status in the low byte).
+    // Returns false when both queues are full and the caller should send
+    // the message itself; thinning then forgets what it last sent on the
+    // message's channel.
+    bool Send(uint32_t message);
+
+    MidiBatchStats GetStats() const;
+
+    // Encodes messages into raw MIDI bytes, optionally with running status.
+    // Returns the number of bytes written; stops early when out is full and
+    // reports how many messages fit through messagesUsed.
+    static size_t Encode(const uint32_t* messages, size_t count, bool runningStatus,
+                         uint8_t* out, size_t capacity, size_t& messagesUsed);
+
+private:
+    struct QueuedMessage {
+        uint32_t message;
+        int64_t queuedNs;           // steady_clock time of Send
+    };
+
+    static const size_t MAX_PENDING = 4096;
+
+    void SenderThread();
+    void Collect();
+    void Append(const QueuedMessage& queued);
+    void Flush();
+    void ResetThinning();
+
+    Submitter m_submitter;
+    MidiBatchOptions m_options;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    SpscQueue<QueuedMessage, MAX_PENDING> m_queue;
+
+    // Messages after the queue filled, collected once it is empty. The
+    // input callback spills everything until this drains, so nothing
+    // overtakes a spilled message.
+    SpscQueue<QueuedMessage, MAX_PENDING> m_spill;
+    bool m_spilling;                    // Input callback only
+    std::atomic<uint32_t> m_staleChannels;  // Bit per channel sent around the queues
+
+    // Sender thread state: messages waiting for the next submit
+    std::vector<QueuedMessage> m_pending;
+    std::vector<uint32_t> m_encodeMessages;
+    std::vector<uint8_t> m_bytes;
+
+    // Controller thinning: slot per channel for CC 0-127, pitch bend and
+    // channel pressure
+    static const int THIN_SLOTS = 130;
+    int m_pendingSlot[16][THIN_SLOTS];  // Index in m_pending, or -1
+    size_t m_channelBarrier[16];        // m_pending size after the last non-controller message
+    uint16_t m_lastSent[16][THIN_SLOTS];
+
+    std::atomic<uint64_t> m_messagesIn;
+    std::atomic<uint64_t> m_messagesSent;
+    std::atomic<uint64_t> m_messagesThinned;
+    std::atomic<uint64_t> m_messagesSpilled;
+    std::atomic<uint64_t> m_queueOverflows;
+    std::atomic<uint64_t> m_batches;
+    std::atomic<uint64_t> m_bytesSent;
+    std::atomic<uint64_t> m_statusBytesSaved;
+    std::atomic<uint64_t> m_submitStalls;
+    std::atomic<double> m_totalLatencyMs;
+    std::atomic<double> m_maxLatencyMs;
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free multi-producer/single-consumer ring buffer.
+// Every slot carries a sequence number that tells producers and the
+// consumer whose turn it is, so a producer claims a slot with a single
+// compare-exchange and publishes it with a release store. Capacity must be
+// a power of two. No side ever blocks or allocates; Push fails when full.
+template <typename T, size_t Capacity>
+class MpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscQueue()
+        : m_head(0)
+        , m_tail(0)
+    {
+        for (size_t i = 0; i < Capacity; i++)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Producer side, any thread; returns false when full
+    bool Push(const T& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot& slot = m_slots[tail & (Capacity - 1)];
+            // Signed so the comparison survives index wrap-around
+            ptrdiff_t lag = static_cast<ptrdiff_t>(slot.sequence.load(std::memory_order_acquire) - tail);
+            if (lag == 0)
+            {
+                // Free slot; claim it unless another producer got there first
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                {
+                    slot.item = item;
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+            {
+                // Still holds the item from one lap ago
+                return false;
+            }
+            else
+            {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer side; returns false when empty or when the next item is
+    // claimed but not yet written
+    bool Pop(T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[head & (Capacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+        {
+            return false;
+        }
+        item = slot.item;
+        slot.sequence.store(head + Capacity, std::memory_order_release);
+        m_head.store(head + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Approximate when producers are active
+    size_t Size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+    Slot m_slots[Capacity];
+
+    // Consumer and producer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+};
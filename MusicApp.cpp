@@ -1,7 +1,54 @@
 #include "MusicApp.h"
+#include "HeadlessEngine.h"
+#include <cmath>
+
+// The audio/MIDI engine lives for the whole application
+static DeviceManager g_deviceManager;
+
+// Applies connection changes from the UI on its own thread
+static EngineController g_engine(g_deviceManager);
+
+// Latest meter values and when each channel last clipped
+static LevelReading g_levels = {};
+static uint32_t g_lastClipCount[METER_MAX_CHANNELS] = {};
+static DWORD g_lastClipTime[METER_MAX_CHANNELS] = {};
+static DWORD g_lastReadingTime = 0;
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
+    // Startup time for headless mode is measured from here
+    double launchHostMs = SampleTimeline::HostTimeMs();
+
+    // Arguments configure headless mode; anything else is rejected before a
+    // window exists
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    std::vector<std::wstring> args;
+    for (int i = 1; argv && i < argc; i++)
+    {
+        args.push_back(argv[i]);
+    }
+    LocalFree(argv);
+
+    EngineConfig config;
+    std::wstring configError;
+    bool configOk = ParseEngineConfig(args, config, configError);
+    if (configOk && !args.empty() && !config.headless)
+    {
+        configError = L"Options are only accepted with --headless";
+        configOk = false;
+    }
+    if (!configOk)
+    {
+        std::wstring message = configError + L"\n\n" + GetEngineConfigUsage();
+        MessageBoxW(nullptr, message.c_str(), L"Music Performance App", MB_ICONEXCLAMATION | MB_OK);
+        return 1;
+    }
+    if (config.headless)
+    {
+        return RunHeadless(config, launchHostMs);
+    }
+
     // Register the window class
     WNDCLASSEXW wc = {};
     wc.cbSize = sizeof(WNDCLASSEXW);
@@ -40,6 +87,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // Create the menu
     CreateMainMenu(hwnd);
 
+    // Visualizers and loggers attach to the output by name; the app runs
+    // fine without it
+    g_deviceManager.StartTap(AUDIO_TAP_DEFAULT_NAME);
+    g_engine.Start();
+
     // Show the window
     ShowWindow(hwnd, nCmdShow);
     UpdateWindow(hwnd);
@@ -59,11 +111,36 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
     switch (uMsg)
     {
+        case WM_CREATE:
+            SetTimer(hwnd, ID_METER_TIMER, METER_REFRESH_MS, nullptr);
+            return 0;
+
         case WM_COMMAND:
             HandleCommand(hwnd, wParam);
             return 0;
 
+        case WM_TIMER:
+            if (wParam == ID_METER_TIMER)
+            {
+                if (g_deviceManager.ReadInputLevels(g_levels))
+                {
+                    g_lastReadingTime = GetTickCount();
+                    InvalidateRect(hwnd, nullptr, FALSE);
+                }
+                else if (GetTickCount() - g_lastReadingTime > METER_STALE_MS && DecayLevelMeters())
+                {
+                    InvalidateRect(hwnd, nullptr, FALSE);
+                }
+            }
+            return 0;
+
+        case WM_ERASEBKGND:
+            // WM_PAINT covers the whole client area
+            return 1;
+
         case WM_DESTROY:
+            KillTimer(hwnd, ID_METER_TIMER);
+            g_engine.Stop();
             PostQuitMessage(0);
             return 0;
 
@@ -71,7 +148,19 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         {
             PAINTSTRUCT ps;
             HDC hdc = BeginPaint(hwnd, &ps);
-            FillRect(hdc, &ps.rcPaint, (HBRUSH)(COLOR_WINDOW + 1));
+            RECT rc;
+            GetClientRect(hwnd, &rc);
+
+            // Draw off-screen so the meters do not flicker at frame rate
+            HDC memDC = CreateCompatibleDC(hdc);
+            HBITMAP bitmap = CreateCompatibleBitmap(hdc, rc.right, rc.bottom);
+            HGDIOBJ oldBitmap = SelectObject(memDC, bitmap);
+            FillRect(memDC, &rc, (HBRUSH)(COLOR_WINDOW + 1));
+            DrawLevelMeters(memDC, rc);
+            BitBlt(hdc, 0, 0, rc.right, rc.bottom, memDC, 0, 0, SRCCOPY);
+            SelectObject(memDC, oldBitmap);
+            DeleteObject(bitmap);
+            DeleteDC(memDC);
             EndPaint(hwnd, &ps);
             return 0;
         }
@@ -100,7 +189,7 @@ void HandleCommand(HWND hwnd, WPARAM wParam)
     {
         case ID_FILE_SETTINGS:
         {
-            ConfigDialog dialog(hwnd);
+            ConfigDialog dialog(hwnd, g_deviceManager, g_engine);
             dialog.Show();
             break;
         }
@@ -109,4 +198,100 @@ void HandleCommand(HWND hwnd, WPARAM wParam)
             DestroyWindow(hwnd);
             break;
     }
-} 
\ No newline at end of file
+} 
+
+// Map a linear level onto the meter's -60..0 dBFS scale
+static int LevelToWidth(float level, int width)
+{
+    const float floorDb = -60.0f;
+    if (level <= 0.0f)
+    {
+        return 0;
+    }
+    float db = 20.0f * std::log10(level);
+    if (db < floorDb)
+    {
+        return 0;
+    }
+    if (db > 0.0f)
+    {
+        db = 0.0f;
+    }
+    return static_cast<int>((db - floorDb) / -floorDb * width);
+}
+
+void DrawLevelMeters(HDC hdc, const RECT& rc)
+{
+    const int margin = 20;
+    const int barHeight = 18;
+    const int clipWidth = 14;
+
+    HBRUSH trackBrush = CreateSolidBrush(RGB(40, 40, 40));
+    HBRUSH rmsBrush = CreateSolidBrush(RGB(0, 170, 60));
+    HBRUSH peakBrush = CreateSolidBrush(RGB(120, 220, 120));
+    HBRUSH truePeakBrush = CreateSolidBrush(RGB(240, 200, 0));
+    HBRUSH clipBrush = CreateSolidBrush(RGB(220, 30, 30));
+
+    int width = rc.right - rc.left - 2 * margin - clipWidth - 4;
+    DWORD now = GetTickCount();
+    for (int ch = 0; ch < g_levels.channels && ch < METER_MAX_CHANNELS; ch++)
+    {
+        int top = rc.top + margin + ch * (barHeight + 6);
+        RECT track = { margin, top, margin + width, top + barHeight };
+        FillRect(hdc, &track, trackBrush);
+
+        // Peak behind RMS, true peak as a marker line
+        RECT peak = track;
+        peak.right = margin + LevelToWidth(g_levels.peak[ch], width);
+        FillRect(hdc, &peak, peakBrush);
+
+        RECT rms = track;
+        rms.right = margin + LevelToWidth(g_levels.rms[ch], width);
+        FillRect(hdc, &rms, rmsBrush);
+
+        int truePeakX = margin + LevelToWidth(g_levels.truePeak[ch], width);
+        RECT marker = { truePeakX - 1, top, truePeakX + 1, top + barHeight };
+        FillRect(hdc, &marker, truePeakBrush);
+
+        // Clip indicator stays lit for a while after the last clipped block
+        if (g_levels.clipCount[ch] != g_lastClipCount[ch])
+        {
+            g_lastClipCount[ch] = g_levels.clipCount[ch];
+            g_lastClipTime[ch] = now;
+        }
+        RECT clip = { track.right + 4, top, track.right + 4 + clipWidth, top + barHeight };
+        bool clipLit = g_lastClipCount[ch] != 0 && now - g_lastClipTime[ch] < METER_CLIP_HOLD_MS;
+        FillRect(hdc, &clip, clipLit ? clipBrush : trackBrush);
+    }
+
+    DeleteObject(trackBrush);
+    DeleteObject(rmsBrush);
+    DeleteObject(peakBrush);
+    DeleteObject(truePeakBrush);
+    DeleteObject(clipBrush);
+}
+
+// Drops the held levels by 3 dB per refresh, to zero below the bottom of
+// the scale, so the meters fall away when the input stops instead of
+// freezing at the last reading. Returns true while the display changes.
+bool DecayLevelMeters()
+{
+    const float decay = 0.7071f;
+    const float floor = 0.001f;
+
+    bool changed = false;
+    DWORD now = GetTickCount();
+    for (int ch = 0; ch < g_levels.channels && ch < METER_MAX_CHANNELS; ch++)
+    {
+        float* levels[] = { &g_levels.peak[ch], &g_levels.rms[ch], &g_levels.truePeak[ch] };
+        for (float* level : levels)
+        {
+            changed = changed || *level > 0.0f;
+            *level = *level * decay < floor ? 0.0f : *level * decay;
+        }
+
+        // A lit clip indicator still has to go out
+        changed = changed || (g_lastClipCount[ch] != 0 && now - g_lastClipTime[ch] < METER_CLIP_HOLD_MS + METER_REFRESH_MS);
+    }
+    return changed;
+}
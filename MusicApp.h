@@ -12,7 +12,18 @@
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 void CreateMainMenu(HWND hwnd);
 void HandleCommand(HWND hwnd, WPARAM wParam);
+void DrawLevelMeters(HDC hdc, const RECT& rc);
+bool DecayLevelMeters();
 
 // Menu command IDs
 #define ID_FILE_SETTINGS 1001
-#define ID_FILE_EXIT 1002 
\ No newline at end of file
+#define ID_FILE_EXIT 1002
+
+// Level meter refresh timer
+#define ID_METER_TIMER 2001
+#define METER_REFRESH_MS 33
+
+// Meters fall back once no reading has arrived for this long (nothing
+// connected); clip indicators stay lit this long after the last clip
+#define METER_STALE_MS 100
+#define METER_CLIP_HOLD_MS 2000 
\ No newline at end of file
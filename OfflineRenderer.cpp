@@ -0,0 +1,220 @@
+#include "OfflineRenderer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <mutex>
+
+static const int RENDER_CHANNELS = 2;
+
+// Blocks per window for each pool thread; more gives stealing room
+static const unsigned BLOCKS_PER_THREAD = 4;
+
+// Per-thread scratch so tasks do not allocate once warmed up. A source
+// reads its own audio while the block it renders into is live, so the two
+// use separate buffers.
+enum ScratchSlot {
+    BLOCK_SCRATCH,
+    SOURCE_SCRATCH,
+    NUM_SCRATCH_SLOTS
+};
+
+static float* GetScratch(ScratchSlot slot, size_t samples)
+{
+    static thread_local std::vector<float> scratch[NUM_SCRATCH_SLOTS];
+    if (scratch[slot].size() < samples)
+    {
+        scratch[slot].resize(samples);
+    }
+    return scratch[slot].data();
+}
+
+LoopRenderSource::LoopRenderSource(const LoopStore& loop, uint64_t startFrame, float gain, float pan)
+    : m_table(loop.Snapshot())
+    , m_channels(loop.GetChannels())
+    , m_blockFrames(loop.GetBlockFrames())
+    , m_startFrame(startFrame)
+{
+    pan = std::max(-1.0f, std::min(1.0f, pan));
+    if (m_channels == 1)
+    {
+        // Constant-power pan for mono loops
+        const float quarterPi = 0.785398163f;
+        m_leftGain = gain * std::cos((pan + 1.0f) * quarterPi);
+        m_rightGain = gain * std::sin((pan + 1.0f) * quarterPi);
+    }
+    else
+    {
+        // Balance for stereo loops; centre leaves both sides untouched
+        m_leftGain = gain * std::min(1.0f, 1.0f - pan);
+        m_rightGain = gain * std::min(1.0f, 1.0f + pan);
+    }
+}
+
+void LoopRenderSource::Render(uint64_t startFrame, size_t frames, float* stereoOut)
+{
+    if (m_table->lengthFrames == 0 || startFrame + frames <= m_startFrame)
+    {
+        return;
+    }
+
+    // Skip the part of the request before the loop enters
+    if (startFrame < m_startFrame)
+    {
+        size_t skip = static_cast<size_t>(m_startFrame - startFrame);
+        stereoOut += skip * RENDER_CHANNELS;
+        frames -= skip;
+        startFrame = m_startFrame;
+    }
+
+    float* loopFrames = GetScratch(SOURCE_SCRATCH, frames * m_channels);
+    LoopStore::Read(*m_table, m_channels, m_blockFrames,
+                    static_cast<size_t>((startFrame - m_startFrame) % m_table->lengthFrames), loopFrames, frames);
+
+    if (m_channels == 1)
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            stereoOut[2 * i] += loopFrames[i] * m_leftGain;
+            stereoOut[2 * i + 1] += loopFrames[i] * m_rightGain;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            stereoOut[2 * i] += loopFrames[i * m_channels] * m_leftGain;
+            stereoOut[2 * i + 1] += loopFrames[i * m_channels + 1] * m_rightGain;
+        }
+    }
+}
+
+OfflineRenderer::OfflineRenderer()
+    : m_cancelled(false)
+{
+}
+
+void OfflineRenderer::AddSource(std::shared_ptr<RenderSource> source)
+{
+    m_sources.push_back(std::move(source));
+}
+
+void OfflineRenderer::ClearSources()
+{
+    m_sources.clear();
+}
+
+RenderResult OfflineRenderer::Render(const RenderSettings& settings, const ProgressCallback& progress)
+{
+    RenderResult result = {};
+    m_cancelled = false;
+
+    if (settings.sampleRate == 0 || settings.blockFrames == 0)
+    {
+        return result;
+    }
+
+    WaveFileWriter writer;
+    if (!writer.Open(settings.path, RENDER_CHANNELS, settings.sampleRate, settings.format))
+    {
+        return result;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    ThreadPool pool(settings.threads);
+    result.threads = pool.GetThreadCount();
+
+    const size_t blockFrames = settings.blockFrames;
+    const size_t windowBlocks = pool.GetThreadCount() * BLOCKS_PER_THREAD;
+    const size_t windowSamples = windowBlocks * blockFrames * RENDER_CHANNELS;
+
+    // One window renders while the previous one is encoded and written
+    std::vector<float> windows[2];
+    windows[0].resize(windowSamples);
+    windows[1].resize(windowSamples);
+    std::unique_ptr<std::mutex[]> blockLocks(new std::mutex[windowBlocks]);
+    std::future<bool> pendingWrite;
+    bool writeOk = true;
+
+    uint64_t totalBlocks = (settings.lengthFrames + blockFrames - 1) / blockFrames;
+    for (uint64_t firstBlock = 0, window = 0; firstBlock < totalBlocks && !m_cancelled; firstBlock += windowBlocks, window++)
+    {
+        std::vector<float>& mix = windows[window % 2];
+        std::fill(mix.begin(), mix.end(), 0.0f);
+
+        size_t blocks = static_cast<size_t>(std::min<uint64_t>(windowBlocks, totalBlocks - firstBlock));
+        uint64_t windowStart = firstBlock * blockFrames;
+        uint64_t windowFrames = std::min<uint64_t>(blocks * blockFrames, settings.lengthFrames - windowStart);
+
+        auto renderBlock = [&, windowStart, windowFrames](RenderSource* source, size_t block) {
+            uint64_t offset = block * blockFrames;
+            size_t frames = static_cast<size_t>(std::min<uint64_t>(blockFrames, windowFrames - offset));
+            float* scratch = GetScratch(BLOCK_SCRATCH, frames * RENDER_CHANNELS);
+            std::fill(scratch, scratch + frames * RENDER_CHANNELS, 0.0f);
+            source->Render(windowStart + offset, frames, scratch);
+
+            float* dest = mix.data() + offset * RENDER_CHANNELS;
+            std::lock_guard<std::mutex> lock(blockLocks[block]);
+            for (size_t i = 0; i < frames * RENDER_CHANNELS; i++)
+            {
+                dest[i] += scratch[i];
+            }
+        };
+
+        for (const auto& source : m_sources)
+        {
+            RenderSource* raw = source.get();
+            if (raw->IsTimeParallel())
+            {
+                for (size_t block = 0; block < blocks; block++)
+                {
+                    pool.Submit([renderBlock, raw, block] { renderBlock(raw, block); });
+                }
+            }
+            else
+            {
+                pool.Submit([renderBlock, raw, blocks] {
+                    for (size_t block = 0; block < blocks; block++)
+                    {
+                        renderBlock(raw, block);
+                    }
+                });
+            }
+        }
+        pool.WaitIdle();
+
+        // Hand the finished window to the writer once the previous one is on disk
+        if (pendingWrite.valid())
+        {
+            writeOk = pendingWrite.get() && writeOk;
+        }
+        if (!writeOk)
+        {
+            break;
+        }
+        const float* data = mix.data();
+        pendingWrite = std::async(std::launch::async, [&writer, data, windowFrames] {
+            return writer.Write(data, static_cast<size_t>(windowFrames));
+        });
+
+        result.framesRendered = windowStart + windowFrames;
+        if (progress)
+        {
+            progress(static_cast<double>(result.framesRendered) / settings.lengthFrames);
+        }
+    }
+
+    if (pendingWrite.valid())
+    {
+        writeOk = pendingWrite.get() && writeOk;
+    }
+    writeOk = writer.Close() && writeOk;
+
+    result.renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    double sessionSeconds = static_cast<double>(result.framesRendered) / settings.sampleRate;
+    result.realtimeFactor = result.renderSeconds > 0.0 ? sessionSeconds / result.renderSeconds : 0.0;
+    result.success = writeOk && !m_cancelled && result.framesRendered == settings.lengthFrames;
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "LoopStore.h"
+#include "WaveFileWriter.h"
+
+// A track that can be rendered offline. Render adds the track's stereo
+// output for [startFrame, startFrame + frames) into out.
+class RenderSource {
+public:
+    virtual ~RenderSource() {}
+
+    // Sources whose output depends only on the requested range can be
+    // split across time blocks; stateful ones (instruments, effects with
+    // tails) are rendered in order on one thread at a time.
+    virtual bool IsTimeParallel() const = 0;
+    virtual void Render(uint64_t startFrame, size_t frames, float* stereoOut) = 0;
+};
+
+// Plays a loop snapshot repeatedly from a session offset
+class LoopRenderSource : public RenderSource {
+public:
+    LoopRenderSource(const LoopStore& loop, uint64_t startFrame, float gain, float pan);
+
+    bool IsTimeParallel() const override { return true; }
+    void Render(uint64_t startFrame, size_t frames, float* stereoOut) override;
+
+private:
+    std::shared_ptr<const BlockTable> m_table;
+    int m_channels;
+    size_t m_blockFrames;
+    uint64_t m_startFrame;
+    float m_leftGain;
+    float m_rightGain;
+};
+
+struct RenderSettings {
+    std::string path;
+    uint32_t sampleRate;
+    uint64_t lengthFrames;
+    WaveSampleFormat format;
+    size_t blockFrames;         // Time split granularity
+    unsigned threads;           // 0 = all hardware threads
+};
+
+struct RenderResult {
+    bool success;
+    uint64_t framesRendered;
+    double renderSeconds;
+    double realtimeFactor;      // Session duration divided by render time
+    unsigned threads;
+};
+
+// Faster-than-realtime bounce of a session to a stereo WAV file.
+//
+// Work is spread over a work-stealing pool as (track, time block) tasks
+// where the source allows it and as one sequential task per track where
+// it does not. Rendering proceeds in windows of blocks; while the pool
+// renders one window, a writer thread encodes and streams the previous
+// one to disk.
+class OfflineRenderer {
+public:
+    typedef std::function<void(double progress)> ProgressCallback;
+
+    OfflineRenderer();
+
+    void AddSource(std::shared_ptr<RenderSource> source);
+    void ClearSources();
+
+    RenderResult Render(const RenderSettings& settings, const ProgressCallback& progress = ProgressCallback());
+
+    // May be called from another thread to abort a render in progress
+    void Cancel() { m_cancelled = true; }
+
+private:
+    std::vector<std::shared_ptr<RenderSource>> m_sources;
+    std::atomic<bool> m_cancelled;
+};
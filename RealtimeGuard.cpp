@@ -0,0 +1,275 @@
+#include "RealtimeGuard.h"
+
+#ifdef MUSICAPP_REALTIME_CHECKS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "MpscQueue.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__GLIBC__)
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+// Plain-data thread locals need no constructor, so they are safe to touch
+// from inside the allocator hooks
+static thread_local int t_realtimeDepth = 0;
+static thread_local bool t_recording = false;
+
+static MpscQueue<RealtimeViolation, 256> s_violations;
+static std::atomic<uint64_t> s_violationCount(0);
+static std::atomic<uint64_t> s_droppedCount(0);
+
+static int CaptureStack(void** frames, int maxFrames)
+{
+#ifdef _WIN32
+    return CaptureStackBackTrace(1, static_cast<DWORD>(maxFrames), frames, nullptr);
+#elif defined(__GLIBC__)
+    return backtrace(frames, maxFrames);
+#else
+    return 0;
+#endif
+}
+
+#ifdef __GLIBC__
+// The first backtrace loads the unwinder, which allocates; do it before any
+// real-time thread can get here
+static const int s_unwinderLoaded = []
+{
+    void* frame;
+    return backtrace(&frame, 1);
+}();
+#endif
+
+RealtimeScope::RealtimeScope()
+{
+    t_realtimeDepth++;
+}
+
+RealtimeScope::~RealtimeScope()
+{
+    t_realtimeDepth--;
+}
+
+bool RealtimeGuard::InRealtimeScope()
+{
+    return t_realtimeDepth > 0;
+}
+
+void RealtimeGuard::Check(RealtimeViolationKind kind, size_t bytes)
+{
+    // Whatever the recording itself does must not report again
+    if (t_realtimeDepth == 0 || t_recording)
+    {
+        return;
+    }
+    t_recording = true;
+
+    RealtimeViolation violation;
+    violation.kind = kind;
+    violation.bytes = bytes;
+    violation.index = s_violationCount.fetch_add(1, std::memory_order_relaxed);
+    violation.frameCount = CaptureStack(violation.frames, RealtimeViolation::MAX_FRAMES);
+    if (!s_violations.Push(violation))
+    {
+        s_droppedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    t_recording = false;
+}
+
+bool RealtimeGuard::ReadViolation(RealtimeViolation& violation)
+{
+    return s_violations.Pop(violation);
+}
+
+uint64_t RealtimeGuard::GetViolationCount()
+{
+    return s_violationCount.load(std::memory_order_relaxed);
+}
+
+uint64_t RealtimeGuard::GetDroppedCount()
+{
+    return s_droppedCount.load(std::memory_order_relaxed);
+}
+
+size_t RealtimeGuard::PrintReport(FILE* out)
+{
+    static const char* const KIND_NAMES[] = { "allocation", "deallocation", "lock wait", "file write" };
+
+    size_t printed = 0;
+    RealtimeViolation violation;
+    while (ReadViolation(violation))
+    {
+        std::fprintf(out, "real-time violation #%llu: %s", static_cast<unsigned long long>(violation.index),
+                     KIND_NAMES[static_cast<int>(violation.kind)]);
+        if (violation.bytes > 0)
+        {
+            std::fprintf(out, " (%zu bytes)", violation.bytes);
+        }
+        std::fprintf(out, "\n");
+        std::fflush(out);
+
+#ifdef __GLIBC__
+        backtrace_symbols_fd(violation.frames, violation.frameCount, fileno(out));
+#else
+        // Resolve offline against the build's symbols
+        for (int i = 0; i < violation.frameCount; i++)
+        {
+            std::fprintf(out, "    %p\n", violation.frames[i]);
+        }
+#endif
+        printed++;
+    }
+
+    uint64_t dropped = GetDroppedCount();
+    if (dropped > 0)
+    {
+        std::fprintf(out, "%llu more violations not recorded (report buffer full)\n", static_cast<unsigned long long>(dropped));
+    }
+    return printed;
+}
+
+#ifdef __GLIBC__
+
+// glibc exports its own entry points under these names, so the public ones
+// can be replaced here and forwarded without dlsym
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void __libc_free(void* pointer);
+ssize_t __write(int fd, const void* data, size_t bytes);
+size_t _IO_fwrite(const void* data, size_t size, size_t count, FILE* file);
+}
+
+extern "C" void* malloc(size_t size) noexcept
+{
+    RealtimeGuard::Check(RealtimeViolationKind::Allocation, size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept
+{
+    RealtimeGuard::Check(RealtimeViolationKind::Allocation, count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) noexcept
+{
+    RealtimeGuard::Check(RealtimeViolationKind::Allocation, size);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void* pointer) noexcept
+{
+    if (pointer)
+    {
+        RealtimeGuard::Check(RealtimeViolationKind::Deallocation);
+    }
+    __libc_free(pointer);
+}
+
+extern "C" ssize_t write(int fd, const void* data, size_t bytes)
+{
+    RealtimeGuard::Check(RealtimeViolationKind::FileWrite, bytes);
+    return __write(fd, data, bytes);
+}
+
+extern "C" size_t fwrite(const void* data, size_t size, size_t count, FILE* file)
+{
+    RealtimeGuard::Check(RealtimeViolationKind::FileWrite, size * count);
+    return _IO_fwrite(data, size, count, file);
+}
+
+// Only locks that would wait are reported; an uncontended lock is a few
+// atomic operations. The real function has no private alias to call, so it
+// is looked up once.
+typedef int (*PthreadMutexLock)(pthread_mutex_t*);
+static std::atomic<PthreadMutexLock> s_realMutexLock(nullptr);
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+{
+    PthreadMutexLock realLock = s_realMutexLock.load(std::memory_order_acquire);
+    if (!realLock)
+    {
+        realLock = reinterpret_cast<PthreadMutexLock>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+        s_realMutexLock.store(realLock, std::memory_order_release);
+    }
+
+    if (t_realtimeDepth > 0 && !t_recording)
+    {
+        int result = pthread_mutex_trylock(mutex);
+        if (result != EBUSY)
+        {
+            return result;
+        }
+        RealtimeGuard::Check(RealtimeViolationKind::LockWait);
+    }
+    return realLock(mutex);
+}
+
+#else
+
+// Elsewhere the C runtime cannot be replaced portably; operator new and
+// delete cover every container and string
+void* operator new(size_t size)
+{
+    RealtimeGuard::Check(RealtimeViolationKind::Allocation, size);
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeGuard::Check(RealtimeViolationKind::Allocation, size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    if (pointer)
+    {
+        RealtimeGuard::Check(RealtimeViolationKind::Deallocation);
+    }
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+    operator delete(pointer);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Opt-in checker for the real-time rule: code running in a device callback
+// must not allocate, wait on a lock or touch files.
+//
+// Build with MUSICAPP_REALTIME_CHECKS (the CMake option of the same name)
+// and every callback marked with a RealtimeScope is watched. Allocations
+// through operator new/delete are caught on every platform; on glibc,
+// malloc/free, contended pthread mutex locks and write/fwrite are caught by
+// interposing the library functions. Other blocking calls can be marked
+// with RealtimeGuard::Check. Each violation is recorded with its stack into
+// a lock-free buffer that a non-real-time thread drains.
+//
+// Without the option every call here compiles to nothing. The test build
+// always makes a checked copy of the engine and runs the callback paths
+// under it (tests/RealtimeCallbackTest), so a blocking call fails ctest.
+
+enum class RealtimeViolationKind : uint8_t {
+    Allocation,
+    Deallocation,
+    LockWait,
+    FileWrite
+};
+
+struct RealtimeViolation {
+    static const int MAX_FRAMES = 24;
+
+    RealtimeViolationKind kind;
+    size_t bytes;               // Allocation size or write length, 0 if unknown
+    uint64_t index;             // Running count of violations when recorded
+    int frameCount;
+    void* frames[MAX_FRAMES];   // Return addresses, innermost first
+};
+
+#ifdef MUSICAPP_REALTIME_CHECKS
+
+// Marks the current thread as real-time while in scope; scopes nest
+class RealtimeScope {
+public:
+    RealtimeScope();
+    ~RealtimeScope();
+
+    RealtimeScope(const RealtimeScope&) = delete;
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+};
+
+class RealtimeGuard {
+public:
+    static bool IsEnabled() { return true; }
+    static bool InRealtimeScope();
+
+    // Records a violation if the calling thread is in a real-time scope
+    static void Check(RealtimeViolationKind kind, size_t bytes = 0);
+
+    // Any single thread. Returns false when nothing is pending.
+    static bool ReadViolation(RealtimeViolation& violation);
+
+    static uint64_t GetViolationCount();
+    static uint64_t GetDroppedCount();   // Recorded while the buffer was full
+
+    // Drains the buffer and prints each violation with its stack; returns
+    // the number printed
+    static size_t PrintReport(FILE* out);
+};
+
+#else
+
+class RealtimeScope {
+public:
+    RealtimeScope() {}
+};
+
+class RealtimeGuard {
+public:
+    static bool IsEnabled() { return false; }
+    static bool InRealtimeScope() { return false; }
+    static void Check(RealtimeViolationKind, size_t = 0) {}
+    static bool ReadViolation(RealtimeViolation&) { return false; }
+    static uint64_t GetViolationCount() { return 0; }
+    static uint64_t GetDroppedCount() { return 0; }
+    static size_t PrintReport(FILE*) { return 0; }
+};
+
+#endif
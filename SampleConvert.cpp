@@ -0,0 +1,112 @@
+#include "SampleConvert.h"
+#include "Simd.h"
+
+static const float PCM16_TO_FLOAT = 1.0f / 32768.0f;
+static const float FLOAT_TO_PCM16 = 32768.0f;
+static const float PCM32_TO_FLOAT = 1.0f / 2147483648.0f;
+static const float FLOAT_TO_PCM32 = 2147483648.0f;
+
+// Largest float below 2^31; anything above it would overflow the conversion
+static const float PCM32_MAX_FLOAT = 2147483520.0f;
+
+void ConvertPcm16ToFloat(const int16_t* in, float* out, size_t count)
+{
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    const __m128 scale = _mm_set1_ps(PCM16_TO_FLOAT);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+
+        // Sign-extend to 32 bits by unpacking into the high halves and shifting back
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = in[i] * PCM16_TO_FLOAT;
+    }
+}
+
+void ConvertFloatToPcm16(const float* in, int16_t* out, size_t count)
+{
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    const __m128 scale = _mm_set1_ps(FLOAT_TO_PCM16);
+    const __m128 limit = _mm_set1_ps(32767.0f);
+    for (; i + 8 <= count; i += 8)
+    {
+        // cvtps rounds to nearest and packs saturates to the 16-bit range;
+        // cvtps turns huge positive values into INT32_MIN, so clamp first
+        __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), limit));
+        __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), limit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float scaled = in[i] * FLOAT_TO_PCM16;
+        if (scaled > 32767.0f)
+        {
+            scaled = 32767.0f;
+        }
+        else if (scaled < -32768.0f)
+        {
+            scaled = -32768.0f;
+        }
+        out[i] = static_cast<int16_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+    }
+}
+
+void ConvertPcm32ToFloat(const int32_t* in, float* out, size_t count)
+{
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    const __m128 scale = _mm_set1_ps(PCM32_TO_FLOAT);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 4));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        out[i] = in[i] * PCM32_TO_FLOAT;
+    }
+}
+
+void ConvertFloatToPcm32(const float* in, int32_t* out, size_t count)
+{
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    const __m128 scale = _mm_set1_ps(FLOAT_TO_PCM32);
+    const __m128 limit = _mm_set1_ps(PCM32_MAX_FLOAT);
+    for (; i + 8 <= count; i += 8)
+    {
+        // cvtps turns anything out of range into INT32_MIN, which is right
+        // below the range; above it, clamp first
+        __m128i lo = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), limit));
+        __m128i hi = _mm_cvtps_epi32(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), limit));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 4), hi);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float scaled = in[i] * FLOAT_TO_PCM32;
+        if (scaled > PCM32_MAX_FLOAT)
+        {
+            scaled = PCM32_MAX_FLOAT;
+        }
+        else if (scaled < -FLOAT_TO_PCM32)
+        {
+            scaled = -FLOAT_TO_PCM32;
+        }
+        out[i] = static_cast<int32_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Conversion between 16- and 32-bit PCM and float samples in [-1, 1).
+// Float to PCM saturates instead of wrapping.
+void ConvertPcm16ToFloat(const int16_t* in, float* out, size_t count);
+void ConvertFloatToPcm16(const float* in, int16_t* out, size_t count);
+void ConvertPcm32ToFloat(const int32_t* in, float* out, size_t count);
+void ConvertFloatToPcm32(const float* in, int32_t* out, size_t count);
@@ -0,0 +1,221 @@
+#include "SampleLibrary.h"
+#include "SampleConvert.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+static const uint16_t WAVE_FORMAT_PCM = 0x0001;
+static const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+static uint16_t ReadU16(const uint8_t* p)
+{
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Finds the format and data chunks of a RIFF/WAVE image
+static bool ParseWave(SampleData& sample)
+{
+    const uint8_t* data = sample.file.GetData();
+    size_t size = sample.file.GetSize();
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+    {
+        return false;
+    }
+
+    bool haveFormat = false;
+    size_t offset = 12;
+    while (offset + 8 <= size)
+    {
+        uint32_t chunkSize = ReadU32(data + offset + 4);
+        const uint8_t* body = data + offset + 8;
+        size_t available = std::min<size_t>(chunkSize, size - offset - 8);
+
+        if (std::memcmp(data + offset, "fmt ", 4) == 0 && available >= 16)
+        {
+            uint16_t tag = ReadU16(body);
+            uint16_t bits = ReadU16(body + 14);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && available >= 26)
+            {
+                // The sub-format GUID begins with the plain format tag
+                tag = ReadU16(body + 24);
+            }
+
+            sample.channels = ReadU16(body + 2);
+            sample.sampleRate = ReadU32(body + 4);
+            if (tag == WAVE_FORMAT_PCM && bits == 16)
+            {
+                sample.format = WaveSampleFormat::Pcm16;
+            }
+            else if (tag == WAVE_FORMAT_IEEE_FLOAT && bits == 32)
+            {
+                sample.format = WaveSampleFormat::Float32;
+            }
+            else
+            {
+                return false;
+            }
+            haveFormat = sample.channels >= 1 && sample.channels <= 2 && sample.sampleRate > 0;
+        }
+        else if (std::memcmp(data + offset, "data", 4) == 0 && haveFormat)
+        {
+            sample.frames = body;
+            sample.frameCount = static_cast<uint32_t>(available / WaveFileWriter::GetBytesPerFrame(sample.channels, sample.format));
+            return sample.frameCount > 0;
+        }
+
+        offset += 8 + static_cast<size_t>(chunkSize) + (chunkSize & 1);
+    }
+    return false;
+}
+
+int SampleLibrary::AddSample(const std::wstring& path)
+{
+    std::unique_ptr<SampleData> sample(new SampleData());
+    if (!sample->file.Open(path) || !ParseWave(*sample))
+    {
+        return -1;
+    }
+
+    sample->attackFrames = std::min(ATTACK_FRAMES, sample->frameCount);
+    sample->attack.resize((sample->attackFrames + 3) * sample->channels);
+    DecodeFrames(*sample, -1, sample->attackFrames + 3, sample->attack.data());
+
+    m_samples.push_back(std::move(sample));
+    return static_cast<int>(m_samples.size() - 1);
+}
+
+void SampleLibrary::AddZone(const SampleZone& zone)
+{
+    m_zones.push_back(zone);
+}
+
+bool SampleLibrary::LoadMap(const std::wstring& path, std::wstring& error)
+{
+    std::filesystem::path mapPath(path);
+    std::ifstream file{mapPath};
+    if (!file)
+    {
+        error = L"Cannot open sample map: " + path;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        std::string::size_type comment = line.find('#');
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        std::istringstream fields(line);
+        int root, lowKey, highKey, lowVelocity, highVelocity;
+        if (!(fields >> root))
+        {
+            continue;
+        }
+
+        std::string sampleFile;
+        fields >> lowKey >> highKey >> lowVelocity >> highVelocity >> std::ws;
+        std::getline(fields, sampleFile);
+        while (!sampleFile.empty() && std::isspace(static_cast<unsigned char>(sampleFile.back())))
+        {
+            sampleFile.pop_back();
+        }
+
+        std::wstring where = path + L":" + std::to_wstring(lineNumber) + L": ";
+        if (fields.fail() || sampleFile.empty() || root < 0 || root > 127 || lowKey < 0 || highKey > 127 || lowKey > highKey ||
+            lowVelocity < 1 || highVelocity > 127 || lowVelocity > highVelocity)
+        {
+            error = where + L"expected <root> <lowKey> <highKey> <lowVelocity> <highVelocity> <file>";
+            return false;
+        }
+
+        // Map files are UTF-8
+        std::filesystem::path samplePath = mapPath.parent_path() / std::filesystem::u8path(sampleFile);
+        int sample = AddSample(samplePath.wstring());
+        if (sample < 0)
+        {
+            error = where + L"cannot load " + samplePath.wstring() + L" (16-bit PCM or 32-bit float WAV required)";
+            return false;
+        }
+
+        SampleZone zone;
+        zone.sample = sample;
+        zone.lowKey = static_cast<uint8_t>(lowKey);
+        zone.highKey = static_cast<uint8_t>(highKey);
+        zone.lowVelocity = static_cast<uint8_t>(lowVelocity);
+        zone.highVelocity = static_cast<uint8_t>(highVelocity);
+        zone.rootKey = root;
+        zone.gain = 1.0f;
+        AddZone(zone);
+    }
+    return true;
+}
+
+const SampleZone* SampleLibrary::FindZone(int key, int velocity) const
+{
+    for (const SampleZone& zone : m_zones)
+    {
+        if (key >= zone.lowKey && key <= zone.highKey && velocity >= zone.lowVelocity && velocity <= zone.highVelocity)
+        {
+            return &zone;
+        }
+    }
+    return nullptr;
+}
+
+size_t SampleLibrary::GetPreloadedBytes() const
+{
+    size_t bytes = 0;
+    for (const auto& sample : m_samples)
+    {
+        bytes += sample->attack.size() * sizeof(float);
+    }
+    return bytes;
+}
+
+void SampleLibrary::DecodeFrames(const SampleData& sample, int64_t first, size_t count, float* out)
+{
+    const int channels = sample.channels;
+
+    // Silence before the start
+    while (count > 0 && first < 0)
+    {
+        std::fill(out, out + channels, 0.0f);
+        out += channels;
+        first++;
+        count--;
+    }
+
+    if (count > 0 && first < sample.frameCount)
+    {
+        size_t frames = std::min<size_t>(count, static_cast<size_t>(sample.frameCount - first));
+        size_t samples = frames * channels;
+        if (sample.format == WaveSampleFormat::Pcm16)
+        {
+            ConvertPcm16ToFloat(reinterpret_cast<const int16_t*>(sample.frames) + first * channels, out, samples);
+        }
+        else
+        {
+            std::memcpy(out, reinterpret_cast<const float*>(sample.frames) + first * channels, samples * sizeof(float));
+        }
+        out += samples;
+        count -= frames;
+    }
+
+    // Silence after the end
+    std::fill(out, out + count * channels, 0.0f);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "WaveFileWriter.h"
+
+// One memory-mapped WAV file. The attack is decoded to float up front so a
+// voice can start without touching the mapping; the rest is read from the
+// mapping as it plays.
+struct SampleData {
+    MappedFile file;
+    const uint8_t* frames;          // Start of the sample data in the mapping
+    WaveSampleFormat format;
+    int channels;                   // 1 or 2
+    uint32_t sampleRate;
+    uint32_t frameCount;
+
+    // Interleaved float frames -1 .. attackFrames + 1: a frame of silence
+    // before the start and two after the attack for interpolation
+    std::vector<float> attack;
+    uint32_t attackFrames;
+};
+
+// Key and velocity range mapped to a sample
+struct SampleZone {
+    int sample;
+    uint8_t lowKey;
+    uint8_t highKey;
+    uint8_t lowVelocity;
+    uint8_t highVelocity;
+    double rootKey;                 // Key at which the sample plays unpitched
+    float gain;
+};
+
+// Set of samples and the zones that select them. Built on a loader thread,
+// then shared read-only with the sampler.
+class SampleLibrary {
+public:
+    // About 0.75 s at 44.1 kHz, longer than the prefetcher needs to get ahead
+    static constexpr uint32_t ATTACK_FRAMES = 32768;
+
+    // Maps a PCM16 or float WAV file; returns its index or -1
+    int AddSample(const std::wstring& path);
+    void AddZone(const SampleZone& zone);
+
+    // Loads a map file with one zone per line:
+    //   <rootKey> <lowKey> <highKey> <lowVelocity> <highVelocity> <file>
+    // '#' starts a comment; files are relative to the map's directory.
+    bool LoadMap(const std::wstring& path, std::wstring& error);
+
+    // First zone containing the key and velocity, or nullptr
+    const SampleZone* FindZone(int key, int velocity) const;
+
+    const SampleData& GetSample(int index) const { return *m_samples[index]; }
+    size_t GetSampleCount() const { return m_samples.size(); }
+    size_t GetPreloadedBytes() const;
+
+    // Decodes frames [first, first + count) to interleaved float. Frames
+    // outside the sample are silence. Reads the mapping, so on the audio
+    // thread only use ranges the prefetcher has touched.
+    static void DecodeFrames(const SampleData& sample, int64_t first, size_t count, float* out);
+
+private:
+    std::vector<std::unique_ptr<SampleData>> m_samples;
+    std::vector<SampleZone> m_zones;
+};
@@ -0,0 +1,223 @@
+#include "SampleTimeline.h"
+#include <chrono>
+#include <cmath>
+
+// Anchors required before the fitted slope replaces the nominal rate
+static const int MIN_FIT_ANCHORS = 8;
+
+// How fast the latency floor may rise per anchor, in samples
+static const double LATENCY_FLOOR_RISE = 0.02;
+
+std::atomic<SampleTimeline::HostClock> SampleTimeline::s_hostClock(nullptr);
+
+LinearClockFit::LinearClockFit()
+    : m_weight(0.005)
+{
+    Reset(44.1);
+}
+
+void LinearClockFit::Reset(double nominalSamplesPerMs)
+{
+    m_nominalSlope = nominalSamplesPerMs;
+    m_count = 0;
+    m_meanX = 0.0;
+    m_meanY = 0.0;
+    m_covXX = 0.0;
+    m_covXY = 0.0;
+    m_covYY = 0.0;
+    m_latencyOffset = 0.0;
+}
+
+void LinearClockFit::SetForgetting(double weight)
+{
+    if (weight > 0.0 && weight < 1.0)
+    {
+        m_weight = weight;
+    }
+}
+
+void LinearClockFit::AddAnchor(double hostTimeMs, double samplePosition)
+{
+    m_count++;
+    if (m_count == 1)
+    {
+        m_meanX = hostTimeMs;
+        m_meanY = samplePosition;
+        return;
+    }
+
+    // Average equally until the window fills, then forget exponentially
+    double a = m_weight;
+    if (m_count < static_cast<int>(1.0 / m_weight))
+    {
+        a = 1.0 / m_count;
+    }
+
+    double dx = hostTimeMs - m_meanX;
+    double dy = samplePosition - m_meanY;
+    m_meanX += a * dx;
+    m_meanY += a * dy;
+    m_covXX = (1.0 - a) * (m_covXX + a * dx * dx);
+    m_covXY = (1.0 - a) * (m_covXY + a * dx * dy);
+    m_covYY = (1.0 - a) * (m_covYY + a * dy * dy);
+
+    if (m_count >= MIN_FIT_ANCHORS)
+    {
+        // How far this anchor sits before the fitted line, i.e. how late it arrived
+        double residual = m_meanY + GetSlope() * (hostTimeMs - m_meanX) - samplePosition;
+        if (m_count == MIN_FIT_ANCHORS || residual < m_latencyOffset)
+        {
+            m_latencyOffset = residual;
+        }
+        else
+        {
+            m_latencyOffset += LATENCY_FLOOR_RISE;
+        }
+    }
+}
+
+double LinearClockFit::GetSlope() const
+{
+    if (m_count < MIN_FIT_ANCHORS || m_covXX <= 0.0)
+    {
+        return m_nominalSlope;
+    }
+    return m_covXY / m_covXX;
+}
+
+double LinearClockFit::GetResidualRms() const
+{
+    if (m_count < MIN_FIT_ANCHORS || m_covXX <= 0.0)
+    {
+        return 0.0;
+    }
+    double residual = m_covYY - (m_covXY * m_covXY) / m_covXX;
+    return residual > 0.0 ? std::sqrt(residual) : 0.0;
+}
+
+SampleTimeline::SampleTimeline()
+    : m_sampleRate(44100.0)
+    , m_sequence(0)
+    , m_slope(44.1)
+    , m_meanTimeMs(0.0)
+    , m_meanSample(0.0)
+    , m_errorSamples(0.0)
+{
+    for (auto& position : m_positions)
+    {
+        position = 0;
+    }
+}
+
+void SampleTimeline::Reset(double sampleRate)
+{
+    m_sampleRate = sampleRate;
+    m_fit.Reset(sampleRate / 1000.0);
+    for (auto& position : m_positions)
+    {
+        position = 0;
+    }
+
+    // Until the first anchor, sample 0 is "now"
+    FitSnapshot fit = { sampleRate / 1000.0, HostTimeMs(), 0.0, 0.0 };
+    Publish(fit);
+}
+
+uint64_t SampleTimeline::Advance(int stream, uint32_t frames, double hostTimeMs)
+{
+    uint64_t start = m_positions[stream].load(std::memory_order_relaxed);
+    uint64_t end = start + frames;
+    m_positions[stream].store(end, std::memory_order_release);
+
+    // Only the capture clock drives the fit; playback is clocked from capture here
+    if (stream == CAPTURE_STREAM)
+    {
+        m_fit.AddAnchor(hostTimeMs, static_cast<double>(end));
+
+        FitSnapshot fit = { m_fit.GetSlope(), m_fit.GetMeanTimeMs(),
+                            m_fit.GetMeanSample() - m_fit.GetLatencyOffset(), m_fit.GetResidualRms() };
+        Publish(fit);
+    }
+
+    return start;
+}
+
+void SampleTimeline::Skip(int stream, uint32_t frames)
+{
+    m_positions[stream].fetch_add(frames, std::memory_order_release);
+}
+
+uint64_t SampleTimeline::GetSamplePosition(int stream) const
+{
+    return m_positions[stream].load(std::memory_order_acquire);
+}
+
+void SampleTimeline::Publish(const FitSnapshot& fit)
+{
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_slope.store(fit.slope, std::memory_order_relaxed);
+    m_meanTimeMs.store(fit.meanTimeMs, std::memory_order_relaxed);
+    m_meanSample.store(fit.meanSample, std::memory_order_relaxed);
+    m_errorSamples.store(fit.errorSamples, std::memory_order_relaxed);
+
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+SampleTimeline::FitSnapshot SampleTimeline::Load() const
+{
+    FitSnapshot fit;
+    uint32_t before;
+    uint32_t after;
+    do
+    {
+        before = m_sequence.load(std::memory_order_acquire);
+        fit.slope = m_slope.load(std::memory_order_relaxed);
+        fit.meanTimeMs = m_meanTimeMs.load(std::memory_order_relaxed);
+        fit.meanSample = m_meanSample.load(std::memory_order_relaxed);
+        fit.errorSamples = m_errorSamples.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = m_sequence.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    return fit;
+}
+
+double SampleTimeline::HostTimeToSample(double hostTimeMs) const
+{
+    FitSnapshot fit = Load();
+    return fit.meanSample + fit.slope * (hostTimeMs - fit.meanTimeMs);
+}
+
+double SampleTimeline::SampleToHostTime(double samplePosition) const
+{
+    FitSnapshot fit = Load();
+    return fit.meanTimeMs + (samplePosition - fit.meanSample) / fit.slope;
+}
+
+double SampleTimeline::GetEstimatedErrorSamples() const
+{
+    return Load().errorSamples;
+}
+
+double SampleTimeline::GetMeasuredSampleRate() const
+{
+    return Load().slope * 1000.0;
+}
+
+double SampleTimeline::HostTimeMs()
+{
+    HostClock clock = s_hostClock.load(std::memory_order_acquire);
+    if (clock)
+    {
+        return clock();
+    }
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double, std::milli>(now).count();
+}
+
+void SampleTimeline::SetHostClock(HostClock clock)
+{
+    s_hostClock.store(clock, std::memory_order_release);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Exponentially weighted least-squares fit of sample position against host
+// time. Each anchor is a (host time, sample position) pair observed when a
+// device buffer completes; the fit tracks the device's actual sample rate
+// and offset, so drift between the sample clock and the host clock is
+// followed continuously. Single-threaded; SampleTimeline publishes the
+// result to other threads.
+class LinearClockFit {
+public:
+    LinearClockFit();
+
+    void Reset(double nominalSamplesPerMs);
+
+    // Smaller forgetting factors follow changes faster but average less jitter
+    void SetForgetting(double weight);
+    void AddAnchor(double hostTimeMs, double samplePosition);
+
+    double GetSlope() const;                // Samples per millisecond
+    double GetMeanTimeMs() const { return m_meanX; }
+    double GetMeanSample() const { return m_meanY; }
+    double GetResidualRms() const;          // Estimated error in samples
+
+    // Anchors are only ever late (callbacks run after the buffer completes),
+    // so the lower envelope of the residuals is tracked and removed from the
+    // mean; this is the correction in samples to subtract from the mean
+    double GetLatencyOffset() const { return m_latencyOffset; }
+    int GetAnchorCount() const { return m_count; }
+
+private:
+    double m_nominalSlope;
+    double m_weight;
+    int m_count;
+    double m_meanX;
+    double m_meanY;
+    double m_covXX;
+    double m_covXY;
+    double m_covYY;
+    double m_latencyOffset;
+};
+
+// Shared timeline service: running sample counters per audio stream and a
+// mapping from host time (for example MIDI timestamps) onto the capture
+// sample clock.
+//
+// Advance is called from the audio callback; the mapping functions may be
+// called from any thread and never block (they retry on a concurrent
+// update instead of taking a lock).
+class SampleTimeline {
+public:
+    enum Stream {
+        CAPTURE_STREAM = 0,
+        PLAYBACK_STREAM = 1,
+        NUM_STREAMS = 2
+    };
+
+    SampleTimeline();
+
+    void Reset(double sampleRate);
+
+    // Records that a buffer of the given stream completed at hostTimeMs.
+    // Returns the stream's sample position at the start of that buffer.
+    uint64_t Advance(int stream, uint32_t frames, double hostTimeMs);
+
+    // Moves a stream past frames that were lost, without adding an anchor
+    void Skip(int stream, uint32_t frames);
+    uint64_t GetSamplePosition(int stream) const;
+
+    // Mapping between host time and capture sample position
+    double HostTimeToSample(double hostTimeMs) const;
+    double SampleToHostTime(double samplePosition) const;
+
+    double GetEstimatedErrorSamples() const;
+    double GetMeasuredSampleRate() const;
+
+    // Monotonic host clock in milliseconds used for every anchor
+    static double HostTimeMs();
+
+    // Replaces the host clock, for simulated devices running on virtual
+    // time; nullptr restores the system clock
+    typedef double (*HostClock)();
+    static void SetHostClock(HostClock clock);
+
+private:
+    struct FitSnapshot {
+        double slope;
+        double meanTimeMs;
+        double meanSample;
+        double errorSamples;
+    };
+
+    static std::atomic<HostClock> s_hostClock;
+
+    void Publish(const FitSnapshot& fit);
+    FitSnapshot Load() const;
+
+    double m_sampleRate;
+    LinearClockFit m_fit;                   // Audio callback thread only
+    std::atomic<uint64_t> m_positions[NUM_STREAMS];
+
+    // Seqlock-protected copy of the fit for readers on other threads
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<double> m_slope;
+    std::atomic<double> m_meanTimeMs;
+    std::atomic<double> m_meanSample;
+    std::atomic<double> m_errorSamples;
+};
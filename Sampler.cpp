@@ -0,0 +1,489 @@
+#include "Sampler.h"
+#include "Simd.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Short fade-in so notes never start with a click
+static const double ATTACK_RAMP_SECONDS = 0.002;
+
+// How far ahead of each voice the prefetcher keeps the mapping resident,
+// and how often it looks
+static const uint32_t PREFETCH_FRAMES = 65536;
+static const std::chrono::milliseconds PREFETCH_INTERVAL(5);
+static const size_t PAGE_BYTES = 4096;
+
+static const float MONO_PAN_GAIN = 0.70710678f;
+static const float FRACTION_SCALE = 1.0f / 4294967296.0f;
+
+// Keeps the prefetcher's page touches from being optimised away
+static volatile uint8_t s_prefetchSink;
+
+static inline float Hermite(float ym1, float y0, float y1, float y2, float t)
+{
+    float c1 = 0.5f * (y1 - ym1);
+    float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+    float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+    return ((c3 * t + c2) * t + c1) * t + y0;
+}
+
+#ifdef MUSICAPP_SSE2
+static inline __m128 HermiteSse(__m128 ym1, __m128 y0, __m128 y1, __m128 y2, __m128 t)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 c1 = _mm_mul_ps(half, _mm_sub_ps(y1, ym1));
+    __m128 c2 = _mm_sub_ps(_mm_add_ps(ym1, _mm_add_ps(y1, y1)),
+                           _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.5f), y0), _mm_mul_ps(half, y2)));
+    __m128 c3 = _mm_add_ps(_mm_mul_ps(half, _mm_sub_ps(y2, ym1)),
+                           _mm_mul_ps(_mm_set1_ps(1.5f), _mm_sub_ps(y0, y1)));
+    __m128 r = _mm_add_ps(_mm_mul_ps(c3, t), c2);
+    r = _mm_add_ps(_mm_mul_ps(r, t), c1);
+    return _mm_add_ps(_mm_mul_ps(r, t), y0);
+}
+
+// Adds four frames of left and right into interleaved stereo
+static inline void MixStereo(float* out, __m128 left, __m128 right)
+{
+    _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_unpacklo_ps(left, right)));
+    _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(left, right)));
+}
+#endif
+
+Sampler::Sampler()
+    : m_noteCounter(0)
+    , m_current(nullptr)
+    , m_sampleRate(44100)
+    , m_releaseSeconds(0.3)
+    , m_gain(0.5f)
+    , m_activeVoiceCount(0)
+    , m_hasLibrary(false)
+    , m_swapPending(false)
+    , m_prefetchRunning(false)
+{
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        m_voices.state[v] = VOICE_FREE;
+        m_prefetchSample[v] = -1;
+        m_prefetchFrame[v] = 0;
+    }
+    std::fill(m_sustainPedal, m_sustainPedal + 16, false);
+
+    // Widest window a span can read: every frame at the highest pitch plus interpolation taps
+    m_window.resize((MAX_SPAN_FRAMES * MAX_PITCH_RATIO + 4) * 2);
+}
+
+Sampler::~Sampler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_prefetchMutex);
+        m_prefetchRunning = false;
+    }
+    m_prefetchWake.notify_one();
+    if (m_prefetchThread.joinable())
+    {
+        m_prefetchThread.join();
+    }
+}
+
+void Sampler::SetLibrary(std::shared_ptr<const SampleLibrary> library)
+{
+    std::shared_ptr<LibrarySwap> swap(new LibrarySwap());
+    swap->library = library;
+    m_hasLibrary = library != nullptr;
+    std::atomic_store(&m_pendingSwap, swap);
+    m_swapPending = true;
+
+    std::lock_guard<std::mutex> lock(m_prefetchMutex);
+    if (!m_prefetchRunning)
+    {
+        m_prefetchRunning = true;
+        m_prefetchThread = std::thread(&Sampler::PrefetchThread, this);
+    }
+}
+
+void Sampler::BeginBlock()
+{
+    // Adopt a new library once the prefetcher has released the one before
+    // it, so a library is never destroyed on this thread
+    if (m_swapPending && !std::atomic_load(&m_retiredSwap))
+    {
+        // Cleared before taking the swap so one stored meanwhile stays flagged
+        m_swapPending = false;
+        std::shared_ptr<LibrarySwap> swap = std::atomic_exchange(&m_pendingSwap, std::shared_ptr<LibrarySwap>());
+        if (swap)
+        {
+            std::shared_ptr<const SampleLibrary> next = swap->library;
+            swap->library = std::atomic_exchange(&m_library, next);
+            m_current = next.get();
+            std::fill(m_voices.state, m_voices.state + MAX_VOICES, VOICE_FREE);
+            std::atomic_store(&m_retiredSwap, std::move(swap));
+        }
+    }
+
+    // Tell the prefetcher where each voice is
+    int active = 0;
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        if (m_voices.state[v] != VOICE_FREE)
+        {
+            active++;
+            m_prefetchSample[v].store(m_voices.sample[v], std::memory_order_relaxed);
+            m_prefetchFrame[v].store(static_cast<uint32_t>(m_voices.position[v] >> 32), std::memory_order_relaxed);
+        }
+        else
+        {
+            m_prefetchSample[v].store(-1, std::memory_order_relaxed);
+        }
+    }
+    m_activeVoiceCount = active;
+}
+
+void Sampler::HandleMidiMessage(uint32_t message)
+{
+    if (!m_current)
+    {
+        return;
+    }
+
+    uint8_t status = static_cast<uint8_t>(message & 0xFF);
+    int channel = status & 0x0F;
+    int data1 = (message >> 8) & 0x7F;
+    int data2 = (message >> 16) & 0x7F;
+
+    switch (status & 0xF0)
+    {
+        case 0x90:
+            if (data2 > 0)
+            {
+                NoteOn(channel, data1, data2);
+            }
+            else
+            {
+                NoteOff(channel, data1);
+            }
+            break;
+        case 0x80:
+            NoteOff(channel, data1);
+            break;
+        case 0xB0:
+            if (data1 == 64)
+            {
+                // Sustain pedal: lifting it releases the notes it was holding
+                m_sustainPedal[channel] = data2 >= 64;
+                for (int v = 0; v < MAX_VOICES && !m_sustainPedal[channel]; v++)
+                {
+                    if (m_voices.held[v] && m_voices.channel[v] == channel)
+                    {
+                        ReleaseVoice(v);
+                    }
+                }
+            }
+            else if (data1 == 120 || data1 == 123)
+            {
+                // All sound off stops at once; all notes off lets notes release
+                for (int v = 0; v < MAX_VOICES; v++)
+                {
+                    if (m_voices.state[v] != VOICE_FREE && m_voices.channel[v] == channel)
+                    {
+                        if (data1 == 120)
+                        {
+                            m_voices.state[v] = VOICE_FREE;
+                        }
+                        else
+                        {
+                            ReleaseVoice(v);
+                        }
+                    }
+                }
+            }
+            break;
+    }
+}
+
+void Sampler::NoteOn(int channel, int key, int velocity)
+{
+    const SampleZone* zone = m_current->FindZone(key, velocity);
+    if (!zone)
+    {
+        return;
+    }
+
+    const SampleData& sample = m_current->GetSample(zone->sample);
+    double sampleRate = m_sampleRate;
+    double ratio = std::pow(2.0, (key - zone->rootKey) / 12.0) * sample.sampleRate / sampleRate;
+    ratio = std::min(ratio, static_cast<double>(MAX_PITCH_RATIO));
+
+    float velocityGain = static_cast<float>(velocity) / 127.0f;
+    float level = velocityGain * velocityGain * zone->gain * m_gain;
+    double releaseSeconds = std::max(0.001, static_cast<double>(m_releaseSeconds));
+
+    int v = AllocateVoice();
+    m_voices.state[v] = VOICE_ATTACK;
+    m_voices.channel[v] = static_cast<uint8_t>(channel);
+    m_voices.key[v] = static_cast<uint8_t>(key);
+    m_voices.held[v] = false;
+    m_voices.sample[v] = zone->sample;
+    m_voices.position[v] = 0;
+    m_voices.increment[v] = std::max<uint64_t>(1, static_cast<uint64_t>(ratio * 4294967296.0));
+    m_voices.gainLeft[v] = sample.channels == 1 ? level * MONO_PAN_GAIN : level;
+    m_voices.gainRight[v] = m_voices.gainLeft[v];
+    m_voices.envelope[v] = 0.0f;
+    m_voices.attackStep[v] = static_cast<float>(1.0 / (ATTACK_RAMP_SECONDS * sampleRate));
+    m_voices.releaseStep[v] = static_cast<float>(1.0 / (releaseSeconds * sampleRate));
+    m_voices.age[v] = ++m_noteCounter;
+}
+
+void Sampler::NoteOff(int channel, int key)
+{
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        if ((m_voices.state[v] == VOICE_ATTACK || m_voices.state[v] == VOICE_SUSTAIN) && !m_voices.held[v] &&
+            m_voices.channel[v] == channel && m_voices.key[v] == key)
+        {
+            if (m_sustainPedal[channel])
+            {
+                m_voices.held[v] = true;
+            }
+            else
+            {
+                ReleaseVoice(v);
+            }
+        }
+    }
+}
+
+void Sampler::ReleaseVoice(int voice)
+{
+    m_voices.state[voice] = VOICE_RELEASE;
+    m_voices.held[voice] = false;
+}
+
+int Sampler::AllocateVoice()
+{
+    // A free voice, else the quietest releasing voice, else the oldest
+    int quietest = -1;
+    int oldest = 0;
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        if (m_voices.state[v] == VOICE_FREE)
+        {
+            return v;
+        }
+        if (m_voices.state[v] == VOICE_RELEASE && (quietest < 0 || m_voices.envelope[v] < m_voices.envelope[quietest]))
+        {
+            quietest = v;
+        }
+        if (m_voices.age[v] < m_voices.age[oldest])
+        {
+            oldest = v;
+        }
+    }
+    return quietest >= 0 ? quietest : oldest;
+}
+
+void Sampler::Render(float* stereoOut, size_t frames)
+{
+    if (!m_current)
+    {
+        return;
+    }
+
+    for (int v = 0; v < MAX_VOICES; v++)
+    {
+        if (m_voices.state[v] != VOICE_FREE)
+        {
+            RenderVoice(v, stereoOut, frames);
+        }
+    }
+}
+
+void Sampler::RenderVoice(int voice, float* stereoOut, size_t frames)
+{
+    const SampleData& sample = m_current->GetSample(m_voices.sample[voice]);
+    const uint64_t end = static_cast<uint64_t>(sample.frameCount) << 32;
+
+    while (frames > 0)
+    {
+        uint64_t position = m_voices.position[voice];
+        uint64_t increment = m_voices.increment[voice];
+        if (position >= end)
+        {
+            m_voices.state[voice] = VOICE_FREE;
+            return;
+        }
+
+        // Spans end at the sample end and at envelope stage changes
+        size_t count = std::min<size_t>(frames, MAX_SPAN_FRAMES);
+        count = static_cast<size_t>(std::min<uint64_t>(count, (end - position + increment - 1) / increment));
+
+        float envelope = m_voices.envelope[voice];
+        float step = 0.0f;
+        VoiceState state = m_voices.state[voice];
+        if (state == VOICE_ATTACK)
+        {
+            step = m_voices.attackStep[voice];
+            count = std::min(count, static_cast<size_t>(std::ceil((1.0f - envelope) / step)));
+        }
+        else if (state == VOICE_RELEASE)
+        {
+            step = -m_voices.releaseStep[voice];
+            count = std::min(count, static_cast<size_t>(std::ceil(envelope / -step)));
+        }
+
+        if (count > 0)
+        {
+            RenderSpan(voice, stereoOut, count, step);
+            envelope += step * count;
+            stereoOut += count * 2;
+            frames -= count;
+        }
+
+        if (state == VOICE_ATTACK && envelope >= 1.0f - 1e-6f)
+        {
+            envelope = 1.0f;
+            m_voices.state[voice] = VOICE_SUSTAIN;
+        }
+        else if (state == VOICE_RELEASE && envelope <= 1e-6f)
+        {
+            m_voices.state[voice] = VOICE_FREE;
+            return;
+        }
+        m_voices.envelope[voice] = envelope;
+    }
+}
+
+void Sampler::RenderSpan(int voice, float* out, size_t frames, float envelopeStep)
+{
+    const SampleData& sample = m_current->GetSample(m_voices.sample[voice]);
+    uint64_t position = m_voices.position[voice];
+    const uint64_t increment = m_voices.increment[voice];
+
+    // Source frames from one before the first position to two after the last
+    int64_t first = static_cast<int64_t>(position >> 32) - 1;
+    int64_t last = static_cast<int64_t>((position + increment * (frames - 1)) >> 32) + 2;
+    const float* src = GetSourceWindow(sample, first, static_cast<size_t>(last - first + 1));
+
+    const float envelope = m_voices.envelope[voice];
+    const float gainLeft = m_voices.gainLeft[voice];
+    const float gainRight = m_voices.gainRight[voice];
+    const bool stereo = sample.channels == 2;
+
+    size_t i = 0;
+#ifdef MUSICAPP_SSE2
+    const __m128 ramp = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 step = _mm_set1_ps(envelopeStep);
+    const __m128 left = _mm_set1_ps(gainLeft);
+    const __m128 right = _mm_set1_ps(gainRight);
+    for (; i + 4 <= frames; i += 4)
+    {
+        // Gather the four taps for each frame; the arithmetic is vectorised
+        alignas(16) float tap[8][4];
+        alignas(16) float fraction[4];
+        for (int j = 0; j < 4; j++)
+        {
+            size_t index = static_cast<size_t>(static_cast<int64_t>(position >> 32) - first);
+            fraction[j] = static_cast<float>(static_cast<uint32_t>(position)) * FRACTION_SCALE;
+            if (stereo)
+            {
+                const float* p = src + index * 2;
+                tap[0][j] = p[-2]; tap[1][j] = p[0]; tap[2][j] = p[2]; tap[3][j] = p[4];
+                tap[4][j] = p[-1]; tap[5][j] = p[1]; tap[6][j] = p[3]; tap[7][j] = p[5];
+            }
+            else
+            {
+                const float* p = src + index;
+                tap[0][j] = p[-1]; tap[1][j] = p[0]; tap[2][j] = p[1]; tap[3][j] = p[2];
+            }
+            position += increment;
+        }
+
+        __m128 t = _mm_load_ps(fraction);
+        __m128 env = _mm_add_ps(_mm_set1_ps(envelope + envelopeStep * i), _mm_mul_ps(step, ramp));
+        __m128 a = _mm_mul_ps(env, HermiteSse(_mm_load_ps(tap[0]), _mm_load_ps(tap[1]), _mm_load_ps(tap[2]), _mm_load_ps(tap[3]), t));
+        __m128 b = stereo ? _mm_mul_ps(env, HermiteSse(_mm_load_ps(tap[4]), _mm_load_ps(tap[5]), _mm_load_ps(tap[6]), _mm_load_ps(tap[7]), t)) : a;
+        MixStereo(out + i * 2, _mm_mul_ps(a, left), _mm_mul_ps(b, right));
+    }
+#endif
+    for (; i < frames; i++)
+    {
+        size_t index = static_cast<size_t>(static_cast<int64_t>(position >> 32) - first);
+        float t = static_cast<float>(static_cast<uint32_t>(position)) * FRACTION_SCALE;
+        float env = envelope + envelopeStep * i;
+        float a, b;
+        if (stereo)
+        {
+            const float* p = src + index * 2;
+            a = Hermite(p[-2], p[0], p[2], p[4], t);
+            b = Hermite(p[-1], p[1], p[3], p[5], t);
+        }
+        else
+        {
+            const float* p = src + index;
+            a = b = Hermite(p[-1], p[0], p[1], p[2], t);
+        }
+        out[i * 2] += a * env * gainLeft;
+        out[i * 2 + 1] += b * env * gainRight;
+        position += increment;
+    }
+
+    m_voices.position[voice] = position;
+}
+
+const float* Sampler::GetSourceWindow(const SampleData& sample, int64_t first, size_t count)
+{
+    // Inside the preloaded attack the frames are read in place
+    if (first >= -1 && first + static_cast<int64_t>(count) <= static_cast<int64_t>(sample.attackFrames) + 2)
+    {
+        return sample.attack.data() + (first + 1) * sample.channels;
+    }
+
+    // Past it they are decoded from the mapping, which the prefetcher keeps resident
+    SampleLibrary::DecodeFrames(sample, first, count, m_window.data());
+    return m_window.data();
+}
+
+void Sampler::PrefetchThread()
+{
+    std::unique_lock<std::mutex> lock(m_prefetchMutex);
+    while (m_prefetchRunning)
+    {
+        m_prefetchWake.wait_for(lock, PREFETCH_INTERVAL, [this] { return !m_prefetchRunning; });
+        lock.unlock();
+
+        // Release the library the audio thread last swapped out
+        std::atomic_store(&m_retiredSwap, std::shared_ptr<LibrarySwap>());
+
+        std::shared_ptr<const SampleLibrary> library = std::atomic_load(&m_library);
+        if (library)
+        {
+            uint8_t sum = 0;
+            for (int v = 0; v < MAX_VOICES; v++)
+            {
+                int32_t index = m_prefetchSample[v].load(std::memory_order_relaxed);
+                if (index < 0 || static_cast<size_t>(index) >= library->GetSampleCount())
+                {
+                    continue;
+                }
+
+                // Touch one byte per page from the voice's position onwards;
+                // the attack is already in memory
+                const SampleData& sample = library->GetSample(index);
+                uint32_t frame = m_prefetchFrame[v].load(std::memory_order_relaxed);
+                size_t bytesPerFrame = WaveFileWriter::GetBytesPerFrame(sample.channels, sample.format);
+                size_t begin = std::max(frame, sample.attackFrames) * bytesPerFrame;
+                size_t end = std::min<size_t>(static_cast<size_t>(frame) + PREFETCH_FRAMES, sample.frameCount) * bytesPerFrame;
+                for (size_t offset = begin; offset < end; offset += PAGE_BYTES)
+                {
+                    sum += sample.frames[offset];
+                }
+                if (end > begin)
+                {
+                    sum += sample.frames[end - 1];
+                }
+            }
+            s_prefetchSink = sum;
+        }
+
+        lock.lock();
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "SampleLibrary.h"
+
+// MIDI-triggered sample player.
+//
+// Voices live in a fixed pool in structure-of-arrays layout and are
+// rendered with SSE2 cubic interpolation straight into a stereo mix. Notes
+// start from each sample's preloaded attack; a prefetch thread touches the
+// mapped pages ahead of every playing voice so the audio thread does not
+// take page faults once a voice plays past the attack.
+//
+// The audio thread calls BeginBlock once per block and then alternates
+// Render and HandleMidiMessage to place events at their exact frame. The
+// library may be replaced from any thread; the audio thread picks it up at
+// the next block and a non-real-time thread releases the old one.
+class Sampler {
+public:
+    static const int MAX_VOICES = 128;
+
+    Sampler();
+    ~Sampler();
+
+    void SetLibrary(std::shared_ptr<const SampleLibrary> library);
+    bool HasLibrary() const { return m_hasLibrary; }
+
+    // True while a library is loaded or a change of library is waiting for
+    // BeginBlock. The audio thread may skip the sampler otherwise; it must
+    // keep calling BeginBlock after an unload so the old library is released.
+    bool IsActive() const { return m_hasLibrary || m_swapPending; }
+
+    // Settings; take effect for notes started afterwards
+    void SetSampleRate(uint32_t sampleRate) { m_sampleRate = sampleRate; }
+    void SetReleaseTime(double seconds) { m_releaseSeconds = seconds; }
+    void SetGain(float gain) { m_gain = gain; }
+
+    // Audio thread
+    void BeginBlock();
+    void HandleMidiMessage(uint32_t message);
+    void Render(float* stereoOut, size_t frames);   // Adds into stereoOut
+
+    int GetActiveVoiceCount() const { return m_activeVoiceCount; }
+
+private:
+    enum VoiceState : uint8_t {
+        VOICE_FREE,
+        VOICE_ATTACK,
+        VOICE_SUSTAIN,
+        VOICE_RELEASE
+    };
+
+    // Frames rendered per interpolation pass; bounds the source window
+    static constexpr size_t MAX_SPAN_FRAMES = 256;
+    static constexpr uint32_t MAX_PITCH_RATIO = 8;
+
+    struct LibrarySwap {
+        std::shared_ptr<const SampleLibrary> library;
+    };
+
+    void NoteOn(int channel, int key, int velocity);
+    void NoteOff(int channel, int key);
+    void ReleaseVoice(int voice);
+    int AllocateVoice();
+    void RenderVoice(int voice, float* stereoOut, size_t frames);
+    void RenderSpan(int voice, float* stereoOut, size_t frames, float envelopeStep);
+    const float* GetSourceWindow(const SampleData& sample, int64_t first, size_t count);
+    void PrefetchThread();
+
+    // Voice pool: index v in every array is one voice
+    struct VoicePool {
+        VoiceState state[MAX_VOICES];
+        uint8_t channel[MAX_VOICES];
+        uint8_t key[MAX_VOICES];
+        bool held[MAX_VOICES];          // Released while the sustain pedal was down
+        int32_t sample[MAX_VOICES];
+        uint64_t position[MAX_VOICES];  // 32.32 fixed-point frame position
+        uint64_t increment[MAX_VOICES];
+        float gainLeft[MAX_VOICES];
+        float gainRight[MAX_VOICES];
+        float envelope[MAX_VOICES];
+        float attackStep[MAX_VOICES];
+        float releaseStep[MAX_VOICES];
+        uint32_t age[MAX_VOICES];
+    };
+    VoicePool m_voices;
+    uint32_t m_noteCounter;
+    bool m_sustainPedal[16];
+
+    const SampleLibrary* m_current;     // Library the voices play from
+    std::vector<float> m_window;        // Source frames decoded from the mapping
+
+    std::atomic<uint32_t> m_sampleRate;
+    std::atomic<double> m_releaseSeconds;
+    std::atomic<float> m_gain;
+    std::atomic<int> m_activeVoiceCount;
+    std::atomic<bool> m_hasLibrary;
+    std::atomic<bool> m_swapPending;
+
+    // Library hand-over between threads
+    std::shared_ptr<const SampleLibrary> m_library;
+    std::shared_ptr<LibrarySwap> m_pendingSwap;
+    std::shared_ptr<LibrarySwap> m_retiredSwap;
+
+    // Published by the audio thread for the prefetcher
+    std::atomic<int32_t> m_prefetchSample[MAX_VOICES];
+    std::atomic<uint32_t> m_prefetchFrame[MAX_VOICES];
+
+    std::thread m_prefetchThread;
+    std::mutex m_prefetchMutex;
+    std::condition_variable m_prefetchWake;
+    bool m_prefetchRunning;
+};
@@ -0,0 +1,187 @@
+#include "SharedMemory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+SharedMemory::SharedMemory()
+    : m_data(nullptr)
+    , m_size(0)
+#ifdef _WIN32
+    , m_mapping(nullptr)
+#endif
+{
+}
+
+SharedMemory::~SharedMemory()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+// Session-local names, so no privileges are needed
+static std::wstring MappingName(const std::wstring& name)
+{
+    return L"Local\\" + name;
+}
+
+bool SharedMemory::Create(const std::wstring& name, size_t size, bool& existed)
+{
+    Close();
+
+    uint64_t size64 = size;
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+                                   static_cast<DWORD>(size64), MappingName(name).c_str());
+    if (!m_mapping)
+    {
+        return false;
+    }
+    existed = GetLastError() == ERROR_ALREADY_EXISTS;
+
+    m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION info;
+    if (!m_data || VirtualQuery(m_data, &info, sizeof(info)) == 0 || info.RegionSize < size)
+    {
+        Close();
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+bool SharedMemory::Open(const std::wstring& name)
+{
+    Close();
+
+    m_mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, MappingName(name).c_str());
+    if (!m_mapping)
+    {
+        return false;
+    }
+
+    m_data = static_cast<uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION info;
+    if (!m_data || VirtualQuery(m_data, &info, sizeof(info)) == 0)
+    {
+        Close();
+        return false;
+    }
+    m_size = info.RegionSize;
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    m_size = 0;
+}
+
+#else
+
+// POSIX shared memory names are a single path component
+static std::string ObjectName(const std::wstring& name)
+{
+    std::string result = "/";
+    for (wchar_t c : name)
+    {
+        result += (c > 0 && c < 0x80 && c != L'/') ? static_cast<char>(c) : '_';
+    }
+    return result;
+}
+
+bool SharedMemory::Create(const std::wstring& name, size_t size, bool& existed)
+{
+    Close();
+
+    std::string objectName = ObjectName(name);
+    int fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    existed = fd < 0;
+    if (existed)
+    {
+        fd = shm_open(objectName.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    bool sized = existed ? fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= size
+                         : ftruncate(fd, static_cast<off_t>(size)) == 0;
+    void* data = sized ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        if (!existed)
+        {
+            shm_unlink(objectName.c_str());
+        }
+        return false;
+    }
+
+    m_data = static_cast<uint8_t*>(data);
+    m_size = size;
+    m_unlinkName = objectName;
+    return true;
+}
+
+bool SharedMemory::Open(const std::wstring& name)
+{
+    Close();
+
+    int fd = shm_open(ObjectName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    m_data = static_cast<uint8_t*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void SharedMemory::Close()
+{
+    if (m_data)
+    {
+        munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+    if (!m_unlinkName.empty())
+    {
+        shm_unlink(m_unlinkName.c_str());
+        m_unlinkName.clear();
+    }
+    m_size = 0;
+}
+
+#endif
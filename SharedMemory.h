@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Named memory region shared between processes on the same machine. The
+// owner creates it; other processes open it read-only by name. The region
+// stays alive while any process has it open.
+class SharedMemory {
+public:
+    SharedMemory();
+    ~SharedMemory();
+
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory& operator=(const SharedMemory&) = delete;
+
+    // Creates the region, or opens it if it already exists with at least
+    // this size. existed reports which happened.
+    bool Create(const std::wstring& name, size_t size, bool& existed);
+
+    // Maps an existing region read-only
+    bool Open(const std::wstring& name);
+
+    void Close();
+
+    bool IsOpen() const { return m_data != nullptr; }
+    uint8_t* GetData() const { return m_data; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    uint8_t* m_data;
+    size_t m_size;
+#ifdef _WIN32
+    void* m_mapping;
+#else
+    std::string m_unlinkName;   // Set by Create; removed on Close
+#endif
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 is baseline on every x64 target; 32-bit builds only get it when the
+// compiler is told to use it. Everything else takes the scalar paths.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MUSICAPP_SSE2 1
+#include <emmintrin.h>
+#endif
@@ -0,0 +1,704 @@
+#include "SimulatedWaveDevice.h"
+#include "SampleTimeline.h"
+#include <chrono>
+#include <cstring>
+
+SimulatedWaveDevice* SimulatedWaveDevice::s_instance = nullptr;
+
+SimulatedDeviceOptions::SimulatedDeviceOptions()
+    : seed(1)
+    , jitterMs(2.0)
+    , lateProbability(0.002)
+    , lateMs(40.0)
+    , dropProbability(0.0005)
+    , emptyProbability(0.0005)
+    , requeueFailureProbability(0.0002)
+    , writeFailureProbability(0.0002)
+    , deviceLossProbability(0.00002)
+{
+}
+
+double SimulatedLatency::Percentile(double fraction) const
+{
+    if (total == 0)
+    {
+        return 0.0;
+    }
+    uint64_t rank = static_cast<uint64_t>(fraction * (total - 1));
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen > rank)
+        {
+            return (i + 1) * BUCKET_MS;
+        }
+    }
+    return maxMs;
+}
+
+SimulatedWaveDevice::SimulatedWaveDevice(const SimulatedDeviceOptions& options)
+    : m_options(options)
+    , m_random(options.seed)
+    , m_quit(false)
+    , m_inOpen(false)
+    , m_format()
+    , m_callback(0)
+    , m_instance(0)
+    , m_capturing(false)
+    , m_lost(false)
+    , m_inPrepared(0)
+    , m_periodMs(0.0)
+    , m_nextCaptureMs(0.0)
+    , m_signal(static_cast<uint32_t>(options.seed))
+    , m_inCallback(false)
+    , m_callbackCaptureMs(0.0)
+    , m_callbackChecksum(0)
+    , m_callbackSkip(0)
+    , m_callbackBytes(0)
+    , m_outOpen(false)
+    , m_outPrepared(0)
+    , m_playbackEndMs(0.0)
+    , m_nowMs(0.0)
+    , m_clockMs(0.0)
+    , m_targetMs(0.0)
+    , m_periodsLeft(0)
+    , m_stats()
+    , m_latency()
+{
+    s_instance = this;
+    SampleTimeline::SetHostClock(VirtualTimeMs);
+    m_thread = std::thread(&SimulatedWaveDevice::DeviceThread, this);
+}
+
+SimulatedWaveDevice::~SimulatedWaveDevice()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+    SampleTimeline::SetHostClock(nullptr);
+    s_instance = nullptr;
+}
+
+double SimulatedWaveDevice::VirtualTimeMs()
+{
+    return s_instance->m_clockMs.load(std::memory_order_relaxed);
+}
+
+WaveDeviceApi SimulatedWaveDevice::GetApi() const
+{
+    WaveDeviceApi api = {
+        InOpen,
+        InClose,
+        InPrepareHeader,
+        InUnprepareHeader,
+        InAddBuffer,
+        InStart,
+        InStop,
+        InReset,
+        OutOpen,
+        OutClose,
+        OutPrepareHeader,
+        OutUnprepareHeader,
+        OutWrite,
+        OutReset
+    };
+    return api;
+}
+
+void SimulatedWaveDevice::Advance(double simulatedMs)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_targetMs = (m_targetMs > m_nowMs ? m_targetMs : m_nowMs) + simulatedMs;
+    }
+    m_wake.notify_all();
+}
+
+void SimulatedWaveDevice::AdvancePeriods(int periods)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_periodsLeft += periods;
+    }
+    m_wake.notify_all();
+}
+
+bool SimulatedWaveDevice::WaitUntilIdle(int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_idle.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !HasWork() && !m_inCallback; });
+}
+
+bool SimulatedWaveDevice::IsLost() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lost;
+}
+
+bool SimulatedWaveDevice::IsCapturing() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capturing;
+}
+
+int SimulatedWaveDevice::GetOpenDeviceCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (m_inOpen ? 1 : 0) + (m_outOpen ? 1 : 0);
+}
+
+int SimulatedWaveDevice::GetPreparedHeaderCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inPrepared + m_outPrepared;
+}
+
+SimulatedDeviceStats SimulatedWaveDevice::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SimulatedDeviceStats stats = m_stats;
+    stats.simulatedMs = m_nowMs;
+    return stats;
+}
+
+SimulatedLatency SimulatedWaveDevice::GetLatency() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latency;
+}
+
+double SimulatedWaveDevice::GetBufferMs() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_periodMs;
+}
+
+void SimulatedWaveDevice::DeviceThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_deviceThreadId = std::this_thread::get_id();
+    while (!m_quit)
+    {
+        if (!m_returns.Empty())
+        {
+            LPWAVEHDR header = m_returns.Front();
+            m_returns.PopFront();
+            m_stats.shutdownCallbacks++;
+            Deliver(lock, header);
+        }
+        else if (HasWork())
+        {
+            StepCapture(lock);
+        }
+        else
+        {
+            m_idle.notify_all();
+            m_wake.wait(lock);
+        }
+    }
+}
+
+bool SimulatedWaveDevice::HasWork() const
+{
+    return !m_returns.Empty() || (m_inOpen && m_capturing && !m_lost && (m_nowMs < m_targetMs || m_periodsLeft > 0));
+}
+
+void SimulatedWaveDevice::StepCapture(std::unique_lock<std::mutex>& lock)
+{
+    // Callbacks are late by the jitter and the odd long stall, but never
+    // overtake each other
+    double nominalMs = m_nextCaptureMs;
+    m_nextCaptureMs += m_periodMs;
+    if (m_periodsLeft > 0)
+    {
+        m_periodsLeft--;
+    }
+    double delayMs = NextUniform() * m_options.jitterMs;
+    if (NextUniform() < m_options.lateProbability)
+    {
+        delayMs += m_options.lateMs;
+    }
+    if (nominalMs + delayMs > m_nowMs)
+    {
+        m_nowMs = nominalMs + delayMs;
+        m_clockMs.store(m_nowMs, std::memory_order_relaxed);
+    }
+    AdvancePlayback();
+
+    if (NextUniform() < m_options.deviceLossProbability)
+    {
+        m_lost = true;
+        m_stats.deviceLosses++;
+        return;
+    }
+    if (NextUniform() < m_options.dropProbability)
+    {
+        m_stats.droppedBuffers++;
+        return;
+    }
+    if (m_inQueue.Empty())
+    {
+        m_stats.captureOverruns++;
+        return;
+    }
+
+    LPWAVEHDR header = m_inQueue.Front();
+    m_inQueue.PopFront();
+    DWORD bytes = header->dwBufferLength - header->dwBufferLength % m_format.nBlockAlign;
+    if (NextUniform() < m_options.emptyProbability)
+    {
+        m_stats.emptyBuffers++;
+        bytes = 0;
+    }
+    FillCapture(header, bytes);
+    m_callbackCaptureMs = nominalMs - m_periodMs;
+    Deliver(lock, header);
+}
+
+void SimulatedWaveDevice::Deliver(std::unique_lock<std::mutex>& lock, LPWAVEHDR header)
+{
+    header->dwFlags = (header->dwFlags & ~WHDR_INQUEUE) | WHDR_DONE;
+    m_callbackBytes = header->dwBytesRecorded;
+    m_callbackSkip = BlendedBytes(m_callbackBytes);
+    m_callbackChecksum = Checksum(header->lpData + m_callbackSkip, m_callbackBytes - m_callbackSkip);
+    m_inCallback = true;
+    m_stats.callbacks++;
+
+    // The engine calls back into the device from here
+    typedef void (CALLBACK* WaveInCallback)(HWAVEIN, UINT, DWORD_PTR, DWORD_PTR, DWORD_PTR);
+    WaveInCallback callback = reinterpret_cast<WaveInCallback>(m_callback);
+    HWAVEIN handle = reinterpret_cast<HWAVEIN>(this);
+    DWORD_PTR instance = m_instance;
+    lock.unlock();
+    callback(handle, WIM_DATA, instance, reinterpret_cast<DWORD_PTR>(header), 0);
+    lock.lock();
+
+    m_inCallback = false;
+}
+
+void SimulatedWaveDevice::AdvancePlayback()
+{
+    while (!m_outQueue.Empty() && m_outQueue.Front().endMs <= m_nowMs)
+    {
+        LPWAVEHDR header = m_outQueue.Front().header;
+        header->dwFlags = (header->dwFlags & ~WHDR_INQUEUE) | WHDR_DONE;
+        m_outQueue.PopFront();
+    }
+}
+
+double SimulatedWaveDevice::NextUniform()
+{
+    // splitmix64, so a seed gives the same script on every platform
+    uint64_t z = (m_random += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+void SimulatedWaveDevice::FillCapture(LPWAVEHDR header, DWORD bytes)
+{
+    int16_t* samples = reinterpret_cast<int16_t*>(header->lpData);
+    for (DWORD i = 0; i < bytes / sizeof(int16_t); i++)
+    {
+        m_signal = m_signal * 1664525u + 1013904223u;
+        samples[i] = static_cast<int16_t>(static_cast<int32_t>(m_signal) >> 18);
+    }
+    header->dwBytesRecorded = bytes;
+}
+
+// DeviceManager may blend the start of a block into a dropout concealment
+// or fade it in; that part is left out of the check
+DWORD SimulatedWaveDevice::BlendedBytes(DWORD bytes) const
+{
+    DWORD blended = (m_format.nSamplesPerSec / 200) * m_format.nBlockAlign;
+    return blended < bytes ? blended : bytes;
+}
+
+uint64_t SimulatedWaveDevice::Checksum(const char* data, DWORD bytes)
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (DWORD i = 0; i < bytes; i++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InOpen(LPHWAVEIN handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (device->m_inOpen || format->wFormatTag != WAVE_FORMAT_PCM || format->wBitsPerSample != 16 || !(flags & CALLBACK_FUNCTION))
+    {
+        return MMSYSERR_ERROR;
+    }
+
+    // Reopening is how an engine recovers from a lost device
+    device->m_inOpen = true;
+    device->m_lost = false;
+    device->m_capturing = false;
+    device->m_format = *format;
+    device->m_callback = callback;
+    device->m_instance = instance;
+    device->m_inPrepared = 0;
+
+    // Capture waits for the next Advance, not one left over from before a
+    // loss, so nothing is delivered while the engine is still connecting
+    device->m_targetMs = device->m_nowMs;
+    device->m_periodsLeft = 0;
+    *handle = reinterpret_cast<HWAVEIN>(device);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InClose(HWAVEIN handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::unique_lock<std::mutex> lock(device->m_mutex);
+    if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (!device->m_inQueue.Empty())
+    {
+        device->m_stats.closeWhileQueued++;
+        return WAVERR_STILLPLAYING;
+    }
+
+    // As with winmm, no callback runs after close returns
+    device->m_capturing = false;
+    device->m_idle.wait(lock, [device] { return device->m_returns.Empty() && !device->m_inCallback; });
+    device->m_stats.leakedHeaders += device->m_inPrepared;
+    device->m_inPrepared = 0;
+    device->m_inOpen = false;
+    device->m_capturing = false;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InPrepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (!(header->dwFlags & WHDR_PREPARED))
+    {
+        header->dwFlags |= WHDR_PREPARED;
+        device->m_inPrepared++;
+    }
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InUnprepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (header->dwFlags & WHDR_INQUEUE)
+    {
+        return WAVERR_STILLPLAYING;
+    }
+    if (header->dwFlags & WHDR_PREPARED)
+    {
+        header->dwFlags &= ~WHDR_PREPARED;
+        device->m_inPrepared--;
+    }
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InAddBuffer(HWAVEIN handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (device->m_lost)
+    {
+        return MMSYSERR_NODRIVER;
+    }
+    if (!(header->dwFlags & WHDR_PREPARED))
+    {
+        return WAVERR_UNPREPARED;
+    }
+    if (header->dwFlags & WHDR_INQUEUE)
+    {
+        return WAVERR_STILLPLAYING;
+    }
+    if (device->m_capturing && device->NextUniform() < device->m_options.requeueFailureProbability)
+    {
+        device->m_stats.requeueFailures++;
+        return MMSYSERR_NOMEM;
+    }
+
+    header->dwBytesRecorded = 0;
+    if (!device->m_inQueue.PushBack(header))
+    {
+        return MMSYSERR_NOMEM;
+    }
+    header->dwFlags = (header->dwFlags & ~WHDR_DONE) | WHDR_INQUEUE;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InStart(HWAVEIN handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    {
+        std::lock_guard<std::mutex> lock(device->m_mutex);
+        if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+        {
+            return MMSYSERR_INVALHANDLE;
+        }
+        if (device->m_lost)
+        {
+            return MMSYSERR_NODRIVER;
+        }
+        if (!device->m_inQueue.Empty())
+        {
+            const WAVEFORMATEX& format = device->m_format;
+            device->m_periodMs = 1000.0 * (device->m_inQueue.Front()->dwBufferLength / format.nBlockAlign) / format.nSamplesPerSec;
+        }
+        device->m_capturing = device->m_periodMs > 0.0;
+        device->m_nextCaptureMs = device->m_nowMs + device->m_periodMs;
+    }
+    device->m_wake.notify_all();
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InStop(HWAVEIN handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    {
+        std::lock_guard<std::mutex> lock(device->m_mutex);
+        if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+        {
+            return MMSYSERR_INVALHANDLE;
+        }
+        if (!device->m_capturing)
+        {
+            return MMSYSERR_NOERROR;
+        }
+        device->m_capturing = false;
+
+        // The buffer being filled comes back partly full; the rest stay queued
+        if (!device->m_inQueue.Empty() && !device->m_lost)
+        {
+            LPWAVEHDR header = device->m_inQueue.Front();
+            device->m_inQueue.PopFront();
+            DWORD frames = header->dwBufferLength / device->m_format.nBlockAlign;
+            device->FillCapture(header, static_cast<DWORD>(device->NextUniform() * frames) * device->m_format.nBlockAlign);
+            device->m_returns.PushBack(header);
+        }
+    }
+    device->m_wake.notify_all();
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::InReset(HWAVEIN handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::unique_lock<std::mutex> lock(device->m_mutex);
+    if (!device->m_inOpen || handle != reinterpret_cast<HWAVEIN>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+
+    // Every queued buffer comes back empty before reset returns
+    device->m_capturing = false;
+    for (size_t i = 0; i < device->m_inQueue.Size(); i++)
+    {
+        device->m_inQueue[i]->dwBytesRecorded = 0;
+        device->m_returns.PushBack(device->m_inQueue[i]);
+    }
+    device->m_inQueue.Clear();
+    device->m_wake.notify_all();
+    device->m_idle.wait(lock, [device] { return device->m_returns.Empty() && !device->m_inCallback; });
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutOpen(LPHWAVEOUT handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (device->m_outOpen || format->wFormatTag != WAVE_FORMAT_PCM || format->wBitsPerSample != 16)
+    {
+        return MMSYSERR_ERROR;
+    }
+    device->m_outOpen = true;
+    device->m_outPrepared = 0;
+    device->m_playbackEndMs = 0.0;
+    *handle = reinterpret_cast<HWAVEOUT>(device);
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutClose(HWAVEOUT handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_outOpen || handle != reinterpret_cast<HWAVEOUT>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    device->AdvancePlayback();
+    if (!device->m_outQueue.Empty())
+    {
+        device->m_stats.closeWhileQueued++;
+        return WAVERR_STILLPLAYING;
+    }
+    device->m_stats.leakedHeaders += device->m_outPrepared;
+    device->m_outPrepared = 0;
+    device->m_outOpen = false;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutPrepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_outOpen || handle != reinterpret_cast<HWAVEOUT>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (!(header->dwFlags & WHDR_PREPARED))
+    {
+        header->dwFlags |= WHDR_PREPARED;
+        device->m_outPrepared++;
+    }
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutUnprepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_outOpen || handle != reinterpret_cast<HWAVEOUT>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    device->AdvancePlayback();
+    if (header->dwFlags & WHDR_INQUEUE)
+    {
+        return WAVERR_STILLPLAYING;
+    }
+    if (header->dwFlags & WHDR_PREPARED)
+    {
+        header->dwFlags &= ~WHDR_PREPARED;
+        device->m_outPrepared--;
+    }
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutWrite(HWAVEOUT handle, LPWAVEHDR header, UINT size)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_outOpen || handle != reinterpret_cast<HWAVEOUT>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    if (device->m_lost)
+    {
+        return MMSYSERR_NODRIVER;
+    }
+    if (!(header->dwFlags & WHDR_PREPARED))
+    {
+        return WAVERR_UNPREPARED;
+    }
+    device->AdvancePlayback();
+    if (header->dwFlags & WHDR_INQUEUE)
+    {
+        return WAVERR_STILLPLAYING;
+    }
+    if (device->m_outQueue.Size() == SimulatedQueue<Playing>::CAPACITY)
+    {
+        return MMSYSERR_NOMEM;
+    }
+    if (device->NextUniform() < device->m_options.writeFailureProbability)
+    {
+        device->m_stats.writeFailures++;
+        return MMSYSERR_NOMEM;
+    }
+
+    // Output written from a capture callback must end with that capture;
+    // anything in front of it is dropout concealment
+    bool fromCallback = device->m_inCallback && std::this_thread::get_id() == device->m_deviceThreadId;
+    DWORD fillBytes = 0;
+    if (fromCallback)
+    {
+        if (header->dwBufferLength < device->m_callbackBytes)
+        {
+            device->m_stats.corruptOutputs++;
+        }
+        else
+        {
+            fillBytes = header->dwBufferLength - device->m_callbackBytes;
+            DWORD skip = device->m_callbackSkip;
+            if (Checksum(header->lpData + fillBytes + skip, device->m_callbackBytes - skip) != device->m_callbackChecksum)
+            {
+                device->m_stats.corruptOutputs++;
+            }
+            if (fillBytes > 0)
+            {
+                device->m_stats.concealedOutputs++;
+            }
+        }
+    }
+
+    // Plays after whatever is queued; a gap before it is an underrun
+    double startMs = device->m_nowMs;
+    if (device->m_playbackEndMs > 0.0 && device->m_playbackEndMs < startMs)
+    {
+        device->m_stats.playbackUnderruns++;
+    }
+    if (device->m_playbackEndMs > startMs)
+    {
+        startMs = device->m_playbackEndMs;
+    }
+    const WAVEFORMATEX& format = device->m_format;
+    device->m_playbackEndMs = startMs + 1000.0 * (header->dwBufferLength / format.nBlockAlign) / format.nSamplesPerSec;
+
+    if (fromCallback)
+    {
+        double latencyMs = startMs + 1000.0 * (fillBytes / format.nBlockAlign) / format.nSamplesPerSec - device->m_callbackCaptureMs;
+        SimulatedLatency& latency = device->m_latency;
+        int bucket = static_cast<int>(latencyMs / SimulatedLatency::BUCKET_MS);
+        latency.counts[bucket < SimulatedLatency::BUCKETS ? bucket : SimulatedLatency::BUCKETS - 1]++;
+        latency.total++;
+        if (latencyMs > latency.maxMs)
+        {
+            latency.maxMs = latencyMs;
+        }
+    }
+
+    device->m_outQueue.PushBack({ header, device->m_playbackEndMs });
+    header->dwFlags = (header->dwFlags & ~WHDR_DONE) | WHDR_INQUEUE;
+    return MMSYSERR_NOERROR;
+}
+
+MMRESULT WINAPI SimulatedWaveDevice::OutReset(HWAVEOUT handle)
+{
+    SimulatedWaveDevice* device = s_instance;
+    std::lock_guard<std::mutex> lock(device->m_mutex);
+    if (!device->m_outOpen || handle != reinterpret_cast<HWAVEOUT>(device))
+    {
+        return MMSYSERR_INVALHANDLE;
+    }
+    for (size_t i = 0; i < device->m_outQueue.Size(); i++)
+    {
+        LPWAVEHDR header = device->m_outQueue[i].header;
+        header->dwFlags = (header->dwFlags & ~WHDR_INQUEUE) | WHDR_DONE;
+    }
+    device->m_outQueue.Clear();
+    device->m_playbackEndMs = 0.0;
+    return MMSYSERR_NOERROR;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "WaveDeviceApi.h"
+
+// Fault and timing script for the simulated device. Probabilities apply
+// per capture buffer unless noted; all draws come from the seed.
+struct SimulatedDeviceOptions {
+    uint64_t seed;
+    double jitterMs;                    // Callbacks arrive up to this late
+    double lateProbability;             // Chance of an extra lateMs delay
+    double lateMs;
+    double dropProbability;             // Capture period lost in the driver
+    double emptyProbability;            // Buffer returned with no data
+    double requeueFailureProbability;   // Per waveInAddBuffer while running
+    double writeFailureProbability;     // Per waveOutWrite
+    double deviceLossProbability;       // Device unplugged until reopened
+
+    SimulatedDeviceOptions();
+};
+
+struct SimulatedDeviceStats {
+    double simulatedMs;
+    uint64_t callbacks;
+    uint64_t captureOverruns;       // A capture period passed with no buffer queued
+    uint64_t playbackUnderruns;     // Output ran dry before the next write
+    uint64_t droppedBuffers;
+    uint64_t emptyBuffers;
+    uint64_t requeueFailures;
+    uint64_t writeFailures;
+    uint64_t deviceLosses;
+    uint64_t shutdownCallbacks;     // Buffers returned by waveInStop/waveInReset
+    uint64_t corruptOutputs;        // Output differing from the input it was written for
+    uint64_t concealedOutputs;      // Writes carrying concealment in front of the capture
+    uint64_t closeWhileQueued;      // Close refused because buffers were still queued
+    uint64_t leakedHeaders;         // Headers still prepared when their device closed
+};
+
+// Latency from a buffer's first captured sample to its first played sample
+struct SimulatedLatency {
+    static const int BUCKETS = 4096;
+    static constexpr double BUCKET_MS = 0.25;
+
+    uint64_t counts[BUCKETS];       // The last bucket collects everything longer
+    uint64_t total;
+    double maxMs;
+
+    double Percentile(double fraction) const;
+};
+
+// Fixed-capacity FIFO for queued headers. The device calls run inside the
+// engine's callbacks, so they must not allocate.
+template<typename T>
+class SimulatedQueue {
+public:
+    static const size_t CAPACITY = 256;
+
+    SimulatedQueue() : m_head(0), m_count(0) {}
+
+    bool Empty() const { return m_count == 0; }
+    size_t Size() const { return m_count; }
+    T& Front() { return m_items[m_head]; }
+    T& operator[](size_t index) { return m_items[(m_head + index) % CAPACITY]; }
+
+    bool PushBack(const T& item)
+    {
+        if (m_count == CAPACITY)
+        {
+            return false;
+        }
+        m_items[(m_head + m_count) % CAPACITY] = item;
+        m_count++;
+        return true;
+    }
+
+    void PopFront()
+    {
+        m_head = (m_head + 1) % CAPACITY;
+        m_count--;
+    }
+
+    void Clear()
+    {
+        m_head = 0;
+        m_count = 0;
+    }
+
+private:
+    T m_items[CAPACITY];
+    size_t m_head;
+    size_t m_count;
+};
+
+// In-process stand-in for a winmm input and output device pair.
+//
+// Time is virtual: the device thread runs capture periods back to back and
+// delivers WIM_DATA callbacks as fast as the engine handles them, so hours
+// of audio pass in minutes. Capture buffers are filled with a seeded
+// signal, and each output write is checked against the input of the
+// callback it was made from, apart from any dropout concealment written
+// ahead of it. Output plays out against the same virtual clock. The check
+// assumes the engine passes audio straight through, so run it with the
+// sampler unloaded.
+//
+// Only one instance may exist at a time; its GetApi table routes the
+// winmm calls to it. While it exists, SampleTimeline::HostTimeMs follows
+// the virtual clock, so the engine sees the injected timing.
+class SimulatedWaveDevice {
+public:
+    explicit SimulatedWaveDevice(const SimulatedDeviceOptions& options);
+    ~SimulatedWaveDevice();
+
+    WaveDeviceApi GetApi() const;
+
+    // Lets capture run for this much more virtual time; returns at once
+    void Advance(double simulatedMs);
+
+    // Lets capture run for this many more periods, whether or not each one
+    // delivers a buffer, and stops between two callbacks; returns at once
+    void AdvancePeriods(int periods);
+
+    // Waits until the device has nothing left to do, or the timeout passes
+    bool WaitUntilIdle(int timeoutMs);
+
+    bool IsLost() const;
+    bool IsCapturing() const;
+    int GetOpenDeviceCount() const;
+    int GetPreparedHeaderCount() const;
+    SimulatedDeviceStats GetStats() const;
+    SimulatedLatency GetLatency() const;
+    double GetBufferMs() const;
+
+private:
+    void DeviceThread();
+    bool HasWork() const;
+    void StepCapture(std::unique_lock<std::mutex>& lock);
+    void Deliver(std::unique_lock<std::mutex>& lock, LPWAVEHDR header);
+    void AdvancePlayback();
+    double NextUniform();
+    void FillCapture(LPWAVEHDR header, DWORD bytes);
+    DWORD BlendedBytes(DWORD bytes) const;
+    static uint64_t Checksum(const char* data, DWORD bytes);
+    static double VirtualTimeMs();
+
+    // winmm entry points
+    static MMRESULT WINAPI InOpen(LPHWAVEIN handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+    static MMRESULT WINAPI InClose(HWAVEIN handle);
+    static MMRESULT WINAPI InPrepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI InUnprepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI InAddBuffer(HWAVEIN handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI InStart(HWAVEIN handle);
+    static MMRESULT WINAPI InStop(HWAVEIN handle);
+    static MMRESULT WINAPI InReset(HWAVEIN handle);
+    static MMRESULT WINAPI OutOpen(LPHWAVEOUT handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+    static MMRESULT WINAPI OutClose(HWAVEOUT handle);
+    static MMRESULT WINAPI OutPrepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI OutUnprepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI OutWrite(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+    static MMRESULT WINAPI OutReset(HWAVEOUT handle);
+
+    static SimulatedWaveDevice* s_instance;
+
+    SimulatedDeviceOptions m_options;
+    uint64_t m_random;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;     // Work for the device thread
+    std::condition_variable m_idle;     // Device thread went idle
+    std::thread m_thread;
+    bool m_quit;
+
+    // Input device
+    bool m_inOpen;
+    WAVEFORMATEX m_format;
+    DWORD_PTR m_callback;
+    DWORD_PTR m_instance;
+    bool m_capturing;
+    bool m_lost;
+    int m_inPrepared;
+    SimulatedQueue<LPWAVEHDR> m_inQueue;
+    SimulatedQueue<LPWAVEHDR> m_returns;    // Buffers handed back by stop/reset
+    double m_periodMs;
+    double m_nextCaptureMs;             // Nominal completion of the next period
+    uint32_t m_signal;                  // Capture signal generator state
+
+    // Buffer being delivered, for checking the output written from it
+    bool m_inCallback;
+    std::thread::id m_deviceThreadId;
+    double m_callbackCaptureMs;
+    uint64_t m_callbackChecksum;       // Of the capture after its first m_callbackSkip bytes
+    DWORD m_callbackSkip;
+    DWORD m_callbackBytes;
+
+    // Output device
+    bool m_outOpen;
+    int m_outPrepared;
+    struct Playing {
+        LPWAVEHDR header;
+        double endMs;
+    };
+    SimulatedQueue<Playing> m_outQueue;
+    double m_playbackEndMs;             // When the queued output runs out, 0 before the first write
+
+    double m_nowMs;
+    std::atomic<double> m_clockMs;      // m_nowMs for other threads
+    double m_targetMs;
+    int m_periodsLeft;
+    SimulatedDeviceStats m_stats;
+    SimulatedLatency m_latency;
+};
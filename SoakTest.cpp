@@ -0,0 +1,242 @@
+#include "SoakTest.h"
+#include "DeviceManager.h"
+#include "RealtimeGuard.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+static const int SOAK_PASSED = 0;
+static const int SOAK_FAILED = 5;
+
+SoakOptions::SoakOptions()
+    : simulatedSeconds(3600.0)
+    , maxSegmentSeconds(120.0)
+    , numBuffers(0)
+    , bufferSize(0)
+    , watchdogMs(10000)
+    , device()
+{
+}
+
+// Ends the process if a phase runs longer than the limit, since a stuck
+// engine thread cannot be recovered
+class SoakWatchdog {
+public:
+    explicit SoakWatchdog(int limitMs)
+        : m_limitMs(limitMs)
+        , m_phase(nullptr)
+        , m_cycle(0)
+        , m_stop(false)
+        , m_thread(&SoakWatchdog::Run, this)
+    {
+    }
+
+    ~SoakWatchdog()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        m_thread.join();
+    }
+
+    void Enter(const char* phase, uint64_t cycle)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_phase = phase;
+        m_cycle = cycle;
+        m_started = std::chrono::steady_clock::now();
+    }
+
+    void Leave()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_phase = nullptr;
+    }
+
+private:
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop)
+        {
+            m_wake.wait_for(lock, std::chrono::milliseconds(100));
+            if (m_phase && std::chrono::steady_clock::now() - m_started > std::chrono::milliseconds(m_limitMs))
+            {
+                printf("DEADLOCK: %s did not return within %d ms (cycle %llu)\n", m_phase, m_limitMs,
+                       static_cast<unsigned long long>(m_cycle));
+                fflush(stdout);
+                std::_Exit(SOAK_FAILED);
+            }
+        }
+    }
+
+    int m_limitMs;
+    const char* m_phase;
+    uint64_t m_cycle;
+    std::chrono::steady_clock::time_point m_started;
+    bool m_stop;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread m_thread;
+};
+
+// Seeded draws for the harness's own choices, separate from the device's
+static double NextUniform(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int RunSoakTest(const SoakOptions& options, SoakResult* result)
+{
+    SimulatedWaveDevice device(options.device);
+    DeviceManager engine;
+    engine.SetWaveDeviceApi(device.GetApi());
+    if (options.numBuffers > 0 || options.bufferSize > 0)
+    {
+        engine.SetBufferGeometry(options.numBuffers > 0 ? options.numBuffers : engine.GetNumBuffers(),
+                                 options.bufferSize > 0 ? options.bufferSize : engine.GetBufferSize());
+    }
+
+    AudioDeviceInfo input = { 0, L"Simulated input", true };
+    AudioDeviceInfo output = { 0, L"Simulated output", false };
+
+    printf("Soak: %.0f s simulated, seed %llu, %d x %d byte buffers\n", options.simulatedSeconds,
+           static_cast<unsigned long long>(options.device.seed), engine.GetNumBuffers(), engine.GetBufferSize());
+    fflush(stdout);
+
+    SoakWatchdog watchdog(options.watchdogMs);
+    uint64_t random = options.device.seed ^ 0x5DEECE66Dull;
+    uint64_t cycles = 0;
+    uint64_t connectFailures = 0;
+    uint64_t midStreamDisconnects = 0;
+    uint64_t resourceLeaks = 0;
+    double nextProgressMs = 0.0;
+    auto started = std::chrono::steady_clock::now();
+
+    while (device.GetStats().simulatedMs < options.simulatedSeconds * 1000.0)
+    {
+        cycles++;
+        watchdog.Enter("connect", cycles);
+        bool connected = engine.ConnectAudioInputToOutput(input, output);
+        watchdog.Leave();
+
+        if (connected)
+        {
+            // Run a stretch, then pull the plug either at its end or a few
+            // callbacks later, with capture running and output still queued
+            double segmentMs = (0.2 + NextUniform(random) * 0.8) * options.maxSegmentSeconds * 1000.0;
+            device.Advance(segmentMs);
+            if (!device.WaitUntilIdle(options.watchdogMs))
+            {
+                printf("DEADLOCK: device still busy after %d ms (cycle %llu)\n", options.watchdogMs, static_cast<unsigned long long>(cycles));
+                fflush(stdout);
+                std::_Exit(SOAK_FAILED);
+            }
+
+            // The point is counted in capture periods on the virtual clock,
+            // never in wall time, so a seed replays the same run
+            if (NextUniform(random) < 0.3 && !device.IsLost())
+            {
+                device.AdvancePeriods(1 + static_cast<int>(NextUniform(random) * 8));
+                if (!device.WaitUntilIdle(options.watchdogMs))
+                {
+                    printf("DEADLOCK: device still busy after %d ms (cycle %llu)\n", options.watchdogMs, static_cast<unsigned long long>(cycles));
+                    fflush(stdout);
+                    std::_Exit(SOAK_FAILED);
+                }
+                midStreamDisconnects++;
+            }
+        }
+        else
+        {
+            connectFailures++;
+        }
+
+        watchdog.Enter("disconnect", cycles);
+        engine.DisconnectAudioDevices();
+        watchdog.Leave();
+
+        if (device.GetOpenDeviceCount() != 0 || device.GetPreparedHeaderCount() != 0 || engine.IsAudioConnected())
+        {
+            printf("LEAK after cycle %llu: %d devices open, %d headers prepared\n", static_cast<unsigned long long>(cycles),
+                   device.GetOpenDeviceCount(), device.GetPreparedHeaderCount());
+            resourceLeaks++;
+        }
+
+        double simulatedMs = device.GetStats().simulatedMs;
+        if (simulatedMs >= nextProgressMs)
+        {
+            printf("  %.0f s simulated, %llu cycles\n", simulatedMs / 1000.0, static_cast<unsigned long long>(cycles));
+            fflush(stdout);
+            nextProgressMs = simulatedMs + options.simulatedSeconds * 100.0;
+        }
+
+        // A connect failing every time means the run cannot make progress
+        if (connectFailures > 100 && connectFailures * 2 > cycles)
+        {
+            printf("Connect keeps failing (%llu of %llu cycles)\n", static_cast<unsigned long long>(connectFailures),
+                   static_cast<unsigned long long>(cycles));
+            break;
+        }
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    SimulatedDeviceStats deviceStats = device.GetStats();
+    SimulatedLatency latency = device.GetLatency();
+    EngineStats stats = engine.GetStats();
+
+    printf("Simulated %.1f s in %.1f s (%.0fx), %llu connect cycles, %llu failed, %llu mid-stream disconnects\n",
+           deviceStats.simulatedMs / 1000.0, wallSeconds, deviceStats.simulatedMs / 1000.0 / wallSeconds,
+           static_cast<unsigned long long>(cycles), static_cast<unsigned long long>(connectFailures),
+           static_cast<unsigned long long>(midStreamDisconnects));
+    printf("Callbacks %llu (%llu at shutdown); engine buffers %llu, empty %llu, requeue failures %llu, write failures %llu\n",
+           static_cast<unsigned long long>(deviceStats.callbacks), static_cast<unsigned long long>(deviceStats.shutdownCallbacks),
+           static_cast<unsigned long long>(stats.buffersProcessed), static_cast<unsigned long long>(stats.emptyBuffers),
+           static_cast<unsigned long long>(stats.requeueFailures), static_cast<unsigned long long>(stats.outputWriteFailures));
+    printf("Xruns: capture overruns %llu, playback underruns %llu\n",
+           static_cast<unsigned long long>(deviceStats.captureOverruns), static_cast<unsigned long long>(deviceStats.playbackUnderruns));
+    printf("Dropouts %llu: %llu frames repeated, %llu faded around, %llu writes carrying concealment\n",
+           static_cast<unsigned long long>(stats.dropouts), static_cast<unsigned long long>(stats.concealedFrames),
+           static_cast<unsigned long long>(stats.silencedFrames), static_cast<unsigned long long>(deviceStats.concealedOutputs));
+    printf("Injected: dropped %llu, empty %llu, requeue failures %llu, write failures %llu, device losses %llu\n",
+           static_cast<unsigned long long>(deviceStats.droppedBuffers), static_cast<unsigned long long>(deviceStats.emptyBuffers),
+           static_cast<unsigned long long>(deviceStats.requeueFailures), static_cast<unsigned long long>(deviceStats.writeFailures),
+           static_cast<unsigned long long>(deviceStats.deviceLosses));
+    printf("Latency ms: p50 %.2f, p90 %.2f, p99 %.2f, p99.9 %.2f, max %.2f (%llu buffers)\n",
+           latency.Percentile(0.5), latency.Percentile(0.9), latency.Percentile(0.99), latency.Percentile(0.999), latency.maxMs,
+           static_cast<unsigned long long>(latency.total));
+    printf("Corrupt outputs %llu, leaked headers %llu, refused closes %llu, leaking cycles %llu\n",
+           static_cast<unsigned long long>(deviceStats.corruptOutputs), static_cast<unsigned long long>(deviceStats.leakedHeaders),
+           static_cast<unsigned long long>(deviceStats.closeWhileQueued), static_cast<unsigned long long>(resourceLeaks));
+
+    bool failed = deviceStats.corruptOutputs > 0 || deviceStats.leakedHeaders > 0 || deviceStats.closeWhileQueued > 0 || resourceLeaks > 0 ||
+                  connectFailures * 2 > cycles;
+    if (RealtimeGuard::GetViolationCount() > 0)
+    {
+        RealtimeGuard::PrintReport(stdout);
+        printf("%llu real-time violations in the device callbacks\n", static_cast<unsigned long long>(RealtimeGuard::GetViolationCount()));
+        failed = true;
+    }
+
+    if (result)
+    {
+        result->cycles = cycles;
+        result->connectFailures = connectFailures;
+        result->midStreamDisconnects = midStreamDisconnects;
+        result->device = deviceStats;
+        result->engine = stats;
+    }
+
+    printf("Soak %s\n", failed ? "FAILED" : "passed");
+    fflush(stdout);
+    return failed ? SOAK_FAILED : SOAK_PASSED;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include "DeviceManager.h"
+#include "SimulatedWaveDevice.h"
+
+struct SoakOptions {
+    double simulatedSeconds;    // Total audio time to run
+    double maxSegmentSeconds;   // Longest stretch between reconnects
+    int numBuffers;             // 0 keeps the engine default
+    int bufferSize;
+    int watchdogMs;             // Longest a connect or disconnect may take
+    SimulatedDeviceOptions device;
+
+    SoakOptions();
+};
+
+// What a run did, for comparing runs
+struct SoakResult {
+    uint64_t cycles;
+    uint64_t connectFailures;
+    uint64_t midStreamDisconnects;
+    SimulatedDeviceStats device;
+    EngineStats engine;
+};
+
+// Runs a DeviceManager against a SimulatedWaveDevice for the requested
+// simulated time, connecting and disconnecting at seeded intervals. Some
+// disconnects come a seeded number of callbacks into a stretch. A lost
+// device is reopened. Prints xrun counts, the latency distribution and any
+// resource leak, and returns 0 if the run was clean. A connect or
+// disconnect that outlives the watchdog is reported as a deadlock and ends
+// the process. Every choice is drawn from the seed and timed on the virtual
+// clock, so a seed replays the same run.
+int RunSoakTest(const SoakOptions& options, SoakResult* result = nullptr);
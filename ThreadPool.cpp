@@ -0,0 +1,140 @@
+#include "ThreadPool.h"
+
+// Index of the pool worker running on this thread, or -1 elsewhere
+static thread_local int t_workerIndex = -1;
+static thread_local const ThreadPool* t_workerPool = nullptr;
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : m_nextQueue(0)
+    , m_stopping(false)
+    , m_queued(0)
+    , m_pending(0)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+        {
+            threadCount = 1;
+        }
+    }
+
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        m_queues.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+    }
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::WorkerThread, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    WaitIdle();
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_stopping = true;
+    }
+    m_workAvailable.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(Task task)
+{
+    unsigned index;
+    if (t_workerPool == this)
+    {
+        index = static_cast<unsigned>(t_workerIndex);
+    }
+    else
+    {
+        index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    }
+
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        // Count before pushing so a stealing worker never takes the count below zero;
+        // taking the wait mutex orders this with a worker deciding to sleep
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    m_workAvailable.notify_one();
+}
+
+bool ThreadPool::PopLocal(unsigned index, Task& task)
+{
+    WorkerQueue& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::Steal(unsigned thief, Task& task)
+{
+    size_t count = m_queues.size();
+    for (size_t offset = 1; offset < count; offset++)
+    {
+        WorkerQueue& queue = *m_queues[(thief + offset) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::WorkerThread(unsigned index)
+{
+    t_workerIndex = static_cast<int>(index);
+    t_workerPool = this;
+
+    for (;;)
+    {
+        Task task;
+        if (PopLocal(index, task) || Steal(index, task))
+        {
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::lock_guard<std::mutex> lock(m_waitMutex);
+                m_idle.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_waitMutex);
+        m_workAvailable.wait(lock, [this] {
+            return m_stopping || m_queued.load(std::memory_order_acquire) > 0;
+        });
+        if (m_stopping && m_queued.load(std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    m_idle.wait(lock, [this] {
+        return m_pending.load(std::memory_order_acquire) == 0;
+    });
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for offline (non-realtime) processing.
+//
+// Each worker owns a deque: it pops its own work LIFO for cache locality
+// and idle workers steal FIFO from the others, so uneven tasks balance
+// across cores without a single contended queue. Tasks submitted from a
+// worker go to that worker's deque; external submissions are spread
+// round-robin. Not for use from the audio callback.
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+
+    // threadCount 0 uses one worker per hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    void Submit(Task task);
+
+    // Blocks until every submitted task has finished
+    void WaitIdle();
+
+    unsigned GetThreadCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void WorkerThread(unsigned index);
+    bool PopLocal(unsigned index, Task& task);
+    bool Steal(unsigned thief, Task& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<unsigned> m_nextQueue;
+    std::atomic<bool> m_stopping;
+
+    // Sleeping workers and WaitIdle callers park here
+    std::mutex m_waitMutex;
+    std::condition_variable m_workAvailable;
+    std::condition_variable m_idle;
+    std::atomic<size_t> m_queued;       // Tasks sitting in deques
+    std::atomic<size_t> m_pending;      // Tasks submitted but not finished
+};
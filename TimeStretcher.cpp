@@ -0,0 +1,320 @@
+#include "TimeStretcher.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const double PI = 3.14159265358979323846;
+static const double TWO_PI = 2.0 * PI;
+
+// Vocoder output buffered ahead of the resampler: one block at the highest
+// pitch ratio, the frame offset and a hop of slack
+static const size_t OUTPUT_CAPACITY = TimeStretcher::MAX_BLOCK_FRAMES * 2 + TimeStretcher::FFT_SIZE * 2 + 8;
+static const size_t MAX_FRAME_OFFSET = TimeStretcher::FFT_SIZE;
+
+// The phase difference across an analysis hop longer than the frame cannot
+// tell neighbouring frequencies apart. Such hops measure each peak's
+// frequency against an extra frame this far back instead, so the input
+// history holds that much more than one frame.
+static const size_t TRACKING_HOP = TimeStretcher::SYNTHESIS_HOP;
+static const size_t HISTORY_FRAMES = TimeStretcher::FFT_SIZE + TRACKING_HOP;
+
+static float WrapPhase(float phase)
+{
+    return phase - static_cast<float>(TWO_PI) * std::floor((phase + static_cast<float>(PI)) / static_cast<float>(TWO_PI));
+}
+
+LoopStretchInput::LoopStretchInput(const LoopStore& loop)
+    : m_loop(loop)
+    , m_position(0)
+{
+}
+
+void LoopStretchInput::ReadInput(float* interleaved, size_t frames)
+{
+    m_position = m_loop.Read(m_position, interleaved, frames);
+}
+
+TimeStretcher::TimeStretcher(int channels, std::unique_ptr<FftEngine> fft)
+    : m_channels(std::max(1, std::min(channels, MAX_CHANNELS)))
+    , m_fft(std::move(fft))
+    , m_input(nullptr)
+    , m_stretch(1.0)
+    , m_pitchRatio(1.0)
+    , m_frameOffset(0)
+{
+    const size_t bins = FFT_SIZE / 2 + 1;
+
+    m_window.resize(FFT_SIZE);
+    for (size_t n = 0; n < FFT_SIZE; n++)
+    {
+        // Periodic Hann so overlapped squared windows sum to a constant
+        m_window[n] = static_cast<float>(0.5 - 0.5 * std::cos(TWO_PI * n / FFT_SIZE));
+    }
+
+    m_re.resize(FFT_SIZE);
+    m_im.resize(FFT_SIZE);
+    m_magnitude.resize(bins);
+    m_phase.resize(bins);
+    m_peaks.resize(bins);
+    m_peakOf.resize(bins);
+    m_readBuffer.resize(HISTORY_FRAMES * m_channels);
+
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        ChannelState& state = m_state[ch];
+        state.input.resize(HISTORY_FRAMES);
+        state.previousPhase.resize(bins);
+        state.synthesisPhase.resize(bins);
+        state.overlapAdd.resize(FFT_SIZE);
+        state.output.resize(OUTPUT_CAPACITY);
+    }
+
+    Reset();
+}
+
+void TimeStretcher::SetStretch(double ratio)
+{
+    m_stretch = std::max(0.25, std::min(4.0, ratio));
+}
+
+void TimeStretcher::SetPitchSemitones(double semitones)
+{
+    semitones = std::max(-12.0, std::min(12.0, semitones));
+    m_pitchRatio = std::pow(2.0, semitones / 12.0);
+}
+
+void TimeStretcher::SetFrameOffset(size_t frames)
+{
+    m_frameOffset = std::min(frames, MAX_FRAME_OFFSET);
+}
+
+void TimeStretcher::Reset()
+{
+    m_hopRemainder = 0.0;
+    m_framesAnalyzed = 0;
+    m_primed = false;
+
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        ChannelState& state = m_state[ch];
+        std::fill(state.input.begin(), state.input.end(), 0.0f);
+        std::fill(state.previousPhase.begin(), state.previousPhase.end(), 0.0f);
+        std::fill(state.synthesisPhase.begin(), state.synthesisPhase.end(), 0.0f);
+        std::fill(state.overlapAdd.begin(), state.overlapAdd.end(), 0.0f);
+
+        // One sample of history for the resampler
+        state.output[0] = 0.0f;
+        state.outputFrames = 1;
+    }
+    m_readPosition = 1.0;
+}
+
+void TimeStretcher::Process(float* interleaved, size_t frames)
+{
+    if (!m_input)
+    {
+        std::fill(interleaved, interleaved + frames * m_channels, 0.0f);
+        return;
+    }
+
+    // Parameters are sampled once per block
+    double pitchRatio = m_pitchRatio;
+    double vocoderRatio = m_stretch * pitchRatio;
+
+    while (frames > 0)
+    {
+        size_t count = std::min(frames, MAX_BLOCK_FRAMES);
+        ProcessChunk(interleaved, count, pitchRatio, vocoderRatio);
+        interleaved += count * m_channels;
+        frames -= count;
+    }
+}
+
+void TimeStretcher::ProcessChunk(float* interleaved, size_t frames, double pitchRatio, double vocoderRatio)
+{
+    // Run vocoder frames until the resampler has everything this chunk reads
+    size_t needed = static_cast<size_t>(m_readPosition + frames * pitchRatio) + 3 + m_frameOffset;
+    while (m_state[0].outputFrames < needed)
+    {
+        RunFrame(vocoderRatio);
+    }
+
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        const float* y = m_state[ch].output.data();
+        double position = m_readPosition;
+        for (size_t i = 0; i < frames; i++)
+        {
+            // 4-point Hermite interpolation
+            size_t index = static_cast<size_t>(position);
+            float t = static_cast<float>(position - index);
+            float ym1 = y[index - 1], y0 = y[index], y1 = y[index + 1], y2 = y[index + 2];
+            float c1 = 0.5f * (y1 - ym1);
+            float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+            float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+            interleaved[i * m_channels + ch] = ((c3 * t + c2) * t + c1) * t + y0;
+            position += pitchRatio;
+        }
+    }
+    m_readPosition += frames * pitchRatio;
+
+    // Drop consumed output, keeping one sample of history
+    size_t consumed = static_cast<size_t>(m_readPosition) - 1;
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        ChannelState& state = m_state[ch];
+        std::memmove(state.output.data(), state.output.data() + consumed, (state.outputFrames - consumed) * sizeof(float));
+        state.outputFrames -= consumed;
+    }
+    m_readPosition -= consumed;
+}
+
+void TimeStretcher::RunFrame(double vocoderRatio)
+{
+    // Fractional analysis hops accumulate so the average ratio is exact
+    double exactHop = SYNTHESIS_HOP / vocoderRatio + m_hopRemainder;
+    size_t analysisHop = std::max<size_t>(1, static_cast<size_t>(exactHop));
+    m_hopRemainder = exactHop - analysisHop;
+
+    // A hop longer than the history (fast tempo with the pitch lowered)
+    // skips the input in between, so the tempo stays exact
+    size_t readFrames = m_primed ? analysisHop : FFT_SIZE;
+    while (readFrames > HISTORY_FRAMES)
+    {
+        size_t skip = std::min(readFrames - HISTORY_FRAMES, HISTORY_FRAMES);
+        m_input->ReadInput(m_readBuffer.data(), skip);
+        readFrames -= skip;
+    }
+    m_input->ReadInput(m_readBuffer.data(), readFrames);
+
+    for (int ch = 0; ch < m_channels; ch++)
+    {
+        ChannelState& state = m_state[ch];
+        std::vector<float>& input = state.input;
+        std::memmove(input.data(), input.data() + readFrames, (HISTORY_FRAMES - readFrames) * sizeof(float));
+        float* dest = input.data() + HISTORY_FRAMES - readFrames;
+        for (size_t i = 0; i < readFrames; i++)
+        {
+            dest[i] = m_readBuffer[i * m_channels + ch];
+        }
+
+        // Across a hop longer than the frame, frequencies are measured
+        // against the frame TRACKING_HOP back
+        size_t phaseHop = analysisHop;
+        if (m_primed && analysisHop > FFT_SIZE)
+        {
+            Analyze(input.data());
+            std::copy(m_phase.begin(), m_phase.end(), state.previousPhase.begin());
+            phaseHop = TRACKING_HOP;
+        }
+        Analyze(input.data() + TRACKING_HOP);
+        Synthesize(ch, phaseHop);
+    }
+
+    m_primed = true;
+    m_framesAnalyzed += analysisHop;
+}
+
+void TimeStretcher::Analyze(const float* frame)
+{
+    const size_t bins = FFT_SIZE / 2 + 1;
+
+    for (size_t n = 0; n < FFT_SIZE; n++)
+    {
+        m_re[n] = frame[n] * m_window[n];
+        m_im[n] = 0.0f;
+    }
+    m_fft->Forward(m_re.data(), m_im.data());
+
+    for (size_t k = 0; k < bins; k++)
+    {
+        m_magnitude[k] = std::sqrt(m_re[k] * m_re[k] + m_im[k] * m_im[k]);
+        m_phase[k] = std::atan2(m_im[k], m_re[k]);
+    }
+}
+
+void TimeStretcher::Synthesize(int channel, size_t phaseHop)
+{
+    ChannelState& state = m_state[channel];
+    const size_t bins = FFT_SIZE / 2 + 1;
+
+    // Identity phase locking: find spectral peaks and assign every bin to the
+    // nearest one, splitting at the midpoint between neighbouring peaks
+    size_t peakCount = 0;
+    for (size_t k = 0; k < bins; k++)
+    {
+        float m = m_magnitude[k];
+        if ((k < 1 || m > m_magnitude[k - 1]) && (k < 2 || m > m_magnitude[k - 2]) &&
+            (k + 1 >= bins || m >= m_magnitude[k + 1]) && (k + 2 >= bins || m >= m_magnitude[k + 2]))
+        {
+            m_peaks[peakCount++] = static_cast<int>(k);
+        }
+    }
+    size_t nearest = 0;
+    for (size_t k = 0; k < bins; k++)
+    {
+        if (peakCount == 0)
+        {
+            m_peakOf[k] = static_cast<int>(k);
+            continue;
+        }
+        while (nearest + 1 < peakCount && static_cast<int>(k) > (m_peaks[nearest] + m_peaks[nearest + 1]) / 2)
+        {
+            nearest++;
+        }
+        m_peakOf[k] = m_peaks[nearest];
+    }
+
+    // Advance peak phases by their measured frequency over the synthesis hop
+    float hopScale = static_cast<float>(SYNTHESIS_HOP) / phaseHop;
+    for (size_t k = 0; k < bins; k++)
+    {
+        if (m_peakOf[k] != static_cast<int>(k))
+        {
+            continue;
+        }
+        if (!m_primed)
+        {
+            state.synthesisPhase[k] = m_phase[k];
+            continue;
+        }
+        float expected = static_cast<float>(TWO_PI * k * phaseHop / FFT_SIZE);
+        float deviation = WrapPhase(m_phase[k] - state.previousPhase[k] - expected);
+        state.synthesisPhase[k] = WrapPhase(state.synthesisPhase[k] + (expected + deviation) * hopScale);
+    }
+
+    // Bins around a peak keep their phase relationship to it
+    for (size_t k = 0; k < bins; k++)
+    {
+        int peak = m_peakOf[k];
+        if (peak != static_cast<int>(k))
+        {
+            state.synthesisPhase[k] = state.synthesisPhase[peak] + m_phase[k] - m_phase[peak];
+        }
+        state.previousPhase[k] = m_phase[k];
+
+        m_re[k] = m_magnitude[k] * std::cos(state.synthesisPhase[k]);
+        m_im[k] = m_magnitude[k] * std::sin(state.synthesisPhase[k]);
+    }
+
+    // Real output: mirror the conjugate spectrum
+    for (size_t k = 1; k < FFT_SIZE / 2; k++)
+    {
+        m_re[FFT_SIZE - k] = m_re[k];
+        m_im[FFT_SIZE - k] = -m_im[k];
+    }
+    m_fft->Inverse(m_re.data(), m_im.data());
+
+    // Hann analysis and synthesis at 75% overlap sum to 1.5
+    const float norm = 1.0f / 1.5f;
+    for (size_t n = 0; n < FFT_SIZE; n++)
+    {
+        state.overlapAdd[n] += m_re[n] * m_window[n] * norm;
+    }
+
+    // The first hop of the accumulator is complete
+    std::memcpy(state.output.data() + state.outputFrames, state.overlapAdd.data(), SYNTHESIS_HOP * sizeof(float));
+    state.outputFrames += SYNTHESIS_HOP;
+    std::memmove(state.overlapAdd.data(), state.overlapAdd.data() + SYNTHESIS_HOP, (FFT_SIZE - SYNTHESIS_HOP) * sizeof(float));
+    std::fill(state.overlapAdd.end() - SYNTHESIS_HOP, state.overlapAdd.end(), 0.0f);
+}
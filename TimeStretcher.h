@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Fft.h"
+#include "LoopStore.h"
+
+// Sequential source of interleaved input audio for a TimeStretcher
+class StretchInput {
+public:
+    virtual ~StretchInput() {}
+    virtual void ReadInput(float* interleaved, size_t frames) = 0;
+};
+
+// Reads a loop continuously, wrapping at its end
+class LoopStretchInput : public StretchInput {
+public:
+    explicit LoopStretchInput(const LoopStore& loop);
+
+    void Seek(size_t frame) { m_position = frame; }
+    void ReadInput(float* interleaved, size_t frames) override;
+
+private:
+    const LoopStore& m_loop;
+    size_t m_position;
+};
+
+// Real-time time-stretch and pitch-shift using a phase vocoder with
+// identity phase locking.
+//
+// Output is pulled with Process. The vocoder stretches by
+// stretch * pitchRatio and a cubic resampler reads its output at
+// pitchRatio, so pitch and tempo are independent. All buffers are
+// allocated up front; Process never allocates. Stretch and pitch may be
+// changed from another thread and take effect at the next block.
+class TimeStretcher {
+public:
+    static constexpr size_t FFT_SIZE = 2048;
+    static constexpr size_t SYNTHESIS_HOP = FFT_SIZE / 4;
+    static constexpr int MAX_CHANNELS = 2;
+    static constexpr size_t MAX_BLOCK_FRAMES = 1024;
+
+    explicit TimeStretcher(int channels, std::unique_ptr<FftEngine> fft = CreateFft(FFT_SIZE));
+
+    void SetInput(StretchInput* input) { m_input = input; }
+
+    // Output duration divided by input duration, clamped to [0.25, 4]
+    void SetStretch(double ratio);
+    // Pitch shift in semitones, clamped to [-12, 12]
+    void SetPitchSemitones(double semitones);
+
+    // Extra output kept ready ahead of demand. Giving each of several
+    // stretchers a different value spreads their FFT frames across audio
+    // blocks instead of all landing in the same one.
+    void SetFrameOffset(size_t frames);
+
+    void Reset();
+    void Process(float* interleaved, size_t frames);
+
+    // Frames processed per call to the vocoder, for CPU accounting
+    size_t GetFramesAnalyzed() const { return m_framesAnalyzed; }
+
+private:
+    void ProcessChunk(float* interleaved, size_t frames, double pitchRatio, double vocoderRatio);
+    void RunFrame(double vocoderRatio);
+    void Analyze(const float* frame);
+    void Synthesize(int channel, size_t phaseHop);
+
+    int m_channels;
+    std::unique_ptr<FftEngine> m_fft;
+    StretchInput* m_input;
+    std::atomic<double> m_stretch;
+    std::atomic<double> m_pitchRatio;
+    size_t m_frameOffset;
+    double m_hopRemainder;          // Fractional analysis hop carried between frames
+    size_t m_framesAnalyzed;
+    bool m_primed;
+
+    std::vector<float> m_window;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<float> m_magnitude;
+    std::vector<float> m_phase;
+    std::vector<int> m_peaks;
+    std::vector<int> m_peakOf;      // Nearest spectral peak for each bin
+    std::vector<float> m_readBuffer;
+
+    struct ChannelState {
+        std::vector<float> input;           // Recent input; the analysis frame is its end
+        std::vector<float> previousPhase;
+        std::vector<float> synthesisPhase;
+        std::vector<float> overlapAdd;
+        std::vector<float> output;          // Vocoder output awaiting resampling
+        size_t outputFrames;
+    };
+    ChannelState m_state[MAX_CHANNELS];
+    double m_readPosition;          // Fractional read position into the vocoder output
+};
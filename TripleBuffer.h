@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for publishing the latest value from one writer
+// thread to one reader thread. The writer never waits for the reader and
+// the reader always gets the most recently published complete value;
+// intermediate values the reader did not pick up are simply replaced.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : m_writeIndex(0)
+        , m_middle(1)
+        , m_readIndex(2)
+    {
+    }
+
+    // Writer side: fill the back buffer, then publish it
+    T& WriteBuffer() { return m_buffers[m_writeIndex]; }
+
+    void Publish()
+    {
+        uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_writeIndex | DIRTY_BIT), std::memory_order_acq_rel);
+        m_writeIndex = previous & INDEX_MASK;
+    }
+
+    // Reader side: returns true if a new value was picked up since the last call
+    bool Update()
+    {
+        if ((m_middle.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+        {
+            return false;
+        }
+        uint8_t previous = m_middle.exchange(static_cast<uint8_t>(m_readIndex), std::memory_order_acq_rel);
+        m_readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& ReadBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t DIRTY_BIT = 0x4;
+
+    T m_buffers[3];
+    int m_writeIndex;                   // Writer thread only
+    std::atomic<uint8_t> m_middle;      // Shared slot index plus dirty flag
+    int m_readIndex;                    // Reader thread only
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <windows.h>
+#include <mmsystem.h>
+
+// The waveIn/waveOut calls DeviceManager makes, gathered in a table so a
+// simulated device (SimulatedWaveDevice) can stand in for winmm. Members
+// have the winmm names and signatures, so call sites read the same.
+struct WaveDeviceApi {
+    decltype(&::waveInOpen) waveInOpen;
+    decltype(&::waveInClose) waveInClose;
+    decltype(&::waveInPrepareHeader) waveInPrepareHeader;
+    decltype(&::waveInUnprepareHeader) waveInUnprepareHeader;
+    decltype(&::waveInAddBuffer) waveInAddBuffer;
+    decltype(&::waveInStart) waveInStart;
+    decltype(&::waveInStop) waveInStop;
+    decltype(&::waveInReset) waveInReset;
+    decltype(&::waveOutOpen) waveOutOpen;
+    decltype(&::waveOutClose) waveOutClose;
+    decltype(&::waveOutPrepareHeader) waveOutPrepareHeader;
+    decltype(&::waveOutUnprepareHeader) waveOutUnprepareHeader;
+    decltype(&::waveOutWrite) waveOutWrite;
+    decltype(&::waveOutReset) waveOutReset;
+};
+
+// The real devices
+inline WaveDeviceApi GetSystemWaveDeviceApi()
+{
+    WaveDeviceApi api = {
+        ::waveInOpen,
+        ::waveInClose,
+        ::waveInPrepareHeader,
+        ::waveInUnprepareHeader,
+        ::waveInAddBuffer,
+        ::waveInStart,
+        ::waveInStop,
+        ::waveInReset,
+        ::waveOutOpen,
+        ::waveOutClose,
+        ::waveOutPrepareHeader,
+        ::waveOutUnprepareHeader,
+        ::waveOutWrite,
+        ::waveOutReset
+    };
+    return api;
+}
@@ -0,0 +1,146 @@
+#include "WaveFileWriter.h"
+#include "SampleConvert.h"
+#include <cstring>
+
+static const uint16_t WAVE_TAG_PCM = 1;
+static const uint16_t WAVE_TAG_FLOAT = 3;
+
+// Sizes in the RIFF header are 32-bit little-endian
+static void PutLe16(char* p, uint16_t value)
+{
+    p[0] = static_cast<char>(value & 0xFF);
+    p[1] = static_cast<char>(value >> 8);
+}
+
+static void PutLe32(char* p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        p[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+WaveFileWriter::WaveFileWriter()
+    : m_file(nullptr)
+    , m_channels(0)
+    , m_sampleRate(0)
+    , m_format(WaveSampleFormat::Pcm16)
+    , m_framesWritten(0)
+{
+}
+
+WaveFileWriter::~WaveFileWriter()
+{
+    Close();
+}
+
+size_t WaveFileWriter::GetBytesPerFrame(int channels, WaveSampleFormat format)
+{
+    return channels * (format == WaveSampleFormat::Pcm16 ? sizeof(int16_t) : sizeof(float));
+}
+
+bool WaveFileWriter::Open(const std::string& path, int channels, uint32_t sampleRate, WaveSampleFormat format)
+{
+    Close();
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_channels = channels;
+    m_sampleRate = sampleRate;
+    m_format = format;
+    m_framesWritten = 0;
+
+    // Placeholder sizes until Close
+    if (!WriteHeader())
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool WaveFileWriter::WriteHeader()
+{
+    size_t bytesPerFrame = GetBytesPerFrame(m_channels, m_format);
+    uint64_t dataBytes = m_framesWritten * bytesPerFrame;
+
+    // RIFF sizes saturate at 4 GB rather than wrapping
+    uint32_t dataSize = dataBytes > 0xFFFFFFFFull - 36 ? 0xFFFFFFFFu - 36 : static_cast<uint32_t>(dataBytes);
+
+    char header[44];
+    std::memcpy(header, "RIFF", 4);
+    PutLe32(header + 4, 36 + dataSize);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    PutLe32(header + 16, 16);
+    PutLe16(header + 20, m_format == WaveSampleFormat::Pcm16 ? WAVE_TAG_PCM : WAVE_TAG_FLOAT);
+    PutLe16(header + 22, static_cast<uint16_t>(m_channels));
+    PutLe32(header + 24, m_sampleRate);
+    PutLe32(header + 28, static_cast<uint32_t>(m_sampleRate * bytesPerFrame));
+    PutLe16(header + 32, static_cast<uint16_t>(bytesPerFrame));
+    PutLe16(header + 34, static_cast<uint16_t>(8 * bytesPerFrame / m_channels));
+    std::memcpy(header + 36, "data", 4);
+    PutLe32(header + 40, dataSize);
+
+    return std::fseek(m_file, 0, SEEK_SET) == 0 &&
+           std::fwrite(header, sizeof(header), 1, m_file) == 1;
+}
+
+void WaveFileWriter::Encode(const float* interleaved, size_t frames, int channels, WaveSampleFormat format, void* out)
+{
+    // Both encodings are little-endian, which every supported target is
+    size_t count = frames * channels;
+    if (format == WaveSampleFormat::Pcm16)
+    {
+        ConvertFloatToPcm16(interleaved, static_cast<int16_t*>(out), count);
+    }
+    else
+    {
+        std::memcpy(out, interleaved, count * sizeof(float));
+    }
+}
+
+bool WaveFileWriter::Write(const float* interleaved, size_t frames)
+{
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_encodeBuffer.resize(frames * GetBytesPerFrame(m_channels, m_format));
+    Encode(interleaved, frames, m_channels, m_format, &m_encodeBuffer[0]);
+    return WriteEncoded(m_encodeBuffer.data(), frames);
+}
+
+bool WaveFileWriter::WriteEncoded(const void* data, size_t frames)
+{
+    if (!m_file)
+    {
+        return false;
+    }
+
+    size_t bytes = frames * GetBytesPerFrame(m_channels, m_format);
+    if (bytes > 0 && std::fwrite(data, bytes, 1, m_file) != 1)
+    {
+        return false;
+    }
+    m_framesWritten += frames;
+    return true;
+}
+
+bool WaveFileWriter::Close()
+{
+    if (!m_file)
+    {
+        return true;
+    }
+
+    bool ok = WriteHeader();
+    ok = std::fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    return ok;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+// Sample encodings supported for WAV output
+enum class WaveSampleFormat {
+    Pcm16,
+    Float32
+};
+
+// Streaming RIFF/WAVE writer. Audio is appended as interleaved float
+// frames and encoded on the way out; the header sizes are patched on Close
+// so files of any length can be written without buffering them.
+class WaveFileWriter {
+public:
+    WaveFileWriter();
+    ~WaveFileWriter();
+
+    bool Open(const std::string& path, int channels, uint32_t sampleRate, WaveSampleFormat format);
+    bool Write(const float* interleaved, size_t frames);
+    bool Close();
+
+    bool IsOpen() const { return m_file != nullptr; }
+    uint64_t GetFramesWritten() const { return m_framesWritten; }
+
+    // Encode without writing, e.g. to prepare output on another thread
+    static size_t GetBytesPerFrame(int channels, WaveSampleFormat format);
+    static void Encode(const float* interleaved, size_t frames, int channels, WaveSampleFormat format, void* out);
+    bool WriteEncoded(const void* data, size_t frames);
+
+private:
+    bool WriteHeader();
+
+    std::FILE* m_file;
+    int m_channels;
+    uint32_t m_sampleRate;
+    WaveSampleFormat m_format;
+    uint64_t m_framesWritten;
+    std::string m_encodeBuffer;
+};
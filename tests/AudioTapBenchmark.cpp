@@ -0,0 +1,152 @@
+#include "AudioTap.h"
+#include "AudioTapReader.h"
+#include "BenchTimer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Cost of AudioTap::Write in the audio callback with eight readers polling
+// the ring, written at the device's pace and back to back, against the
+// same writes with nobody reading. Paced blocks carry their publish time,
+// so the readers also measure how long a block takes to reach them.
+static const wchar_t* const TAP_NAME = L"AudioTapBenchmark";
+static const int READERS = 8;
+static const uint32_t CHANNELS = 2;
+static const uint32_t SAMPLE_RATE = 48000;
+static const uint32_t BLOCK_FRAMES = 64;
+static const int PACED_BLOCKS = 1500;
+static const int UNPACED_BLOCKS = 50000;
+
+// A write may take at most this share of the block period
+static const double BUDGET_FRACTION = 0.02;
+
+struct ReaderResult {
+    std::vector<double> latencyUs;
+    uint64_t blocksRead;
+    uint64_t blocksSkipped;
+    uint64_t blocksTorn;
+};
+
+// Polls the tap, copying each block out, until told to stop. Latency is
+// taken from blocks whose host time was set to their publish time.
+static void RunReader(std::atomic<bool>& stop, std::atomic<bool>& timed, ReaderResult& result)
+{
+    AudioTapReader reader;
+    if (!reader.Open(TAP_NAME))
+    {
+        return;
+    }
+    std::vector<float> copy(static_cast<size_t>(BLOCK_FRAMES) * CHANNELS);
+    while (!stop)
+    {
+        AudioTapBlock block;
+        if (!reader.Acquire(block))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        double now = NowMicroseconds();
+        std::copy(block.samples, block.samples + static_cast<size_t>(block.frames) * block.channels, copy.begin());
+        if (reader.Release(block) && timed && block.hostTimeMs > 0.0)
+        {
+            result.latencyUs.push_back(now - block.hostTimeMs * 1000.0);
+        }
+    }
+    result.blocksRead = reader.GetBlocksRead();
+    result.blocksSkipped = reader.GetBlocksSkipped();
+    result.blocksTorn = reader.GetBlocksTorn();
+}
+
+// Write times in microseconds. Paced writes wait for each block period and
+// are stamped with their publish time.
+static std::vector<double> WriteBlocks(AudioTap& tap, int blocks, bool paced, uint64_t& frame)
+{
+    std::vector<float> block(static_cast<size_t>(BLOCK_FRAMES) * CHANNELS, 0.25f);
+    std::vector<double> times;
+    times.reserve(blocks);
+    auto period = std::chrono::nanoseconds(1000000000ull * BLOCK_FRAMES / SAMPLE_RATE);
+    auto due = std::chrono::steady_clock::now();
+    for (int i = 0; i < blocks; i++)
+    {
+        if (paced)
+        {
+            due += period;
+            std::this_thread::sleep_until(due);
+        }
+        double start = NowMicroseconds();
+        tap.Write(block.data(), BLOCK_FRAMES, CHANNELS, SAMPLE_RATE, frame, paced ? start / 1000.0 : 0.0);
+        times.push_back(NowMicroseconds() - start);
+        frame += BLOCK_FRAMES;
+    }
+    return times;
+}
+
+int main()
+{
+    AudioTap tap;
+    if (!tap.Start(TAP_NAME))
+    {
+        std::fprintf(stderr, "could not create the tap\n");
+        return EXIT_FAILURE;
+    }
+
+    double periodUs = BLOCK_FRAMES * 1e6 / SAMPLE_RATE;
+    std::printf("%u-frame stereo blocks, %.0f us per block, %d readers\n", BLOCK_FRAMES, periodUs, READERS);
+    std::printf("writes                   p50 us    p99 us    max us\n");
+
+    uint64_t frame = 0;
+    std::vector<double> alone = WriteBlocks(tap, UNPACED_BLOCKS, false, frame);
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> timed(false);
+    std::vector<ReaderResult> results(READERS);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS; r++)
+    {
+        readers.emplace_back(RunReader, std::ref(stop), std::ref(timed), std::ref(results[r]));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::vector<double> unpaced = WriteBlocks(tap, UNPACED_BLOCKS, false, frame);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    timed = true;
+    std::vector<double> paced = WriteBlocks(tap, PACED_BLOCKS, true, frame);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    stop = true;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    std::printf("no readers, unpaced   %9.3f %9.3f %9.3f\n", Percentile(alone, 0.5), Percentile(alone, 0.99),
+                Percentile(alone, 1.0));
+    std::printf("%d readers, unpaced    %9.3f %9.3f %9.3f\n", READERS, Percentile(unpaced, 0.5),
+                Percentile(unpaced, 0.99), Percentile(unpaced, 1.0));
+    std::printf("%d readers, paced      %9.3f %9.3f %9.3f\n", READERS, Percentile(paced, 0.5), Percentile(paced, 0.99),
+                Percentile(paced, 1.0));
+
+    std::printf("\nreader  latency p50 us    p99 us    max us      read   skipped  torn\n");
+    std::vector<double> latency;
+    bool allRead = true;
+    for (int r = 0; r < READERS; r++)
+    {
+        const ReaderResult& result = results[r];
+        latency.insert(latency.end(), result.latencyUs.begin(), result.latencyUs.end());
+        std::printf("%6d  %14.1f %9.1f %9.1f %9llu %9llu %5llu\n", r, Percentile(result.latencyUs, 0.5),
+                    Percentile(result.latencyUs, 0.99), Percentile(result.latencyUs, 1.0),
+                    static_cast<unsigned long long>(result.blocksRead), static_cast<unsigned long long>(result.blocksSkipped),
+                    static_cast<unsigned long long>(result.blocksTorn));
+        allRead = allRead && result.latencyUs.size() > PACED_BLOCKS / 2;
+    }
+    std::printf("   all  %14.1f %9.1f %9.1f\n", Percentile(latency, 0.5), Percentile(latency, 0.99),
+                Percentile(latency, 1.0));
+
+    // Readers must neither slow the writer down nor miss the paced blocks
+    bool withinBudget = Percentile(paced, 0.5) < BUDGET_FRACTION * periodUs;
+    std::printf("\nmedian paced write %s %.0f%% of the block period, readers %s the paced blocks\n",
+                withinBudget ? "within" : "OVER", 100.0 * BUDGET_FRACTION, allRead ? "kept up with" : "MISSED");
+    return withinBudget && allRead ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,196 @@
+#include "AudioTap.h"
+#include "AudioTapReader.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Readers on other threads against an unpaced writer and a small ring, so
+// slots are overwritten while readers hold them. Every block a reader
+// releases as intact must hold exactly what was written for it; torn and
+// skipped blocks must be reported, never passed off as good data.
+
+static const wchar_t* const TAP_NAME = L"AudioTapTest";
+static const uint32_t SLOT_COUNT = 16;
+static const uint32_t SLOT_BYTES = 4096;
+static const uint32_t CHANNELS = 2;
+static const uint32_t SAMPLE_RATE = 44100;
+static const uint32_t SLOT_FRAMES = SLOT_BYTES / (CHANNELS * sizeof(float));
+
+// The value written for a channel of a frame; exact in a float
+static float ExpectedSample(uint64_t frame, uint32_t channel)
+{
+    return static_cast<float>((frame * CHANNELS + channel) % (1u << 24));
+}
+
+struct ReaderResult {
+    uint64_t intact;
+    uint64_t torn;              // Release reported an overwrite
+    uint64_t corrupt;           // Released as intact but wrong
+    uint64_t outOfOrder;
+    uint64_t discontinuous;     // Stream position jumped with nothing skipped
+    uint64_t blocksRead;
+    uint64_t blocksSkipped;
+    uint64_t blocksTorn;
+};
+
+static void RunReader(std::atomic<bool>& stop, std::chrono::microseconds hold, ReaderResult& result)
+{
+    result = ReaderResult();
+    AudioTapReader reader;
+    if (!reader.Open(TAP_NAME))
+    {
+        result.corrupt = 1;
+        return;
+    }
+
+    std::vector<float> copy(SLOT_BYTES / sizeof(float));
+    bool haveLast = false;
+    uint64_t lastSequence = 0;
+    uint64_t nextFrame = 0;
+    uint64_t skippedBefore = 0;
+    while (!stop)
+    {
+        AudioTapBlock block;
+        if (!reader.Acquire(block))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Copy out, then hold every other block as a slow analysis would
+        AudioTapBlock header = block;
+        size_t samples = static_cast<size_t>(block.frames) * block.channels;
+        std::copy(block.samples, block.samples + samples, copy.begin());
+        if (hold.count() > 0 && block.sequence % 2 == 0)
+        {
+            std::this_thread::sleep_for(hold);
+        }
+        if (!reader.Release(block))
+        {
+            result.torn++;
+            continue;
+        }
+        result.intact++;
+
+        bool valid = header.channels == CHANNELS && header.sampleRate == SAMPLE_RATE &&
+                     header.format == AudioTapSampleFormat::Float32 && header.frames > 0 &&
+                     header.frames <= SLOT_FRAMES;
+        for (uint32_t f = 0; valid && f < header.frames; f++)
+        {
+            for (uint32_t c = 0; c < CHANNELS; c++)
+            {
+                valid = valid && copy[f * CHANNELS + c] == ExpectedSample(header.streamFrame + f, c);
+            }
+        }
+        if (!valid)
+        {
+            result.corrupt++;
+            continue;
+        }
+
+        // Consecutive intact blocks follow on from each other unless the
+        // reader lost some in between
+        if (haveLast)
+        {
+            if (header.sequence <= lastSequence)
+            {
+                result.outOfOrder++;
+            }
+            bool lostAny = header.sequence != lastSequence + 1 || reader.GetBlocksSkipped() != skippedBefore;
+            if (!lostAny && header.streamFrame != nextFrame)
+            {
+                result.discontinuous++;
+            }
+        }
+        haveLast = true;
+        lastSequence = header.sequence;
+        nextFrame = header.streamFrame + header.frames;
+        skippedBefore = reader.GetBlocksSkipped();
+    }
+
+    result.blocksRead = reader.GetBlocksRead();
+    result.blocksSkipped = reader.GetBlocksSkipped();
+    result.blocksTorn = reader.GetBlocksTorn();
+}
+
+int main()
+{
+    AudioTap tap;
+    if (!tap.Start(TAP_NAME, SLOT_COUNT, SLOT_BYTES))
+    {
+        std::fprintf(stderr, "could not create the tap\n");
+        return 1;
+    }
+
+    // One reader keeps up as best it can, one holds blocks long enough for
+    // the ring to come round
+    std::atomic<bool> stop(false);
+    ReaderResult fast;
+    ReaderResult slow;
+    std::thread fastReader(RunReader, std::ref(stop), std::chrono::microseconds(0), std::ref(fast));
+    std::thread slowReader(RunReader, std::ref(stop), std::chrono::microseconds(300), std::ref(slow));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Block sizes from one frame to three slots, so blocks also split, in
+    // bursts that lap the ring
+    std::vector<float> block(SLOT_FRAMES * 3 * CHANNELS);
+    uint64_t frame = 0;
+    uint32_t size = 1;
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    for (int writes = 1; std::chrono::steady_clock::now() < end; writes++)
+    {
+        size = (size + 97) % (SLOT_FRAMES * 3) + 1;
+        for (uint32_t f = 0; f < size; f++)
+        {
+            for (uint32_t c = 0; c < CHANNELS; c++)
+            {
+                block[f * CHANNELS + c] = ExpectedSample(frame + f, c);
+            }
+        }
+        tap.Write(block.data(), size, CHANNELS, SAMPLE_RATE, frame, 0.0);
+        frame += size;
+        if (writes % 8 == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    uint64_t published = tap.GetBlocksPublished();
+
+    stop = true;
+    fastReader.join();
+    slowReader.join();
+
+    const ReaderResult* results[] = { &fast, &slow };
+    for (const ReaderResult* result : results)
+    {
+        CHECK(result->corrupt == 0);
+        CHECK(result->outOfOrder == 0);
+        CHECK(result->discontinuous == 0);
+        CHECK(result->intact > 0);
+        CHECK(result->blocksRead == result->intact + result->torn);
+        CHECK(result->blocksTorn == result->torn);
+        CHECK(result->blocksRead + result->blocksSkipped <= published);
+    }
+
+    // The slow reader must have been overrun, and been told
+    CHECK(slow.torn > 0);
+    CHECK(slow.blocksSkipped > 0);
+
+    std::printf("%llu blocks published\n", static_cast<unsigned long long>(published));
+    std::printf("fast reader: %llu intact, %llu torn, %llu skipped\n", static_cast<unsigned long long>(fast.intact),
+                static_cast<unsigned long long>(fast.torn), static_cast<unsigned long long>(fast.blocksSkipped));
+    std::printf("slow reader: %llu intact, %llu torn, %llu skipped\n", static_cast<unsigned long long>(slow.intact),
+                static_cast<unsigned long long>(slow.torn), static_cast<unsigned long long>(slow.blocksSkipped));
+
+    // Readers see the tap close
+    AudioTapReader reader;
+    CHECK(reader.Open(TAP_NAME));
+    CHECK(reader.IsWriterOpen());
+    tap.Stop();
+    CHECK(!reader.IsWriterOpen());
+    return CheckResult();
+}
@@ -0,0 +1,125 @@
+#include "CommandQueue.h"
+#include "BenchTimer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Latency from posting a command to a sleeping consumer until its result is
+// visible, the cost of a post, and the same with the consumer kept busy.
+// The consumer waits without a timeout, so every sample includes a real
+// wake-up; any sample near the EngineController refresh interval would
+// point at a lost one.
+static const int POSTS = 5000;
+static const double REFRESH_US = 50000.0;
+
+class EchoConsumer {
+public:
+    EchoConsumer()
+        : m_running(true)
+        , m_applied(0)
+    {
+        m_thread = std::thread(&EchoConsumer::Run, this);
+    }
+
+    ~EchoConsumer()
+    {
+        m_running = false;
+        m_queue.Close();
+        m_thread.join();
+    }
+
+    CommandQueue<uint64_t, 256> m_queue;
+    std::atomic<bool> m_running;
+    std::atomic<uint64_t> m_applied;
+
+private:
+    void Run()
+    {
+        while (m_running)
+        {
+            uint64_t command;
+            while (m_queue.Pop(command))
+            {
+                m_applied.store(command, std::memory_order_release);
+            }
+            m_queue.WaitUntil(std::chrono::steady_clock::now() + std::chrono::hours(1));
+        }
+    }
+
+    std::thread m_thread;
+};
+
+// Posts one command at a time and spins until it is applied
+static bool MeasureRoundTrip(int pauseMicros, const char* label)
+{
+    EchoConsumer consumer;
+    std::vector<double> latencies;
+    std::vector<double> postCosts;
+    latencies.reserve(POSTS);
+    postCosts.reserve(POSTS);
+    for (uint64_t i = 1; i <= POSTS; i++)
+    {
+        double start = NowMicroseconds();
+        consumer.m_queue.Push(i);
+        postCosts.push_back(NowMicroseconds() - start);
+        while (consumer.m_applied.load(std::memory_order_acquire) < i)
+        {
+        }
+        latencies.push_back(NowMicroseconds() - start);
+        if (pauseMicros > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(pauseMicros));
+        }
+    }
+
+    double worst = Percentile(latencies, 1.0);
+    std::printf("%-22s %9.1f %9.1f %9.1f %10.2f\n", label, Percentile(latencies, 0.5),
+                Percentile(latencies, 0.99), worst, Percentile(postCosts, 0.5));
+    return worst < REFRESH_US;
+}
+
+// Several threads posting as fast as the consumer drains, retrying when full
+static void MeasureContendedPosts()
+{
+    const int THREADS = 4;
+    const int PER_THREAD = 200000;
+    EchoConsumer consumer;
+    std::vector<std::thread> producers;
+    std::atomic<uint64_t> retries(0);
+    double start = NowMicroseconds();
+    for (int t = 0; t < THREADS; t++)
+    {
+        producers.emplace_back([&consumer, &retries] {
+            for (int i = 0; i < PER_THREAD; i++)
+            {
+                while (!consumer.m_queue.Push(1))
+                {
+                    retries.fetch_add(1, std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    double elapsed = NowMicroseconds() - start;
+    std::printf("\n%d posting threads: %.0f ns per command delivered, %.2f retries per post on a full queue\n",
+                THREADS, 1000.0 * elapsed / (THREADS * PER_THREAD), static_cast<double>(retries) / (THREADS * PER_THREAD));
+}
+
+int main()
+{
+    std::printf("%d posts, each waited for before the next\n", POSTS);
+    std::printf("consumer               p50 us    p99 us    max us  post p50 us\n");
+    bool prompt = MeasureRoundTrip(500, "asleep between posts");
+    prompt = MeasureRoundTrip(0, "back to back") && prompt;
+    MeasureContendedPosts();
+
+    std::printf("\nevery command %s\n", prompt ? "applied well inside the refresh interval" : "NOT WOKEN PROMPTLY");
+    return prompt ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,230 @@
+#include "CommandQueue.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// The command hand-off EngineController is built on, driven the way it is
+// used: producers post and wait for the consumer to publish the result,
+// and the consumer sleeps without a timeout between commands, so a lost
+// wake-up hangs the test instead of being hidden by a poll. Also runs
+// clean under ThreadSanitizer (MUSICAPP_THREAD_SANITIZER).
+
+static const int PRODUCERS = 4;
+
+struct Command {
+    int producer;
+    uint32_t index;
+};
+
+// What the consumer publishes after each command, like EngineState
+struct Snapshot {
+    uint64_t version;
+    uint32_t applied[PRODUCERS];    // Commands applied per producer
+};
+
+static std::chrono::steady_clock::time_point Forever()
+{
+    return std::chrono::steady_clock::now() + std::chrono::hours(1);
+}
+
+class Consumer {
+public:
+    Consumer()
+        : m_running(true)
+        , m_outOfOrder(0)
+    {
+        std::shared_ptr<Snapshot> first = std::make_shared<Snapshot>();
+        first->version = 0;
+        std::fill(first->applied, first->applied + PRODUCERS, 0u);
+        m_state = first;
+        m_thread = std::thread(&Consumer::Run, this);
+    }
+
+    void Stop()
+    {
+        m_running = false;
+        m_queue.Close();
+        m_thread.join();
+    }
+
+    std::shared_ptr<const Snapshot> GetState() const { return std::atomic_load(&m_state); }
+
+    CommandQueue<Command, 16> m_queue;
+    std::atomic<bool> m_running;
+    int m_outOfOrder;               // Consumer thread until stopped
+
+private:
+    void Run()
+    {
+        Snapshot current = *m_state;
+        for (;;)
+        {
+            bool running = m_running;
+            Command command;
+            bool applied = false;
+            while (m_queue.Pop(command))
+            {
+                if (command.index != current.applied[command.producer])
+                {
+                    m_outOfOrder++;
+                }
+                current.applied[command.producer] = command.index + 1;
+                applied = true;
+            }
+            if (applied)
+            {
+                current.version++;
+                std::atomic_store(&m_state, std::shared_ptr<const Snapshot>(std::make_shared<Snapshot>(current)));
+            }
+            if (!running)
+            {
+                break;
+            }
+            m_queue.WaitUntil(Forever());
+        }
+    }
+
+    std::shared_ptr<const Snapshot> m_state;
+    std::thread m_thread;
+};
+
+// Every post waits for its own result, so nearly every one has to wake a
+// sleeping consumer
+static void TestPostAndWait()
+{
+    const uint32_t POSTS = 5000;
+    Consumer consumer;
+    std::atomic<bool> done(false);
+    std::atomic<bool> versionWentBack(false);
+
+    std::thread reader([&] {
+        uint64_t last = 0;
+        while (!done)
+        {
+            std::shared_ptr<const Snapshot> state = consumer.GetState();
+            if (state->version < last)
+            {
+                versionWentBack = true;
+            }
+            last = state->version;
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.emplace_back([&consumer, p] {
+            for (uint32_t i = 0; i < POSTS; i++)
+            {
+                Command command = { p, i };
+                while (!consumer.m_queue.Push(command))
+                {
+                    std::this_thread::yield();
+                }
+                while (consumer.GetState()->applied[p] <= i)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+    done = true;
+    reader.join();
+    consumer.Stop();
+
+    std::shared_ptr<const Snapshot> state = consumer.GetState();
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        CHECK(state->applied[p] == POSTS);
+    }
+    CHECK(consumer.m_outOfOrder == 0);
+    CHECK(!versionWentBack);
+}
+
+// Bursts that overfill the queue, with the consumer asleep at the start of each
+static void TestBursts()
+{
+    const uint32_t POSTS = 20000;
+    Consumer consumer;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.emplace_back([&consumer, p] {
+            for (uint32_t i = 0; i < POSTS; i++)
+            {
+                Command command = { p, i };
+                while (!consumer.m_queue.Push(command))
+                {
+                    std::this_thread::yield();
+                }
+                if (i % 64 == 63)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+
+    // Everything posted must be applied without any further wake-up
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    bool drained = false;
+    while (!drained && std::chrono::steady_clock::now() < deadline)
+    {
+        std::shared_ptr<const Snapshot> state = consumer.GetState();
+        drained = true;
+        for (int p = 0; p < PRODUCERS; p++)
+        {
+            drained = drained && state->applied[p] == POSTS;
+        }
+        std::this_thread::yield();
+    }
+    consumer.Stop();
+    CHECK(drained);
+    CHECK(consumer.m_outOfOrder == 0);
+}
+
+// Close wakes a consumer with nothing queued; after Reopen the deadline
+// applies again
+static void TestCloseAndDeadline()
+{
+    CommandQueue<Command, 16> queue;
+    std::thread waiter([&queue] { queue.WaitUntil(Forever()); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.Close();
+    waiter.join();
+
+    queue.WaitUntil(Forever());     // Closed, so returns at once
+
+    queue.Reopen();
+    auto start = std::chrono::steady_clock::now();
+    queue.WaitUntil(start + std::chrono::milliseconds(20));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+
+    Command command = { 0, 7 };
+    CHECK(queue.Push(command));
+    queue.WaitUntil(Forever());     // Already queued, so returns at once
+    Command popped = {};
+    CHECK(queue.Pop(popped) && popped.index == 7);
+    CHECK(!queue.Pop(popped));
+}
+
+int main()
+{
+    TestCloseAndDeadline();
+    TestPostAndWait();
+    TestBursts();
+    return CheckResult();
+}
@@ -0,0 +1,55 @@
+#include "SoakTest.h"
+#include "TestCheck.h"
+#include <cstdio>
+
+// A short soak against the simulated device, with faults far more frequent
+// than the defaults, run twice from one seed: both runs must be clean and
+// must match to the callback.
+
+static SoakOptions ShortSoak(uint64_t seed)
+{
+    SoakOptions options;
+    options.simulatedSeconds = 600.0;
+    options.maxSegmentSeconds = 5.0;
+    options.watchdogMs = 20000;
+    options.device.seed = seed;
+    options.device.lateProbability = 0.02;
+    options.device.dropProbability = 0.01;
+    options.device.emptyProbability = 0.01;
+    options.device.requeueFailureProbability = 0.005;
+    options.device.writeFailureProbability = 0.005;
+    options.device.deviceLossProbability = 0.001;
+    return options;
+}
+
+int main()
+{
+    SoakResult first = {};
+    SoakResult second = {};
+    CHECK(RunSoakTest(ShortSoak(7), &first) == 0);
+    CHECK(RunSoakTest(ShortSoak(7), &second) == 0);
+
+    // Every fault kind came up, so the run covered them
+    CHECK(first.midStreamDisconnects > 0);
+    CHECK(first.device.droppedBuffers > 0);
+    CHECK(first.device.emptyBuffers > 0);
+    CHECK(first.device.writeFailures > 0);
+    CHECK(first.device.deviceLosses > 0);
+    CHECK(first.engine.dropouts > 0);
+
+    // The seed replays the run
+    CHECK(first.cycles == second.cycles);
+    CHECK(first.midStreamDisconnects == second.midStreamDisconnects);
+    CHECK(first.device.simulatedMs == second.device.simulatedMs);
+    CHECK(first.device.callbacks == second.device.callbacks);
+    CHECK(first.device.shutdownCallbacks == second.device.shutdownCallbacks);
+    CHECK(first.device.captureOverruns == second.device.captureOverruns);
+    CHECK(first.device.playbackUnderruns == second.device.playbackUnderruns);
+    CHECK(first.device.concealedOutputs == second.device.concealedOutputs);
+    CHECK(first.engine.buffersProcessed == second.engine.buffersProcessed);
+    CHECK(first.engine.framesProcessed == second.engine.framesProcessed);
+    CHECK(first.engine.dropouts == second.engine.dropouts);
+    CHECK(first.engine.concealedFrames == second.engine.concealedFrames);
+    CHECK(first.engine.silencedFrames == second.engine.silencedFrames);
+    return CheckResult();
+}
@@ -0,0 +1,101 @@
+#include "DropoutConcealer.h"
+#include "BenchTimer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Cost of a dropout in the audio callback: Conceal for the gap, including
+// the period search, and Process for the block that blends in after it,
+// for the test's gap patterns at 1024-frame blocks. A block without a gap
+// only pays for Process adding it to the history.
+static const uint32_t BLOCK_FRAMES = 1024;
+static const uint32_t SAMPLE_RATE = 44100;
+static const int GAPS = 400;
+static const int BLOCKS_BETWEEN_GAPS = 3;
+
+// A dropout may take at most this share of the block budget
+static const double BUDGET_FRACTION = 0.02;
+
+int main()
+{
+    struct Pattern {
+        const char* name;
+        std::vector<uint32_t> gaps;
+    };
+    const Pattern patterns[] = {
+        { "short gaps", { 64, 128, 256, 100, 200 } },
+        { "one buffer", { 1024, 1024, 1024 } },
+        { "long stalls", { 2048, 4410, 10240 } },
+    };
+    const int channelCounts[] = { 1, 2, 6, 8 };
+
+    double budgetUs = BLOCK_FRAMES * 1e6 / SAMPLE_RATE;
+    std::printf("%u-frame blocks, budget %.0f us per block\n", BLOCK_FRAMES, budgetUs);
+    std::printf("pattern      ch  block p50 us  conceal p50 us  p99 us  blend p50 us  p99 us  share\n");
+
+    bool withinBudget = true;
+    for (const Pattern& pattern : patterns)
+    {
+        for (int channels : channelCounts)
+        {
+            // Two partials per channel, so the period search has work to do
+            const double twoPi = 6.283185307179586;
+            std::vector<float> source(static_cast<size_t>(BLOCK_FRAMES) * channels * 64);
+            for (size_t i = 0; i < source.size(); i++)
+            {
+                double t = static_cast<double>(i / channels) / SAMPLE_RATE;
+                int c = static_cast<int>(i % channels);
+                source[i] = static_cast<float>(0.5 * std::sin(twoPi * 220.0 * t) + 0.2 * std::sin(twoPi * 661.0 * t + c));
+            }
+            size_t blockSamples = static_cast<size_t>(BLOCK_FRAMES) * channels;
+            size_t sourceBlocks = source.size() / blockSamples;
+
+            DropoutConcealer concealer;
+            concealer.Reset(channels, SAMPLE_RATE, BLOCK_FRAMES);
+            std::vector<float> fill(static_cast<size_t>(concealer.GetMaxFillFrames()) * channels);
+            std::vector<float> block(blockSamples);
+            size_t next = 0;
+            auto nextBlock = [&] {
+                const float* from = source.data() + (next++ % sourceBlocks) * blockSamples;
+                std::copy(from, from + blockSamples, block.begin());
+            };
+
+            std::vector<double> plainTimes;
+            std::vector<double> concealTimes;
+            std::vector<double> blendTimes;
+            std::vector<double> dropoutTimes;
+            for (int g = 0; g < GAPS; g++)
+            {
+                for (int b = 0; b < BLOCKS_BETWEEN_GAPS; b++)
+                {
+                    nextBlock();
+                    double start = NowMicroseconds();
+                    concealer.Process(block.data(), BLOCK_FRAMES);
+                    plainTimes.push_back(NowMicroseconds() - start);
+                }
+
+                uint32_t gap = pattern.gaps[g % pattern.gaps.size()];
+                DropoutAction action;
+                nextBlock();
+                double start = NowMicroseconds();
+                concealer.Conceal(gap, fill.data(), action);
+                double concealed = NowMicroseconds();
+                concealer.Process(block.data(), BLOCK_FRAMES);
+                double blended = NowMicroseconds();
+                concealTimes.push_back(concealed - start);
+                blendTimes.push_back(blended - concealed);
+                dropoutTimes.push_back(blended - start);
+            }
+
+            double dropoutP99 = Percentile(dropoutTimes, 0.99);
+            std::printf("%-11s %3d  %12.2f  %14.2f  %6.2f  %12.2f  %6.2f  %4.1f%%\n", pattern.name, channels,
+                        Percentile(plainTimes, 0.5), Percentile(concealTimes, 0.5), Percentile(concealTimes, 0.99),
+                        Percentile(blendTimes, 0.5), Percentile(blendTimes, 0.99), 100.0 * dropoutP99 / budgetUs);
+            withinBudget = withinBudget && dropoutP99 < BUDGET_FRACTION * budgetUs;
+        }
+    }
+
+    std::printf("p99 dropout cost %s %.0f%% of the budget\n", withinBudget ? "within" : "OVER", 100.0 * BUDGET_FRACTION);
+    return withinBudget ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,279 @@
+#include "DropoutConcealer.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Injects gaps of different lengths into tonal and noisy streams and
+// measures the step at every junction against the signal's own largest
+// step. Splicing the blocks together directly clicks; the concealed
+// stream must not. Also covers the gap detector's decisions.
+
+static const int CHANNELS = 2;
+static const uint32_t SAMPLE_RATE = 44100;
+static const uint32_t BLOCK_FRAMES = 1024;
+static const int BLOCKS = 60;
+
+enum SignalKind {
+    TONE,
+    CHORD,
+    NOISE
+};
+
+static float Signal(uint64_t frame, int channel, SignalKind kind, std::mt19937& random)
+{
+    const double twoPi = 6.283185307179586;
+    double t = static_cast<double>(frame) / SAMPLE_RATE;
+    switch (kind)
+    {
+        case TONE:
+            return static_cast<float>(0.5 * std::sin(twoPi * 220.0 * t) + 0.2 * std::sin(twoPi * 661.0 * t + channel));
+        case CHORD:
+            return static_cast<float>(0.3 * std::sin(twoPi * 97.3 * t) + 0.3 * std::sin(twoPi * 146.0 * t) +
+                                      0.2 * std::sin(twoPi * 1234.0 * t));
+        case NOISE:
+            break;
+    }
+    return std::uniform_real_distribution<float>(-0.3f, 0.3f)(random);
+}
+
+// Largest second difference across channels at a frame
+static double Step(const std::vector<float>& samples, size_t frame)
+{
+    double largest = 0.0;
+    for (int c = 0; c < CHANNELS; c++)
+    {
+        double d = samples[(frame + 1) * CHANNELS + c] - 2.0 * samples[frame * CHANNELS + c] +
+                   samples[(frame - 1) * CHANNELS + c];
+        largest = std::max(largest, std::fabs(d));
+    }
+    return largest;
+}
+
+// Largest step within two frames of any junction
+static double WorstJunctionStep(const std::vector<float>& samples, const std::vector<size_t>& junctions)
+{
+    double worst = 0.0;
+    for (size_t junction : junctions)
+    {
+        for (size_t frame = junction - 2; frame <= junction + 2; frame++)
+        {
+            worst = std::max(worst, Step(samples, frame));
+        }
+    }
+    return worst;
+}
+
+struct GapRun {
+    double spliceClick;         // Worst junction step, spliced, against the signal's own
+    double concealedClick;      // The same with concealment
+    uint32_t repeatedFrames;
+    uint32_t fadedGaps;
+    float sourcePeak;
+    float concealedPeak;
+};
+
+static GapRun RunGaps(SignalKind kind, const std::vector<uint32_t>& gaps)
+{
+    GapRun run = {};
+    std::mt19937 random(1);
+    DropoutConcealer concealer;
+    concealer.Reset(CHANNELS, SAMPLE_RATE, BLOCK_FRAMES);
+    std::vector<float> block(BLOCK_FRAMES * CHANNELS);
+    std::vector<float> fill(concealer.GetMaxFillFrames() * CHANNELS);
+
+    std::vector<float> spliced;
+    std::vector<float> concealed;
+    std::vector<size_t> splicedJunctions;
+    std::vector<size_t> concealedJunctions;
+    uint64_t source = 0;
+    size_t nextGap = 0;
+    for (int b = 0; b < BLOCKS; b++)
+    {
+        // A gap every ten blocks, after enough audio to have a period
+        uint32_t gap = (b % 10 == 5 && nextGap < gaps.size()) ? gaps[nextGap++] : 0;
+        source += gap;
+        for (uint32_t i = 0; i < BLOCK_FRAMES; i++)
+        {
+            for (int c = 0; c < CHANNELS; c++)
+            {
+                block[i * CHANNELS + c] = Signal(source + i, c, kind, random);
+            }
+        }
+        source += BLOCK_FRAMES;
+
+        if (gap > 0)
+        {
+            splicedJunctions.push_back(spliced.size() / CHANNELS);
+        }
+        spliced.insert(spliced.end(), block.begin(), block.end());
+
+        bool changed = false;
+        if (gap > 0)
+        {
+            DropoutAction action;
+            uint32_t frames = concealer.Conceal(gap, fill.data(), action);
+            CHECK(frames <= concealer.GetMaxFillFrames());
+            concealedJunctions.push_back(concealed.size() / CHANNELS);
+            concealed.insert(concealed.end(), fill.begin(), fill.begin() + frames * CHANNELS);
+            concealedJunctions.push_back(concealed.size() / CHANNELS);
+            if (action == DropoutAction::Repeated)
+            {
+                CHECK(frames == gap);
+                run.repeatedFrames += frames;
+            }
+            else
+            {
+                CHECK(action == DropoutAction::FadedOut);
+                CHECK(gap > BLOCK_FRAMES);
+
+                // Faded all the way to silence
+                for (int c = 0; c < CHANNELS; c++)
+                {
+                    CHECK(std::fabs(fill[(frames - 1) * CHANNELS + c]) < 1e-6f);
+                }
+                run.fadedGaps++;
+            }
+            changed = concealer.Process(block.data(), BLOCK_FRAMES);
+            CHECK(changed);
+        }
+        else
+        {
+            // Clean blocks pass through untouched
+            changed = concealer.Process(block.data(), BLOCK_FRAMES);
+            CHECK(!changed || b % 10 == 6);
+        }
+        concealed.insert(concealed.end(), block.begin(), block.end());
+    }
+
+    double typical = 0.0;
+    for (size_t frame = 1; frame < 4000; frame++)
+    {
+        typical = std::max(typical, Step(spliced, frame));
+    }
+    run.spliceClick = WorstJunctionStep(spliced, splicedJunctions) / typical;
+    run.concealedClick = WorstJunctionStep(concealed, concealedJunctions) / typical;
+    for (float sample : spliced)
+    {
+        run.sourcePeak = std::max(run.sourcePeak, std::fabs(sample));
+    }
+    for (float sample : concealed)
+    {
+        run.concealedPeak = std::max(run.concealedPeak, std::fabs(sample));
+    }
+    return run;
+}
+
+static void TestGapInjection()
+{
+    const char* const kindNames[] = { "tone", "chord", "noise" };
+    struct Pattern {
+        const char* name;
+        std::vector<uint32_t> gaps;
+        bool repeated;
+    };
+    const Pattern patterns[] = {
+        { "short gaps", { 64, 128, 256, 100, 200 }, true },
+        { "one buffer", { 1024, 1024, 1024 }, true },
+        { "long stalls", { 2048, 4410, 10240 }, false },
+    };
+
+    for (int kind = TONE; kind <= NOISE; kind++)
+    {
+        for (const Pattern& pattern : patterns)
+        {
+            GapRun run = RunGaps(static_cast<SignalKind>(kind), pattern.gaps);
+            std::printf("%-5s %-11s spliced %6.1fx, concealed %5.2fx\n", kindNames[kind], pattern.name,
+                        run.spliceClick, run.concealedClick);
+
+            uint32_t total = 0;
+            for (uint32_t gap : pattern.gaps)
+            {
+                total += gap;
+            }
+            CHECK(run.repeatedFrames == (pattern.repeated ? total : 0));
+            CHECK(run.fadedGaps == (pattern.repeated ? 0 : pattern.gaps.size()));
+
+            // Filling never reaches past the audio it repeats
+            CHECK(run.concealedPeak <= run.sourcePeak);
+
+            if (kind == NOISE)
+            {
+                // Noise has no waveform to continue, but no junction may
+                // step further than the noise itself
+                CHECK(run.concealedClick < 1.5);
+            }
+            else
+            {
+                // Splicing a tone clicks at over fifty times its own
+                // largest step; concealed junctions stay within a few
+                CHECK(run.spliceClick > 50.0);
+                CHECK(run.concealedClick < 6.0);
+            }
+        }
+    }
+}
+
+// A gap before there is enough audio to repeat fades in the next block
+static void TestColdStart()
+{
+    DropoutConcealer concealer;
+    concealer.Reset(CHANNELS, SAMPLE_RATE, BLOCK_FRAMES);
+    std::vector<float> fill(concealer.GetMaxFillFrames() * CHANNELS);
+    DropoutAction action = DropoutAction::None;
+    CHECK(concealer.Conceal(256, fill.data(), action) == 0);
+    CHECK(action == DropoutAction::FadedOut);
+
+    std::vector<float> block(BLOCK_FRAMES * CHANNELS, 0.5f);
+    CHECK(concealer.Process(block.data(), BLOCK_FRAMES));
+    CHECK(std::fabs(block[0]) < 0.05f);
+    CHECK(block[(BLOCK_FRAMES - 1) * CHANNELS] == 0.5f);
+}
+
+static void TestGapDetector()
+{
+    const double error = 2.0;
+    CaptureGapDetector detector;
+    detector.Reset(BLOCK_FRAMES);
+
+    // Nothing is trusted while the clock fit warms up
+    uint32_t lost = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lost += detector.Update(3000.0, error);
+    }
+    CHECK(lost == 0);
+    CHECK(detector.Update(0.0, error) == 0);
+
+    // A late callback followed by the buffers queued behind it
+    CHECK(detector.Update(900.0, error) == 0);
+    CHECK(detector.Update(0.0, error) == 0);
+
+    // Jitter within half a buffer
+    for (int i = 0; i < 50; i++)
+    {
+        CHECK(detector.Update(i % 2 ? 300.0 : -300.0, error) == 0);
+    }
+
+    // Frames really lost leave the same deficit on the next callback
+    CHECK(detector.Update(700.0, error) == 0);
+    CHECK(detector.Update(702.0, error) == 700);
+
+    // The caller moves the capture position on, so the deficit clears
+    CHECK(detector.Update(2.0, error) == 0);
+    CHECK(detector.Update(1.0, error) == 0);
+
+    // A deficit that keeps growing by a buffer is a stall, not a loss yet
+    CHECK(detector.Update(1024.0, error) == 0);
+    CHECK(detector.Update(2048.0, error) == 0);
+}
+
+int main()
+{
+    TestGapInjection();
+    TestColdStart();
+    TestGapDetector();
+    return CheckResult();
+}
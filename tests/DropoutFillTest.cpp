@@ -0,0 +1,97 @@
+#include "DeviceManager.h"
+#include "SimulatedWaveDevice.h"
+#include "AudioTapReader.h"
+#include "TestCheck.h"
+#include <cstdio>
+
+// The engine against the simulated device with output writes failing and
+// capture buffers coming back empty. The fill for a block that only failed
+// to play goes to the output alone: the tap already has those frames, so
+// every block it publishes starts at or after the end of the one before.
+
+static const wchar_t* const TAP_NAME = L"DropoutFillTest";
+static const int STEPS = 200;
+static const double STEP_MS = 250.0;
+
+struct TapPositions {
+    uint64_t blocks;
+    uint64_t overlaps;          // A block starting before the last one ended
+    uint64_t holes;             // A block starting after the last one ended
+    uint64_t torn;
+    uint64_t nextFrame;
+    bool haveLast;
+};
+
+static void ReadTap(AudioTapReader& reader, TapPositions& positions)
+{
+    AudioTapBlock block;
+    while (reader.Acquire(block))
+    {
+        if (positions.haveLast)
+        {
+            positions.overlaps += block.streamFrame < positions.nextFrame ? 1 : 0;
+            positions.holes += block.streamFrame > positions.nextFrame ? 1 : 0;
+        }
+        positions.nextFrame = block.streamFrame + block.frames;
+        positions.haveLast = true;
+        positions.blocks++;
+        positions.torn += reader.Release(block) ? 0 : 1;
+    }
+}
+
+static void TestFillPositions(double writeFailureProbability, double emptyProbability)
+{
+    SimulatedDeviceOptions options;
+    options.seed = 11;
+    options.writeFailureProbability = writeFailureProbability;
+    options.emptyProbability = emptyProbability;
+    SimulatedWaveDevice device(options);
+    DeviceManager engine;
+    engine.SetWaveDeviceApi(device.GetApi());
+    CHECK(engine.StartTap(TAP_NAME));
+
+    AudioTapReader reader;
+    CHECK(reader.Open(TAP_NAME));
+    AudioDeviceInfo input = { 0, L"Simulated input", true };
+    AudioDeviceInfo output = { 0, L"Simulated output", false };
+    CHECK(engine.ConnectAudioInputToOutput(input, output));
+
+    // Read between steps so the ring never laps the reader
+    TapPositions positions = {};
+    for (int step = 0; step < STEPS; step++)
+    {
+        device.Advance(STEP_MS);
+        CHECK(device.WaitUntilIdle(10000));
+        ReadTap(reader, positions);
+    }
+    engine.DisconnectAudioDevices();
+    ReadTap(reader, positions);
+
+    SimulatedDeviceStats deviceStats = device.GetStats();
+    EngineStats engineStats = engine.GetStats();
+    printf("write failures %llu, empty buffers %llu: %llu blocks, %llu overlaps, %llu holes\n",
+           static_cast<unsigned long long>(deviceStats.writeFailures), static_cast<unsigned long long>(deviceStats.emptyBuffers),
+           static_cast<unsigned long long>(positions.blocks), static_cast<unsigned long long>(positions.overlaps),
+           static_cast<unsigned long long>(positions.holes));
+    CHECK(positions.blocks > 0);
+    CHECK(positions.torn == 0);
+    CHECK(reader.GetBlocksSkipped() == 0);
+    CHECK(positions.overlaps == 0);
+    CHECK(deviceStats.writeFailures > 0 || writeFailureProbability == 0.0);
+    CHECK(deviceStats.emptyBuffers > 0 || emptyProbability == 0.0);
+    CHECK(engineStats.dropouts > 0);
+
+    // Failed writes alone never leave the capture stream short
+    if (emptyProbability == 0.0)
+    {
+        CHECK(positions.holes == 0);
+    }
+    engine.StopTap();
+}
+
+int main()
+{
+    TestFillPositions(0.05, 0.0);
+    TestFillPositions(0.05, 0.02);
+    return CheckResult();
+}
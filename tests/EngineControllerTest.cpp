@@ -0,0 +1,119 @@
+#include "EngineController.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Threads keep posting tempo changes while the controller is stopped and
+// restarted. Between sessions the tempo is set to a value no poster uses;
+// a command left queued by a Post that raced Stop must be dropped, not
+// applied when the controller starts again.
+
+static const int POSTERS = 3;
+static const int CYCLES = 300;
+static const double RESTART_TEMPO = 77.0;
+
+struct Posters {
+    std::atomic<bool> allowed;
+    std::atomic<bool> stop;
+    std::atomic<int> busy;          // Posters inside a burst of Posts
+    std::atomic<uint64_t> posted;   // Posts that returned a sequence
+};
+
+static void RunPoster(EngineController& controller, Posters& posters, int index)
+{
+    while (!posters.stop)
+    {
+        if (!posters.allowed)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        posters.busy++;
+        if (posters.allowed)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                if (controller.Post(EngineCommand::SetTempo, 0, 0, 100.0 + index) != 0)
+                {
+                    posters.posted++;
+                }
+            }
+        }
+        posters.busy--;
+    }
+}
+
+// Waits for the control thread to have applied everything up to sequence
+static bool WaitForApplied(const EngineController& controller, uint64_t sequence)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (controller.GetState()->appliedSequence < sequence)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+int main()
+{
+    DeviceManager deviceManager;
+    EngineController controller(deviceManager);
+    CHECK(controller.Post(EngineCommand::SetTempo, 0, 0, 90.0) == 0);
+
+    Posters posters;
+    posters.allowed = false;
+    posters.stop = false;
+    posters.busy = 0;
+    posters.posted = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < POSTERS; i++)
+    {
+        threads.emplace_back(RunPoster, std::ref(controller), std::ref(posters), i);
+    }
+
+    int staleApplied = 0;
+    for (int cycle = 0; cycle < CYCLES; cycle++)
+    {
+        deviceManager.SetTempo(RESTART_TEMPO);
+        controller.Start();
+
+        // Nothing queued before this marker may have changed the tempo
+        uint64_t marker = controller.Post(EngineCommand::DisconnectAudio);
+        CHECK(marker != 0);
+        CHECK(WaitForApplied(controller, marker));
+        staleApplied += controller.GetState()->tempoBpm != RESTART_TEMPO ? 1 : 0;
+
+        // Stop with posts in flight, then let every burst finish so any
+        // command that raced the stop is queued before the next start
+        posters.allowed = true;
+        std::this_thread::sleep_for(std::chrono::microseconds(200 + 37 * (cycle % 16)));
+        controller.Stop();
+        posters.allowed = false;
+        while (posters.busy > 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    posters.stop = true;
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::shared_ptr<const EngineState> state = controller.GetState();
+    std::printf("%d restarts, %llu commands posted, %llu dropped\n", CYCLES,
+                static_cast<unsigned long long>(posters.posted.load()),
+                static_cast<unsigned long long>(state->commandsDropped));
+    CHECK(staleApplied == 0);
+    CHECK(posters.posted > 0);
+    CHECK(!state->audioConnected && !state->midiConnected);
+    return CheckResult();
+}
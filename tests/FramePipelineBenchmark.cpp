@@ -0,0 +1,87 @@
+#include "FramePipeline.h"
+#include "GenericFramePipeline.h"
+#include "BenchTimer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// One callback's decode, mix and encode through the specialized pipeline
+// against the generic version that checks the format for every sample.
+static const uint32_t FRAMES = 256;
+static const int RUNS = 31;
+static const int CALLS_PER_RUN = 2000;
+
+// Median time of one call to work, in nanoseconds
+template <typename Work>
+static double MedianNanoseconds(Work work)
+{
+    std::vector<double> runs;
+    for (int r = 0; r < RUNS; r++)
+    {
+        double start = NowMicroseconds();
+        for (int i = 0; i < CALLS_PER_RUN; i++)
+        {
+            work();
+        }
+        runs.push_back(1000.0 * (NowMicroseconds() - start) / CALLS_PER_RUN);
+    }
+    return Percentile(runs, 0.5);
+}
+
+int main()
+{
+    const DeviceSampleFormat formats[] = { DeviceSampleFormat::Pcm16, DeviceSampleFormat::Pcm24,
+                                           DeviceSampleFormat::Pcm32, DeviceSampleFormat::Float32 };
+    const char* const formatNames[] = { "pcm16", "pcm24", "pcm32", "float" };
+    const int channelCounts[] = { 1, 2, 6, 8 };
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> distribution(-1.1f, 1.1f);
+
+    std::printf("%u frames per callback: decode, add stereo, encode\n", FRAMES);
+    std::printf("format  ch  generic ns  pipeline ns  speedup\n");
+    bool faster = true;
+    for (int f = 0; f < 4; f++)
+    {
+        for (int channels : channelCounts)
+        {
+            DeviceSampleFormat format = formats[f];
+            const FramePipeline* pipeline = GetFramePipeline(format, channels);
+            size_t samples = static_cast<size_t>(FRAMES) * channels;
+            std::vector<float> source(samples);
+            for (float& sample : source)
+            {
+                sample = distribution(random);
+            }
+            std::vector<float> stereo(FRAMES * 2);
+            for (float& sample : stereo)
+            {
+                sample = 0.1f * distribution(random);
+            }
+            std::vector<uint8_t> device(samples * GetDeviceBytesPerSample(format));
+            GenericEncode(format, channels, source.data(), device.data(), FRAMES);
+
+            std::vector<float> frames(samples);
+            std::vector<uint8_t> output(device.size());
+            volatile uint8_t sink = 0;
+            double generic = MedianNanoseconds([&] {
+                GenericDecode(format, channels, device.data(), frames.data(), FRAMES);
+                GenericAddStereo(channels, stereo.data(), frames.data(), FRAMES);
+                GenericEncode(format, channels, frames.data(), output.data(), FRAMES);
+                sink = sink + output[0];
+            });
+            double specialized = MedianNanoseconds([&] {
+                pipeline->decode(device.data(), frames.data(), FRAMES);
+                pipeline->addStereo(stereo.data(), frames.data(), FRAMES);
+                pipeline->encode(frames.data(), output.data(), FRAMES);
+                sink = sink + output[0];
+            });
+            std::printf("%-6s %3d %11.0f %12.0f %7.1fx\n", formatNames[f], channels, generic, specialized,
+                        generic / specialized);
+            faster = faster && specialized < generic;
+        }
+    }
+
+    std::printf("\npipeline %s\n", faster ? "faster in every case" : "NOT FASTER in every case");
+    return faster ? EXIT_SUCCESS : EXIT_FAILURE;
+}
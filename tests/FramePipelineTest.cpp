@@ -0,0 +1,152 @@
+#include "FramePipeline.h"
+#include "GenericFramePipeline.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Every specialized pipeline against the generic reference, for every
+// format, channel count 1 to 8 and block lengths that leave each vector
+// kernel a remainder. Guard bytes after the output catch overruns.
+
+static const DeviceSampleFormat FORMATS[] = { DeviceSampleFormat::Pcm16, DeviceSampleFormat::Pcm24,
+                                              DeviceSampleFormat::Pcm32, DeviceSampleFormat::Float32 };
+static const uint32_t MAX_FRAMES = 40;
+static const size_t GUARD = 16;
+static const uint8_t GUARD_BYTE = 0xCD;
+static const float GUARD_SAMPLE = 7.0f;
+
+// A PCM sample as a signed integer
+static int64_t ReadPcm(const uint8_t* sample, size_t bytes)
+{
+    int32_t value = 0;
+    memcpy(reinterpret_cast<uint8_t*>(&value) + 4 - bytes, sample, bytes);
+    return value >> (32 - 8 * bytes);
+}
+
+static void TestAgainstGeneric()
+{
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> distribution(-1.2f, 1.2f);
+    for (DeviceSampleFormat format : FORMATS)
+    {
+        size_t bytesPerSample = GetDeviceBytesPerSample(format);
+        for (int channels = 1; channels <= PIPELINE_MAX_CHANNELS; channels++)
+        {
+            const FramePipeline* pipeline = GetFramePipeline(format, channels);
+            CHECK(pipeline != nullptr);
+            if (pipeline == nullptr)
+            {
+                continue;
+            }
+            for (uint32_t frames = 0; frames < MAX_FRAMES; frames++)
+            {
+                size_t samples = static_cast<size_t>(frames) * channels;
+
+                // Three decimals keep the vector and scalar rounding off ties,
+                // and some samples past full scale exercise the saturation
+                std::vector<float> source(samples);
+                for (float& sample : source)
+                {
+                    sample = std::round(distribution(random) * 1000.0f) / 1000.0f;
+                }
+                std::vector<float> stereo(frames * 2);
+                for (float& sample : stereo)
+                {
+                    sample = distribution(random);
+                }
+                std::vector<uint8_t> device(samples * bytesPerSample);
+                GenericEncode(format, channels, source.data(), device.data(), frames);
+
+                std::vector<float> expected(samples + GUARD, GUARD_SAMPLE);
+                std::vector<float> actual(samples + GUARD, GUARD_SAMPLE);
+                GenericDecode(format, channels, device.data(), expected.data(), frames);
+                pipeline->decode(device.data(), actual.data(), frames);
+                CHECK(memcmp(expected.data(), actual.data(), expected.size() * sizeof(float)) == 0);
+
+                GenericAddStereo(channels, stereo.data(), expected.data(), frames);
+                pipeline->addStereo(stereo.data(), actual.data(), frames);
+                bool mixed = true;
+                for (size_t i = 0; i < expected.size(); i++)
+                {
+                    mixed = mixed && std::fabs(expected[i] - actual[i]) <= 1e-6f;
+                }
+                CHECK(mixed);
+
+                // Vector rounding breaks ties to even, so PCM may differ by one
+                std::vector<uint8_t> expectedOut(samples * bytesPerSample + GUARD, GUARD_BYTE);
+                std::vector<uint8_t> actualOut(samples * bytesPerSample + GUARD, GUARD_BYTE);
+                GenericEncode(format, channels, expected.data(), expectedOut.data(), frames);
+                pipeline->encode(expected.data(), actualOut.data(), frames);
+                bool encoded = true;
+                for (size_t i = 0; i < samples; i++)
+                {
+                    const uint8_t* x = &expectedOut[i * bytesPerSample];
+                    const uint8_t* y = &actualOut[i * bytesPerSample];
+                    if (format == DeviceSampleFormat::Float32)
+                    {
+                        encoded = encoded && memcmp(x, y, bytesPerSample) == 0;
+                    }
+                    else
+                    {
+                        encoded = encoded && std::llabs(ReadPcm(x, bytesPerSample) - ReadPcm(y, bytesPerSample)) <= 1;
+                    }
+                }
+                CHECK(encoded);
+                bool guarded = true;
+                for (size_t i = samples * bytesPerSample; i < actualOut.size(); i++)
+                {
+                    guarded = guarded && actualOut[i] == GUARD_BYTE;
+                }
+                CHECK(guarded);
+                if (!encoded || !guarded)
+                {
+                    std::fprintf(stderr, "encode: format %d, %d channels, %u frames\n", static_cast<int>(format),
+                                 channels, frames);
+                }
+            }
+        }
+    }
+}
+
+// Overs clip to the extremes of each PCM format, however far out they are
+static void TestSaturation()
+{
+    const float overs[8] = { 1.0f, -1.0f, 2.0f, -2.0f, 1e9f, -1e9f, 1e30f, -1e30f };
+    for (int format = 0; format < 3; format++)
+    {
+        size_t bytesPerSample = GetDeviceBytesPerSample(FORMATS[format]);
+        int64_t maximum = (int64_t(1) << (8 * bytesPerSample - 1)) - 1;
+        if (FORMATS[format] == DeviceSampleFormat::Pcm32)
+        {
+            maximum = 2147483520;
+        }
+        int64_t minimum = -(int64_t(1) << (8 * bytesPerSample - 1));
+
+        // Eight channels of one frame reach the vector kernels; three mono
+        // frames are too few for them
+        std::vector<uint8_t> wide(8 * bytesPerSample);
+        GetFramePipeline(FORMATS[format], 8)->encode(overs, wide.data(), 1);
+        std::vector<uint8_t> narrow(3 * bytesPerSample);
+        GetFramePipeline(FORMATS[format], 1)->encode(overs + 4, narrow.data(), 3);
+        for (int i = 0; i < 8; i++)
+        {
+            CHECK(ReadPcm(&wide[i * bytesPerSample], bytesPerSample) == (i % 2 == 0 ? maximum : minimum));
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            CHECK(ReadPcm(&narrow[i * bytesPerSample], bytesPerSample) == (i % 2 == 0 ? maximum : minimum));
+        }
+    }
+}
+
+int main()
+{
+    CHECK(GetFramePipeline(DeviceSampleFormat::Pcm16, 0) == nullptr);
+    CHECK(GetFramePipeline(DeviceSampleFormat::Pcm16, PIPELINE_MAX_CHANNELS + 1) == nullptr);
+    TestAgainstGeneric();
+    TestSaturation();
+    return CheckResult();
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "FramePipeline.h"
+#include <cstring>
+
+// The frame pipeline written the straightforward way: the format is checked
+// for every sample and the channel count is a runtime stride. The test
+// checks the specialized pipelines against it and the benchmark times both.
+
+inline int32_t GenericRoundClamped(float scaled, float minimum, float maximum)
+{
+    if (scaled > maximum)
+    {
+        scaled = maximum;
+    }
+    else if (scaled < minimum)
+    {
+        scaled = minimum;
+    }
+    return static_cast<int32_t>(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+inline void GenericDecode(DeviceSampleFormat format, int channels, const void* in, float* out, uint32_t frames)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(in);
+    size_t bytesPerSample = GetDeviceBytesPerSample(format);
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        for (int channel = 0; channel < channels; channel++)
+        {
+            size_t index = static_cast<size_t>(frame) * channels + channel;
+            const uint8_t* source = bytes + index * bytesPerSample;
+            float sample;
+            switch (format)
+            {
+                case DeviceSampleFormat::Pcm16:
+                {
+                    int16_t value;
+                    memcpy(&value, source, sizeof(value));
+                    sample = value * (1.0f / 32768.0f);
+                    break;
+                }
+                case DeviceSampleFormat::Pcm24:
+                {
+                    int32_t value = static_cast<int32_t>(static_cast<uint32_t>(source[0]) << 8 |
+                                                         static_cast<uint32_t>(source[1]) << 16 |
+                                                         static_cast<uint32_t>(source[2]) << 24) >> 8;
+                    sample = value * (1.0f / 8388608.0f);
+                    break;
+                }
+                case DeviceSampleFormat::Pcm32:
+                {
+                    int32_t value;
+                    memcpy(&value, source, sizeof(value));
+                    sample = value * (1.0f / 2147483648.0f);
+                    break;
+                }
+                default:
+                    memcpy(&sample, source, sizeof(sample));
+                    break;
+            }
+            out[index] = sample;
+        }
+    }
+}
+
+inline void GenericEncode(DeviceSampleFormat format, int channels, const float* in, void* out, uint32_t frames)
+{
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    size_t bytesPerSample = GetDeviceBytesPerSample(format);
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        for (int channel = 0; channel < channels; channel++)
+        {
+            size_t index = static_cast<size_t>(frame) * channels + channel;
+            uint8_t* target = bytes + index * bytesPerSample;
+            float sample = in[index];
+            switch (format)
+            {
+                case DeviceSampleFormat::Pcm16:
+                {
+                    int16_t value = static_cast<int16_t>(GenericRoundClamped(sample * 32768.0f, -32768.0f, 32767.0f));
+                    memcpy(target, &value, sizeof(value));
+                    break;
+                }
+                case DeviceSampleFormat::Pcm24:
+                {
+                    int32_t value = GenericRoundClamped(sample * 8388608.0f, -8388608.0f, 8388607.0f);
+                    target[0] = static_cast<uint8_t>(value);
+                    target[1] = static_cast<uint8_t>(value >> 8);
+                    target[2] = static_cast<uint8_t>(value >> 16);
+                    break;
+                }
+                case DeviceSampleFormat::Pcm32:
+                {
+                    // The largest float below 2^31
+                    int32_t value = GenericRoundClamped(sample * 2147483648.0f, -2147483648.0f, 2147483520.0f);
+                    memcpy(target, &value, sizeof(value));
+                    break;
+                }
+                default:
+                    memcpy(target, &sample, sizeof(sample));
+                    break;
+            }
+        }
+    }
+}
+
+inline void GenericAddStereo(int channels, const float* stereo, float* interleaved, uint32_t frames)
+{
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        float* frame = interleaved + static_cast<size_t>(i) * channels;
+        if (channels == 1)
+        {
+            frame[0] += 0.5f * (stereo[i * 2] + stereo[i * 2 + 1]);
+        }
+        else
+        {
+            frame[0] += stereo[i * 2];
+            frame[1] += stereo[i * 2 + 1];
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include "LevelMeter.h"
+#include "SampleConvert.h"
+#include "BenchTimer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Per-block metering cost in the audio callback: the PCM16 to float copy
+// the meter reads plus peak, RMS and true peak, at 64-frame blocks
+static const size_t BLOCK_FRAMES = 64;
+static const double SAMPLE_RATE = 44100.0;
+static const int BLOCKS = 20000;
+
+// The meter may take at most this share of the block budget
+static const double BUDGET_FRACTION = 0.02;
+
+int main()
+{
+    double budgetUs = BLOCK_FRAMES / SAMPLE_RATE * 1e6;
+    std::printf("%zu-frame blocks, budget %.0f us per block\n", BLOCK_FRAMES, budgetUs);
+    std::printf("channels    p50 us    p99 us   share of budget\n");
+
+    bool withinBudget = true;
+    const int channelCounts[] = { 1, 2, 4, 8 };
+    for (int channels : channelCounts)
+    {
+        // A loud tone with some overs so every path, clipping included, runs
+        size_t samples = BLOCK_FRAMES * channels;
+        std::vector<int16_t> input(samples * 16);
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            double value = 1.05 * std::sin(0.031 * static_cast<double>(i / channels) + channels);
+            input[i] = static_cast<int16_t>(value > 1.0 ? 32767 : value < -1.0 ? -32768 : value * 32767.0);
+        }
+        std::vector<float> block(samples);
+
+        LevelMeter meter;
+        meter.Reset(channels, SAMPLE_RATE);
+
+        std::vector<double> times;
+        times.reserve(BLOCKS);
+        for (int i = 0; i < BLOCKS; i++)
+        {
+            const int16_t* source = input.data() + (i % 16) * samples;
+            double start = NowMicroseconds();
+            ConvertPcm16ToFloat(source, block.data(), samples);
+            meter.Process(block.data(), BLOCK_FRAMES);
+            times.push_back(NowMicroseconds() - start);
+        }
+
+        LevelReading reading;
+        meter.Read(reading);
+        double p50 = Percentile(times, 0.5);
+        double p99 = Percentile(times, 0.99);
+        std::printf("%8d  %8.2f  %8.2f   %6.2f%%%s\n", channels, p50, p99, 100.0 * p50 / budgetUs,
+                    reading.clipCount[0] > 0 ? "" : "  (no clips seen)");
+        withinBudget = withinBudget && p50 < BUDGET_FRACTION * budgetUs;
+    }
+
+    std::printf("median cost %s %.0f%% of the budget\n", withinBudget ? "within" : "OVER", 100.0 * BUDGET_FRACTION);
+    return withinBudget ? EXIT_SUCCESS : EXIT_FAILURE;
+}
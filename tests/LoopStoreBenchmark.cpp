@@ -0,0 +1,101 @@
+#include "LoopStore.h"
+#include "BenchTimer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Memory and undo/redo switch time of a long stereo loop across a deep
+// overdub history, against keeping a full copy of the loop per undo step
+static const int CHANNELS = 2;
+static const size_t SAMPLE_RATE = 44100;
+static const size_t LOOP_SECONDS = 180;
+static const size_t OVERDUB_SECONDS = 2;
+static const int LEVELS = 200;
+
+static double Checksum(const LoopStore& store)
+{
+    std::vector<float> buffer(SAMPLE_RATE * CHANNELS);
+    double sum = 0.0;
+    size_t length = store.GetLengthFrames();
+    for (size_t frame = 0; frame < length; frame += SAMPLE_RATE)
+    {
+        size_t count = length - frame < SAMPLE_RATE ? length - frame : SAMPLE_RATE;
+        store.Read(frame, buffer.data(), count);
+        for (size_t i = 0; i < count * CHANNELS; i++)
+        {
+            sum += buffer[i];
+        }
+    }
+    return sum;
+}
+
+int main()
+{
+    size_t loopFrames = LOOP_SECONDS * SAMPLE_RATE;
+    LoopStore store(CHANNELS);
+    store.SetMaxHistory(LEVELS);
+    store.Clear(loopFrames);
+
+    std::mt19937 random(1);
+    std::uniform_int_distribution<size_t> startFrame(0, loopFrames - 1);
+    std::vector<float> overdub(OVERDUB_SECONDS * SAMPLE_RATE * CHANNELS);
+    for (size_t i = 0; i < overdub.size(); i++)
+    {
+        overdub[i] = 0.1f * std::sin(static_cast<float>(i) * 0.01f);
+    }
+
+    std::vector<double> commitTimes;
+    for (int level = 0; level < LEVELS; level++)
+    {
+        double start = NowMicroseconds();
+        store.BeginOverdub();
+        store.WriteOverdub(startFrame(random), overdub.data(), overdub.size() / CHANNELS);
+        store.CommitOverdub();
+        commitTimes.push_back(NowMicroseconds() - start);
+    }
+    double finalChecksum = Checksum(store);
+
+    size_t loopBytes = loopFrames * CHANNELS * sizeof(float);
+    size_t usage = store.GetMemoryUsage();
+    size_t fullCopies = loopBytes * (LEVELS + 1);
+    std::printf("loop %zu s stereo, %d overdubs of %zu s, %zu-frame blocks\n", LOOP_SECONDS, LEVELS, OVERDUB_SECONDS,
+                store.GetBlockFrames());
+    std::printf("memory: %.1f MB with shared blocks, %.1f MB as full copies (%.1f%%)\n", usage / 1048576.0,
+                fullCopies / 1048576.0, 100.0 * usage / fullCopies);
+    std::printf("memory per undo level: %.2f MB for %.2f MB of overdubbed audio\n", usage / 1048576.0 / LEVELS,
+                overdub.size() * sizeof(float) / 1048576.0);
+    std::printf("overdub commit: p50 %.0f us, p99 %.0f us\n", Percentile(commitTimes, 0.5), Percentile(commitTimes, 0.99));
+
+    // Walk the whole history down and back up
+    std::vector<double> undoTimes;
+    std::vector<double> redoTimes;
+    for (int level = 0; level < LEVELS; level++)
+    {
+        double start = NowMicroseconds();
+        bool undone = store.Undo();
+        undoTimes.push_back(NowMicroseconds() - start);
+        if (!undone)
+        {
+            std::printf("undo stopped at level %d\n", level);
+            return EXIT_FAILURE;
+        }
+    }
+    bool silent = Checksum(store) == 0.0;
+    for (int level = 0; level < LEVELS; level++)
+    {
+        double start = NowMicroseconds();
+        store.Redo();
+        redoTimes.push_back(NowMicroseconds() - start);
+    }
+    bool restored = Checksum(store) == finalChecksum;
+
+    std::printf("undo: p50 %.2f us, p99 %.2f us, max %.2f us\n", Percentile(undoTimes, 0.5), Percentile(undoTimes, 0.99),
+                Percentile(undoTimes, 1.0));
+    std::printf("redo: p50 %.2f us, p99 %.2f us, max %.2f us\n", Percentile(redoTimes, 0.5), Percentile(redoTimes, 0.99),
+                Percentile(redoTimes, 1.0));
+    std::printf("content after full undo %s, after full redo %s\n", silent ? "silent" : "NOT SILENT",
+                restored ? "restored" : "NOT RESTORED");
+    return silent && restored ? EXIT_SUCCESS : EXIT_FAILURE;
+}
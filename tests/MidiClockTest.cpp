@@ -0,0 +1,231 @@
+#include "MidiClock.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+
+// Drives the PLL offline with synthetic clock streams: ideal tick times plus
+// arrival jitter, quantized to whole milliseconds like WinMM timestamps
+
+static double TickPeriodMs(double bpm)
+{
+    return 60000.0 / (bpm * MIDI_CLOCK_PPQN);
+}
+
+struct ClockStream {
+    double tempoBpm;
+    double endTempoBpm;         // Tempo ramps linearly to this over the stream
+    double driftPpm;            // Sender crystal error
+    double jitterMs;            // Uniform arrival delay of up to this much
+    bool quantize;
+};
+
+struct StreamResult {
+    MidiClockStats stats;
+    double maxPositionError;    // Ticks, over the second half of the stream
+    double finalTempoError;     // BPM
+};
+
+static StreamResult RunStream(const ClockStream& stream, int ticks, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> delay(0.0, stream.jitterMs);
+
+    MidiClockPll pll;
+    pll.Reset(120.0);
+    pll.OnStart();
+
+    StreamResult result = {};
+    double idealMs = 100.0;
+    double tempoBpm = stream.tempoBpm;
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        double arrivalMs = idealMs + delay(random);
+        if (stream.quantize)
+        {
+            arrivalMs = std::floor(arrivalMs);
+        }
+        pll.OnTick(arrivalMs);
+
+        // Position halfway to the next ideal tick, against the true position
+        tempoBpm = stream.tempoBpm + (stream.endTempoBpm - stream.tempoBpm) * tick / ticks;
+        double periodMs = TickPeriodMs(tempoBpm) * (1.0 + stream.driftPpm * 1e-6);
+        double probeMs = idealMs + 0.5 * periodMs + 0.5 * stream.jitterMs;
+        if (tick >= ticks / 2)
+        {
+            double error = std::fabs(pll.GetPositionTicks(probeMs) - (tick + 0.5));
+            result.maxPositionError = error > result.maxPositionError ? error : result.maxPositionError;
+        }
+        idealMs += periodMs;
+    }
+
+    result.stats = pll.GetStats();
+    double trueBpm = tempoBpm / (1.0 + stream.driftPpm * 1e-6);
+    result.finalTempoError = std::fabs(result.stats.tempoBpm - trueBpm);
+    return result;
+}
+
+static void TestSteadyJitteredClock()
+{
+    // 60 s at 120 BPM with up to 2 ms of arrival jitter
+    for (uint32_t seed = 1; seed <= 4; seed++)
+    {
+        ClockStream stream = { 120.0, 120.0, 0.0, 2.0, true };
+        StreamResult result = RunStream(stream, 60 * 48, seed);
+        CHECK(result.stats.locked);
+        CHECK(result.stats.running);
+        CHECK(result.stats.ticks == 60 * 48);
+        CHECK(result.finalTempoError < 0.1);
+        CHECK(result.stats.tempoStabilityBpm < 0.25);
+        CHECK(result.stats.jitterMs > 0.2 && result.stats.jitterMs < 1.5);
+        CHECK(result.maxPositionError < 0.1);
+    }
+}
+
+static void TestDriftingClock()
+{
+    // A sender 300 ppm fast at 133 BPM: the PLL must follow the sender, not
+    // the nominal tempo, without the position drifting off over time
+    ClockStream stream = { 133.0, 133.0, -300.0, 1.0, true };
+    StreamResult result = RunStream(stream, 120 * 53, 7);
+    CHECK(result.stats.locked);
+    CHECK(result.finalTempoError < 0.05);
+    CHECK(result.maxPositionError < 0.1);
+}
+
+static void TestTempoRamp()
+{
+    // 100 to 140 BPM over about two minutes
+    ClockStream stream = { 100.0, 140.0, 0.0, 1.0, true };
+    StreamResult result = RunStream(stream, 5000, 3);
+    CHECK(result.stats.locked);
+    CHECK(result.finalTempoError < 0.2);
+    CHECK(result.maxPositionError < 0.15);
+}
+
+static void TestTempoJumpAndGap()
+{
+    MidiClockPll pll;
+    pll.Reset(120.0);
+    pll.OnStart();
+
+    double timeMs = 0.0;
+    for (int tick = 0; tick < 480; tick++)
+    {
+        pll.OnTick(timeMs);
+        timeMs += TickPeriodMs(120.0);
+    }
+    CHECK(std::fabs(pll.GetTempoBpm() - 120.0) < 0.01);
+
+    // An abrupt change to 90 BPM reacquires instead of slewing for seconds
+    for (int tick = 0; tick < 2 * MIDI_CLOCK_PPQN; tick++)
+    {
+        timeMs += TickPeriodMs(90.0);
+        pll.OnTick(timeMs);
+    }
+    CHECK(std::fabs(pll.GetTempoBpm() - 90.0) < 0.5);
+
+    // Ticks lost for half a second; the count stays in step with the ticks received
+    timeMs += 500.0;
+    for (int tick = 0; tick < 4 * MIDI_CLOCK_PPQN; tick++)
+    {
+        timeMs += TickPeriodMs(90.0);
+        pll.OnTick(timeMs);
+    }
+    CHECK(std::fabs(pll.GetTempoBpm() - 90.0) < 0.1);
+    CHECK(pll.GetStats().ticks == 480 + 6 * MIDI_CLOCK_PPQN);
+    CHECK(std::fabs(pll.GetPositionTicks(timeMs) - (pll.GetStats().ticks - 1)) < 0.05);
+}
+
+static void TestTransport()
+{
+    MidiClockPll pll;
+    pll.Reset(120.0);
+
+    // Ticks while stopped run the PLL but not the position
+    double timeMs = 0.0;
+    for (int tick = 0; tick < 48; tick++)
+    {
+        pll.OnTick(timeMs);
+        timeMs += TickPeriodMs(120.0);
+    }
+    CHECK(pll.GetStats().ticks == 0);
+    CHECK(pll.GetPositionTicks(timeMs) == 0.0);
+
+    // Song position 4 sixteenths is 24 ticks, one beat
+    pll.OnSongPosition(4);
+    pll.OnContinue();
+    pll.OnTick(timeMs);
+    CHECK(pll.GetStats().ticks == 25);
+    CHECK(std::fabs(pll.GetPositionTicks(timeMs + 0.5 * TickPeriodMs(120.0)) - 24.5) < 0.01);
+
+    pll.OnStop();
+    timeMs += TickPeriodMs(120.0);
+    pll.OnTick(timeMs);
+    CHECK(pll.GetStats().ticks == 25);
+    CHECK(!pll.GetStats().running);
+}
+
+static void TestPublishedCopy()
+{
+    // A writer publishing every tick and readers that check each copy is
+    // from a single tick: the tick just counted is always one past the
+    // tick the phase refers to
+    PublishedMidiClock published;
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+    std::atomic<int> reads(0);
+
+    std::thread readers[2];
+    for (std::thread& reader : readers)
+    {
+        reader = std::thread([&]
+        {
+            uint64_t lastTicks = 0;
+            while (!done.load())
+            {
+                MidiClockPhase phase = published.GetPhase();
+                MidiClockStats stats = published.GetStats();
+                if ((phase.positionTicks > 0 && phase.phasePosition + 1 != phase.positionTicks) ||
+                    stats.ticks < lastTicks)
+                {
+                    torn++;
+                }
+                lastTicks = stats.ticks;
+                reads++;
+            }
+        });
+    }
+
+    MidiClockPll pll;
+    pll.OnStart();
+    double timeMs = 0.0;
+    for (int tick = 0; tick < 200000; tick++)
+    {
+        pll.OnTick(timeMs);
+        published.Publish(pll);
+        timeMs += TickPeriodMs(120.0);
+    }
+    done = true;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+
+    CHECK(torn == 0);
+    CHECK(reads > 0);
+    CHECK(published.GetStats().ticks == 200000);
+    CHECK(std::fabs(published.GetStats().tempoBpm - 120.0) < 0.01);
+}
+
+int main()
+{
+    TestSteadyJitteredClock();
+    TestDriftingClock();
+    TestTempoRamp();
+    TestTempoJumpAndGap();
+    TestTransport();
+    TestPublishedCopy();
+    return CheckResult();
+}
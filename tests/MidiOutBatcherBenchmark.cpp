@@ -0,0 +1,121 @@
+#include "MidiOutBatcher.h"
+#include "BenchTimer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Driver calls, bytes and latency for a dense MPE controller flood with
+// each batching option, the most messages a saturating sender gets through,
+// and a check that thinning resends values after a controller reset
+static const int CHANNELS = 16;
+static const int FLOOD_STEPS = 8000;                // 2 s at one step per 250 us
+static const int STEP_MICROS = 250;
+
+static uint32_t ShortMessage(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    return status | (data1 << 8) | (data2 << 16);
+}
+
+static void RunFlood(const MidiBatchOptions& options, const char* label)
+{
+    size_t bytes = 0;
+    size_t calls = 0;
+    MidiOutBatcher batcher;
+    batcher.Start([&](const uint8_t*, size_t size) {
+        bytes += size;
+        calls++;
+        return true;
+    }, options);
+
+    // Pitch bend, CC74 and pressure on every channel each step, a note
+    // every 50 ms
+    uint64_t offered = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int step = 0; step < FLOOD_STEPS; step++)
+    {
+        for (int channel = 0; channel < CHANNELS; channel++)
+        {
+            uint8_t value = static_cast<uint8_t>((step * 3 + channel) & 0x7F);
+            batcher.Send(ShortMessage(0xE0 | channel, value, 0x40));
+            batcher.Send(ShortMessage(0xB0 | channel, 74, value));
+            batcher.Send(ShortMessage(0xD0 | channel, (step / 4) & 0x7F, 0));
+            offered += 3;
+            if (step % 200 == 0)
+            {
+                batcher.Send(ShortMessage(0x90 | channel, 60, 100));
+                offered++;
+            }
+        }
+        std::this_thread::sleep_until(start + std::chrono::microseconds(STEP_MICROS * (step + 1)));
+    }
+    batcher.Stop();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    MidiBatchStats stats = batcher.GetStats();
+    std::printf("%-24s %8.0f %8llu %8llu %8llu %7.0f %9zu %8.3f %8.3f\n", label, offered / seconds,
+                static_cast<unsigned long long>(stats.messagesSent),
+                static_cast<unsigned long long>(stats.messagesThinned),
+                static_cast<unsigned long long>(stats.queueOverflows), calls / seconds, bytes,
+                stats.averageLatencyMs, stats.maxLatencyMs);
+}
+
+static void RunSaturated()
+{
+    size_t calls = 0;
+    MidiOutBatcher batcher;
+    MidiBatchOptions options = { 1000, true, false };
+    batcher.Start([&](const uint8_t*, size_t) {
+        calls++;
+        return true;
+    }, options);
+
+    uint64_t accepted = 0;
+    double start = NowMicroseconds();
+    while (NowMicroseconds() - start < 1e6)
+    {
+        accepted += batcher.Send(ShortMessage(0xB0, 7, 0x40)) ? 1 : 0;
+    }
+    batcher.Stop();
+
+    MidiBatchStats stats = batcher.GetStats();
+    std::printf("\nsaturating sender: %llu messages/s accepted, %llu sent, %llu spilled, %llu overflowed, %zu submits\n",
+                static_cast<unsigned long long>(accepted), static_cast<unsigned long long>(stats.messagesSent),
+                static_cast<unsigned long long>(stats.messagesSpilled), static_cast<unsigned long long>(stats.queueOverflows),
+                calls);
+}
+
+// Sends the same controller value either side of a reset, one tick apart,
+// and returns how many messages reached the submitter
+static uint64_t SentAcrossReset(uint32_t reset)
+{
+    MidiOutBatcher batcher;
+    MidiBatchOptions options = { 1000, false, true };
+    batcher.Start([](const uint8_t*, size_t) { return true; }, options);
+    batcher.Send(ShortMessage(0xB3, 74, 10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    batcher.Send(reset);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    batcher.Send(ShortMessage(0xB3, 74, 10));
+    batcher.Stop();
+    return batcher.GetStats().messagesSent;
+}
+
+int main()
+{
+    std::printf("%d channels, 3 controllers each per %d us step\n", CHANNELS, STEP_MICROS);
+    std::printf("options                   offer/s     sent  thinned overflow submit/s     bytes  avg ms   max ms\n");
+    RunFlood(MidiBatchOptions { 1000, false, false }, "batched");
+    RunFlood(MidiBatchOptions { 1000, true, false }, "running status");
+    RunFlood(MidiBatchOptions { 1000, true, true }, "running status, thinned");
+    RunSaturated();
+
+    // Reset all controllers, program change and system reset must each
+    // let the repeated value through
+    bool resends = SentAcrossReset(ShortMessage(0xB3, 121, 0)) == 3 &&
+                   SentAcrossReset(ShortMessage(0xC3, 5, 0)) == 3 &&
+                   SentAcrossReset(0xFF) == 3;
+    std::printf("\ncontroller values %s\n", resends ? "resent after resets" : "THINNED ACROSS A RESET");
+    return resends ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,147 @@
+#include "MidiOutBatcher.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// A submitter that holds every batch back while the device is "busy", so
+// the batcher's queues fill. Messages that go past the queue must still
+// come out in order, and a message the caller has to send itself must not
+// leave thinning believing an older controller value is current.
+
+static uint32_t ShortMessage(uint8_t status, uint8_t data1, uint8_t data2)
+{
+    return status | (data1 << 8) | (data2 << 16);
+}
+
+struct StallingDevice {
+    std::atomic<bool> busy;
+    std::vector<uint8_t> bytes;     // Sender thread only, until Stop
+
+    StallingDevice() : busy(false) {}
+
+    MidiOutBatcher::Submitter Submitter()
+    {
+        return [this](const uint8_t* data, size_t size) {
+            if (busy)
+            {
+                return false;
+            }
+            bytes.insert(bytes.end(), data, data + size);
+            return true;
+        };
+    }
+};
+
+static bool WaitForSent(const MidiOutBatcher& batcher, uint64_t sent)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (batcher.GetStats().messagesSent < sent)
+    {
+        if (std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Note on i, distinct for the first 16384
+static uint32_t Note(uint32_t i)
+{
+    return ShortMessage(0x90, static_cast<uint8_t>(i & 0x7F), static_cast<uint8_t>((i >> 7) & 0x7F));
+}
+
+static void TestOrderWhileStalled()
+{
+    // The first queue's worth is left time to move into the stalled batch,
+    // so the rest fills the queue again and spills
+    const uint32_t FIRST = 4096;
+    const uint32_t STALLED = FIRST + 8000;
+    const uint32_t AFTER = 300;
+    StallingDevice device;
+    MidiOutBatcher batcher;
+    MidiBatchOptions options = { 1000, false, false };
+    device.busy = true;
+    CHECK(batcher.Start(device.Submitter(), options));
+
+    bool accepted = true;
+    for (uint32_t i = 0; i < STALLED; i++)
+    {
+        if (i == FIRST)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        accepted = batcher.Send(Note(i)) && accepted;
+    }
+    CHECK(accepted);
+    CHECK(batcher.GetStats().messagesSpilled > 0);
+
+    // Once the spill drains, sends go back through the main queue
+    device.busy = false;
+    CHECK(WaitForSent(batcher, STALLED));
+    for (uint32_t i = STALLED; i < STALLED + AFTER; i++)
+    {
+        accepted = batcher.Send(Note(i)) && accepted;
+    }
+    CHECK(accepted);
+    CHECK(WaitForSent(batcher, STALLED + AFTER));
+    batcher.Stop();
+
+    MidiBatchStats stats = batcher.GetStats();
+    CHECK(stats.queueOverflows == 0);
+    CHECK(device.bytes.size() == 3 * static_cast<size_t>(STALLED + AFTER));
+    bool ordered = device.bytes.size() == 3 * static_cast<size_t>(STALLED + AFTER);
+    for (uint32_t i = 0; ordered && i < STALLED + AFTER; i++)
+    {
+        uint32_t message = device.bytes[3 * i] | (device.bytes[3 * i + 1] << 8) | (device.bytes[3 * i + 2] << 16);
+        ordered = message == Note(i);
+    }
+    CHECK(ordered);
+    std::printf("%u messages in order, %llu spilled\n", STALLED + AFTER, static_cast<unsigned long long>(stats.messagesSpilled));
+}
+
+static void TestThinningAfterDirectSend()
+{
+    StallingDevice device;
+    MidiOutBatcher batcher;
+    MidiBatchOptions options = { 1000, false, true };
+    CHECK(batcher.Start(device.Submitter(), options));
+
+    // The receiver has cutoff 10
+    CHECK(batcher.Send(ShortMessage(0xB0, 74, 10)));
+    CHECK(WaitForSent(batcher, 1));
+
+    // Fill everything while stalled; then cutoff 20 goes out directly
+    device.busy = true;
+    uint32_t queued = 0;
+    while (queued < 20000 && batcher.Send(Note(queued)))
+    {
+        queued++;
+    }
+    CHECK(queued < 20000);
+    CHECK(!batcher.Send(ShortMessage(0xB0, 74, 20)));
+
+    // Cutoff 10 again differs from what the receiver now has
+    device.busy = false;
+    CHECK(WaitForSent(batcher, 1 + queued));
+    CHECK(batcher.Send(ShortMessage(0xB0, 74, 10)));
+    CHECK(WaitForSent(batcher, 2 + queued));
+    batcher.Stop();
+
+    MidiBatchStats stats = batcher.GetStats();
+    CHECK(stats.queueOverflows == 2);
+    CHECK(stats.messagesThinned == 0);
+    size_t size = device.bytes.size();
+    CHECK(size >= 3 && device.bytes[size - 3] == 0xB0 && device.bytes[size - 2] == 74 && device.bytes[size - 1] == 10);
+}
+
+int main()
+{
+    TestOrderWhileStalled();
+    TestThinningAfterDirectSend();
+    return CheckResult();
+}
@@ -0,0 +1,126 @@
+#include "OfflineRenderer.h"
+#include "BenchTimer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Bounce of a synthetic session at 1, 2, 4 ... threads up to the hardware
+// count: loops of different lengths, which split across time blocks, and
+// two stateful instruments, which each render in order on one thread.
+static const char* const BOUNCE_PATH = "OfflineRendererBenchmark.wav";
+static const uint32_t SAMPLE_RATE = 48000;
+static const uint64_t SESSION_SECONDS = 120;
+static const int LOOP_TRACKS = 24;
+static const int INSTRUMENT_TRACKS = 2;
+
+// A detuned saw through a one-pole filter; the filter carries state from
+// block to block, so it cannot be split in time
+class FilteredSawSource : public RenderSource {
+public:
+    explicit FilteredSawSource(double frequency)
+        : m_increment(frequency / SAMPLE_RATE)
+        , m_phase(0.0)
+        , m_state(0.0f)
+    {
+    }
+
+    bool IsTimeParallel() const override { return false; }
+
+    void Render(uint64_t startFrame, size_t frames, float* stereoOut) override
+    {
+        (void)startFrame;
+        for (size_t i = 0; i < frames; i++)
+        {
+            m_phase += m_increment;
+            m_phase -= std::floor(m_phase);
+            float saw = static_cast<float>(2.0 * m_phase - 1.0);
+            m_state += 0.05f * (saw - m_state);
+            stereoOut[2 * i] += 0.1f * m_state;
+            stereoOut[2 * i + 1] += 0.1f * m_state;
+        }
+    }
+
+private:
+    double m_increment;
+    double m_phase;
+    float m_state;
+};
+
+int main()
+{
+    // Loops from 1.3 to about 7 seconds, spread across the stereo field
+    std::vector<std::unique_ptr<LoopStore>> loops;
+    OfflineRenderer renderer;
+    for (int t = 0; t < LOOP_TRACKS; t++)
+    {
+        int channels = t % 3 == 0 ? 1 : 2;
+        size_t length = SAMPLE_RATE * 13 / 10 + static_cast<size_t>(t) * 12007;
+        std::vector<float> samples(length * channels);
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            samples[i] = 0.2f * static_cast<float>(std::sin(0.0021 * (t + 1) * static_cast<double>(i / channels)));
+        }
+        loops.emplace_back(new LoopStore(channels));
+        loops.back()->Clear(length);
+        loops.back()->BeginOverdub();
+        loops.back()->WriteOverdub(0, samples.data(), length);
+        loops.back()->CommitOverdub();
+        float pan = static_cast<float>(t % 5) / 2.0f - 1.0f;
+        renderer.AddSource(std::make_shared<LoopRenderSource>(*loops.back(), static_cast<uint64_t>(t) * 4800, 0.5f, pan));
+    }
+    for (int t = 0; t < INSTRUMENT_TRACKS; t++)
+    {
+        renderer.AddSource(std::make_shared<FilteredSawSource>(55.0 * (t + 1) + 0.3));
+    }
+
+    unsigned hardware = std::thread::hardware_concurrency();
+    hardware = hardware > 0 ? hardware : 1;
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < hardware; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardware);
+
+    std::printf("%llu s session at %u Hz, %d loop and %d instrument tracks, 32-bit float, %u hardware threads\n",
+                static_cast<unsigned long long>(SESSION_SECONDS), SAMPLE_RATE, LOOP_TRACKS, INSTRUMENT_TRACKS, hardware);
+    std::printf("threads   render s   x realtime   speedup\n");
+
+    bool rendered = true;
+    double singleSeconds = 0.0;
+    for (unsigned threads : threadCounts)
+    {
+        RenderSettings settings;
+        settings.path = BOUNCE_PATH;
+        settings.sampleRate = SAMPLE_RATE;
+        settings.lengthFrames = SESSION_SECONDS * SAMPLE_RATE;
+        settings.format = WaveSampleFormat::Float32;
+        settings.blockFrames = 16384;
+        settings.threads = threads;
+
+        // Best of three, so a stray stall does not decide the row
+        RenderResult best = {};
+        for (int run = 0; run < 3; run++)
+        {
+            RenderResult result = renderer.Render(settings);
+            rendered = rendered && result.success && result.framesRendered == settings.lengthFrames;
+            if (run == 0 || result.renderSeconds < best.renderSeconds)
+            {
+                best = result;
+            }
+        }
+        if (threads == 1)
+        {
+            singleSeconds = best.renderSeconds;
+        }
+        std::printf("%7u  %9.3f  %11.1f  %8.2fx\n", best.threads, best.renderSeconds, best.realtimeFactor,
+                    singleSeconds / best.renderSeconds);
+    }
+    std::remove(BOUNCE_PATH);
+
+    std::printf("\nevery render %s\n", rendered ? "complete" : "FAILED OR SHORT");
+    return rendered ? EXIT_SUCCESS : EXIT_FAILURE;
+}
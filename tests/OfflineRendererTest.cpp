@@ -0,0 +1,185 @@
+#include "OfflineRenderer.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Bounces loops to a float WAV file and compares the file with the source
+
+static const char* const BOUNCE_PATH = "OfflineRendererTest.wav";
+static const uint32_t SAMPLE_RATE = 44100;
+
+// Interleaved stereo samples from the data chunk of a float WAV file
+static std::vector<float> ReadBounce(const char* path)
+{
+    std::vector<float> samples;
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file)
+    {
+        return samples;
+    }
+
+    char riff[12];
+    if (std::fread(riff, 1, sizeof(riff), file) == sizeof(riff))
+    {
+        char id[4];
+        uint32_t size;
+        while (std::fread(id, 1, 4, file) == 4 && std::fread(&size, 4, 1, file) == 1)
+        {
+            if (std::memcmp(id, "data", 4) == 0)
+            {
+                samples.resize(size / sizeof(float));
+                samples.resize(std::fread(samples.data(), sizeof(float), samples.size(), file));
+                break;
+            }
+            std::fseek(file, size + (size & 1), SEEK_CUR);
+        }
+    }
+    std::fclose(file);
+    return samples;
+}
+
+static RenderSettings MakeSettings(uint64_t lengthFrames, size_t blockFrames, unsigned threads)
+{
+    RenderSettings settings;
+    settings.path = BOUNCE_PATH;
+    settings.sampleRate = SAMPLE_RATE;
+    settings.lengthFrames = lengthFrames;
+    settings.format = WaveSampleFormat::Float32;
+    settings.blockFrames = blockFrames;
+    settings.threads = threads;
+    return settings;
+}
+
+static void FillLoop(LoopStore& loop, const std::vector<float>& samples)
+{
+    loop.BeginOverdub();
+    loop.WriteOverdub(0, samples.data(), samples.size() / loop.GetChannels());
+    loop.CommitOverdub();
+}
+
+static void TestStereoConstant()
+{
+    // A stereo loop of constant 0.25 at unity gain bounces as 0.25
+    LoopStore loop(2, 512);
+    loop.Clear(3000);
+    FillLoop(loop, std::vector<float>(3000 * 2, 0.25f));
+
+    OfflineRenderer renderer;
+    renderer.AddSource(std::make_shared<LoopRenderSource>(loop, 0, 1.0f, 0.0f));
+    RenderResult result = renderer.Render(MakeSettings(10000, 1024, 2));
+    CHECK(result.success);
+    CHECK(result.framesRendered == 10000);
+
+    std::vector<float> bounce = ReadBounce(BOUNCE_PATH);
+    CHECK(bounce.size() == 10000 * 2);
+    size_t wrong = 0;
+    for (float sample : bounce)
+    {
+        wrong += sample != 0.25f;
+    }
+    CHECK(wrong == 0);
+}
+
+static void TestMonoRampWithOffset()
+{
+    // A mono ramp entering 700 frames in, panned centre, wrapping several
+    // times at block boundaries that do not line up with the loop
+    const size_t loopFrames = 1500;
+    const uint64_t entry = 700;
+    LoopStore loop(1, 256);
+    loop.Clear(loopFrames);
+    std::vector<float> ramp(loopFrames);
+    for (size_t i = 0; i < loopFrames; i++)
+    {
+        ramp[i] = static_cast<float>(i) / loopFrames - 0.5f;
+    }
+    FillLoop(loop, ramp);
+
+    OfflineRenderer renderer;
+    renderer.AddSource(std::make_shared<LoopRenderSource>(loop, entry, 0.5f, 0.0f));
+    RenderResult result = renderer.Render(MakeSettings(9001, 333, 3));
+    CHECK(result.success);
+
+    std::vector<float> bounce = ReadBounce(BOUNCE_PATH);
+    CHECK(bounce.size() == 9001 * 2);
+    const float centre = 0.5f * std::cos(0.785398163f);
+    double maxError = 0.0;
+    for (size_t frame = 0; frame < bounce.size() / 2; frame++)
+    {
+        float expected = frame < entry ? 0.0f : ramp[(frame - entry) % loopFrames] * centre;
+        for (int side = 0; side < 2; side++)
+        {
+            double error = std::fabs(bounce[frame * 2 + side] - expected);
+            maxError = error > maxError ? error : maxError;
+        }
+    }
+    CHECK(maxError < 1e-6);
+}
+
+// Renders a counter that only comes out right if blocks arrive in order
+class SequentialSource : public RenderSource {
+public:
+    SequentialSource() : m_next(0), m_outOfOrder(0) {}
+
+    bool IsTimeParallel() const override { return false; }
+
+    void Render(uint64_t startFrame, size_t frames, float* stereoOut) override
+    {
+        if (startFrame != m_next)
+        {
+            m_outOfOrder++;
+        }
+        for (size_t i = 0; i < frames; i++)
+        {
+            stereoOut[2 * i] += static_cast<float>((startFrame + i) % 1000) * 0.001f;
+        }
+        m_next = startFrame + frames;
+    }
+
+    uint64_t m_next;
+    int m_outOfOrder;
+};
+
+static void TestMixedSources()
+{
+    // Several loops and a stateful source mix into the same blocks
+    LoopStore first(2, 128);
+    first.Clear(1000);
+    FillLoop(first, std::vector<float>(1000 * 2, 0.125f));
+    LoopStore second(1, 128);
+    second.Clear(777);
+    FillLoop(second, std::vector<float>(777, 0.5f));
+
+    auto sequential = std::make_shared<SequentialSource>();
+    OfflineRenderer renderer;
+    renderer.AddSource(std::make_shared<LoopRenderSource>(first, 0, 1.0f, 0.0f));
+    renderer.AddSource(std::make_shared<LoopRenderSource>(second, 100, 1.0f, -1.0f));
+    renderer.AddSource(sequential);
+    RenderResult result = renderer.Render(MakeSettings(20000, 500, 4));
+    CHECK(result.success);
+    CHECK(sequential->m_outOfOrder == 0);
+    CHECK(sequential->m_next == 20000);
+
+    std::vector<float> bounce = ReadBounce(BOUNCE_PATH);
+    CHECK(bounce.size() == 20000 * 2);
+    size_t wrong = 0;
+    for (size_t frame = 0; frame < bounce.size() / 2; frame++)
+    {
+        // The second loop is panned hard left: all of it on the left side
+        float left = 0.125f + (frame >= 100 ? 0.5f : 0.0f) + static_cast<float>(frame % 1000) * 0.001f;
+        float right = 0.125f;
+        wrong += std::fabs(bounce[frame * 2] - left) > 1e-6f || std::fabs(bounce[frame * 2 + 1] - right) > 1e-6f;
+    }
+    CHECK(wrong == 0);
+}
+
+int main()
+{
+    TestStereoConstant();
+    TestMonoRampWithOffset();
+    TestMixedSources();
+    std::remove(BOUNCE_PATH);
+    return CheckResult();
+}
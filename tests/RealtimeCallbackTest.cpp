@@ -0,0 +1,277 @@
+#include "RealtimeGuard.h"
+#include "AudioRecorder.h"
+#include "AudioTap.h"
+#include "DropoutConcealer.h"
+#include "FramePipeline.h"
+#include "LevelMeter.h"
+#include "MidiClock.h"
+#include "MidiOutBatcher.h"
+#include "SampleTimeline.h"
+#include "Sampler.h"
+#include "TimeStretcher.h"
+#include "WaveFileWriter.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+// Runs the engine code the device callbacks call inside a RealtimeScope,
+// built with MUSICAPP_REALTIME_CHECKS, and fails on any allocation, lock
+// wait or file write it makes. Everything the engine sets up outside the
+// callbacks is set up here outside the scope too.
+
+static const uint32_t SAMPLE_RATE = 44100;
+static const uint32_t BLOCK_FRAMES = 256;
+static const int BLOCKS = 200;
+
+static const char* const SAMPLE_PATH = "RealtimeCallbackTest.wav";
+static const char* const RECORD_PATH = "RealtimeCallbackTestRecord.wav";
+
+// Runs work in a real-time scope and fails with the report if it blocked
+static void CheckRealtime(const char* name, const std::function<void()>& work)
+{
+    uint64_t before = RealtimeGuard::GetViolationCount();
+    {
+        RealtimeScope realtime;
+        work();
+    }
+    uint64_t violations = RealtimeGuard::GetViolationCount() - before;
+    if (violations > 0)
+    {
+        std::fprintf(stderr, "%s: %llu real-time violations\n", name, static_cast<unsigned long long>(violations));
+        RealtimeGuard::PrintReport(stderr);
+    }
+    CHECK(violations == 0);
+}
+
+// The checker itself must see an allocation, or a clean run means nothing
+static void TestAllocationIsCaught()
+{
+    uint64_t before = RealtimeGuard::GetViolationCount();
+    {
+        RealtimeScope realtime;
+        std::vector<float> allocated(BLOCK_FRAMES);
+        allocated[0] = 1.0f;
+    }
+    CHECK(RealtimeGuard::GetViolationCount() - before == 2);
+
+    // Drain the two reports so a later failure prints only its own
+    RealtimeViolation violation;
+    bool sawAllocation = false;
+    while (RealtimeGuard::ReadViolation(violation))
+    {
+        sawAllocation = sawAllocation || violation.kind == RealtimeViolationKind::Allocation;
+    }
+    CHECK(sawAllocation);
+}
+
+static void TestFramePipelines()
+{
+    const DeviceSampleFormat formats[] = { DeviceSampleFormat::Pcm16, DeviceSampleFormat::Pcm24,
+                                           DeviceSampleFormat::Pcm32, DeviceSampleFormat::Float32 };
+    std::vector<uint8_t> device(BLOCK_FRAMES * PIPELINE_MAX_CHANNELS * 4);
+    std::vector<float> frames(BLOCK_FRAMES * PIPELINE_MAX_CHANNELS);
+    std::vector<float> stereo(BLOCK_FRAMES * 2, 0.25f);
+    for (DeviceSampleFormat format : formats)
+    {
+        for (int channels = 1; channels <= PIPELINE_MAX_CHANNELS; channels++)
+        {
+            const FramePipeline* pipeline = GetFramePipeline(format, channels);
+            CHECK(pipeline != nullptr);
+            CheckRealtime("FramePipeline", [&] {
+                pipeline->decode(device.data(), frames.data(), BLOCK_FRAMES);
+                pipeline->addStereo(stereo.data(), frames.data(), BLOCK_FRAMES);
+                pipeline->encode(frames.data(), device.data(), BLOCK_FRAMES);
+            });
+        }
+    }
+}
+
+static void TestMeterConcealerAndTap()
+{
+    std::vector<float> block(BLOCK_FRAMES * 2);
+    LevelMeter meter;
+    meter.Reset(2, SAMPLE_RATE);
+
+    DropoutConcealer concealer;
+    concealer.Reset(2, SAMPLE_RATE, 2048);
+    std::vector<float> fill(concealer.GetMaxFillFrames() * 2);
+    CaptureGapDetector gapDetector;
+    gapDetector.Reset(BLOCK_FRAMES);
+
+    AudioTap tap;
+    bool tapOpen = tap.Start(L"RealtimeCallbackTestTap");
+    CHECK(tapOpen);
+
+    AudioRecorder recorder;
+    CHECK(recorder.Start(RECORD_PATH, 2, SAMPLE_RATE, WaveSampleFormat::Pcm16));
+
+    SampleTimeline timeline;
+    timeline.Reset(SAMPLE_RATE);
+
+    CheckRealtime("audio path", [&] {
+        double hostTimeMs = 0.0;
+        for (int b = 0; b < BLOCKS; b++)
+        {
+            for (uint32_t i = 0; i < BLOCK_FRAMES; i++)
+            {
+                float sample = 0.5f * std::sin(0.05f * static_cast<float>(b * BLOCK_FRAMES + i));
+                block[2 * i] = sample;
+                block[2 * i + 1] = sample;
+            }
+            hostTimeMs += 1000.0 * BLOCK_FRAMES / SAMPLE_RATE;
+            uint64_t streamFrame = timeline.Advance(SampleTimeline::CAPTURE_STREAM, BLOCK_FRAMES, hostTimeMs);
+            gapDetector.Update(0.0, 1.0);
+            meter.Process(block.data(), BLOCK_FRAMES);
+
+            // A gap every so often, filled and then blended out of
+            if (b % 50 == 49)
+            {
+                DropoutAction action;
+                concealer.Conceal(BLOCK_FRAMES / 2, fill.data(), action);
+            }
+            concealer.Process(block.data(), BLOCK_FRAMES);
+
+            recorder.Write(block.data(), BLOCK_FRAMES);
+            if (tapOpen)
+            {
+                tap.Write(block.data(), BLOCK_FRAMES, 2, SAMPLE_RATE, streamFrame, hostTimeMs);
+            }
+        }
+    });
+
+    recorder.Stop();
+    tap.Stop();
+    std::remove(RECORD_PATH);
+}
+
+static void TestSampler()
+{
+    // A one-second tone, longer than the preloaded attack
+    {
+        WaveFileWriter writer;
+        CHECK(writer.Open(SAMPLE_PATH, 1, SAMPLE_RATE, WaveSampleFormat::Pcm16));
+        std::vector<float> tone(SAMPLE_RATE);
+        for (size_t i = 0; i < tone.size(); i++)
+        {
+            tone[i] = 0.5f * static_cast<float>(std::sin(6.283185307179586 * 220.0 * i / SAMPLE_RATE));
+        }
+        CHECK(writer.Write(tone.data(), tone.size()));
+        CHECK(writer.Close());
+    }
+
+    std::shared_ptr<SampleLibrary> library = std::make_shared<SampleLibrary>();
+    SampleZone zone = { library->AddSample(L"RealtimeCallbackTest.wav"), 0, 127, 1, 127, 57.0, 1.0f };
+    CHECK(zone.sample >= 0);
+    library->AddZone(zone);
+
+    Sampler sampler;
+    sampler.SetSampleRate(SAMPLE_RATE);
+    sampler.SetLibrary(library);
+    std::vector<float> mix(BLOCK_FRAMES * 2);
+
+    CheckRealtime("Sampler", [&] {
+        for (int b = 0; b < BLOCKS; b++)
+        {
+            sampler.BeginBlock();
+            sampler.Render(mix.data(), BLOCK_FRAMES / 2);
+            int key = 40 + b % 40;
+            sampler.HandleMidiMessage(0x90 | (key << 8) | (100 << 16));
+            if (b % 3 == 0)
+            {
+                sampler.HandleMidiMessage(0x80 | ((key - 2) << 8));
+            }
+            sampler.Render(mix.data() + BLOCK_FRAMES, BLOCK_FRAMES / 2);
+        }
+    });
+
+    // The swap is adopted on the audio thread; the old library is released
+    // elsewhere
+    sampler.SetLibrary(nullptr);
+    library.reset();
+    CheckRealtime("Sampler unload", [&] {
+        sampler.BeginBlock();
+        sampler.Render(mix.data(), BLOCK_FRAMES);
+    });
+    std::remove(SAMPLE_PATH);
+}
+
+class ToneInput : public StretchInput {
+public:
+    ToneInput() : m_position(0) {}
+
+    void ReadInput(float* interleaved, size_t frames) override
+    {
+        for (size_t i = 0; i < frames; i++, m_position++)
+        {
+            interleaved[2 * i] = 0.5f * std::sin(0.03f * static_cast<float>(m_position % 100000));
+            interleaved[2 * i + 1] = interleaved[2 * i];
+        }
+    }
+
+private:
+    uint64_t m_position;
+};
+
+static void TestTimeStretcher()
+{
+    ToneInput input;
+    TimeStretcher stretcher(2);
+    stretcher.SetInput(&input);
+    std::vector<float> block(BLOCK_FRAMES * 2);
+    const double stretches[] = { 0.25, 1.0, 1.5, 4.0 };
+    for (double stretch : stretches)
+    {
+        stretcher.SetStretch(stretch);
+        stretcher.SetPitchSemitones(stretch > 1.0 ? -5.0 : 7.0);
+        CheckRealtime("TimeStretcher", [&] {
+            for (int b = 0; b < BLOCKS; b++)
+            {
+                stretcher.Process(block.data(), BLOCK_FRAMES);
+            }
+        });
+    }
+}
+
+static void TestMidiPath()
+{
+    MidiOutBatcher batcher;
+    MidiBatchOptions options = { 1000, true, true };
+    CHECK(batcher.Start([](const uint8_t*, size_t) { return true; }, options));
+
+    MidiClockPll pll;
+    PublishedMidiClock published;
+
+    CheckRealtime("MIDI input", [&] {
+        double timeMs = 0.0;
+        for (int i = 0; i < 2000; i++)
+        {
+            batcher.Send(0xB0 | (74 << 8) | ((i & 0x7F) << 16));
+            if (i % 8 == 0)
+            {
+                timeMs += 20.8;
+                pll.OnTick(timeMs);
+                published.Publish(pll);
+            }
+        }
+    });
+    batcher.Stop();
+}
+
+int main()
+{
+    if (!RealtimeGuard::IsEnabled())
+    {
+        std::fprintf(stderr, "built without MUSICAPP_REALTIME_CHECKS\n");
+        return 1;
+    }
+
+    TestAllocationIsCaught();
+    TestFramePipelines();
+    TestMeterConcealerAndTap();
+    TestSampler();
+    TestTimeStretcher();
+    TestMidiPath();
+    return CheckResult();
+}
@@ -0,0 +1,196 @@
+#include "SampleTimeline.h"
+#include "TestCheck.h"
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+
+// Simulated capture devices whose sample clock drifts against the host
+// clock, with callbacks that arrive late by a random amount
+
+static const uint32_t BUFFER_FRAMES = 256;
+
+struct DriftingDevice {
+    double nominalRate;
+    double startPpm;            // Sample clock error at the start...
+    double endPpm;              // ...and at the end, changing linearly
+    double jitterMs;            // Callbacks arrive up to this late
+    double stallChance;         // Chance per buffer of a further 5-15 ms stall
+};
+
+struct TimelineResult {
+    double maxErrorSamples;     // Mapping error over the last half of the run
+    double rateErrorPpm;        // Measured rate against the device's final rate
+    double estimatedError;      // Reported by the timeline
+};
+
+static double g_virtualTimeMs = 0.0;
+
+static double VirtualClock()
+{
+    return g_virtualTimeMs;
+}
+
+static TimelineResult RunDevice(const DriftingDevice& device, double seconds, uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> late(0.0, device.jitterMs);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_real_distribution<double> stall(5.0, 15.0);
+
+    g_virtualTimeMs = 1000.0;
+    SampleTimeline timeline;
+    timeline.Reset(device.nominalRate);
+
+    TimelineResult result = {};
+    double bufferEndMs = g_virtualTimeMs;
+    uint64_t frames = 0;
+    int buffers = static_cast<int>(seconds * device.nominalRate / BUFFER_FRAMES);
+    double rate = device.nominalRate;
+    for (int buffer = 0; buffer < buffers; buffer++)
+    {
+        double ppm = device.startPpm + (device.endPpm - device.startPpm) * buffer / buffers;
+        rate = device.nominalRate * (1.0 + ppm * 1e-6);
+        bufferEndMs += BUFFER_FRAMES * 1000.0 / rate;
+        frames += BUFFER_FRAMES;
+
+        double delayMs = late(random);
+        if (chance(random) < device.stallChance)
+        {
+            delayMs += stall(random);
+        }
+        g_virtualTimeMs = bufferEndMs + delayMs;
+        timeline.Advance(SampleTimeline::CAPTURE_STREAM, BUFFER_FRAMES, SampleTimeline::HostTimeMs());
+
+        // The last frame of this buffer was captured exactly at bufferEndMs
+        if (buffer >= buffers / 2)
+        {
+            double error = std::fabs(timeline.HostTimeToSample(bufferEndMs) - static_cast<double>(frames));
+            result.maxErrorSamples = error > result.maxErrorSamples ? error : result.maxErrorSamples;
+        }
+    }
+
+    result.rateErrorPpm = std::fabs(timeline.GetMeasuredSampleRate() / rate - 1.0) * 1e6;
+    result.estimatedError = timeline.GetEstimatedErrorSamples();
+    return result;
+}
+
+static void TestNoiselessFit()
+{
+    // Exact anchors give the exact line and no residual
+    LinearClockFit fit;
+    fit.Reset(48.0);
+    CHECK(fit.GetSlope() == 48.0);
+    for (int i = 0; i < 100; i++)
+    {
+        fit.AddAnchor(i * 10.0, 1000.0 + i * 480.5);
+    }
+    CHECK(std::fabs(fit.GetSlope() - 48.05) < 1e-9);
+    CHECK(fit.GetResidualRms() < 0.01);
+    CHECK(std::fabs(fit.GetLatencyOffset()) < 1e-6);
+}
+
+static void TestDriftingClocks()
+{
+    SampleTimeline::SetHostClock(VirtualClock);
+
+    // A steady crystal error with a millisecond of scheduling jitter: the
+    // mapping stays within a quarter of a millisecond
+    for (uint32_t seed = 1; seed <= 3; seed++)
+    {
+        DriftingDevice device = { 44100.0, 150.0, 150.0, 1.0, 0.0 };
+        TimelineResult result = RunDevice(device, 120.0, seed);
+        CHECK(result.maxErrorSamples < 11.0);
+        CHECK(result.rateErrorPpm < 20.0);
+        CHECK(result.estimatedError > 0.0 && result.estimatedError < 44.1);
+    }
+
+    // Drift that wanders from -80 to +80 ppm, as a warming crystal would
+    DriftingDevice wandering = { 48000.0, -80.0, 80.0, 1.0, 0.0 };
+    TimelineResult result = RunDevice(wandering, 600.0, 4);
+    CHECK(result.maxErrorSamples < 12.0);
+    CHECK(result.rateErrorPpm < 20.0);
+
+    // Occasional long stalls: the late anchors must not drag the mapping
+    // by more than a millisecond
+    DriftingDevice stalling = { 44100.0, -200.0, -200.0, 2.0, 0.02 };
+    result = RunDevice(stalling, 300.0, 5);
+    CHECK(result.maxErrorSamples < 44.1);
+    CHECK(result.rateErrorPpm < 100.0);
+
+    SampleTimeline::SetHostClock(nullptr);
+}
+
+static void TestPositions()
+{
+    g_virtualTimeMs = 0.0;
+    SampleTimeline::SetHostClock(VirtualClock);
+    SampleTimeline timeline;
+    timeline.Reset(44100.0);
+
+    // Before any anchor, now maps to sample 0 at the nominal rate
+    CHECK(std::fabs(timeline.HostTimeToSample(10.0) - 441.0) < 1e-9);
+    CHECK(std::fabs(timeline.SampleToHostTime(441.0) - 10.0) < 1e-9);
+
+    CHECK(timeline.Advance(SampleTimeline::PLAYBACK_STREAM, 256, 5.0) == 0);
+    CHECK(timeline.Advance(SampleTimeline::PLAYBACK_STREAM, 256, 11.0) == 256);
+    timeline.Skip(SampleTimeline::PLAYBACK_STREAM, 100);
+    CHECK(timeline.GetSamplePosition(SampleTimeline::PLAYBACK_STREAM) == 612);
+    CHECK(timeline.GetSamplePosition(SampleTimeline::CAPTURE_STREAM) == 0);
+
+    // Playback does not move the fit
+    CHECK(std::fabs(timeline.HostTimeToSample(10.0) - 441.0) < 1e-9);
+
+    SampleTimeline::SetHostClock(nullptr);
+}
+
+static void TestConcurrentReaders()
+{
+    // Readers map host time to samples and back while the callback
+    // advances; a copy mixed from two fits would not round-trip
+    SampleTimeline timeline;
+    timeline.Reset(44100.0);
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+
+    std::thread readers[2];
+    for (std::thread& reader : readers)
+    {
+        reader = std::thread([&]
+        {
+            while (!done.load())
+            {
+                // Each call loads the fit once; a round trip that fails
+                // while the fit reads the same before and after was torn
+                double sample = timeline.HostTimeToSample(5000.0);
+                bool roundTrip = std::fabs(timeline.SampleToHostTime(sample) - 5000.0) < 1e-6;
+                if (!roundTrip && timeline.HostTimeToSample(5000.0) == sample)
+                {
+                    torn++;
+                }
+            }
+        });
+    }
+
+    double timeMs = 0.0;
+    for (int buffer = 0; buffer < 200000; buffer++)
+    {
+        timeMs += BUFFER_FRAMES / 44.1 * (1.0 + 0.001 * (buffer % 7));
+        timeline.Advance(SampleTimeline::CAPTURE_STREAM, BUFFER_FRAMES, timeMs);
+    }
+    done = true;
+    for (std::thread& reader : readers)
+    {
+        reader.join();
+    }
+    CHECK(torn == 0);
+}
+
+int main()
+{
+    TestNoiselessFit();
+    TestDriftingClocks();
+    TestPositions();
+    TestConcurrentReaders();
+    return CheckResult();
+}
@@ -0,0 +1,145 @@
+#include "Sampler.h"
+#include "WaveFileWriter.h"
+#include "BenchTimer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+// Per-block cost of a full voice pool playing mapped samples past their
+// preloaded attacks, and a check that unloading releases the library once
+// the audio thread has adopted the change
+static const size_t BLOCK_FRAMES = 64;
+static const double SAMPLE_RATE = 44100.0;
+
+// Long enough that every voice streams from the mapping for most of the run
+static const int BLOCKS = 10000;
+
+static const char* const MAP_PATH = "SamplerBenchmark.map";
+
+static bool WriteTone(const char* path, int channels, double seconds, WaveSampleFormat format)
+{
+    WaveFileWriter writer;
+    if (!writer.Open(path, channels, static_cast<uint32_t>(SAMPLE_RATE), format))
+    {
+        return false;
+    }
+    size_t frames = static_cast<size_t>(seconds * SAMPLE_RATE);
+    std::vector<float> samples(frames * channels);
+    for (size_t i = 0; i < frames; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            samples[i * channels + c] = 0.5f * static_cast<float>(std::sin(6.283185307179586 * 220.0 * i / SAMPLE_RATE));
+        }
+    }
+    bool ok = writer.Write(samples.data(), frames);
+    return writer.Close() && ok;
+}
+
+// A mono PCM16 sample on the low velocities and a stereo float one on the high
+static std::shared_ptr<SampleLibrary> LoadLibrary()
+{
+    if (!WriteTone("SamplerBenchmarkMono.wav", 1, 40.0, WaveSampleFormat::Pcm16) ||
+        !WriteTone("SamplerBenchmarkStereo.wav", 2, 40.0, WaveSampleFormat::Float32))
+    {
+        return nullptr;
+    }
+    std::ofstream(MAP_PATH) << "57 0 127 1 63 SamplerBenchmarkMono.wav\n"
+                               "57 0 127 64 127 SamplerBenchmarkStereo.wav\n";
+
+    std::shared_ptr<SampleLibrary> library = std::make_shared<SampleLibrary>();
+    std::wstring error;
+    if (!library->LoadMap(L"SamplerBenchmark.map", error))
+    {
+        std::fprintf(stderr, "%ls\n", error.c_str());
+        return nullptr;
+    }
+    return library;
+}
+
+static void MeasureVoices(const std::shared_ptr<SampleLibrary>& library, int velocity, const char* label)
+{
+    Sampler sampler;
+    sampler.SetLibrary(library);
+    sampler.SetGain(0.05f);
+    sampler.BeginBlock();
+    for (int v = 0; v < Sampler::MAX_VOICES; v++)
+    {
+        int key = 45 + v % 24;
+        sampler.HandleMidiMessage(0x90 | (key << 8) | (velocity << 16));
+    }
+
+    std::vector<float> mix(BLOCK_FRAMES * 2);
+    std::vector<double> times;
+    times.reserve(BLOCKS);
+    for (int i = 0; i < BLOCKS; i++)
+    {
+        double start = NowMicroseconds();
+        sampler.BeginBlock();
+        std::fill(mix.begin(), mix.end(), 0.0f);
+        sampler.Render(mix.data(), BLOCK_FRAMES);
+        times.push_back(NowMicroseconds() - start);
+    }
+
+    double budgetUs = BLOCK_FRAMES / SAMPLE_RATE * 1e6;
+    double p50 = Percentile(times, 0.5);
+    std::printf("%-14s %6d %9.1f %9.1f %9.1f %10.3f %10.0f\n", label, sampler.GetActiveVoiceCount(), p50,
+                Percentile(times, 0.99), Percentile(times, 1.0), p50 / Sampler::MAX_VOICES,
+                Sampler::MAX_VOICES * budgetUs / p50);
+}
+
+// Runs blocks the way the audio callback does, skipping the sampler when it
+// reports nothing to do, until the unloaded library is destroyed
+static bool UnloadReleasesLibrary(std::shared_ptr<SampleLibrary> library)
+{
+    std::weak_ptr<SampleLibrary> watch = library;
+    Sampler sampler;
+    sampler.SetLibrary(library);
+    library.reset();
+
+    std::vector<float> mix(BLOCK_FRAMES * 2);
+    bool unloaded = false;
+    for (int i = 0; i < 2000 && !watch.expired(); i++)
+    {
+        if (i == 10)
+        {
+            sampler.SetLibrary(nullptr);
+            unloaded = true;
+        }
+        if (sampler.IsActive())
+        {
+            sampler.BeginBlock();
+            sampler.Render(mix.data(), BLOCK_FRAMES);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return unloaded && watch.expired() && !sampler.IsActive();
+}
+
+int main()
+{
+    std::shared_ptr<SampleLibrary> library = LoadLibrary();
+    if (!library)
+    {
+        return EXIT_FAILURE;
+    }
+    std::printf("%zu samples, %zu KB of attacks preloaded\n", library->GetSampleCount(),
+                library->GetPreloadedBytes() / 1024);
+    std::printf("%zu-frame blocks, budget %.0f us per block\n", BLOCK_FRAMES, BLOCK_FRAMES / SAMPLE_RATE * 1e6);
+    std::printf("source         voices    p50 us    p99 us    max us   us/voice voices/core\n");
+    MeasureVoices(library, 100, "stereo float");
+    MeasureVoices(library, 40, "mono pcm16");
+
+    bool released = UnloadReleasesLibrary(std::move(library));
+    std::printf("\nunloaded library %s\n", released ? "released" : "STILL HELD");
+
+    std::remove(MAP_PATH);
+    std::remove("SamplerBenchmarkMono.wav");
+    std::remove("SamplerBenchmarkStereo.wav");
+    return released ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test executables. A failed check is reported and
+// counted rather than stopping the test, so one run shows every failure.
+static int g_checkFailures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_checkFailures++; \
+        } \
+    } while (0)
+
+// Returned from main
+inline int CheckResult()
+{
+    if (g_checkFailures > 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", g_checkFailures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include "TimeStretcher.h"
+#include "BenchTimer.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Offline quality across stretch and pitch settings, and the per-block CPU
+// cost of eight stereo loops at 64-frame blocks
+static const double SAMPLE_RATE = 44100.0;
+static const size_t BLOCK_FRAMES = 64;
+static const int LOOPS = 8;
+
+// A stereo chord, or noise, that counts the frames read from it
+class SignalInput : public StretchInput {
+public:
+    explicit SignalInput(double toneHz) : m_toneHz(toneHz), m_framesRead(0), m_random(1) {}
+
+    void ReadInput(float* interleaved, size_t frames) override
+    {
+        std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+        for (size_t i = 0; i < frames; i++)
+        {
+            float sample;
+            if (m_toneHz > 0.0)
+            {
+                sample = 0.5f * static_cast<float>(std::sin(6.283185307179586 * m_toneHz * (m_framesRead + i) / SAMPLE_RATE));
+            }
+            else
+            {
+                sample = noise(m_random);
+            }
+            interleaved[2 * i] = sample;
+            interleaved[2 * i + 1] = sample;
+        }
+        m_framesRead += frames;
+    }
+
+    double m_toneHz;
+    uint64_t m_framesRead;
+    std::mt19937 m_random;
+};
+
+static double MeasureFrequency(const std::vector<float>& stereo)
+{
+    double first = -1.0;
+    double last = -1.0;
+    int crossings = 0;
+    for (size_t i = 1; i < stereo.size() / 2; i++)
+    {
+        float previous = stereo[2 * (i - 1)];
+        float current = stereo[2 * i];
+        if (previous < 0.0f && current >= 0.0f)
+        {
+            double position = (i - 1) + previous / (previous - current);
+            first = first < 0.0 ? position : first;
+            last = position;
+            crossings++;
+        }
+    }
+    return crossings > 1 ? (crossings - 1) * SAMPLE_RATE / (last - first) : 0.0;
+}
+
+static double Rms(const std::vector<float>& samples)
+{
+    double sum = 0.0;
+    for (float sample : samples)
+    {
+        sum += static_cast<double>(sample) * sample;
+    }
+    return samples.empty() ? 0.0 : std::sqrt(sum / samples.size());
+}
+
+struct Quality {
+    double tempoErrorPercent;
+    double pitchErrorHz;
+    double rmsRatio;            // Output against input, on noise
+};
+
+static Quality MeasureQuality(double stretch, double semitones)
+{
+    Quality quality = {};
+    const size_t settle = 44100;
+    const size_t measured = 44100 * 3;
+    std::vector<float> block(BLOCK_FRAMES * 2);
+
+    // Tempo and pitch on a 440 Hz tone
+    {
+        SignalInput input(440.0);
+        TimeStretcher stretcher(2);
+        stretcher.SetInput(&input);
+        stretcher.SetStretch(stretch);
+        stretcher.SetPitchSemitones(semitones);
+        for (size_t done = 0; done < settle; done += BLOCK_FRAMES)
+        {
+            stretcher.Process(block.data(), BLOCK_FRAMES);
+        }
+        uint64_t readBefore = input.m_framesRead;
+        std::vector<float> output;
+        for (size_t done = 0; done < measured; done += BLOCK_FRAMES)
+        {
+            stretcher.Process(block.data(), BLOCK_FRAMES);
+            output.insert(output.end(), block.begin(), block.end());
+        }
+        double tempoRatio = static_cast<double>(measured) / (input.m_framesRead - readBefore);
+        quality.tempoErrorPercent = 100.0 * std::fabs(tempoRatio / stretch - 1.0);
+        quality.pitchErrorHz = std::fabs(MeasureFrequency(output) - 440.0 * std::pow(2.0, semitones / 12.0));
+    }
+
+    // Level on broadband noise
+    {
+        SignalInput input(0.0);
+        TimeStretcher stretcher(2);
+        stretcher.SetInput(&input);
+        stretcher.SetStretch(stretch);
+        stretcher.SetPitchSemitones(semitones);
+        for (size_t done = 0; done < settle; done += BLOCK_FRAMES)
+        {
+            stretcher.Process(block.data(), BLOCK_FRAMES);
+        }
+        std::vector<float> output;
+        for (size_t done = 0; done < measured; done += BLOCK_FRAMES)
+        {
+            stretcher.Process(block.data(), BLOCK_FRAMES);
+            output.insert(output.end(), block.begin(), block.end());
+        }
+        quality.rmsRatio = Rms(output) / (0.3 / std::sqrt(3.0));
+    }
+    return quality;
+}
+
+// Eight stereo loops, each with its own settings and staggered FFT frames
+static void MeasureCpu(double stretch, double semitones, const char* label)
+{
+    std::vector<std::unique_ptr<SignalInput>> inputs;
+    std::vector<std::unique_ptr<TimeStretcher>> stretchers;
+    for (int loop = 0; loop < LOOPS; loop++)
+    {
+        inputs.emplace_back(new SignalInput(220.0 + 55.0 * loop));
+        stretchers.emplace_back(new TimeStretcher(2));
+        stretchers.back()->SetInput(inputs.back().get());
+        stretchers.back()->SetStretch(stretch);
+        stretchers.back()->SetPitchSemitones(semitones);
+        stretchers.back()->SetFrameOffset(loop * TimeStretcher::SYNTHESIS_HOP / LOOPS);
+    }
+
+    std::vector<float> block(BLOCK_FRAMES * 2);
+    for (int i = 0; i < 200; i++)
+    {
+        for (auto& stretcher : stretchers)
+        {
+            stretcher->Process(block.data(), BLOCK_FRAMES);
+        }
+    }
+
+    std::vector<double> times;
+    for (int i = 0; i < 5000; i++)
+    {
+        double start = NowMicroseconds();
+        for (auto& stretcher : stretchers)
+        {
+            stretcher->Process(block.data(), BLOCK_FRAMES);
+        }
+        times.push_back(NowMicroseconds() - start);
+    }
+
+    double budgetUs = BLOCK_FRAMES / SAMPLE_RATE * 1e6;
+    std::printf("%-28s p50 %6.0f us  p99 %6.0f us  max %6.0f us  (budget %.0f us)\n", label, Percentile(times, 0.5),
+                Percentile(times, 0.99), Percentile(times, 1.0), budgetUs);
+}
+
+int main()
+{
+    std::printf("stretch  semitones  tempo error  pitch error  level\n");
+    const double stretches[] = { 0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 4.0 };
+    const double pitches[] = { -12.0, 0.0, 7.0 };
+    bool accurate = true;
+    for (double stretch : stretches)
+    {
+        for (double semitones : pitches)
+        {
+            Quality quality = MeasureQuality(stretch, semitones);
+            std::printf("%7.2f  %+9.0f  %10.3f%%  %8.2f Hz  %5.2f\n", stretch, semitones, quality.tempoErrorPercent,
+                        quality.pitchErrorHz, quality.rmsRatio);
+            accurate = accurate && quality.tempoErrorPercent < 1.0 && quality.pitchErrorHz < 1.0;
+        }
+    }
+
+    std::printf("\n%d stereo loops, %zu-frame blocks\n", LOOPS, BLOCK_FRAMES);
+    MeasureCpu(1.0, 0.0, "unity");
+    MeasureCpu(1.5, 3.0, "stretch 1.5, +3 semitones");
+    MeasureCpu(0.5, 7.0, "stretch 0.5, +7 semitones");
+    MeasureCpu(0.25, -12.0, "stretch 0.25, -12 semitones");
+
+    std::printf("\ntempo and pitch %s\n", accurate ? "within 1% and 1 Hz everywhere" : "OUT OF TOLERANCE");
+    return accurate ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,107 @@
+#include "TimeStretcher.h"
+#include "TestCheck.h"
+#include <cmath>
+#include <vector>
+
+// Tempo and pitch of the stretcher's output across stretch and pitch
+// settings, including the corners where the analysis hop is longer than
+// the FFT frame
+
+static const double SAMPLE_RATE = 44100.0;
+static const double TONE_HZ = 440.0;
+
+// A stereo sine that counts the frames read from it
+class ToneInput : public StretchInput {
+public:
+    ToneInput() : m_framesRead(0) {}
+
+    void ReadInput(float* interleaved, size_t frames) override
+    {
+        for (size_t i = 0; i < frames; i++)
+        {
+            float sample = 0.5f * static_cast<float>(std::sin(6.283185307179586 * TONE_HZ * (m_framesRead + i) / SAMPLE_RATE));
+            interleaved[2 * i] = sample;
+            interleaved[2 * i + 1] = sample;
+        }
+        m_framesRead += frames;
+    }
+
+    uint64_t m_framesRead;
+};
+
+// Frequency from upward zero crossings, interpolated between samples
+static double MeasureFrequency(const std::vector<float>& stereo)
+{
+    double first = -1.0;
+    double last = -1.0;
+    int crossings = 0;
+    for (size_t i = 1; i < stereo.size() / 2; i++)
+    {
+        float previous = stereo[2 * (i - 1)];
+        float current = stereo[2 * i];
+        if (previous < 0.0f && current >= 0.0f)
+        {
+            double position = (i - 1) + previous / (previous - current);
+            if (first < 0.0)
+            {
+                first = position;
+            }
+            last = position;
+            crossings++;
+        }
+    }
+    return crossings > 1 ? (crossings - 1) * SAMPLE_RATE / (last - first) : 0.0;
+}
+
+static void CheckSetting(double stretch, double semitones)
+{
+    ToneInput input;
+    TimeStretcher stretcher(2);
+    stretcher.SetInput(&input);
+    stretcher.SetStretch(stretch);
+    stretcher.SetPitchSemitones(semitones);
+
+    // Settle, then measure input consumed against output produced
+    const size_t block = 64;
+    std::vector<float> out(block * 2);
+    for (int i = 0; i < 2000; i++)
+    {
+        stretcher.Process(out.data(), block);
+    }
+    uint64_t readBefore = input.m_framesRead;
+    const size_t measured = 44100 * 4;
+    std::vector<float> collected;
+    collected.reserve(measured * 2);
+    for (size_t done = 0; done < measured; done += block)
+    {
+        stretcher.Process(out.data(), block);
+        collected.insert(collected.end(), out.begin(), out.end());
+    }
+
+    double tempoRatio = static_cast<double>(measured) / (input.m_framesRead - readBefore);
+    double expectedHz = TONE_HZ * std::pow(2.0, semitones / 12.0);
+    double measuredHz = MeasureFrequency(collected);
+
+    double tempoError = std::fabs(tempoRatio / stretch - 1.0);
+    if (tempoError > 0.01 || std::fabs(measuredHz - expectedHz) > 1.0)
+    {
+        std::fprintf(stderr, "stretch %.3f, %+.0f semitones: tempo ratio %.4f, %.2f Hz against %.2f Hz\n", stretch,
+                     semitones, tempoRatio, measuredHz, expectedHz);
+    }
+    CHECK(tempoError < 0.01);
+    CHECK(std::fabs(measuredHz - expectedHz) < 1.0);
+}
+
+int main()
+{
+    const double stretches[] = { 0.25, 0.5, 0.8, 1.0, 1.25, 2.0, 4.0 };
+    const double pitches[] = { -12.0, -5.0, 0.0, 7.0, 12.0 };
+    for (double stretch : stretches)
+    {
+        for (double semitones : pitches)
+        {
+            CheckSetting(stretch, semitones);
+        }
+    }
+    return CheckResult();
+}
@@ -0,0 +1,51 @@
+#include <windows.h>
+#include <mmsystem.h>
+#include <chrono>
+#include <thread>
+
+// The system has no wave or MIDI devices here; tests route audio through
+// SimulatedWaveDevice instead
+
+void Sleep(DWORD milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+void OutputDebugStringW(LPCWSTR)
+{
+}
+
+UINT waveInGetNumDevs() { return 0; }
+UINT waveOutGetNumDevs() { return 0; }
+MMRESULT waveInGetDevCapsW(UINT_PTR, WAVEINCAPSW*, UINT) { return MMSYSERR_NODRIVER; }
+MMRESULT waveOutGetDevCapsW(UINT_PTR, WAVEOUTCAPSW*, UINT) { return MMSYSERR_NODRIVER; }
+MMRESULT waveInOpen(LPHWAVEIN, UINT, LPCWAVEFORMATEX, DWORD_PTR, DWORD_PTR, DWORD) { return MMSYSERR_NODRIVER; }
+MMRESULT waveInClose(HWAVEIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInPrepareHeader(HWAVEIN, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInUnprepareHeader(HWAVEIN, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInAddBuffer(HWAVEIN, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInStart(HWAVEIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInStop(HWAVEIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveInReset(HWAVEIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveOutOpen(LPHWAVEOUT, UINT, LPCWAVEFORMATEX, DWORD_PTR, DWORD_PTR, DWORD) { return MMSYSERR_NODRIVER; }
+MMRESULT waveOutClose(HWAVEOUT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveOutPrepareHeader(HWAVEOUT, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveOutUnprepareHeader(HWAVEOUT, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveOutWrite(HWAVEOUT, LPWAVEHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT waveOutReset(HWAVEOUT) { return MMSYSERR_INVALHANDLE; }
+
+UINT midiInGetNumDevs() { return 0; }
+UINT midiOutGetNumDevs() { return 0; }
+MMRESULT midiInGetDevCapsW(UINT_PTR, MIDIINCAPSW*, UINT) { return MMSYSERR_NODRIVER; }
+MMRESULT midiOutGetDevCapsW(UINT_PTR, MIDIOUTCAPSW*, UINT) { return MMSYSERR_NODRIVER; }
+MMRESULT midiInOpen(HMIDIIN*, UINT, DWORD_PTR, DWORD_PTR, DWORD) { return MMSYSERR_NODRIVER; }
+MMRESULT midiInStart(HMIDIIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiInStop(HMIDIIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiInClose(HMIDIIN) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutOpen(HMIDIOUT*, UINT, DWORD_PTR, DWORD_PTR, DWORD) { return MMSYSERR_NODRIVER; }
+MMRESULT midiOutClose(HMIDIOUT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutReset(HMIDIOUT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutShortMsg(HMIDIOUT, DWORD) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutPrepareHeader(HMIDIOUT, LPMIDIHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutUnprepareHeader(HMIDIOUT, LPMIDIHDR, UINT) { return MMSYSERR_INVALHANDLE; }
+MMRESULT midiOutLongMsg(HMIDIOUT, LPMIDIHDR, UINT) { return MMSYSERR_INVALHANDLE; }
@@ -0,0 +1,3 @@
+#pragma once
+
+// Included by DeviceManager.cpp; nothing in it is used
@@ -0,0 +1,154 @@
+#pragma once
+
+// The winmm subset DeviceManager uses; see windows.h in this directory
+
+#include "windows.h"
+
+typedef UINT MMRESULT;
+typedef struct HWAVEIN__* HWAVEIN;
+typedef struct HWAVEOUT__* HWAVEOUT;
+typedef struct HMIDIIN__* HMIDIIN;
+typedef struct HMIDIOUT__* HMIDIOUT;
+typedef HWAVEIN* LPHWAVEIN;
+typedef HWAVEOUT* LPHWAVEOUT;
+
+#define MMSYSERR_NOERROR 0
+#define MMSYSERR_ERROR 1
+#define MMSYSERR_INVALHANDLE 5
+#define MMSYSERR_NODRIVER 6
+#define MMSYSERR_NOMEM 7
+#define WAVERR_STILLPLAYING 33
+#define WAVERR_UNPREPARED 34
+#define MIDIERR_NOTREADY 67
+
+#define WAVE_MAPPER ((UINT)-1)
+#define MIDI_MAPPER ((UINT)-1)
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#define CALLBACK_NULL 0x00000
+#define CALLBACK_FUNCTION 0x30000
+
+#define WIM_OPEN 0x3BE
+#define WIM_CLOSE 0x3BF
+#define WIM_DATA 0x3C0
+#define MIM_DATA 0x3C3
+#define MIM_LONGDATA 0x3C4
+#define MOM_DONE 0x3C9
+
+#define WHDR_DONE 0x01
+#define WHDR_PREPARED 0x02
+#define WHDR_INQUEUE 0x10
+#define MHDR_DONE 0x01
+#define MHDR_PREPARED 0x02
+#define MHDR_INQUEUE 0x04
+
+typedef struct {
+    WORD wFormatTag;
+    WORD nChannels;
+    DWORD nSamplesPerSec;
+    DWORD nAvgBytesPerSec;
+    WORD nBlockAlign;
+    WORD wBitsPerSample;
+    WORD cbSize;
+} WAVEFORMATEX;
+typedef const WAVEFORMATEX* LPCWAVEFORMATEX;
+
+typedef struct wavehdr_tag {
+    LPSTR lpData;
+    DWORD dwBufferLength;
+    DWORD dwBytesRecorded;
+    DWORD_PTR dwUser;
+    DWORD dwFlags;
+    DWORD dwLoops;
+    struct wavehdr_tag* lpNext;
+    DWORD_PTR reserved;
+} WAVEHDR, *LPWAVEHDR;
+
+typedef struct midihdr_tag {
+    LPSTR lpData;
+    DWORD dwBufferLength;
+    DWORD dwBytesRecorded;
+    DWORD_PTR dwUser;
+    DWORD dwFlags;
+    struct midihdr_tag* lpNext;
+    DWORD_PTR reserved;
+    DWORD dwOffset;
+    DWORD_PTR dwReserved[8];
+} MIDIHDR, *LPMIDIHDR;
+
+typedef struct {
+    WORD wMid;
+    WORD wPid;
+    UINT vDriverVersion;
+    wchar_t szPname[32];
+    DWORD dwFormats;
+    WORD wChannels;
+    WORD wReserved1;
+} WAVEINCAPSW;
+
+typedef struct {
+    WORD wMid;
+    WORD wPid;
+    UINT vDriverVersion;
+    wchar_t szPname[32];
+    DWORD dwFormats;
+    WORD wChannels;
+    WORD wReserved1;
+    DWORD dwSupport;
+} WAVEOUTCAPSW;
+
+typedef struct {
+    WORD wMid;
+    WORD wPid;
+    UINT vDriverVersion;
+    wchar_t szPname[32];
+    DWORD dwSupport;
+} MIDIINCAPSW;
+
+typedef struct {
+    WORD wMid;
+    WORD wPid;
+    UINT vDriverVersion;
+    wchar_t szPname[32];
+    WORD wTechnology;
+    WORD wVoices;
+    WORD wNotes;
+    WORD wChannelMask;
+    DWORD dwSupport;
+} MIDIOUTCAPSW;
+
+UINT waveInGetNumDevs();
+UINT waveOutGetNumDevs();
+MMRESULT waveInGetDevCapsW(UINT_PTR deviceId, WAVEINCAPSW* caps, UINT size);
+MMRESULT waveOutGetDevCapsW(UINT_PTR deviceId, WAVEOUTCAPSW* caps, UINT size);
+MMRESULT waveInOpen(LPHWAVEIN handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+MMRESULT waveInClose(HWAVEIN handle);
+MMRESULT waveInPrepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size);
+MMRESULT waveInUnprepareHeader(HWAVEIN handle, LPWAVEHDR header, UINT size);
+MMRESULT waveInAddBuffer(HWAVEIN handle, LPWAVEHDR header, UINT size);
+MMRESULT waveInStart(HWAVEIN handle);
+MMRESULT waveInStop(HWAVEIN handle);
+MMRESULT waveInReset(HWAVEIN handle);
+MMRESULT waveOutOpen(LPHWAVEOUT handle, UINT deviceId, LPCWAVEFORMATEX format, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+MMRESULT waveOutClose(HWAVEOUT handle);
+MMRESULT waveOutPrepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+MMRESULT waveOutUnprepareHeader(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+MMRESULT waveOutWrite(HWAVEOUT handle, LPWAVEHDR header, UINT size);
+MMRESULT waveOutReset(HWAVEOUT handle);
+
+UINT midiInGetNumDevs();
+UINT midiOutGetNumDevs();
+MMRESULT midiInGetDevCapsW(UINT_PTR deviceId, MIDIINCAPSW* caps, UINT size);
+MMRESULT midiOutGetDevCapsW(UINT_PTR deviceId, MIDIOUTCAPSW* caps, UINT size);
+MMRESULT midiInOpen(HMIDIIN* handle, UINT deviceId, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+MMRESULT midiInStart(HMIDIIN handle);
+MMRESULT midiInStop(HMIDIIN handle);
+MMRESULT midiInClose(HMIDIIN handle);
+MMRESULT midiOutOpen(HMIDIOUT* handle, UINT deviceId, DWORD_PTR callback, DWORD_PTR instance, DWORD flags);
+MMRESULT midiOutClose(HMIDIOUT handle);
+MMRESULT midiOutReset(HMIDIOUT handle);
+MMRESULT midiOutShortMsg(HMIDIOUT handle, DWORD message);
+MMRESULT midiOutPrepareHeader(HMIDIOUT handle, LPMIDIHDR header, UINT size);
+MMRESULT midiOutUnprepareHeader(HMIDIOUT handle, LPMIDIHDR header, UINT size);
+MMRESULT midiOutLongMsg(HMIDIOUT handle, LPMIDIHDR header, UINT size);
@@ -0,0 +1,40 @@
+#pragma once
+
+// The part of the Win32 API that DeviceManager, the simulated device and
+// the soak test use, so they build and run on other platforms for the
+// tests. Only declarations; WinmmStubs.cpp defines the functions.
+
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+#define CALLBACK
+#define WINAPI
+
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef int32_t LONG;
+typedef uintptr_t DWORD_PTR;
+typedef uintptr_t UINT_PTR;
+typedef char* LPSTR;
+typedef const wchar_t* LPCWSTR;
+
+#define TRUE 1
+#define FALSE 0
+
+inline void ZeroMemory(void* destination, size_t length)
+{
+    memset(destination, 0, length);
+}
+
+template <size_t N, typename... Args>
+int swprintf_s(wchar_t (&buffer)[N], const wchar_t* format, Args... args)
+{
+    return swprintf(buffer, N, format, args...);
+}
+
+void Sleep(DWORD milliseconds);
+void OutputDebugStringW(LPCWSTR text);